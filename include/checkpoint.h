@@ -0,0 +1,75 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _CHECKPOINT_H_INCLUDED
+#define _CHECKPOINT_H_INCLUDED
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "db_line.h"
+
+/*
+ * Checkpoints of the file system scan
+ *
+ * With 'checkpoint_interval' the entries of every directory whose subtree
+ * has been scanned completely are appended to '<database_out>.checkpoint'
+ * in the database format, followed by a line marking the directory as
+ * completed:
+ *
+ *   @@aide_checkpoint <version> <action> <root prefix> <limit> <shard> <config version> <config digest>
+ *   @@db_spec <fields>
+ *   <entries of the directory>
+ *   @@done <path of the directory>
+ *
+ * The file is synced at most every 'checkpoint_interval' seconds and removed
+ * after the reports have been written. With --resume the completed
+ * directories are not read again, their entries are added from the
+ * checkpoint instead (the comparison is done as usual). Incomplete data at
+ * the end of the file is discarded.
+ *
+ * Directories containing entries with the growing or compressed attribute
+ * (the comparison needs the file on disk) and their parents are never
+ * marked as completed.
+ */
+
+#define CHECKPOINT_VERSION 2
+
+/* lines of the entries of a directory not yet written to the checkpoint */
+typedef struct checkpoint_batch {
+    pthread_mutex_t mutex;
+    char *data;
+    size_t len;
+    size_t size;
+    bool incomplete;
+} checkpoint_batch;
+
+bool checkpoint_open(bool);
+bool checkpoint_active(void);
+void checkpoint_close(bool);
+
+checkpoint_batch *checkpoint_batch_new(void);
+void checkpoint_batch_add(checkpoint_batch *, db_line *);
+void checkpoint_batch_invalidate(checkpoint_batch *);
+bool checkpoint_batch_commit(checkpoint_batch *, const char *);
+
+bool checkpoint_replay(const char *, const char *);
+
+#endif
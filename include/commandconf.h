@@ -34,6 +34,9 @@ int parse_config(char *, char *, char *);
 
 int conf_input_wrapper(char* buf, int max_size, FILE* in);
 
+/* adds the configuration read by the lexer to conf->config_digest */
+void update_config_digest(const char *, size_t);
+
 bool add_rx_rule_to_tree(char*, char*, rx_restriction_t, DB_ATTR_TYPE, int, seltree*, int, char*, char*);
 
 void do_define(char*,char*, int, char*, char*);
@@ -56,6 +59,8 @@ bool do_rootprefix(char*, int, char*, char*);
 
 long do_num_workers(const char *);
 
+long long do_size(const char *);
+
 #ifdef WITH_E2FSATTRS
 void do_report_ignore_e2fsattrs(char*, int, char*, char*);
 #endif
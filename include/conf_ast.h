@@ -53,6 +53,30 @@ typedef enum config_option {
     REPORT_FORMAT_OPTION,
     LIMIT_CMDLINE_OPTION,
     NUM_WORKERS,
+    WORK_STEALING_OPTION,
+    HASH_IO_ENGINE_OPTION,
+    PARALLEL_HASHSUMS_THRESHOLD_OPTION,
+    PARALLEL_BLAKE3_THRESHOLD_OPTION,
+    DATABASE_FORMAT_OPTION,
+    DATABASE_OUT_BUFFER_SIZE_OPTION,
+    DATABASE_GZIP_LEVEL_OPTION,
+    DATABASE_GZIP_THREADS_OPTION,
+    DATABASE_ZSTD_OPTION,
+    DATABASE_ZSTD_LEVEL_OPTION,
+    DATABASE_ZSTD_THREADS_OPTION,
+    TRUST_CTIME_OPTION,
+    TRUST_CTIME_VERIFY_PERCENTAGE_OPTION,
+    SORT_DIRECTORY_ENTRIES_OPTION,
+    MAX_PENDING_ENTRIES_OPTION,
+    DATABASE_IN_CONCURRENT_OPTION,
+    DATABASE_PARSE_THREADS_OPTION,
+    DATABASE_OUT_INDEX_OPTION,
+    DATABASE_IN_DELTA_OPTION,
+    DATABASE_OUT_DELTA_OPTION,
+    DATABASE_IN_SHARD_OPTION,
+    SHARD_CMDLINE_OPTION,
+    CHECKPOINT_INTERVAL_OPTION,
+    DAEMON_MAX_REQUESTS_OPTION,
 } config_option;
 
 typedef struct {
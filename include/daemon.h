@@ -0,0 +1,59 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _DAEMON_H_INCLUDED
+#define _DAEMON_H_INCLUDED
+
+#include <stdbool.h>
+
+/*
+ * Daemon mode
+ *
+ * --daemon=SOCKET parses the configuration, compiles the rule tree and reads
+ * all entries of database_in once, then accepts check requests on the UNIX
+ * socket SOCKET. A request consists of 'key=value' lines terminated by an
+ * empty line (or the end of the input):
+ *
+ *   limit=<regex>          limit the check to the matching entries (--limit)
+ *   report_format=<format> format of the reports
+ *   report_url=<url>       replaces the configured report URLs (repeatable)
+ *
+ * Every request is run by a child process forked from the daemon, i.e. it
+ * shares the resident rule tree and old entries copy-on-write and scans the
+ * file system with num_workers workers. At most 'daemon_max_requests'
+ * requests run concurrently. Reports written to stdout are sent to the
+ * client, the last line sent is '@@aide_exit <exit code>'.
+ *
+ * On SIGHUP or if the configuration file or database_in changes, the daemon
+ * executes itself again to reload both (the listening socket is passed in
+ * the environment variable DAEMON_SOCKET_FD_ENV); SIGINT and SIGTERM stop
+ * the daemon.
+ */
+
+#define DAEMON_REQUEST_MAX_SIZE (64*1024)
+#define DAEMON_REQUEST_TIMEOUT 30
+#define DAEMON_SOCKET_FD_ENV "AIDE_DAEMON_SOCKET_FD"
+
+int daemon_run(const char *, char **);
+
+/* applies the request to conf, on error it is sent to stdout */
+bool daemon_apply_request(char *);
+
+#endif
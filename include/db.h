@@ -31,11 +31,14 @@ typedef enum {
     DB_TYPE_IN,
     DB_TYPE_OUT,
     DB_TYPE_NEW,
+    DB_TYPE_IN_DELTA,
+    DB_TYPE_IN_SHARD,
 } DB_TYPE;
 
 typedef struct {
     db_line* line;
     bool limit;
+    bool removed; /* '@@remove' line of a delta database (see db_delta.h) */
 } db_entry_t;
 
 byte* base64tobyte(char*, int, size_t *);
@@ -45,10 +48,18 @@ db_line* db_char2line(char**, database*);
 int db_init(database*, bool, bool);
 
 db_entry_t db_readline(database*, bool);
+db_entry_t db_readline_single(database*, bool);
+
+DB_ATTR_TYPE db_get_attrs(database*);
 
 int db_writespec(db_config*);
 
 int db_writeline(db_line*,db_config*);
+int db_writeremoved(db_line*,db_config*);
+
+long db_convert(database**, int);
+
+void db_finish_attrs(database*);
 
 void db_close(void);
 
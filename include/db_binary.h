@@ -0,0 +1,57 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _DB_BINARY_H_INCLUDED
+#define _DB_BINARY_H_INCLUDED
+
+#include <stdbool.h>
+#include "attributes.h"
+#include "db.h"
+#include "db_config.h"
+
+/*
+ * Binary database format
+ *
+ * The file consists of a fixed header, an array of fixed-width records (one
+ * per entry, sorted by path) and a string table. Each record holds the stat
+ * fields, references into the string table for variable-length fields (path,
+ * link name, ACLs, extended attributes, ...) and the raw hashsum bytes of all
+ * hashsums of the database attributes. All values are stored in host byte
+ * order, the header contains a byte order mark.
+ *
+ * Input databases in binary format are detected by their magic and read via
+ * mmap(2).
+ */
+
+#define DB_BINARY_VERSION 1
+
+bool db_binary_detect(database *);
+int db_binary_open(database *);
+db_entry_t db_readline_binary(database *, bool);
+DB_ATTR_TYPE db_binary_get_attrs(database *);
+void db_binary_close(database *);
+
+int db_writespec_binary(db_config *);
+int db_writeline_binary(db_line *, db_config *);
+int db_close_binary(db_config *);
+
+int db_path_cmp(const char *, const char *);
+
+#endif
@@ -30,6 +30,10 @@
 #include <sys/types.h>
 #ifdef WITH_ZLIB
 #include <zlib.h>
+#include "pgzip.h"
+#endif
+#ifdef WITH_ZSTD
+#include "zstdio.h"
 #endif
 #include "attributes.h"
 #include "db_line.h"
@@ -50,6 +54,11 @@
 #define DO_DIFF     (1<<2)
 #define DO_DRY_RUN  (1<<3)
 #define DO_LIST     (1<<4)
+#define DO_CONVERT  (1<<5)
+#define DO_COMPACT  (1<<6)
+#define DO_MERGE    (1<<7)
+#define DO_PLAN_SHARDS (1<<8)
+#define DO_DAEMON   (1<<9)
 
 /* TIMEBUFSIZE should be exactly ceil(sizeof(time_t)*8*ln(2)/ln(10))
  * Now it is ceil(sizeof(time_t)*2.5)
@@ -81,8 +90,24 @@ typedef enum {
    DB_FLAG_NONE     =0,
    DB_FLAG_CREATED  =1,
    DB_FLAG_PARSE    =2,
+   DB_FLAG_INDEX_CHECKED =4,
+   DB_FLAG_INDEX    =8,
+   DB_FLAG_DELTA    =16,
 } DB_FLAG;
 
+typedef enum {
+   DB_FORMAT_TEXT = 0,
+   DB_FORMAT_BINARY,
+} DB_FORMAT;
+
+typedef enum {
+   HASH_IO_ENGINE_SYNC = 0,
+   HASH_IO_ENGINE_URING,
+} HASH_IO_ENGINE;
+
+struct db_binary;
+struct db_parser;
+
 typedef struct database {
     url_t* url;
 
@@ -93,6 +118,11 @@ typedef struct database {
     void *fp;
 #ifdef WITH_ZLIB
     gzFile gzp;
+    pgzip_t *pgz;
+#endif
+#ifdef WITH_ZSTD
+    zstd_reader_t *zstd_in;
+    zstd_writer_t *zstd_out;
 #endif
 
     long lineno;
@@ -101,6 +131,22 @@ typedef struct database {
     struct md_container *mdc;
     struct db_line *db_line;
 
+    /* set if database is in binary format */
+    struct db_binary *binary;
+
+    /* set while the database body is parsed by multiple threads */
+    struct db_parser *parser;
+
+    /* position in the uncompressed database, reading stops at read_end if
+     * DB_FLAG_INDEX is set (see db_index.h) */
+    unsigned long long read_pos;
+    unsigned long long read_end;
+
+    /* set if database_in is merged with its delta databases (see db_delta.h) */
+    struct db_merge *merge;
+    /* hashsums of the parent database ('@@delta_db') if DB_FLAG_DELTA is set */
+    char *delta_parent;
+
     DB_FLAG flags;
 
 } database;
@@ -111,21 +157,39 @@ typedef struct db_config {
   database database_in;
   database database_out;
   database database_new;
+  database *database_in_deltas;
+  int num_database_in_deltas;
+  database *database_in_shards;
+  int num_database_in_shards;
 
   DB_ATTR_TYPE db_attrs;
 
 #ifdef WITH_ZLIB
   /* Is dbout gzipped or not */
   int gzip_dbout;
+  int gzip_dbout_level;
+  long gzip_dbout_threads;
   
+#endif
+#ifdef WITH_ZSTD
+  bool zstd_dbout;
+  int zstd_dbout_level;
+  long zstd_dbout_threads;
 #endif
 
   DB_ATTR_TYPE db_out_attrs;
 
+  DB_FORMAT database_format;
+  long long database_out_buffer_size;
+  bool database_out_index;
+  bool database_out_delta;
+
   file_t check_file;
   
   char* config_file;
   char* config_version;
+  /* 'sha256:<base64>' digest of the configuration read by parse_config() */
+  char* config_digest;
   char* aide_version;
   bool config_check_warn_unrestricted_rules;
 
@@ -157,6 +221,30 @@ typedef struct db_config {
   int action;
 
   long num_workers;
+  long database_parse_threads;
+  bool work_stealing;
+  HASH_IO_ENGINE hash_io_engine;
+  long long parallel_hashsums_threshold;
+  long long parallel_blake3_threshold;
+  bool sort_directory_entries;
+  long max_pending_entries;
+  bool database_in_concurrent;
+
+  /* see checkpoint.h */
+  long checkpoint_interval;
+  bool resume;
+
+  /* see daemon.h */
+  char *daemon_socket;
+  long daemon_max_requests;
+
+  bool trust_ctime;
+  int trust_ctime_verify_percentage;
+  long num_reused_hashsums;
+  long num_computed_hashsums;
+  long num_hardlink_hashsums;
+  long long hardlink_bytes_saved;
+  long num_unchanged_streamed;
 
   int progress;
   bool no_color;
@@ -181,7 +269,11 @@ typedef struct db_config {
 
   char* limit;
   pcre2_code* limit_crx;
-  pcre2_match_data* limit_md;
+
+  /* --shard argument and the loaded shard plan (see shard.h) */
+  char *shard;
+  struct shard_plan *shard_plan;
+  int num_shards;
 
   struct seltree* tree;
 
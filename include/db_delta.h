@@ -0,0 +1,50 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _DB_DELTA_H_INCLUDED
+#define _DB_DELTA_H_INCLUDED
+
+#include <stdbool.h>
+#include "db.h"
+#include "db_config.h"
+
+/*
+ * Delta databases
+ *
+ * With 'database_out_delta' --update writes only the added and changed
+ * entries and a '@@remove' line for every removed entry to database_out. The
+ * '@@delta_db' line of the header lists the database_attrs hashsums of the
+ * database the delta is based on (i.e. the last database of the chain read).
+ *
+ * database_in is merged on read with the delta databases configured by
+ * 'database_in_delta' (in the order of the chain, see db_merge.h), i.e. for
+ * every path the entry of the latest database wins. After the databases have been read the
+ * recorded hashsums of every delta database are verified against its
+ * predecessor.
+ *
+ * --compact writes the merged chain to database_out as new base database.
+ */
+
+int db_delta_init(database *);
+
+char *db_delta_parent_hashsums(void);
+int db_delta_verify(void);
+
+#endif
@@ -27,12 +27,16 @@
 #ifdef HAVE_FSTYPE
 #include "file.h"
 #endif
+#include "md.h"
 #include <sys/stat.h>
 #include <stdbool.h>
 
 typedef struct disk_entry {
     char *filename;
+    int dirfd; /* directory file descriptor name is relative to (or AT_FDCWD) */
+    const char *name;
     struct stat fs;
+    DB_ATTR_TYPE stat_attrs; /* stat fields in fs that are valid (as attributes) */
 #ifdef HAVE_FSTYPE
     FS_TYPE fs_type;
 #endif
@@ -40,5 +44,9 @@ typedef struct disk_entry {
     DB_ATTR_TYPE attrs;
 } disk_entry;
 
+struct hash_buffers;
+
 void db_scan_disk(bool);
+md_hashsums calc_hashsums_hardlinked(disk_entry *, DB_ATTR_TYPE, struct hash_buffers *, int, const char *);
+void hardlink_hashsums_reused(disk_entry *);
 #endif
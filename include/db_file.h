@@ -27,10 +27,19 @@
 #include <stdbool.h>
 
 db_entry_t db_readline_file(database*, bool);
+db_line *db_parse_line_file(database*, char *);
+void db_parser_close(database*);
 
 int db_writespec_file(db_config*);
 int db_writeline_file(db_line*);
+int db_writeremoved_file(db_line*);
+char *db_format_lines_file(db_line **, size_t, size_t *);
+void db_append_line_file(db_line *, char **, size_t *, size_t *);
+void db_write_formatted_file(char *, size_t, db_line **, size_t);
 
 int db_close_file(db_config*);
 
+void handle_io_error_on_write(char *);
+void fsync_database(db_config*);
+
 #endif
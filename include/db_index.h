@@ -0,0 +1,62 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _DB_INDEX_H_INCLUDED
+#define _DB_INDEX_H_INCLUDED
+
+#include <stdbool.h>
+#include "db_config.h"
+
+/*
+ * Block index of text databases
+ *
+ * With 'database_out_index' the text database is written in blocks of
+ * complete lines (for gzipped databases every block is a separate gzip
+ * member) and the sidecar file '<database_out>.idx' lists for every block
+ * the file offset, the position in the uncompressed data, the number of the
+ * first line and the first and last path.
+ *
+ * With --limit the index of database_in is used to read only the blocks
+ * which may contain paths starting with the literal prefix of the limit. The
+ * database itself stays a plain text or gzip file.
+ */
+
+#define DB_INDEX_VERSION 2
+#define DB_INDEX_BLOCK_SIZE (4*1024*1024)
+
+typedef struct db_index db_index_t;
+
+typedef struct db_index_range {
+    unsigned long long offset; /* file offset of the first block */
+    unsigned long long pos; /* uncompressed position of the first block */
+    unsigned long long end; /* uncompressed position after the last block */
+    long lineno; /* line number of the first line of the first block */
+} db_index_range;
+
+db_index_t *db_index_new(void);
+void db_index_add_block(db_index_t *, unsigned long long, unsigned long long, long);
+void db_index_add_path(db_index_t *, const char *);
+void db_index_write(db_index_t *, database *, unsigned long long);
+void db_index_free(db_index_t *);
+
+char *get_limit_prefix(const char *);
+bool db_index_find(database *, db_index_range *);
+
+#endif
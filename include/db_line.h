@@ -96,6 +96,9 @@ typedef struct db_line {
   /* Attributes .... */
   DB_ATTR_TYPE attr;
 
+  /* hashsums copied from the old database instead of being computed */
+  DB_ATTR_TYPE reused_hashsums;
+
 } db_line;
 
 #endif
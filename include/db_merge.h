@@ -0,0 +1,44 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _DB_MERGE_H_INCLUDED
+#define _DB_MERGE_H_INCLUDED
+
+#include <stdbool.h>
+#include "db.h"
+#include "db_config.h"
+
+/*
+ * k-way merge of databases sorted by path (see db_path_cmp())
+ *
+ * The entries of all databases are returned in a single pass in path order.
+ * If a path is found in multiple databases the entry of the last database
+ * wins (delta databases, see db_delta.h), entries read from '@@remove' lines
+ * drop the path. With 'disjoint' set a path found in multiple databases is
+ * an error (shard databases, see shard.h).
+ */
+
+typedef struct db_merge db_merge_t;
+
+db_merge_t *db_merge_new(database **, int, bool);
+db_entry_t db_merge_readline(db_merge_t *, bool);
+void db_merge_free(db_merge_t *);
+
+#endif
@@ -30,9 +30,17 @@
 #include "db_config.h"
 #include "md.h"
 
+/* per-worker read buffers for hashsum calculation */
+typedef struct hash_buffers {
+    char *small;
+    char *large;
+} hash_buffers;
+
 list* do_md(list* file_lst,db_config* conf);
 int stat_cmp(struct stat*, struct stat*, bool);
-md_hashsums calc_hashsums(disk_entry *, DB_ATTR_TYPE, ssize_t, bool, int, const char *);
+hash_buffers *hash_buffers_init(void);
+void hash_buffers_free(hash_buffers *);
+md_hashsums calc_hashsums(disk_entry *, DB_ATTR_TYPE, ssize_t, bool, hash_buffers *, int, const char *);
 
 #ifdef WITH_ACL
 void acl2line(db_line* line, int, const char *);
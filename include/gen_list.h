@@ -30,6 +30,7 @@
 #include "db_disk.h"
 
 struct stat;
+struct hash_buffers;
 
 /* DB_FOO are anded together to form rx_rule's attr */
 
@@ -40,13 +41,17 @@ struct stat;
  */
 void populate_tree(seltree*);
 
+void read_old_database(seltree*);
+void limit_old_entries(seltree*);
+
 void write_tree(seltree*);
 
 match_t check_rxtree(file_t, seltree*, char *, bool, const char *);
 match_result check_limit(char*, bool, const char *);
 
-struct db_line* get_file_attrs(disk_entry *, DB_ATTR_TYPE, DB_ATTR_TYPE, int, const char *);
+struct db_line* get_file_attrs(disk_entry *, DB_ATTR_TYPE, DB_ATTR_TYPE, const struct db_line *, struct hash_buffers *, int, const char *);
 void add_file_to_tree(seltree*, db_line*, int, const database *, disk_entry *, const char*);
+void wait_for_old_entries(const char *, bool, const char *);
 
 void print_match(file_t, match_t);
 #endif /*_GEN_LIST_H_INCLUDED*/
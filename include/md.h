@@ -38,11 +38,13 @@
 #ifdef WITH_BLAKE3
 #include <blake3.h>
 #endif
+#include <stdbool.h>
 #include <sys/types.h>
 #include "attributes.h"
 #include "hashsum.h"
 #include "util.h"
 struct db_line;
+struct md_parallel;
 
 /*
   This struct hold's internal data needed for md-calls.
@@ -85,7 +87,14 @@ typedef struct md_container {
 
 #ifdef WITH_BLAKE3
   blake3_hasher blake3;
+  /* use multithreaded update (if supported by libblake3) */
+  bool blake3_parallel;
 #endif
+
+  /*
+    Helper threads updating the hashsums concurrently (NULL if disabled).
+   */
+  struct md_parallel *parallel;
 } md_container;
 
 typedef struct md_hashsums {
@@ -94,6 +103,7 @@ typedef struct md_hashsums {
 } md_hashsums;
 
 int init_md(struct md_container*, const char*, const char *);
+int init_md_parallel(struct md_container*, const char*, const char *);
 int update_md(struct md_container*,void*,ssize_t);
 int close_md(struct md_container*, md_hashsums *, const char*, const char *);
 void hashsums2line(md_hashsums*, struct db_line*, const char *);
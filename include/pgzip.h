@@ -0,0 +1,49 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _PGZIP_H_INCLUDED
+#define _PGZIP_H_INCLUDED
+
+#include <stdio.h>
+
+/*
+ * Block-parallel gzip writer
+ *
+ * The input is split into blocks which are deflated independently by a pool
+ * of compression threads (every block is primed with the last 32 KiB of its
+ * predecessor as dictionary). The compressed blocks are written in order as a
+ * single standard gzip member, i.e. the output can be read by gzgets(3) or
+ * gzip(1).
+ *
+ * With 0 (zero) threads the blocks are compressed by the writing thread.
+ *
+ * pgzip_new_member() finishes the current gzip member and starts a new one,
+ * so the data following can be decompressed starting at the returned file
+ * offset (the concatenated members still form a valid gzip file).
+ */
+
+typedef struct pgzip_s pgzip_t;
+
+pgzip_t *pgzip_open(FILE *, int, int);
+int pgzip_write(pgzip_t *, const char *, size_t);
+int pgzip_new_member(pgzip_t *, unsigned long long *);
+int pgzip_close(pgzip_t *);
+
+#endif
@@ -28,6 +28,7 @@ typedef struct queue_s queue_ts_t;
 queue_ts_t *queue_ts_init(void);
 void  queue_ts_free(queue_ts_t *);
 bool  queue_ts_enqueue(queue_ts_t * const, void * const, const char *);
+bool  queue_ts_push(queue_ts_t * const, void * const, const char *);
 void *queue_ts_dequeue_wait(queue_ts_t * const, const char *);
 void  queue_ts_register(queue_ts_t * const, const char *);
 void  queue_ts_release(queue_ts_t * const, const char *);
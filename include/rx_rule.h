@@ -24,6 +24,7 @@
 
 #include "config.h"
 #include "file.h"
+#include <stdbool.h>
 #include <sys/stat.h>
 #define PCRE2_CODE_UNIT_WIDTH 8
 #include <pcre2.h>
@@ -46,7 +47,9 @@ typedef enum {
 typedef struct rx_rule {
   char* rx; /* Regular expression in text form */
   pcre2_code* crx; /* Compiled regexp */
-  pcre2_match_data *md;
+  char *literal; /* Unescaped text if rx is a literal path (optionally followed by '$'), otherwise NULL */
+  size_t literal_length;
+  bool literal_eol;
   AIDE_RULE_TYPE type;
   DB_ATTR_TYPE attr; /* Which attributes to save */
   char *config_filename;
@@ -75,6 +78,11 @@ typedef struct match_t {
     int length;
 } match_t;
 
+pcre2_match_data *get_thread_match_data(void);
+
+void init_rx_literal(rx_rule *);
+int match_rx_rule(rx_rule *, const char *);
+
 char* get_rule_type_long_string(AIDE_RULE_TYPE);
 char* get_rule_type_char(AIDE_RULE_TYPE);
 
@@ -22,6 +22,7 @@
 #ifndef _SELTREE_STRUCT_H_INCLUDED
 #define _SELTREE_STRUCT_H_INCLUDED
 #include <pthread.h>
+#include <stdbool.h>
 #include "attributes.h"
 #include "list.h"
 #include "tree.h"
@@ -46,5 +47,10 @@ struct seltree {
 
   DB_ATTR_TYPE changed_attrs;
 
+  /* immutable copy of the rule nodes used by check_seltree (root node only), see compile_seltree() */
+  struct seltree* rule_tree;
+  /* node is part of a rule tree and is not locked */
+  bool frozen;
+
 };
 #endif /* _SELTREE_STRUCT_H_INCLUDED */
@@ -0,0 +1,59 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SHARD_H_INCLUDED
+#define _SHARD_H_INCLUDED
+
+#include <stdio.h>
+#include "db_config.h"
+#include "rx_rule.h"
+
+/*
+ * Sharded scanning
+ *
+ * --plan-shards=N splits the tree of database_in into N shards of about the
+ * same number of entries: the largest subtrees are split into their child
+ * directories until every subtree is small enough, then the subtrees are
+ * assigned to the shards (longest processing time first). Shard 0 owns
+ * everything which is not below a subtree of another shard (i.a. the
+ * parents of all subtrees), so the shards are disjoint and together cover
+ * the whole tree.
+ *
+ * The plan file lists one subtree per line:
+ *
+ *   @@aide_shard_plan <version> <number of shards>
+ *   <shard> <number of entries> <path>
+ *
+ * --shard=INDEX:PLANFILE restricts --init and --check to the paths of the
+ * given shard (like --limit). The shard databases written by --init can be
+ * merged into a single database with --merge (see 'database_in_shard').
+ */
+
+#define SHARD_PLAN_VERSION 1
+
+typedef struct shard_plan shard_plan_t;
+
+shard_plan_t *shard_plan_load(const char *, int);
+match_result shard_check(shard_plan_t *, const char *);
+void shard_plan_free(shard_plan_t *);
+
+int shard_plan_write(database *, int, FILE *);
+
+#endif
@@ -33,4 +33,6 @@ tree_node *tree_walk_next(tree_node *);
 
 void *tree_get_data(tree_node *n);
 
+void tree_free(tree_node *, void (*)(void*));
+
 #endif
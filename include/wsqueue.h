@@ -0,0 +1,46 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _WSQUEUE_H_INCLUDED
+#define _WSQUEUE_H_INCLUDED
+
+#include <stdbool.h>
+
+/*
+ * Work-stealing queue: every worker owns a deque, pushes and pops work items
+ * at its bottom (LIFO) and steals from the top (FIFO) of the deques of other
+ * workers when its own deque runs dry.
+ *
+ * Termination is detected by counting pending work items: an item is pending
+ * from wsqueue_push() until the worker that popped it calls wsqueue_done().
+ * wsqueue_pop_wait() returns NULL once no work item is pending any more.
+ */
+
+typedef struct wsqueue_s wsqueue_t;
+
+wsqueue_t *wsqueue_init(int);
+void  wsqueue_free(wsqueue_t *);
+void  wsqueue_push(wsqueue_t * const, int, void * const, const char *);
+void *wsqueue_pop_wait(wsqueue_t * const, int, const char *);
+void  wsqueue_done(wsqueue_t * const, const char *);
+unsigned long wsqueue_get_num_popped(wsqueue_t * const, int);
+unsigned long wsqueue_get_num_stolen(wsqueue_t * const, int);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef _ZSTDIO_H_INCLUDED
+#define _ZSTDIO_H_INCLUDED
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * Streaming Zstandard reader and writer
+ *
+ * The reader decompresses (possibly concatenated) zstd frames from a file
+ * descriptor, which is not closed by zstd_reader_close. The writer compresses
+ * into a FILE stream, using libzstd's worker threads if num_threads > 0.
+ */
+
+typedef struct zstd_reader_s zstd_reader_t;
+typedef struct zstd_writer_s zstd_writer_t;
+
+zstd_reader_t *zstd_reader_open(int);
+ssize_t zstd_reader_read(zstd_reader_t *, void *, size_t);
+char *zstd_reader_gets(zstd_reader_t *, char *, size_t);
+const char *zstd_reader_error(zstd_reader_t *);
+void zstd_reader_close(zstd_reader_t *);
+
+zstd_writer_t *zstd_writer_open(FILE *, int, int);
+int zstd_writer_write(zstd_writer_t *, const char *, size_t);
+int zstd_writer_close(zstd_writer_t *);
+
+#endif
@@ -32,12 +32,15 @@
 #include <time.h>
 #include <stdbool.h>
 #include <string.h>
+#include <limits.h>
 #define PCRE2_CODE_UNIT_WIDTH 8
 #include <pcre2.h>
 
 #include <unistd.h>
 
 #include "attributes.h"
+#include "checkpoint.h"
+#include "daemon.h"
 #include "hashsum.h"
 #include "file.h"
 #include "url.h"
@@ -49,6 +52,7 @@
 #include "log.h"
 #include "progress.h"
 #include "seltree.h"
+#include "shard.h"
 #include "errorcodes.h"
 #include "gen_list.h"
 #include "getopt.h"
@@ -76,6 +80,11 @@ static void usage(int exitvalue)
 	    "  -u, --update\t\tCheck and update the database non-interactively\n"
 	    "  -E, --compare\t\tCompare two databases\n"
 	    "      --list\t\tList the entries of the database in human readable format\n"
+	    "      --convert\t\tConvert the database to the configured database format\n"
+	    "      --compact\t\tMerge the database and its delta databases into a new database\n"
+	    "      --plan-shards=N\tSplit the entries of the database into N shards and print the shard plan\n"
+	    "      --merge\t\tMerge the shard databases into a single database\n"
+	    "      --daemon=SOCKET\tKeep rule tree and database resident and run checks requested on SOCKET\n"
 	    "\nMiscellaneous:\n"
 	    "  -D,\t\t\t--config-check\t\t\tTest the configuration file\n"
 	    "  -p FILE_TYPE:PATH\t--path-check=FILE_TYPE:PATH\tMatch file type and path against rule tree\n"
@@ -84,6 +93,8 @@ static void usage(int exitvalue)
 	    "Options:\n"
 	    "  -c CFGFILE\t--config=CFGFILE\tGet config options from CFGFILE\n"
 	    "  -l REGEX\t--limit=REGEX\t\tLimit command to entries matching REGEX\n"
+	    "  \t\t--shard=INDEX:PLAN\tLimit command to entries of shard INDEX of shard plan PLAN\n"
+	    "  \t\t--resume\t\tResume the interrupted command from its checkpoint\n"
 	    "  -B \"OPTION\"\t--before=\"OPTION\"\tBefore configuration file is read define OPTION\n"
 	    "  -A \"OPTION\"\t--after=\"OPTION\"\tAfter configuration file is read define OPTION\n"
 	    "  -L LEVEL\t--log-level=LEVEL\tSet log message level to LEVEL\n"
@@ -231,6 +242,13 @@ static void read_param(int argc,char**argv)
       ARG_NO_PROGRESS = 1,
       ARG_LIST        = 2,
       ARG_NO_COLOR    = 3,
+      ARG_CONVERT     = 4,
+      ARG_COMPACT     = 5,
+      ARG_PLAN_SHARDS = 6,
+      ARG_SHARD       = 7,
+      ARG_MERGE       = 8,
+      ARG_RESUME      = 9,
+      ARG_DAEMON      = 10,
   };
 
   static struct option options[] =
@@ -253,6 +271,13 @@ static void read_param(int argc,char**argv)
     { "no-color", no_argument, NULL, ARG_NO_COLOR},
     { "compare", no_argument, NULL, 'E'},
     { "list", no_argument, NULL, ARG_LIST},
+    { "convert", no_argument, NULL, ARG_CONVERT},
+    { "compact", no_argument, NULL, ARG_COMPACT},
+    { "plan-shards", required_argument, NULL, ARG_PLAN_SHARDS},
+    { "shard", required_argument, NULL, ARG_SHARD},
+    { "merge", no_argument, NULL, ARG_MERGE},
+    { "resume", no_argument, NULL, ARG_RESUME},
+    { "daemon", required_argument, NULL, ARG_DAEMON},
     { NULL,0,NULL,0 }
   };
 
@@ -298,11 +323,6 @@ static void read_param(int argc,char**argv)
                     INVALID_ARGUMENT("--limit", error in regular expression '%s' at %zu: %s, limit_safe, pcre2_erroffset, pcre2_error)
 
                 }
-                conf->limit_md = pcre2_match_data_create_from_pattern(conf->limit_crx, NULL);
-                if (conf->limit_md == NULL) {
-                    fprintf(stderr, "%s: (%s) pcre2_match_data_create_from_pattern: failed to allocate memory\n", argv[0], "--limit");
-                    exit(MEMORY_ALLOCATION_FAILURE);
-                }
 
                 int pcre2_jit = pcre2_jit_compile(conf->limit_crx, PCRE2_JIT_PARTIAL_SOFT);
                 if (pcre2_jit < 0) {
@@ -340,11 +360,66 @@ static void read_param(int argc,char**argv)
            log_msg(LOG_LEVEL_INFO,"(--no-progress): disable progress bar");
            break;
       }
+      case ARG_RESUME:{
+           conf->resume = true;
+           log_msg(LOG_LEVEL_INFO,"(--resume): resume from checkpoint");
+           break;
+      }
       case ARG_NO_COLOR:{
            conf->no_color = false;
            log_msg(LOG_LEVEL_INFO,"(--no-color): disable colored log output");
            break;
       }
+      case ARG_SHARD:{
+           char *colon = strchr(optarg, ':');
+           if (colon == NULL) {
+               INVALID_ARGUMENT("--shard", %s, "missing ':' (see man aide for details)")
+           }
+           char *endptr = NULL;
+           long index = strtol(optarg, &endptr, 10);
+           if (endptr == optarg || endptr != colon || index < 0 || index > INT_MAX) {
+               INVALID_ARGUMENT("--shard", invalid shard index '%.*s', (int) (colon - optarg), optarg)
+           }
+           if (colon[1] == '\0') {
+               INVALID_ARGUMENT("--shard", %s, "missing shard plan")
+           }
+           if ((conf->shard_plan = shard_plan_load(colon + 1, index)) == NULL) {
+               exit(INVALID_ARGUMENT_ERROR);
+           }
+           conf->shard = checked_strdup(optarg);
+           log_msg(LOG_LEVEL_INFO,"(--shard): set shard to %ld (shard plan: '%s')", index, colon + 1);
+           break;
+      }
+      case ARG_PLAN_SHARDS:{
+            if(conf->action==0){
+                char *endptr = NULL;
+                long num_shards = strtol(optarg, &endptr, 10);
+                if (endptr == optarg || *endptr != '\0' || num_shards < 1 || num_shards > 4096) {
+                    INVALID_ARGUMENT("--plan-shards", invalid number of shards '%s', optarg)
+                }
+                conf->action = DO_PLAN_SHARDS;
+                conf->num_shards = num_shards;
+                log_msg(LOG_LEVEL_INFO,"(--plan-shards): shard plan command (number of shards: %d)", conf->num_shards);
+            } else {
+                INVALID_ARGUMENT("--plan-shards", %s, "cannot have multiple commands on a single commandline")
+            }
+            break;
+      }
+      case ARG_DAEMON:{
+            if(conf->action==0){
+                if (*optarg == '\0') {
+                    INVALID_ARGUMENT("--daemon", %s, "missing socket path")
+                }
+                conf->action = DO_COMPARE|DO_DAEMON;
+                conf->daemon_socket = optarg;
+                /* the daemon and its requests do not have a terminal */
+                conf->progress = -1;
+                log_msg(LOG_LEVEL_INFO,"(--daemon): daemon command (socket: '%s')", conf->daemon_socket);
+            } else {
+                INVALID_ARGUMENT("--daemon", %s, "cannot have multiple commands on a single commandline")
+            }
+            break;
+      }
       case 'p':{
             if(conf->action==0){
                 conf->action=DO_DRY_RUN;
@@ -413,6 +488,9 @@ static void read_param(int argc,char**argv)
       ACTION_CASE("--compare", 'E', DO_DIFF, "database compare")
       ACTION_CASE("--config-check", 'D', DO_DRY_RUN, "config check")
       ACTION_CASE("--list", ARG_LIST, DO_LIST, "list")
+      ACTION_CASE("--convert", ARG_CONVERT, DO_CONVERT, "database convert")
+      ACTION_CASE("--compact", ARG_COMPACT, DO_CONVERT|DO_COMPACT, "database compact")
+      ACTION_CASE("--merge", ARG_MERGE, DO_CONVERT|DO_MERGE, "database merge")
       default: /* '?' */
 	  exit(INVALID_ARGUMENT_ERROR);
       }
@@ -466,6 +544,7 @@ static void setdefaults_before_config(void)
 #endif
       ;
   conf->config_version=NULL;
+  conf->config_digest=NULL;
   conf->aide_version = AIDEVERSION;
   conf->config_check_warn_unrestricted_rules = false;
   
@@ -483,12 +562,22 @@ static void setdefaults_before_config(void)
   conf->database_in.fp=NULL;
 #ifdef WITH_ZLIB
   conf->database_in.gzp = NULL;
+  conf->database_in.pgz = NULL;
+#endif
+#ifdef WITH_ZSTD
+  conf->database_in.zstd_in = NULL;
+  conf->database_in.zstd_out = NULL;
 #endif
   conf->database_in.lineno = 0;
   conf->database_in.fields = NULL;
   conf->database_in.num_fields = 0;
   conf->database_in.mdc = NULL;
   conf->database_in.db_line = NULL;
+  conf->database_in.binary = NULL;
+  conf->database_in.read_pos = 0LLU;
+  conf->database_in.read_end = 0LLU;
+  conf->database_in.merge = NULL;
+  conf->database_in.delta_parent = NULL;
   conf->database_in.flags = DB_FLAG_NONE;
 
   conf->database_out.url = NULL;
@@ -498,12 +587,22 @@ static void setdefaults_before_config(void)
   conf->database_out.fp=NULL;
 #ifdef WITH_ZLIB
   conf->database_out.gzp = NULL;
+  conf->database_out.pgz = NULL;
+#endif
+#ifdef WITH_ZSTD
+  conf->database_out.zstd_in = NULL;
+  conf->database_out.zstd_out = NULL;
 #endif
   conf->database_out.lineno = 0;
   conf->database_out.fields = NULL;
   conf->database_out.num_fields = 0;
   conf->database_out.mdc = NULL;
   conf->database_out.db_line = NULL;
+  conf->database_out.binary = NULL;
+  conf->database_out.read_pos = 0LLU;
+  conf->database_out.read_end = 0LLU;
+  conf->database_out.merge = NULL;
+  conf->database_out.delta_parent = NULL;
   conf->database_out.flags = DB_FLAG_NONE;
 
   conf->database_new.url = NULL;
@@ -513,21 +612,66 @@ static void setdefaults_before_config(void)
   conf->database_new.fp=NULL;
 #ifdef WITH_ZLIB
   conf->database_new.gzp = NULL;
+  conf->database_new.pgz = NULL;
+#endif
+#ifdef WITH_ZSTD
+  conf->database_new.zstd_in = NULL;
+  conf->database_new.zstd_out = NULL;
 #endif
   conf->database_new.lineno = 0;
   conf->database_new.fields = NULL;
   conf->database_new.num_fields = 0;
   conf->database_new.mdc = NULL;
   conf->database_new.db_line = NULL;
+  conf->database_new.binary = NULL;
+  conf->database_new.read_pos = 0LLU;
+  conf->database_new.read_end = 0LLU;
+  conf->database_new.merge = NULL;
+  conf->database_new.delta_parent = NULL;
   conf->database_new.flags = DB_FLAG_NONE;
 
 #ifdef WITH_ZLIB
   conf->gzip_dbout=0;
+  conf->gzip_dbout_level = 9;
+  conf->gzip_dbout_threads = -1;
+#endif
+#ifdef WITH_ZSTD
+  conf->zstd_dbout = false;
+  conf->zstd_dbout_level = 3;
+  conf->zstd_dbout_threads = -1;
 #endif
+  conf->database_format = DB_FORMAT_TEXT;
+  conf->database_out_buffer_size = 4*1024*1024LL;
+  conf->database_out_index = false;
+  conf->database_out_delta = false;
+  conf->database_in_deltas = NULL;
+  conf->num_database_in_deltas = 0;
+  conf->database_in_shards = NULL;
+  conf->num_database_in_shards = 0;
 
   conf->action=0;
 
   conf->num_workers = -1;
+  conf->work_stealing = true;
+  conf->hash_io_engine = HASH_IO_ENGINE_SYNC;
+  conf->parallel_hashsums_threshold = 0LL;
+  conf->parallel_blake3_threshold = 0LL;
+
+  conf->sort_directory_entries = false;
+  conf->max_pending_entries = 0;
+  conf->checkpoint_interval = 0;
+  conf->resume = false;
+  conf->daemon_socket = NULL;
+  conf->daemon_max_requests = 4;
+  conf->database_in_concurrent = false;
+  conf->database_parse_threads = -1;
+  conf->trust_ctime = false;
+  conf->trust_ctime_verify_percentage = 10;
+  conf->num_reused_hashsums = 0L;
+  conf->num_computed_hashsums = 0L;
+  conf->num_hardlink_hashsums = 0L;
+  conf->hardlink_bytes_saved = 0LL;
+  conf->num_unchanged_streamed = 0L;
 
   conf->warn_dead_symlinks=0;
 
@@ -541,6 +685,10 @@ static void setdefaults_before_config(void)
   conf->limit=NULL;
   conf->limit_crx=NULL;
 
+  conf->shard = NULL;
+  conf->shard_plan = NULL;
+  conf->num_shards = 0;
+
   conf->groupsyms=NULL;
 
   conf->start_time=time(NULL);
@@ -624,6 +772,22 @@ static void setdefaults_after_config(void)
       conf->num_workers = 1;
       log_msg(LOG_LEVEL_CONFIG, "(default): set 'num_workers' option to %lu", conf->num_workers);
   }
+  if(conf->database_parse_threads < 0) {
+      conf->database_parse_threads = conf->num_workers;
+      log_msg(LOG_LEVEL_CONFIG, "(default): set 'database_parse_threads' option to %lu", conf->database_parse_threads);
+  }
+#ifdef WITH_ZLIB
+  if(conf->gzip_dbout_threads < 0) {
+      conf->gzip_dbout_threads = conf->num_workers;
+      log_msg(LOG_LEVEL_CONFIG, "(default): set 'gzip_dbout_threads' option to %lu", conf->gzip_dbout_threads);
+  }
+#endif
+#ifdef WITH_ZSTD
+  if(conf->zstd_dbout_threads < 0) {
+      conf->zstd_dbout_threads = conf->num_workers;
+      log_msg(LOG_LEVEL_CONFIG, "(default): set 'zstd_dbout_threads' option to %lu", conf->zstd_dbout_threads);
+  }
+#endif
 
   if (is_log_level_unset()) {
           set_log_level(LOG_LEVEL_WARNING);
@@ -743,6 +907,7 @@ int main(int argc,char**argv)
 
   log_msg(LOG_LEVEL_RULE, "rule tree:");
   log_tree(LOG_LEVEL_RULE, conf->tree, 0);
+  compile_seltree(conf->tree);
 
   if (conf->action&DO_INIT && is_tree_empty(conf->tree)) {
       log_msg(LOG_LEVEL_WARNING, "rule tree is empty, no files will be added to the database");
@@ -769,11 +934,11 @@ int main(int argc,char**argv)
   }
 
   /* Let's do some sanity checks for the config */
-  if (conf->action&(DO_DIFF|DO_COMPARE|DO_LIST) && !(conf->database_in.url)) {
+  if (conf->action&(DO_DIFF|DO_COMPARE|DO_LIST|DO_CONVERT|DO_PLAN_SHARDS) && !(conf->action&DO_MERGE) && !(conf->database_in.url)) {
     log_msg(LOG_LEVEL_ERROR,_("missing 'database_in', config option is required"));
     exit(INVALID_ARGUMENT_ERROR);
   }
-  if (!(conf->action&DO_DRY_RUN) && conf->action&DO_INIT && !(conf->database_out.url)) {
+  if (!(conf->action&DO_DRY_RUN) && conf->action&(DO_INIT|DO_CONVERT) && !(conf->database_out.url)) {
     log_msg(LOG_LEVEL_ERROR,_("missing 'database_out', config option is required"));
     exit(INVALID_ARGUMENT_ERROR);
   }
@@ -784,7 +949,94 @@ int main(int argc,char**argv)
 	    "when doing database update"));
       exit(INVALID_ARGUMENT_ERROR);
     }
+    if(conf->action&DO_CONVERT && !(conf->action&DO_MERGE)){
+      log_msg(LOG_LEVEL_ERROR,_("input and output database urls cannot be the same "
+	    "when doing database convert"));
+      exit(INVALID_ARGUMENT_ERROR);
+    }
   };
+  for (int i = 0 ; i < conf->num_database_in_deltas ; ++i) {
+      if (conf->action&(DO_INIT|DO_CONVERT) && conf->database_out.url && cmpurl(conf->database_in_deltas[i].url, conf->database_out.url) == RETOK) {
+          log_msg(LOG_LEVEL_ERROR, "'database_in_delta' and 'database_out' URLs cannot be the same: '%s'", (conf->database_out.url)->value);
+          exit(INVALID_ARGUMENT_ERROR);
+      }
+  }
+  for (int i = 0 ; i < conf->num_database_in_shards ; ++i) {
+      if (conf->action&DO_MERGE && cmpurl(conf->database_in_shards[i].url, conf->database_out.url) == RETOK) {
+          log_msg(LOG_LEVEL_ERROR, "'database_in_shard' and 'database_out' URLs cannot be the same: '%s'", (conf->database_out.url)->value);
+          exit(INVALID_ARGUMENT_ERROR);
+      }
+  }
+  if (conf->action&DO_MERGE && conf->num_database_in_shards == 0) {
+      log_msg(LOG_LEVEL_ERROR, "missing 'database_in_shard', config option is required for database merge");
+      exit(INVALID_ARGUMENT_ERROR);
+  }
+  if (conf->shard_plan && (conf->action&(DO_INIT|DO_COMPARE)) == (DO_INIT|DO_COMPARE)) {
+      log_msg(LOG_LEVEL_ERROR, "--shard cannot be used with --update (the entries of the other shards would be copied to the new database)");
+      exit(INVALID_ARGUMENT_ERROR);
+  }
+  if (conf->action&DO_DAEMON) {
+      if (conf->limit || conf->shard_plan || conf->resume) {
+          log_msg(LOG_LEVEL_ERROR, "--limit, --shard and --resume cannot be used with --daemon (the limit is set per request)");
+          exit(INVALID_ARGUMENT_ERROR);
+      }
+  }
+  if (conf->resume) {
+      if (!(conf->action&(DO_INIT|DO_COMPARE)) || conf->action&DO_DRY_RUN) {
+          log_msg(LOG_LEVEL_ERROR, "--resume can only be used with --init, --check or --update");
+          exit(INVALID_ARGUMENT_ERROR);
+      }
+      if (conf->checkpoint_interval == 0) {
+          log_msg(LOG_LEVEL_ERROR, "--resume requires 'checkpoint_interval'");
+          exit(INVALID_ARGUMENT_ERROR);
+      }
+  }
+  if (conf->num_database_in_deltas && !conf->db_attrs) {
+      log_msg(LOG_LEVEL_ERROR, "'database_in_delta' requires 'database_attrs' (to verify the base databases)");
+      exit(INVALID_CONFIGURELINE_ERROR);
+  }
+  if (conf->action&DO_COMPACT && conf->num_database_in_deltas == 0) {
+      log_msg(LOG_LEVEL_ERROR, "missing 'database_in_delta', config option is required for database compact");
+      exit(INVALID_ARGUMENT_ERROR);
+  }
+  if (conf->database_out_delta) {
+      if ((conf->action&(DO_INIT|DO_COMPARE|DO_DRY_RUN)) != (DO_INIT|DO_COMPARE)) {
+          if (conf->action&(DO_INIT|DO_CONVERT) && !(conf->action&DO_DRY_RUN)) {
+              log_msg(LOG_LEVEL_NOTICE, "'database_out_delta' is only used with --update (write complete database)");
+          }
+          conf->database_out_delta = false;
+      } else if (conf->database_format == DB_FORMAT_BINARY) {
+          log_msg(LOG_LEVEL_ERROR, "delta databases require the text database format, disable 'database_out_delta'");
+          exit(INVALID_CONFIGURELINE_ERROR);
+      } else if (!conf->db_attrs) {
+          log_msg(LOG_LEVEL_ERROR, "'database_out_delta' requires 'database_attrs' (to identify the base database)");
+          exit(INVALID_CONFIGURELINE_ERROR);
+      }
+  }
+  if (conf->action&(DO_INIT|DO_CONVERT) && conf->database_format == DB_FORMAT_BINARY) {
+      if (conf->database_out.url && (conf->database_out.url)->type != url_file) {
+          log_msg(LOG_LEVEL_ERROR, "binary database format requires a 'file' URL for 'database_out'");
+          exit(INVALID_CONFIGURELINE_ERROR);
+      }
+#ifdef WITH_ZLIB
+      if (conf->gzip_dbout) {
+          log_msg(LOG_LEVEL_ERROR, "binary database format cannot be gzipped, disable 'gzip_dbout'");
+          exit(INVALID_CONFIGURELINE_ERROR);
+      }
+#endif
+#ifdef WITH_ZSTD
+      if (conf->zstd_dbout) {
+          log_msg(LOG_LEVEL_ERROR, "binary database format cannot be compressed, disable 'zstd_dbout'");
+          exit(INVALID_CONFIGURELINE_ERROR);
+      }
+#endif
+  }
+#if defined(WITH_ZLIB) && defined(WITH_ZSTD)
+  if (conf->action&(DO_INIT|DO_CONVERT) && conf->gzip_dbout && conf->zstd_dbout) {
+      log_msg(LOG_LEVEL_ERROR, "'gzip_dbout' and 'zstd_dbout' cannot be enabled both");
+      exit(INVALID_CONFIGURELINE_ERROR);
+  }
+#endif
   if(conf->action&DO_DIFF) {
       if(!(conf->database_new.url)||!(conf->database_in.url)) {
           log_msg(LOG_LEVEL_ERROR,_("must have both input databases defined for database compare"));
@@ -806,6 +1058,16 @@ int main(int argc,char**argv)
       exit (0);
   }
 
+  if ((conf->action&DO_PLAN_SHARDS)) {
+      if(db_init(&(conf->database_in), true, false)==RETFAIL) {
+          exit(IO_ERROR);
+      }
+      log_msg(LOG_LEVEL_INFO, "plan shards for database: %s", (conf->database_in.url)->raw);
+      int ret = shard_plan_write(&(conf->database_in), conf->num_shards, stdout);
+      db_close();
+      exit(ret == RETOK ? 0 : IO_ERROR);
+  }
+
   if ((conf->action&DO_LIST)) {
       if(db_init(&(conf->database_in), true, false)==RETFAIL) {
           exit(IO_ERROR);
@@ -841,6 +1103,53 @@ int main(int argc,char**argv)
       exit (0);
   }
 
+  if ((conf->action&DO_CONVERT)) {
+      database **shards = NULL;
+      if (conf->action&DO_MERGE) {
+          shards = checked_malloc(conf->num_database_in_shards * sizeof(database *)); /* freed below */
+          for (int i = 0 ; i < conf->num_database_in_shards ; ++i) {
+              if(db_init(&(conf->database_in_shards[i]), true, false)==RETFAIL) {
+                  exit(IO_ERROR);
+              }
+              shards[i] = &(conf->database_in_shards[i]);
+          }
+      } else if(db_init(&(conf->database_in), true, false)==RETFAIL) {
+          exit(IO_ERROR);
+      }
+      if(db_init(&(conf->database_out), false,
+#ifdef WITH_ZLIB
+        conf->gzip_dbout
+#else
+        false
+#endif
+       ) == RETFAIL) {
+          exit(IO_ERROR);
+      }
+      if (conf->action&DO_MERGE) {
+          log_msg(LOG_LEVEL_INFO, "merge %d shard database(s) to %s (format: %s)", conf->num_database_in_shards,
+                  (conf->database_out.url)->raw, conf->database_format == DB_FORMAT_BINARY ? "binary" : "text");
+      } else if (conf->action&DO_COMPACT) {
+          log_msg(LOG_LEVEL_INFO, "compact database %s and %d delta database(s) to %s (format: %s)", (conf->database_in.url)->raw, conf->num_database_in_deltas,
+                  (conf->database_out.url)->raw, conf->database_format == DB_FORMAT_BINARY ? "binary" : "text");
+      } else {
+          log_msg(LOG_LEVEL_INFO, "convert database %s to %s (format: %s)", (conf->database_in.url)->raw, (conf->database_out.url)->raw,
+                  conf->database_format == DB_FORMAT_BINARY ? "binary" : "text");
+      }
+      long num_entries = db_convert(shards, conf->num_database_in_shards);
+      if (num_entries < 0) {
+          log_msg(LOG_LEVEL_ERROR,_("Error while writing database. Exiting.."));
+          exit(IO_ERROR);
+      }
+      free(shards);
+      db_close();
+      log_msg(LOG_LEVEL_INFO, "%s %ld database entries", conf->action&DO_MERGE ? "merged" : conf->action&DO_COMPACT ? "compacted" : "converted", num_entries);
+      exit (0);
+  }
+
+  if ((conf->action&DO_DAEMON)) {
+      exit(daemon_run(conf->daemon_socket, argv));
+  }
+
   if (!(conf->action&DO_DRY_RUN)) {
 
   if (!init_report_urls()) {
@@ -866,7 +1175,8 @@ int main(int argc,char**argv)
        ) == RETFAIL) {
 	exit(IO_ERROR);
       }
-      if(db_writespec(conf)==RETFAIL){
+      /* the header of a delta database is written once the base database has been read */
+      if(!conf->database_out_delta && db_writespec(conf)==RETFAIL){
 	log_msg(LOG_LEVEL_ERROR,_("Error while writing database. Exiting.."));
 	exit(IO_ERROR);
       }
@@ -879,12 +1189,25 @@ int main(int argc,char**argv)
       if(db_init(&(conf->database_new), true, false)==RETFAIL)
 	exit(IO_ERROR);
     }
+    if (conf->checkpoint_interval && conf->action&(DO_INIT|DO_COMPARE)) {
+      if (!checkpoint_open(conf->resume)) {
+        exit(IO_ERROR);
+      }
+    }
 
     populate_tree(conf->tree);
 
     if(conf->action&DO_INIT) {
         update_progress_status(PROGRESS_WRITEDB, NULL);
-        log_msg(LOG_LEVEL_INFO, "write new entries to database: %s", (conf->database_out.url)->raw);
+        if (conf->database_out_delta) {
+            if(db_writespec(conf)==RETFAIL){
+                log_msg(LOG_LEVEL_ERROR,_("Error while writing database. Exiting.."));
+                exit(IO_ERROR);
+            }
+            log_msg(LOG_LEVEL_INFO, "write added, changed and removed entries to delta database: %s", (conf->database_out.url)->raw);
+        } else {
+            log_msg(LOG_LEVEL_INFO, "write new entries to database: %s", (conf->database_out.url)->raw);
+        }
         write_tree(conf->tree);
     }
     progress_stop();
@@ -897,6 +1220,9 @@ int main(int argc,char**argv)
 
     int exitcode = gen_report(conf->tree);
 
+    /* the run is complete, the checkpoint is not needed anymore */
+    checkpoint_close(true);
+
     log_msg(LOG_LEVEL_INFO, "exit AIDE with exit code '%d'", exitcode);
 
     exit(exitcode);
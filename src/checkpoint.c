@@ -0,0 +1,436 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "aide.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "attributes.h"
+#include "checkpoint.h"
+#include "db.h"
+#include "db_config.h"
+#include "db_file.h"
+#include "db_line.h"
+#include "gen_list.h"
+#include "log.h"
+#include "url.h"
+#include "util.h"
+
+/* directory completed in a previous run */
+typedef struct checkpoint_dir {
+    char *path;
+    off_t start; /* file offset of the first entry */
+    off_t end; /* file offset of the '@@done' line */
+    long lineno; /* line number of the first entry */
+} checkpoint_dir;
+
+static struct {
+    FILE *fp; /* NULL if checkpointing is disabled */
+    char *path;
+    url_t url;
+    pthread_mutex_t mutex;
+    time_t last_sync;
+    long num_dirs_done;
+
+    /* fields of the entries (see db_parse_line_file()) */
+    database db;
+
+    checkpoint_dir *dirs;
+    size_t num_dirs;
+    int read_fd; /* to read the entries of the completed directories */
+    long num_replayed;
+} checkpoint = { .mutex = PTHREAD_MUTEX_INITIALIZER, .read_fd = -1 };
+
+static char *encode_value(const char *value) {
+    if (value == NULL || *value == '\0') {
+        return checked_strdup("-");
+    }
+    return contains_unsafe(value) ? encode_string(value) : checked_strdup(value);
+}
+
+/* returns the first two lines of the checkpoint identifying the run */
+static char *get_header(void) {
+    char *root_prefix = encode_value(conf->root_prefix_length ? conf->root_prefix : NULL);
+    char *limit = encode_value(conf->limit);
+    char *shard = encode_value(conf->shard);
+    char *config_version = encode_value(conf->config_version);
+    char *config_digest = encode_value(conf->config_digest);
+
+    size_t spec_len = 0;
+    for (ATTRIBUTE i = 0 ; i < num_attrs ; ++i) {
+        if (attributes[i].db_name && ATTR(i) & conf->db_out_attrs) {
+            spec_len += strlen(attributes[i].db_name) + 1;
+        }
+    }
+    int len = snprintf(NULL, 0, "@@aide_checkpoint %d %d %s %s %s %s %s\n@@db_spec", CHECKPOINT_VERSION, conf->action, root_prefix, limit, shard, config_version, config_digest);
+    char *header = checked_malloc(len + spec_len + 2); /* freed by caller */
+    char *p = header + snprintf(header, len + 1, "@@aide_checkpoint %d %d %s %s %s %s %s\n@@db_spec", CHECKPOINT_VERSION, conf->action, root_prefix, limit, shard, config_version, config_digest);
+    for (ATTRIBUTE i = 0 ; i < num_attrs ; ++i) {
+        if (attributes[i].db_name && ATTR(i) & conf->db_out_attrs) {
+            p += sprintf(p, " %s", attributes[i].db_name);
+        }
+    }
+    strcpy(p, "\n");
+
+    free(root_prefix);
+    free(limit);
+    free(shard);
+    free(config_version);
+    free(config_digest);
+    return header;
+}
+
+static int checkpoint_dir_cmp(const void *p1, const void *p2) {
+    const checkpoint_dir *d1 = p1;
+    const checkpoint_dir *d2 = p2;
+    int cmp = strcmp(d1->path, d2->path);
+    if (cmp == 0 && d1->start != d2->start) {
+        return d1->start < d2->start ? -1 : 1;
+    }
+    return cmp;
+}
+
+static int checkpoint_dir_path_cmp(const void *p1, const void *p2) {
+    return strcmp(((const checkpoint_dir *) p1)->path, ((const checkpoint_dir *) p2)->path);
+}
+
+/*
+ * Reads the completed directories of the checkpoint
+ *
+ * Returns the file offset after the last completed directory, -1 if the
+ * checkpoint cannot be used
+ */
+static off_t read_checkpoint(FILE *fp, const char *header) {
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t nread;
+    size_t header_len = strlen(header);
+    size_t size = 0;
+
+    off_t pos = 0;
+    off_t end = 0; /* after the last '@@done' line */
+    off_t start = -1;
+    long lineno = 0;
+    long start_lineno = 0;
+    const char *error = NULL;
+    while (error == NULL && (nread = getline(&line, &line_size, fp)) != -1) {
+        lineno++;
+        if (line[nread - 1] != '\n') {
+            /* incomplete last line */
+            break;
+        }
+        if (lineno <= 2) {
+            if ((size_t) pos + nread > header_len || strncmp(line, &header[pos], nread) != 0) {
+                error = "written by a different command or configuration";
+            }
+            pos += nread;
+            end = pos;
+            continue;
+        }
+        if (strncmp(line, "@@done ", 7) == 0) {
+            line[nread - 1] = '\0';
+            char *path = &line[7];
+            decode_string(path);
+            if (*path != '/') {
+                error = "invalid '@@done' line";
+                break;
+            }
+            if (checkpoint.num_dirs == size) {
+                size = size ? 2 * size : 1024;
+                checkpoint.dirs = checked_realloc(checkpoint.dirs, size * sizeof(checkpoint_dir)); /* freed in checkpoint_close() */
+            }
+            checkpoint.dirs[checkpoint.num_dirs++] = (checkpoint_dir) {
+                .path = checked_strdup(path), /* freed in checkpoint_close() */
+                .start = start == -1 ? pos : start,
+                .end = pos,
+                .lineno = start == -1 ? lineno : start_lineno,
+            };
+            pos += nread;
+            end = pos;
+            start = -1;
+        } else if (*line == '/') {
+            if (start == -1) {
+                start = pos;
+                start_lineno = lineno;
+            }
+            pos += nread;
+        } else {
+            error = "unexpected line";
+        }
+    }
+    free(line);
+    if (error == NULL && lineno < 2) {
+        error = "missing header";
+    }
+    if (error) {
+        log_msg(LOG_LEVEL_WARNING, "%s:%ld: ignore checkpoint (%s)", checkpoint.path, lineno, error);
+        return -1;
+    }
+    if (start != -1) {
+        log_msg(LOG_LEVEL_INFO, "%s: discard entries of incomplete directory (line %ld and below)", checkpoint.path, start_lineno);
+    }
+
+    /* the last checkpoint of a directory wins */
+    qsort(checkpoint.dirs, checkpoint.num_dirs, sizeof(checkpoint_dir), checkpoint_dir_cmp);
+    size_t num = 0;
+    for (size_t i = 0 ; i < checkpoint.num_dirs ; ++i) {
+        if (i + 1 < checkpoint.num_dirs && strcmp(checkpoint.dirs[i].path, checkpoint.dirs[i + 1].path) == 0) {
+            free(checkpoint.dirs[i].path);
+        } else {
+            checkpoint.dirs[num++] = checkpoint.dirs[i];
+        }
+    }
+    checkpoint.num_dirs = num;
+    return end;
+}
+
+/*
+ * Opens the checkpoint '<database_out>.checkpoint' for writing, with resume
+ * set the completed directories of an existing checkpoint are kept
+ *
+ * Returns false on error
+ */
+bool checkpoint_open(bool resume) {
+    if (conf->database_out.url == NULL || (conf->database_out.url)->type != url_file) {
+        log_msg(LOG_LEVEL_ERROR, "'checkpoint_interval' requires a 'file' URL for 'database_out'");
+        return false;
+    }
+    size_t len = strlen((conf->database_out.url)->value) + 12;
+    checkpoint.path = checked_malloc(len); /* freed in checkpoint_close() */
+    snprintf(checkpoint.path, len, "%s.checkpoint", (conf->database_out.url)->value);
+
+    char *header = get_header();
+    off_t end = -1;
+    if (resume) {
+        FILE *fp = fopen(checkpoint.path, "r");
+        if (fp == NULL) {
+            log_msg(errno == ENOENT ? LOG_LEVEL_NOTICE : LOG_LEVEL_WARNING, "--resume: failed to open checkpoint '%s': %s (scan all directories)", checkpoint.path, strerror(errno));
+        } else {
+            end = read_checkpoint(fp, header);
+            fclose(fp);
+        }
+    }
+
+    int fd = open(checkpoint.path, O_RDWR|O_CREAT|O_APPEND|(end == -1 ? O_TRUNC : 0), 0600);
+    if (fd == -1 || (end != -1 && ftruncate(fd, end) == -1) || (checkpoint.fp = fdopen(fd, "a")) == NULL) {
+        log_msg(LOG_LEVEL_ERROR, "failed to open checkpoint '%s' for writing: %s", checkpoint.path, strerror(errno));
+        if (fd != -1) {
+            close(fd);
+        }
+        free(header);
+        return false;
+    }
+    if (end == -1) {
+        fputs(header, checkpoint.fp);
+    } else {
+        if (checkpoint.num_dirs && (checkpoint.read_fd = open(checkpoint.path, O_RDONLY)) == -1) {
+            log_msg(LOG_LEVEL_ERROR, "failed to open checkpoint '%s' for reading: %s", checkpoint.path, strerror(errno));
+            free(header);
+            return false;
+        }
+        log_msg(LOG_LEVEL_NOTICE, "resume from checkpoint '%s' (%zu directories completed)", checkpoint.path, checkpoint.num_dirs);
+    }
+    free(header);
+    if (fflush(checkpoint.fp) == EOF) {
+        log_msg(LOG_LEVEL_ERROR, "failed to write checkpoint '%s': %s", checkpoint.path, strerror(errno));
+        fclose(checkpoint.fp);
+        checkpoint.fp = NULL;
+        return false;
+    }
+    checkpoint.last_sync = time(NULL);
+
+    checkpoint.url = (url_t) { .type = url_file, .value = checkpoint.path, .raw = checkpoint.path };
+    checkpoint.db = (database) { .url = &checkpoint.url };
+    for (ATTRIBUTE i = 0 ; i < num_attrs ; ++i) {
+        if (attributes[i].db_name && ATTR(i) & conf->db_out_attrs) {
+            checkpoint.db.fields = checked_realloc(checkpoint.db.fields, (checkpoint.db.num_fields + 1) * sizeof(ATTRIBUTE)); /* freed in checkpoint_close() */
+            checkpoint.db.fields[checkpoint.db.num_fields++] = i;
+        }
+    }
+    log_msg(LOG_LEVEL_INFO, "write checkpoints of completed directories to '%s' (sync interval: %ld seconds)", checkpoint.path, conf->checkpoint_interval);
+    return true;
+}
+
+bool checkpoint_active(void) {
+    return checkpoint.fp != NULL;
+}
+
+/* closes the checkpoint, with remove set the file is removed */
+void checkpoint_close(bool remove) {
+    if (checkpoint.path == NULL) {
+        return;
+    }
+    if (checkpoint.num_replayed) {
+        log_msg(LOG_LEVEL_INFO, "added %ld entries of %zu directories completed in a previous run from checkpoint", checkpoint.num_replayed, checkpoint.num_dirs);
+    }
+    if (checkpoint.fp) {
+        log_msg(LOG_LEVEL_DEBUG, "%s: %ld directories completed", checkpoint.path, checkpoint.num_dirs_done);
+        fclose(checkpoint.fp);
+        checkpoint.fp = NULL;
+    }
+    if (remove) {
+        if (unlink(checkpoint.path) == -1 && errno != ENOENT) {
+            log_msg(LOG_LEVEL_WARNING, "failed to remove checkpoint '%s': %s", checkpoint.path, strerror(errno));
+        } else {
+            log_msg(LOG_LEVEL_INFO, "removed checkpoint '%s'", checkpoint.path);
+        }
+    }
+    if (checkpoint.read_fd != -1) {
+        close(checkpoint.read_fd);
+        checkpoint.read_fd = -1;
+    }
+    for (size_t i = 0 ; i < checkpoint.num_dirs ; ++i) {
+        free(checkpoint.dirs[i].path);
+    }
+    free(checkpoint.dirs);
+    checkpoint.dirs = NULL;
+    checkpoint.num_dirs = 0;
+    free(checkpoint.db.fields);
+    checkpoint.db.fields = NULL;
+    free(checkpoint.path);
+    checkpoint.path = NULL;
+}
+
+checkpoint_batch *checkpoint_batch_new(void) {
+    checkpoint_batch *batch = checked_malloc(sizeof(checkpoint_batch)); /* freed in checkpoint_batch_commit() */
+    *batch = (checkpoint_batch) { .data = NULL, .len = 0, .size = 0, .incomplete = false };
+    pthread_mutex_init(&batch->mutex, NULL);
+    return batch;
+}
+
+void checkpoint_batch_add(checkpoint_batch *batch, db_line *line) {
+    pthread_mutex_lock(&batch->mutex);
+    if (!batch->incomplete) {
+        db_append_line_file(line, &batch->data, &batch->len, &batch->size);
+    }
+    pthread_mutex_unlock(&batch->mutex);
+}
+
+/* the directory of the batch cannot be marked as completed */
+void checkpoint_batch_invalidate(checkpoint_batch *batch) {
+    pthread_mutex_lock(&batch->mutex);
+    batch->incomplete = true;
+    free(batch->data);
+    batch->data = NULL;
+    batch->len = batch->size = 0;
+    pthread_mutex_unlock(&batch->mutex);
+}
+
+/*
+ * Writes the entries of the completed directory path to the checkpoint and
+ * frees the batch
+ *
+ * Returns false if the directory has not been marked as completed
+ */
+bool checkpoint_batch_commit(checkpoint_batch *batch, const char *path) {
+    bool committed = false;
+    if (!batch->incomplete) {
+        char *safe_path = contains_unsafe(path) ? encode_string(path) : NULL;
+        pthread_mutex_lock(&checkpoint.mutex);
+        if (checkpoint.fp) {
+            if ((batch->len && fwrite(batch->data, 1, batch->len, checkpoint.fp) < batch->len)
+                    || fprintf(checkpoint.fp, "@@done %s\n", safe_path ? safe_path : path) < 0) {
+                log_msg(LOG_LEVEL_WARNING, "failed to write checkpoint '%s': %s (disable checkpointing)", checkpoint.path, strerror(errno));
+                fclose(checkpoint.fp);
+                checkpoint.fp = NULL;
+            } else {
+                committed = true;
+                checkpoint.num_dirs_done++;
+                time_t now = time(NULL);
+                if (now - checkpoint.last_sync >= conf->checkpoint_interval) {
+                    if (fflush(checkpoint.fp) == EOF || (fsync(fileno(checkpoint.fp)) == -1 && errno != EINVAL && errno != EROFS)) {
+                        log_msg(LOG_LEVEL_WARNING, "failed to sync checkpoint '%s': %s", checkpoint.path, strerror(errno));
+                    } else {
+                        log_msg(LOG_LEVEL_DEBUG, "synced checkpoint '%s' (%ld directories completed)", checkpoint.path, checkpoint.num_dirs_done);
+                    }
+                    checkpoint.last_sync = now;
+                }
+            }
+        }
+        pthread_mutex_unlock(&checkpoint.mutex);
+        free(safe_path);
+    }
+    pthread_mutex_destroy(&batch->mutex);
+    free(batch->data);
+    free(batch);
+    return committed;
+}
+
+/*
+ * Adds the entries of the directory path (and of its completed
+ * subdirectories) from the checkpoint to the tree
+ *
+ * Returns false if the directory has not been completed in a previous run
+ */
+bool checkpoint_replay(const char *path, const char *whoami) {
+    if (checkpoint.num_dirs == 0) {
+        return false;
+    }
+    checkpoint_dir key = { .path = (char *) path };
+    checkpoint_dir *dir = bsearch(&key, checkpoint.dirs, checkpoint.num_dirs, sizeof(checkpoint_dir), checkpoint_dir_path_cmp);
+    if (dir == NULL) {
+        return false;
+    }
+
+    size_t len = dir->end - dir->start;
+    char *data = checked_malloc(len + 1); /* freed below */
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(checkpoint.read_fd, data + done, len - done, dir->start + done);
+        if (n <= 0) {
+            log_msg(LOG_LEVEL_WARNING, "failed to read checkpoint '%s': %s (read directory '%s')", checkpoint.path, n ? strerror(errno) : "unexpected end of file", path);
+            free(data);
+            return false;
+        }
+        done += n;
+    }
+    data[len] = '\0';
+
+    database db = checkpoint.db;
+    db.lineno = dir->lineno - 1;
+    long num = 0;
+    char *saveptr = NULL;
+    for (char *str = strtok_r(data, "\n", &saveptr) ; str != NULL ; str = strtok_r(NULL, "\n", &saveptr)) {
+        db.lineno++;
+        db_line *line = db_parse_line_file(&db, str);
+        if (line) {
+            char *subdir = S_ISDIR(line->perm) ? checked_strdup(line->filename) : NULL;
+            add_file_to_tree(conf->tree, line, DB_NEW|DB_DISK, NULL, NULL, whoami);
+            num++;
+            if (subdir) {
+                checkpoint_replay(subdir, whoami);
+                free(subdir);
+            }
+        }
+    }
+    free(data);
+    __atomic_add_fetch(&checkpoint.num_replayed, num, __ATOMIC_RELAXED);
+    LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> added %ld entries from checkpoint (directory completed in a previous run)", path, num);
+    return true;
+}
@@ -27,6 +27,7 @@
 #include <stdbool.h>
 #include <zlib.h>
 #include "attributes.h"
+#include "base64.h"
 #include "conf_ast.h"
 #include "config.h"
 #include "errorcodes.h"
@@ -57,9 +58,9 @@
 #endif
 #include <math.h>
 #include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 
-#define BUFSIZE 4096
 #define ZBUFSIZE 16384
 
 url_t* parse_url(char* val, int linenumber, char* filename, char* linebuf)
@@ -158,12 +159,26 @@ url_t* parse_url(char* val, int linenumber, char* filename, char* linebuf)
   return u;
 }
 
+/* digest of the configuration read by the lexer (see update_config_digest()) */
+static struct md_container config_mdc;
+static bool config_mdc_open = false;
+
+void update_config_digest(const char *buf, size_t len) {
+    if (config_mdc_open && len) {
+        update_md(&config_mdc, (void *) buf, len);
+    }
+}
+
 int parse_config(char *before, char *config, char* after) {
     if(before==NULL && after==NULL && (config==NULL||strcmp(config,"")==0)){
       log_msg(LOG_LEVEL_ERROR,_("missing configuration (use '--config' '--before' or '--after' command line parameter)"));
       return RETFAIL;
     }
 
+    config_mdc.todo_attr = ATTR(attr_sha256);
+    init_md(&config_mdc, "(config)", NULL);
+    config_mdc_open = true;
+
     ast* config_ast = NULL;
     if (before) {
         conf_lex_string("(--before)", before);
@@ -195,6 +210,15 @@ int parse_config(char *before, char *config, char* after) {
         deep_free(config_ast);
         config_ast = NULL;
     }
+
+    md_hashsums hs;
+    config_mdc_open = false;
+    close_md(&config_mdc, &hs, "(config)", NULL);
+    char *enc = encode_base64(hs.hashsums[hash_sha256], hashsums[hash_sha256].length);
+    conf->config_digest = checked_malloc(strlen(enc) + 8);
+    sprintf(conf->config_digest, "sha256:%s", enc);
+    free(enc);
+    log_msg(LOG_LEVEL_DEBUG, "digest of the configuration: %s", conf->config_digest);
   return RETOK;
 }
 
@@ -202,6 +226,7 @@ int conf_input_wrapper(char* buf, int max_size, FILE* in)
 {
   int retval=0;
   retval=fread(buf,1,max_size,in);
+  update_config_digest(buf, retval);
   return retval;
 }
 
@@ -367,6 +392,22 @@ bool do_dbdef(DB_TYPE dbtype ,char* val, int linenumber, char* filename, char* l
     db = &(conf->database_new);
     break;
   }
+  case DB_TYPE_IN_DELTA: {
+    /* every database_in_delta line appends a delta database to the chain */
+    db_option_name = "database_in_delta";
+    conf->database_in_deltas = checked_realloc(conf->database_in_deltas, (conf->num_database_in_deltas + 1) * sizeof(database));
+    db = &(conf->database_in_deltas[conf->num_database_in_deltas]);
+    *db = (database) { .url = NULL, .flags = DB_FLAG_DELTA };
+    break;
+  }
+  case DB_TYPE_IN_SHARD: {
+    /* every database_in_shard line appends a shard database */
+    db_option_name = "database_in_shard";
+    conf->database_in_shards = checked_realloc(conf->database_in_shards, (conf->num_database_in_shards + 1) * sizeof(database));
+    db = &(conf->database_in_shards[conf->num_database_in_shards]);
+    *db = (database) { .url = NULL, .flags = 0 };
+    break;
+  }
   }
 
   if(db->url == NULL){
@@ -375,7 +416,9 @@ bool do_dbdef(DB_TYPE dbtype ,char* val, int linenumber, char* filename, char* l
      * both input and output urls */
     switch (dbtype) {
     case DB_TYPE_IN:
-    case DB_TYPE_NEW:{
+    case DB_TYPE_NEW:
+    case DB_TYPE_IN_DELTA:
+    case DB_TYPE_IN_SHARD: {
       switch (u->type) {
           case url_stdout:
           case url_stderr:
@@ -418,6 +461,11 @@ bool do_dbdef(DB_TYPE dbtype ,char* val, int linenumber, char* filename, char* l
     db->linenumber = linenumber;
     db->filename = filename;
     db->linebuf = linebuf?checked_strdup(linebuf):NULL;
+    if (dbtype == DB_TYPE_IN_DELTA) {
+        conf->num_database_in_deltas++;
+    } else if (dbtype == DB_TYPE_IN_SHARD) {
+        conf->num_database_in_shards++;
+    }
     LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set '%s' option to '%s'", db_option_name, u->raw)
     } else {
         return false;
@@ -479,6 +527,36 @@ long do_num_workers(const char *str) {
     return number;
 }
 
+long long do_size(const char *str) {
+    char *err;
+    errno = 0;
+    long long number = strtoll(str,&err,10);
+    if (err == str || number < 0 || errno == ERANGE) {
+        return -1;
+    }
+    long long factor = 1;
+    switch (*err) {
+        case 'G':
+            factor *= 1024;
+            /* fall through */
+        case 'M':
+            factor *= 1024;
+            /* fall through */
+        case 'K':
+            factor *= 1024;
+            err++;
+            break;
+        case '\0':
+            break;
+        default:
+            return -1;
+    }
+    if (*err != '\0' || number > LLONG_MAX / factor) {
+        return -1;
+    }
+    return number * factor;
+}
+
 #ifdef WITH_E2FSATTRS
 void do_report_ignore_e2fsattrs(char* val, int linenumber, char* filename, char* linebuf) {
     conf->report_ignore_e2fsattrs = 0UL;
@@ -58,6 +58,30 @@ config_option_t config_options[] = {
     { REPORT_FORMAT_OPTION,                     NULL,                           NULL },
     { LIMIT_CMDLINE_OPTION,                     "limit",                        "Limit" },
     { NUM_WORKERS,                              NULL,                           NULL },
+    { WORK_STEALING_OPTION,                     NULL,                           NULL },
+    { HASH_IO_ENGINE_OPTION,                    NULL,                           NULL },
+    { PARALLEL_HASHSUMS_THRESHOLD_OPTION,       NULL,                           NULL },
+    { PARALLEL_BLAKE3_THRESHOLD_OPTION,         NULL,                           NULL },
+    { DATABASE_FORMAT_OPTION,                   NULL,                           NULL },
+    { DATABASE_OUT_BUFFER_SIZE_OPTION,          NULL,                           NULL },
+    { DATABASE_GZIP_LEVEL_OPTION,               NULL,                           NULL },
+    { DATABASE_GZIP_THREADS_OPTION,             NULL,                           NULL },
+    { DATABASE_ZSTD_OPTION,                     NULL,                           NULL },
+    { DATABASE_ZSTD_LEVEL_OPTION,               NULL,                           NULL },
+    { DATABASE_ZSTD_THREADS_OPTION,             NULL,                           NULL },
+    { TRUST_CTIME_OPTION,                       NULL,                           NULL },
+    { TRUST_CTIME_VERIFY_PERCENTAGE_OPTION,     NULL,                           NULL },
+    { SORT_DIRECTORY_ENTRIES_OPTION,            NULL,                           NULL },
+    { MAX_PENDING_ENTRIES_OPTION,               NULL,                           NULL },
+    { DATABASE_IN_CONCURRENT_OPTION,            NULL,                           NULL },
+    { DATABASE_PARSE_THREADS_OPTION,            NULL,                           NULL },
+    { DATABASE_OUT_INDEX_OPTION,                NULL,                           NULL },
+    { DATABASE_IN_DELTA_OPTION,                 NULL,                           NULL },
+    { DATABASE_OUT_DELTA_OPTION,                NULL,                           NULL },
+    { DATABASE_IN_SHARD_OPTION,                 NULL,                           NULL },
+    { SHARD_CMDLINE_OPTION,                     "shard",                        "Shard" },
+    { CHECKPOINT_INTERVAL_OPTION,               NULL,                           NULL },
+    { DAEMON_MAX_REQUESTS_OPTION,               NULL,                           NULL },
 };
 
 static ast* new_ast_node(void) {
@@ -55,6 +55,10 @@
 #include <errno.h>
 #include <unistd.h>
 
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+
 LOG_LEVEL eval_log_level = LOG_LEVEL_TRACE;
 
 bool log_level_set_in_config = false;
@@ -210,6 +214,8 @@ static void eval_config_statement(config_option_statement statement, int linenum
         DATABASE_CONFIG_OPTION_CASE(DATABASE_IN_OPTION, DB_TYPE_IN)
         DATABASE_CONFIG_OPTION_CASE(DATABASE_OUT_OPTION, DB_TYPE_OUT)
         DATABASE_CONFIG_OPTION_CASE(DATABASE_NEW_OPTION, DB_TYPE_NEW)
+        DATABASE_CONFIG_OPTION_CASE(DATABASE_IN_DELTA_OPTION, DB_TYPE_IN_DELTA)
+        DATABASE_CONFIG_OPTION_CASE(DATABASE_IN_SHARD_OPTION, DB_TYPE_IN_SHARD)
         case DATABASE_ATTRIBUTES_OPTION:
             set_database_attr_option(
                     eval_attribute_expression(statement.a, linenumber, filename, linebuf),
@@ -298,6 +304,7 @@ static void eval_config_statement(config_option_statement statement, int linenum
             LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'config_version' option to '%s'", str)
             break;
         case LIMIT_CMDLINE_OPTION:
+        case SHARD_CMDLINE_OPTION:
             /* command-line options are ignored here */
             break;
         case NUM_WORKERS:
@@ -315,6 +322,211 @@ static void eval_config_statement(config_option_statement statement, int linenum
                     LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "'num_workers' option already set (ignore new value '%s')", str)
             }
             break;
+        BOOL_CONFIG_OPTION_CASE(WORK_STEALING_OPTION, work_stealing)
+        case HASH_IO_ENGINE_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            if (strcmp(str, "sync") == 0) {
+                conf->hash_io_engine = HASH_IO_ENGINE_SYNC;
+            } else if (strcmp(str, "uring") == 0) {
+#ifdef WITH_LIBURING
+                conf->hash_io_engine = HASH_IO_ENGINE_URING;
+#else
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "%s", "io_uring support not compiled in, recompile AIDE with '--with-liburing'")
+                exit(INVALID_CONFIGURELINE_ERROR);
+#endif
+            } else {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid hash I/O engine: '%s' (expected 'sync' or 'uring')", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'hash_io_engine' option to '%s'", str)
+            free(str);
+            break;
+        case PARALLEL_HASHSUMS_THRESHOLD_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            long long threshold = do_size(str);
+            if (threshold < 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid size: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            conf->parallel_hashsums_threshold = threshold;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'parallel_hashsums_threshold' option to %lld (config value: '%s')", threshold, str)
+            free(str);
+            break;
+        case PARALLEL_BLAKE3_THRESHOLD_OPTION:
+#ifdef HAVE_BLAKE3_HASHER_UPDATE_TBB
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            conf->parallel_blake3_threshold = do_size(str);
+            if (conf->parallel_blake3_threshold < 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid size: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'parallel_blake3_threshold' option to %lld (config value: '%s')", conf->parallel_blake3_threshold, str)
+            free(str);
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "%s", "multithreaded BLAKE3 not available, recompile AIDE with '--with-blake3' using libblake3 built with TBB support")
+            exit(INVALID_CONFIGURELINE_ERROR);
+#endif
+            break;
+        case DATABASE_FORMAT_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            if (strcmp(str, "text") == 0) {
+                conf->database_format = DB_FORMAT_TEXT;
+            } else if (strcmp(str, "binary") == 0) {
+                conf->database_format = DB_FORMAT_BINARY;
+            } else {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid database format: '%s' (expected 'text' or 'binary')", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'database_format' option to '%s'", str)
+            free(str);
+            break;
+        case DATABASE_OUT_BUFFER_SIZE_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            conf->database_out_buffer_size = do_size(str);
+            if (conf->database_out_buffer_size <= 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid size: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'database_out_buffer_size' option to %lld (config value: '%s')", conf->database_out_buffer_size, str)
+            free(str);
+            break;
+        case DATABASE_GZIP_LEVEL_OPTION:
+#ifdef WITH_ZLIB
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            char *gzip_level_end;
+            long gzip_level = strtol(str, &gzip_level_end, 10);
+            if (*str == '\0' || *gzip_level_end != '\0' || gzip_level < 1 || gzip_level > 9) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid gzip compression level: '%s' (expected 1-9)", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            conf->gzip_dbout_level = gzip_level;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'gzip_dbout_level' option to %d", conf->gzip_dbout_level)
+            free(str);
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "%s", "gzip support not compiled in, recompile AIDE with '--with-zlib'")
+            exit(INVALID_CONFIGURELINE_ERROR);
+#endif
+            break;
+        case DATABASE_GZIP_THREADS_OPTION:
+#ifdef WITH_ZLIB
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            conf->gzip_dbout_threads = do_num_workers(str);
+            if (conf->gzip_dbout_threads < 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of threads: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'gzip_dbout_threads' option to %ld (config value: '%s')", conf->gzip_dbout_threads, str)
+            free(str);
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "%s", "gzip support not compiled in, recompile AIDE with '--with-zlib'")
+            exit(INVALID_CONFIGURELINE_ERROR);
+#endif
+            break;
+        case DATABASE_ZSTD_OPTION:
+#ifdef WITH_ZSTD
+            b = string_expression_to_bool(statement.e, linenumber, filename, linebuf);
+            conf->zstd_dbout = b;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'zstd_dbout' to '%s'", btoa(conf->zstd_dbout))
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "%s", "zstd support not compiled in, recompile AIDE with '--with-zstd'")
+            exit(INVALID_CONFIGURELINE_ERROR);
+#endif
+            break;
+        case DATABASE_ZSTD_LEVEL_OPTION:
+#ifdef WITH_ZSTD
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            char *zstd_level_end;
+            long zstd_level = strtol(str, &zstd_level_end, 10);
+            if (*str == '\0' || *zstd_level_end != '\0' || zstd_level < 1 || zstd_level > ZSTD_maxCLevel()) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid zstd compression level: '%s' (expected 1-%d)", str, ZSTD_maxCLevel());
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            conf->zstd_dbout_level = zstd_level;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'zstd_dbout_level' option to %d", conf->zstd_dbout_level)
+            free(str);
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "%s", "zstd support not compiled in, recompile AIDE with '--with-zstd'")
+            exit(INVALID_CONFIGURELINE_ERROR);
+#endif
+            break;
+        case DATABASE_ZSTD_THREADS_OPTION:
+#ifdef WITH_ZSTD
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            conf->zstd_dbout_threads = do_num_workers(str);
+            if (conf->zstd_dbout_threads < 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of threads: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'zstd_dbout_threads' option to %ld (config value: '%s')", conf->zstd_dbout_threads, str)
+            free(str);
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "%s", "zstd support not compiled in, recompile AIDE with '--with-zstd'")
+            exit(INVALID_CONFIGURELINE_ERROR);
+#endif
+            break;
+        BOOL_CONFIG_OPTION_CASE(TRUST_CTIME_OPTION, trust_ctime)
+        BOOL_CONFIG_OPTION_CASE(SORT_DIRECTORY_ENTRIES_OPTION, sort_directory_entries)
+        BOOL_CONFIG_OPTION_CASE(DATABASE_IN_CONCURRENT_OPTION, database_in_concurrent)
+        BOOL_CONFIG_OPTION_CASE(DATABASE_OUT_INDEX_OPTION, database_out_index)
+        BOOL_CONFIG_OPTION_CASE(DATABASE_OUT_DELTA_OPTION, database_out_delta)
+        case TRUST_CTIME_VERIFY_PERCENTAGE_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            char *percentage_end;
+            long percentage = strtol(str, &percentage_end, 10);
+            if (*str == '\0' || *percentage_end != '\0' || percentage < 0 || percentage > 100) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid percentage: '%s' (expected 0-100)", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            conf->trust_ctime_verify_percentage = percentage;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'trust_ctime_verify_percentage' option to %d", conf->trust_ctime_verify_percentage)
+            free(str);
+            break;
+        case DATABASE_PARSE_THREADS_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            conf->database_parse_threads = do_num_workers(str);
+            if (conf->database_parse_threads < 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of threads: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'database_parse_threads' option to %ld (config value: '%s')", conf->database_parse_threads, str)
+            free(str);
+            break;
+        case MAX_PENDING_ENTRIES_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            char *max_pending_end;
+            long max_pending = strtol(str, &max_pending_end, 10);
+            if (*str == '\0' || *max_pending_end != '\0' || max_pending < 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of entries: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            conf->max_pending_entries = max_pending;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'max_pending_entries' option to %ld", conf->max_pending_entries)
+            free(str);
+            break;
+        case CHECKPOINT_INTERVAL_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            char *interval_end;
+            long interval = strtol(str, &interval_end, 10);
+            if (*str == '\0' || *interval_end != '\0' || interval < 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of seconds: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            conf->checkpoint_interval = interval;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'checkpoint_interval' option to %ld", conf->checkpoint_interval)
+            free(str);
+            break;
+        case DAEMON_MAX_REQUESTS_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            char *max_requests_end;
+            long max_requests = strtol(str, &max_requests_end, 10);
+            if (*str == '\0' || *max_requests_end != '\0' || max_requests < 1) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of requests: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            conf->daemon_max_requests = max_requests;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'daemon_max_requests' option to %ld", conf->daemon_max_requests)
+            free(str);
+            break;
     }
 }
 
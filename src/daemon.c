@@ -0,0 +1,485 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "aide.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+
+#include "commandconf.h"
+#include "daemon.h"
+#include "db.h"
+#include "db_config.h"
+#include "db_disk.h"
+#include "errorcodes.h"
+#include "gen_list.h"
+#include "list.h"
+#include "log.h"
+#include "report.h"
+#include "url.h"
+#include "util.h"
+
+/* file whose change makes the daemon reload */
+typedef struct watched_file {
+    const char *path;
+    struct stat loaded; /* state of the file when the daemon started */
+    struct stat last; /* state of the file at the last check */
+} watched_file;
+
+static watched_file *watched_files = NULL;
+static int num_watched_files = 0;
+
+static volatile sig_atomic_t daemon_signal = 0;
+
+static void daemon_sig_handler(int signum) {
+    /* SIGCHLD only interrupts poll() to reap the finished requests */
+    if (signum != SIGCHLD) {
+        daemon_signal = signum;
+    }
+}
+
+static void set_sighandler(int signum, void (*handler)(int)) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handler;
+    sigemptyset(&sa.sa_mask);
+    /* no SA_RESTART, the signals have to interrupt poll() */
+    sa.sa_flags = 0;
+    sigaction(signum, &sa, NULL);
+}
+
+static bool same_file_state(struct stat *a, struct stat *b) {
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino
+        && a->st_size == b->st_size && a->st_mtime == b->st_mtime;
+}
+
+static void watch_file(const char *path) {
+    struct stat st;
+    if (stat(path, &st) == -1) {
+        log_msg(LOG_LEVEL_WARNING, "daemon: stat() for '%s' failed: %s (changes of the file are not detected)", path, strerror(errno));
+        return;
+    }
+    watched_files = checked_realloc(watched_files, (num_watched_files + 1) * sizeof(watched_file));
+    watched_files[num_watched_files].path = path;
+    watched_files[num_watched_files].loaded = st;
+    watched_files[num_watched_files].last = st;
+    num_watched_files++;
+    log_msg(LOG_LEVEL_DEBUG, "daemon: watch '%s' for changes", path);
+}
+
+static void watch_database(database *db) {
+    if (db->url && db->url->type == url_file) {
+        watch_file(db->url->value);
+    }
+}
+
+/*
+ * Returns the path of a changed file or NULL
+ *
+ * A file counts as changed once its new state has been seen by two
+ * consecutive checks, i.e. a file being written is not read too early.
+ */
+static const char *get_changed_file(void) {
+    for (int i = 0 ; i < num_watched_files ; ++i) {
+        watched_file *f = &watched_files[i];
+        struct stat st;
+        if (stat(f->path, &st) == -1) {
+            continue;
+        }
+        bool stable = same_file_state(&st, &f->last);
+        f->last = st;
+        if (stable && !same_file_state(&st, &f->loaded)) {
+            return f->path;
+        }
+    }
+    return NULL;
+}
+
+/* returns the listening socket passed by the daemon executing itself or -1 */
+static int get_inherited_socket(void) {
+    char *fd_str = getenv(DAEMON_SOCKET_FD_ENV);
+    if (fd_str == NULL) {
+        return -1;
+    }
+    char *endptr;
+    long fd = strtol(fd_str, &endptr, 10);
+    unsetenv(DAEMON_SOCKET_FD_ENV);
+    struct stat st;
+    if (*fd_str == '\0' || *endptr != '\0' || fd < 0 || fd > INT_MAX || fstat(fd, &st) == -1 || !S_ISSOCK(st.st_mode)) {
+        log_msg(LOG_LEVEL_WARNING, "daemon: ignore invalid inherited socket '%s'", fd_str);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    log_msg(LOG_LEVEL_DEBUG, "daemon: use inherited socket (fd: %ld)", fd);
+    return fd;
+}
+
+static int open_socket(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_msg(LOG_LEVEL_ERROR, "daemon: socket path '%s' is too long (maximum length: %zu)", path, sizeof(addr.sun_path) - 1);
+        return -1;
+    }
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        log_msg(LOG_LEVEL_ERROR, "daemon: socket() failed: %s", strerror(errno));
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    int bound = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+    if (bound == -1 && errno == EADDRINUSE) {
+        struct stat st;
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool in_use = probe != -1 && connect(probe, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+        if (probe != -1) {
+            close(probe);
+        }
+        if (in_use) {
+            log_msg(LOG_LEVEL_ERROR, "daemon: socket '%s' is in use (is another daemon running?)", path);
+            close(fd);
+            return -1;
+        }
+        if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            log_msg(LOG_LEVEL_INFO, "daemon: remove stale socket '%s'", path);
+            unlink(path);
+        }
+        bound = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+    }
+    if (bound == -1) {
+        log_msg(LOG_LEVEL_ERROR, "daemon: bind() for socket '%s' failed: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, SOMAXCONN) == -1) {
+        log_msg(LOG_LEVEL_ERROR, "daemon: listen() for socket '%s' failed: %s", path, strerror(errno));
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return fd;
+}
+
+/* sends the error to the client, returns code */
+static int request_error(int code, const char *format, ...)
+#ifdef __GNUC__
+        __attribute__ ((format (printf, 2, 3)))
+#endif
+;
+static int request_error(int code, const char *format, ...) {
+    char msg[512];
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(msg, sizeof(msg), format, ap);
+    va_end(ap);
+
+    log_msg(LOG_LEVEL_WARNING, "daemon: request failed: %s", msg);
+    fprintf(stdout, "@@aide_error %s\n@@aide_exit %d\n", msg, code);
+    fflush(stdout);
+    return code;
+}
+
+/* reads the request until the empty line, returns NULL on error */
+static char *read_request(int fd) {
+    char *request = checked_malloc(DAEMON_REQUEST_MAX_SIZE + 1); /* freed in run_request() */
+    size_t len = 0;
+    request[0] = '\0';
+    while (request[0] != '\n' && strstr(request, "\n\n") == NULL) {
+        if (len == DAEMON_REQUEST_MAX_SIZE) {
+            log_msg(LOG_LEVEL_WARNING, "daemon: request exceeds %d bytes", DAEMON_REQUEST_MAX_SIZE);
+            free(request);
+            return NULL;
+        }
+        ssize_t n = read(fd, request + len, DAEMON_REQUEST_MAX_SIZE - len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_msg(LOG_LEVEL_WARNING, "daemon: failed to read request: %s", errno == EAGAIN || errno == EWOULDBLOCK ? "timed out" : strerror(errno));
+            free(request);
+            return NULL;
+        }
+        if (n == 0) {
+            break;
+        }
+        len += n;
+        request[len] = '\0';
+    }
+    return request;
+}
+
+static bool set_request_limit(char *limit) {
+    int pcre2_errorcode;
+    PCRE2_SIZE pcre2_erroffset;
+    conf->limit = checked_strdup(limit);
+    if ((conf->limit_crx = pcre2_compile((PCRE2_SPTR) conf->limit, PCRE2_ZERO_TERMINATED, PCRE2_UTF|PCRE2_ANCHORED, &pcre2_errorcode, &pcre2_erroffset, NULL)) == NULL) {
+        PCRE2_UCHAR pcre2_error[128];
+        pcre2_get_error_message(pcre2_errorcode, pcre2_error, 128);
+        char *limit_safe = stresc(conf->limit);
+        request_error(INVALID_ARGUMENT_ERROR, "error in regular expression of limit '%s' at %zu: %s", limit_safe, pcre2_erroffset, pcre2_error);
+        free(limit_safe);
+        return false;
+    }
+    if (pcre2_jit_compile(conf->limit_crx, PCRE2_JIT_PARTIAL_SOFT) < 0) {
+        log_msg(LOG_LEVEL_DEBUG, "JIT compilation for limit '%s' failed (fall back to interpreted matching)", conf->limit);
+    }
+    return true;
+}
+
+/* applies the 'key=value' lines of the request to conf */
+bool daemon_apply_request(char *request) {
+    REPORT_FORMAT report_format = REPORT_FORMAT_UNKNOWN;
+    bool report_urls_reset = false;
+    int linenumber = 0;
+
+    char *line = request;
+    while (*line != '\0' && *line != '\n') {
+        char *end = strchr(line, '\n');
+        if (end) {
+            *end = '\0';
+        }
+        linenumber++;
+        char *value = strchr(line, '=');
+        if (value == NULL) {
+            char *line_safe = stresc(line);
+            request_error(INVALID_ARGUMENT_ERROR, "line %d: missing '=': '%s'", linenumber, line_safe);
+            free(line_safe);
+            return false;
+        }
+        *value++ = '\0';
+        log_msg(LOG_LEVEL_INFO, "daemon: request: set '%s' to '%s'", line, value);
+        if (strcmp(line, "limit") == 0) {
+            if (conf->limit) {
+                request_error(INVALID_ARGUMENT_ERROR, "line %d: limit already set", linenumber);
+                return false;
+            }
+            if (!set_request_limit(value)) {
+                return false;
+            }
+        } else if (strcmp(line, "report_format") == 0) {
+            if ((report_format = get_report_format(value)) == REPORT_FORMAT_UNKNOWN) {
+                request_error(INVALID_ARGUMENT_ERROR, "line %d: invalid report format: '%s'", linenumber, value);
+                return false;
+            }
+        } else if (strcmp(line, "report_url") == 0) {
+            if (!report_urls_reset) {
+                /* the report URLs of the request replace the configured ones */
+                conf->report_urls = NULL;
+                report_urls_reset = true;
+            }
+            if (!do_repurldef(checked_strdup(value), linenumber, "(request)", NULL)) {
+                request_error(INVALID_ARGUMENT_ERROR, "line %d: invalid report URL: '%s'", linenumber, value);
+                return false;
+            }
+        } else {
+            request_error(INVALID_ARGUMENT_ERROR, "line %d: unknown key '%s'", linenumber, line);
+            return false;
+        }
+        if (end == NULL) {
+            break;
+        }
+        line = end + 1;
+    }
+
+    if (report_format != REPORT_FORMAT_UNKNOWN) {
+        conf->report_format = report_format;
+        for (list *l = conf->report_urls; l; l = l->next) {
+            ((report_t *) l->data)->format = report_format;
+        }
+    }
+    return true;
+}
+
+/* runs the request in the forked child, returns the exit code */
+static int run_request(int conn) {
+    struct timeval timeout = { .tv_sec = DAEMON_REQUEST_TIMEOUT, .tv_usec = 0 };
+    if (setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1) {
+        log_msg(LOG_LEVEL_WARNING, "daemon: failed to set receive timeout: %s", strerror(errno));
+    }
+    char *request = read_request(conn);
+
+    /* reports written to stdout are sent to the client */
+    if (dup2(conn, STDOUT_FILENO) == -1) {
+        log_msg(LOG_LEVEL_ERROR, "daemon: dup2() failed: %s", strerror(errno));
+        return IO_ERROR;
+    }
+    close(conn);
+
+    if (request == NULL) {
+        return request_error(IO_ERROR, "failed to read request");
+    }
+    bool applied = daemon_apply_request(request);
+    free(request);
+    if (!applied) {
+        return INVALID_ARGUMENT_ERROR;
+    }
+
+    if (!init_report_urls()) {
+        return request_error(INVALID_CONFIGURELINE_ERROR, "failed to initialize report URLs");
+    }
+
+    if (conf->limit) {
+        limit_old_entries(conf->tree);
+    }
+
+    conf->start_time = time(NULL);
+    log_msg(LOG_LEVEL_INFO, "read new entries from disk (limit: '%s', root prefix: '%s')", conf->limit?conf->limit:"(none)", conf->root_prefix);
+    db_scan_disk(false);
+    conf->end_time = time(NULL);
+
+    log_msg(LOG_LEVEL_INFO, "generate reports");
+    int exitcode = gen_report(conf->tree);
+
+    fflush(stdout);
+    fprintf(stdout, "@@aide_exit %d\n", exitcode);
+    fflush(stdout);
+    return exitcode;
+}
+
+static void reap_requests(long *running) {
+    pid_t pid;
+    int status;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        /* requests of a previous daemon image are not counted */
+        if (*running > 0) {
+            (*running)--;
+        }
+        if (WIFEXITED(status)) {
+            log_msg(LOG_LEVEL_INFO, "daemon: request (pid %d) finished with exit code %d", pid, WEXITSTATUS(status));
+        } else if (WIFSIGNALED(status)) {
+            log_msg(LOG_LEVEL_WARNING, "daemon: request (pid %d) terminated by signal %d", pid, WTERMSIG(status));
+        }
+    }
+}
+
+int daemon_run(const char *socket_path, char **argv) {
+    if (db_init(&(conf->database_in), true, false) == RETFAIL) {
+        return IO_ERROR;
+    }
+    read_old_database(conf->tree);
+    db_close();
+
+    if (conf->config_file && strcmp(conf->config_file, "-") != 0) {
+        watch_file(conf->config_file);
+    }
+    watch_database(&(conf->database_in));
+    for (int i = 0 ; i < conf->num_database_in_deltas ; ++i) {
+        watch_database(&(conf->database_in_deltas[i]));
+    }
+
+    int listen_fd = get_inherited_socket();
+    if (listen_fd == -1 && (listen_fd = open_socket(socket_path)) == -1) {
+        return IO_ERROR;
+    }
+
+    set_sighandler(SIGHUP, daemon_sig_handler);
+    set_sighandler(SIGINT, daemon_sig_handler);
+    set_sighandler(SIGTERM, daemon_sig_handler);
+    set_sighandler(SIGCHLD, daemon_sig_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    log_msg(LOG_LEVEL_NOTICE, "daemon: accept requests on socket '%s' (maximum number of concurrent requests: %ld)", socket_path, conf->daemon_max_requests);
+
+    long running = 0;
+    const char *changed = NULL;
+    while (daemon_signal == 0 && (changed = get_changed_file()) == NULL) {
+        reap_requests(&running);
+
+        struct pollfd pfd = { .fd = listen_fd, .events = POLLIN, .revents = 0 };
+        /* with the maximum number of running requests new connections wait in the backlog */
+        if (poll(&pfd, running < conf->daemon_max_requests ? 1 : 0, 1000) <= 0 || !(pfd.revents&POLLIN)) {
+            continue;
+        }
+        int conn = accept(listen_fd, NULL, NULL);
+        if (conn == -1) {
+            if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED) {
+                log_msg(LOG_LEVEL_WARNING, "daemon: accept() failed: %s", strerror(errno));
+            }
+            continue;
+        }
+
+        fflush(stdout);
+        fflush(stderr);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listen_fd);
+            signal(SIGHUP, SIG_DFL);
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+            signal(SIGCHLD, SIG_DFL);
+            signal(SIGPIPE, SIG_DFL);
+            exit(run_request(conn));
+        } else if (pid == -1) {
+            log_msg(LOG_LEVEL_WARNING, "daemon: fork() failed: %s", strerror(errno));
+            const char *msg = "@@aide_error failed to start request\n";
+            (void) !write(conn, msg, strlen(msg));
+        } else {
+            running++;
+            log_msg(LOG_LEVEL_INFO, "daemon: started request (pid %d, running requests: %ld)", pid, running);
+        }
+        close(conn);
+    }
+
+    if (daemon_signal == SIGHUP || changed) {
+        if (changed) {
+            log_msg(LOG_LEVEL_NOTICE, "daemon: '%s' has changed, reload configuration and database", changed);
+        } else {
+            log_msg(LOG_LEVEL_NOTICE, "daemon: received SIGHUP, reload configuration and database");
+        }
+        /*
+         * the listening socket is kept open, i.e. new connections wait in
+         * the backlog; running requests are finished by the forked children
+         */
+        char fd_str[32];
+        snprintf(fd_str, sizeof(fd_str), "%d", listen_fd);
+        fcntl(listen_fd, F_SETFD, 0);
+        setenv(DAEMON_SOCKET_FD_ENV, fd_str, 1);
+        execvp(argv[0], argv);
+        log_msg(LOG_LEVEL_ERROR, "daemon: failed to execute '%s': %s", argv[0], strerror(errno));
+        close(listen_fd);
+        unlink(socket_path);
+        return EXEC_ERROR;
+    }
+    close(listen_fd);
+    unlink(socket_path);
+    log_msg(LOG_LEVEL_NOTICE, "daemon: received signal %d, stop daemon (%ld running request(s) are finished in the background)", (int) daemon_signal, running);
+    return 0;
+}
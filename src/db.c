@@ -25,6 +25,7 @@
 #include <string.h>
 #include <errno.h>
 #include <time.h>
+#include <unistd.h>
 #include "attributes.h"
 #include "config.h"
 #include "hashsum.h"
@@ -33,6 +34,10 @@
 #include "db.h"
 #include "db_line.h"
 #include "db_file.h"
+#include "db_binary.h"
+#include "db_delta.h"
+#include "errorcodes.h"
+#include "db_merge.h"
 #include "md.h"
 
 #ifdef WITH_CURL
@@ -173,6 +178,7 @@ static db_line *close_db_attrs (database *db) {
             }
         }
         line->perm = 0;
+        line->reused_hashsums = 0;
         line->attr = conf->db_attrs;
         close_md(db->mdc, &hs, line->filename, NULL);
         hashsums2line(&hs, line, NULL);
@@ -181,35 +187,122 @@ static db_line *close_db_attrs (database *db) {
     return line;
 }
 
+/* zstd compressed input databases are detected by their magic */
+static int db_zstd_detect(database *db) {
+    switch ((db->url)->type) {
+        case url_file:
+        case url_fd:
+        case url_stdin: {
+            char head[4];
+            if (pread(fileno((FILE *) db->fp), head, sizeof(head), 0) == sizeof(head) && memcmp(head, "\x28\xb5\x2f\xfd", sizeof(head)) == 0) {
+                log_msg(LOG_LEVEL_DEBUG, "%s is zstd compressed", (db->url)->raw);
+#ifdef WITH_ZSTD
+                db->zstd_in = zstd_reader_open(fileno((FILE *) db->fp)); /* freed in db_close */
+                if (db->zstd_in == NULL) {
+                    log_msg(LOG_LEVEL_ERROR, "failed to initialize zstd reader for %s", (db->url)->raw);
+                    return RETFAIL;
+                }
+#else
+                log_msg(LOG_LEVEL_ERROR, "%s: zstd support not compiled in, recompile AIDE with '--with-zstd'", (db->url)->raw);
+                return RETFAIL;
+#endif
+            }
+            return RETOK;
+        }
+        default:
+            return RETOK;
+    }
+}
+
 int db_init(database* db, bool readonly, bool gzip) {
   void* fp = NULL;
   
   log_msg(LOG_LEVEL_TRACE,"db_init(): arguments: db=%p, gzip=%s", (void*) db, btoa(gzip));
   
+#ifdef WITH_ZSTD
+    if (!readonly && conf->zstd_dbout && ((db->url)->type == url_http || (db->url)->type == url_https || (db->url)->type == url_ftp)) {
+        log_msg(LOG_LEVEL_ERROR, "zstd compression is not supported for %s", (db->url)->raw);
+        return RETFAIL;
+    }
+#endif
     db->mdc = init_db_attrs(db->url);
     bool created = false;
-    fp=be_init(db->url, readonly, gzip, false, db->linenumber, db->filename, db->linebuf, &created);
+#ifdef WITH_ZLIB
+    /* gzipped files are written by the block-parallel gzip writer */
+    bool use_pgzip = gzip && !readonly && (db->url)->type != url_http && (db->url)->type != url_https && (db->url)->type != url_ftp;
+#else
+    bool use_pgzip = false;
+#endif
+    fp=be_init(db->url, readonly, gzip && !use_pgzip, false, db->linenumber, db->filename, db->linebuf, &created);
     if (created) { db->flags |= DB_FLAG_CREATED; }
     if(fp==NULL) {
       return RETFAIL;
     } else {
 #ifdef WITH_ZLIB
-        if (gzip) {
+        if (use_pgzip) {
+            db->fp = fp;
+            db->pgz = pgzip_open(fp, conf->gzip_dbout_level, conf->gzip_dbout_threads);
+            if (db->pgz == NULL) {
+                log_msg(LOG_LEVEL_ERROR, "failed to initialize gzip writer for %s", (db->url)->raw);
+                return RETFAIL;
+            }
+        } else if (gzip) {
             db->gzp = fp;
         } else {
 #endif
             db->fp = fp;
 #ifdef WITH_ZLIB
         }
+#endif
+    if (readonly) {
+        int ret = db_binary_detect(db) ? db_binary_open(db) : db_zstd_detect(db);
+        if (ret == RETOK && db == &(conf->database_in) && conf->num_database_in_deltas) {
+            /* the delta databases are opened along with database_in */
+            ret = db_delta_init(db);
+        }
+        return ret;
+    }
+#ifdef WITH_ZSTD
+    if (conf->zstd_dbout) {
+        db->zstd_out = zstd_writer_open(db->fp, conf->zstd_dbout_level, conf->zstd_dbout_threads);
+        if (db->zstd_out == NULL) {
+            log_msg(LOG_LEVEL_ERROR, "failed to initialize zstd writer for %s", (db->url)->raw);
+            return RETFAIL;
+        }
+    }
 #endif
     return RETOK;
     }
 }
 
 db_entry_t db_readline(database* db, bool include_limited_entries){
+  if (db->merge) {
+      return db_merge_readline(db->merge, include_limited_entries);
+  }
+  return db_readline_single(db, include_limited_entries);
+}
+
+/* reads the next entry of db only (i.e. without merging the delta databases) */
+db_entry_t db_readline_single(database* db, bool include_limited_entries){
+  if (db->binary) {
+      return db_readline_binary(db, include_limited_entries);
+  }
   return db_readline_file(db, include_limited_entries);
 }
 
+DB_ATTR_TYPE db_get_attrs(database* db) {
+    if (db->binary) {
+        return db_binary_get_attrs(db);
+    }
+    DB_ATTR_TYPE attrs = ATTR(attr_filename)|ATTR(attr_attr);
+    for (int i = 0 ; i < db->num_fields ; ++i) {
+        if (db->fields[i] != attr_unknown) {
+            attrs |= ATTR(db->fields[i]);
+        }
+    }
+    return attrs;
+}
+
 byte* base64tobyte(char* src,int len,size_t *ret_len)
 {
   if(strcmp(src,"0")!=0){
@@ -276,6 +369,7 @@ db_line* db_char2line(char** ss, database* db){
   line->e2fsattrs=0;
   line->cntx=NULL;
   line->capabilities=NULL;
+  line->reused_hashsums=0;
 
   for (int i = 0 ; i < num_hashes ; ++i) {
       line->hashsums[i]=NULL;
@@ -357,8 +451,9 @@ db_line* db_char2line(char** ss, database* db){
     case attr_acl : {
 #ifdef WITH_POSIX_ACL
       char *tval = NULL;
+      char *saveptr = NULL;
       
-      tval = strtok(ss[db->fields[i]], ",");
+      tval = strtok_r(ss[db->fields[i]], ",", &saveptr);
 
       line->acl = NULL;
 
@@ -370,9 +465,9 @@ db_line* db_char2line(char** ss, database* db){
         line->acl->acl_a = NULL;
         line->acl->acl_d = NULL;
         
-        tval = strtok(NULL, ",");
+        tval = strtok_r(NULL, ",", &saveptr);
         line->acl->acl_a = (char *)base64tobyte(tval, strlen(tval), NULL);
-        tval = strtok(NULL, ",");
+        tval = strtok_r(NULL, ",", &saveptr);
         line->acl->acl_d = (char *)base64tobyte(tval, strlen(tval), NULL);
       }
       /* else, it's broken... */
@@ -383,8 +478,9 @@ db_line* db_char2line(char** ss, database* db){
 #ifdef WITH_XATTR
         size_t num = 0;
         char *tval = NULL;
+        char *saveptr = NULL;
         
-        tval = strtok(ss[db->fields[i]], ",");
+        tval = strtok_r(ss[db->fields[i]], ",", &saveptr);
         num = readlong(tval,  db, "xattrs");
         if (num)
         {
@@ -395,10 +491,10 @@ db_line* db_char2line(char** ss, database* db){
           num = 0;
           while (num < line->xattrs->num)
           {
-            tval = strtok(NULL, ",");
+            tval = strtok_r(NULL, ",", &saveptr);
             decode_string(tval);
             line->xattrs->ents[num].key = checked_strdup(tval);
-            tval = strtok(NULL, ",");
+            tval = strtok_r(NULL, ",", &saveptr);
             if (strcmp(tval,"0") != 0) {
                 line->xattrs->ents[num].val = decode_base64(tval, strlen(tval), &line->xattrs->ents[num].vsz);
             } else {
@@ -497,6 +593,9 @@ int db_writespec(db_config* dbconf)
        (dbconf->gzip_dbout && dbconf->database_out.gzp) ||
 #endif
        (dbconf->database_out.fp!=NULL)){
+      if (dbconf->database_format == DB_FORMAT_BINARY) {
+          return db_writespec_binary(dbconf);
+      }
       if(db_writespec_file(dbconf)==RETOK){
 	return RETOK;
       }
@@ -513,6 +612,9 @@ int db_writeline(db_line* line,db_config* dbconf){
        (dbconf->gzip_dbout && dbconf->database_out.gzp) ||
 #endif
        (dbconf->database_out.fp!=NULL)) {
+      if (dbconf->database_out.binary) {
+          return db_writeline_binary(line, dbconf);
+      }
       if (db_writeline_file(line)==RETOK) {
 	return RETOK;
       }
@@ -520,7 +622,111 @@ int db_writeline(db_line* line,db_config* dbconf){
   return RETFAIL;
 }
 
+int db_writeremoved(db_line* line,db_config* dbconf){
+
+  if (line==NULL||dbconf==NULL) return RETOK;
+
+    if (
+#ifdef WITH_ZLIB
+       (dbconf->gzip_dbout && dbconf->database_out.gzp) ||
+#endif
+       (dbconf->database_out.fp!=NULL)) {
+      if (!dbconf->database_out.binary && db_writeremoved_file(line)==RETOK) {
+	return RETOK;
+      }
+    }
+  return RETFAIL;
+}
+
+/*
+ * Writes all entries of database_in (merged with its delta databases) or of
+ * the shard databases to database_out (--convert, --compact and --merge)
+ *
+ * Returns the number of entries written or -1 if the header cannot be written
+ */
+long db_convert(database **shards, int num_shards) {
+    /* the shards are disjoint, a path found in multiple shards is an error */
+    db_merge_t *merge = shards ? db_merge_new(shards, num_shards, true) : NULL;
+    /* first entry has to be read before the database fields are known */
+    db_entry_t entry = merge ? db_merge_readline(merge, false) : db_readline(&(conf->database_in), false);
+    if (merge) {
+        conf->db_out_attrs = 0;
+        for (int i = 0 ; i < num_shards ; ++i) {
+            conf->db_out_attrs |= db_get_attrs(shards[i]);
+        }
+    } else {
+        /* the delta databases may contain fields not found in database_in */
+        conf->db_out_attrs = db_get_attrs(&(conf->database_in));
+        for (int i = 0 ; i < conf->num_database_in_deltas ; ++i) {
+            conf->db_out_attrs |= db_get_attrs(&(conf->database_in_deltas[i]));
+        }
+    }
+    if (db_writespec(conf) == RETFAIL) {
+        free_db_line(entry.line);
+        free(entry.line);
+        db_merge_free(merge);
+        return -1;
+    }
+    long num_entries = 0L;
+    while (entry.line != NULL) {
+        db_writeline(entry.line, conf);
+        num_entries++;
+        free_db_line(entry.line);
+        free(entry.line);
+        entry = merge ? db_merge_readline(merge, false) : db_readline(&(conf->database_in), false);
+    }
+    db_merge_free(merge);
+    return num_entries;
+}
+
+/* calculates the database_attrs hashsums of the data read (or written) so far */
+void db_finish_attrs(database *db) {
+    if (db->mdc) {
+        db->db_line = close_db_attrs(db);
+        db->mdc = NULL;
+    }
+}
+
+static void close_input_database(database *db) {
+  db_parser_close(db);
+  db_binary_close(db);
+#ifdef WITH_ZLIB
+  if (db->gzp) {
+      gzclose(db->gzp);
+      db->gzp = NULL;
+  }
+#endif
+#ifdef WITH_ZSTD
+  zstd_reader_close(db->zstd_in);
+  db->zstd_in = NULL;
+#endif
+}
+
 void db_close(void) {
+  /* the delta databases are verified before database_out is finished */
+  bool merged = conf->database_in.merge != NULL;
+  db_merge_free(conf->database_in.merge);
+  conf->database_in.merge = NULL;
+  close_input_database(&conf->database_in);
+  close_input_database(&conf->database_new);
+  db_finish_attrs(&conf->database_in);
+  db_finish_attrs(&conf->database_new);
+  for (int i = 0 ; i < conf->num_database_in_deltas ; ++i) {
+      close_input_database(&conf->database_in_deltas[i]);
+      db_finish_attrs(&conf->database_in_deltas[i]);
+  }
+  for (int i = 0 ; i < conf->num_database_in_shards ; ++i) {
+      close_input_database(&conf->database_in_shards[i]);
+      db_finish_attrs(&conf->database_in_shards[i]);
+  }
+  if (merged && db_delta_verify() == RETFAIL) {
+      if (conf->database_out.url && conf->database_out.url->type == url_file && conf->database_out.flags&DB_FLAG_CREATED) {
+          log_msg(LOG_LEVEL_ERROR, "remove incompletely written database %s", (conf->database_out.url)->raw);
+          unlink(conf->database_out.url->value);
+      }
+      exit(DATABASE_ERROR);
+  }
+
   if (conf->database_out.url) {
   switch (conf->database_out.url->type) {
   case url_stdin:
@@ -533,7 +739,11 @@ void db_close(void) {
        (conf->gzip_dbout && conf->database_out.gzp) ||
 #endif
        (conf->database_out.fp!=NULL)) {
-        db_close_file(conf);
+        if (conf->database_out.binary) {
+            db_close_binary(conf);
+        } else {
+            db_close_file(conf);
+        }
     }
     break;
   }
@@ -556,9 +766,7 @@ void db_close(void) {
   }
   }
   }
-  conf->database_in.db_line = close_db_attrs(&conf->database_in);
-  conf->database_out.db_line = close_db_attrs(&conf->database_out);
-  conf->database_new.db_line = close_db_attrs(&conf->database_new);
+  db_finish_attrs(&conf->database_out);
 }
 
 void free_db_line(db_line* dl)
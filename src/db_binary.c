@@ -0,0 +1,691 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "aide.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "attributes.h"
+#include "db.h"
+#include "db_binary.h"
+#include "db_config.h"
+#include "db_file.h"
+#include "db_line.h"
+#include "errorcodes.h"
+#include "gen_list.h"
+#include "hashsum.h"
+#include "log.h"
+#include "md.h"
+#include "progress.h"
+#include "url.h"
+#include "util.h"
+
+#define DB_BINARY_MAGIC "\211AIDEDB\n"
+#define DB_BINARY_MAGIC_LENGTH 8
+#define DB_BINARY_BYTE_ORDER 0x01020304U
+
+/* string table reference of unset strings */
+#define DB_BINARY_NO_STRING UINT64_MAX
+
+/* header flags */
+#define DB_BINARY_FLAG_SORTED (1U<<0)
+
+/* record flags, bit n (n < num_hashes) is set if hashsum n is present */
+#define DB_BINARY_RECORD_FLAG_ACL (1U<<31)
+
+#define DB_BINARY_COPY_BUFFER_SIZE (64*1024)
+
+typedef struct {
+    char magic[DB_BINARY_MAGIC_LENGTH];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint32_t flags;
+    uint32_t hashsums_size;
+    uint64_t db_attrs;
+    uint64_t num_records;
+    uint64_t records_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    int64_t generation_time;
+    uint64_t aide_version;
+    uint64_t config_version;
+} db_binary_header;
+
+/* fixed-width part of a record, followed by the raw hashsum bytes */
+typedef struct {
+    uint64_t attr;
+    int64_t size;
+    int64_t bcount;
+    int64_t atime;
+    int64_t ctime;
+    int64_t mtime;
+    int64_t inode;
+    int64_t nlink;
+    int64_t uid;
+    int64_t gid;
+    uint64_t fs_type;
+    uint64_t e2fsattrs;
+    /* string table references */
+    uint64_t filename;
+    uint64_t linkname;
+    uint64_t selinux;
+    uint64_t capabilities;
+    uint64_t acl_a;
+    uint64_t acl_d;
+    uint64_t xattrs;
+    uint32_t perm;
+    uint32_t flags;
+} db_binary_record;
+
+struct db_binary {
+    /* input database */
+    char *map;
+    size_t map_size;
+    db_binary_header header;
+    uint64_t next_record;
+
+    /* output database */
+    FILE *records_fp;
+    FILE *strings_fp;
+    uint64_t strings_size;
+    uint64_t num_records;
+    char *record;
+    char *previous_path;
+    size_t previous_path_size;
+    bool sorted;
+    DB_ATTR_TYPE db_attrs;
+    size_t hashsums_size;
+    size_t record_size;
+};
+
+static size_t get_hashsums_size(DB_ATTR_TYPE attrs) {
+    size_t size = 0;
+    for (int i = 0 ; i < num_hashes ; ++i) {
+        if (ATTR(hashsums[i].attribute)&attrs) {
+            size += hashsums[i].length;
+        }
+    }
+    return size;
+}
+
+static size_t get_record_size(size_t hashsums_size) {
+    return (sizeof(db_binary_record) + hashsums_size + 7) & ~((size_t) 7);
+}
+
+/* compare paths component by component (i.e. in the order of the rule tree) */
+int db_path_cmp(const char *a, const char *b) {
+    const unsigned char *s1 = (const unsigned char *) a;
+    const unsigned char *s2 = (const unsigned char *) b;
+    while (*s1 && *s1 == *s2) {
+        s1++;
+        s2++;
+    }
+    int c1 = *s1 == '\0' ? 0 : *s1 == '/' ? 1 : *s1 + 1;
+    int c2 = *s2 == '\0' ? 0 : *s2 == '/' ? 1 : *s2 + 1;
+    return c1 - c2;
+}
+
+/* input database */
+
+bool db_binary_detect(database *db) {
+    switch ((db->url)->type) {
+        case url_file:
+        case url_fd:
+        case url_stdin: {
+            char magic[DB_BINARY_MAGIC_LENGTH];
+            if (db->fp && pread(fileno((FILE *) db->fp), magic, DB_BINARY_MAGIC_LENGTH, 0) == DB_BINARY_MAGIC_LENGTH) {
+                return memcmp(magic, DB_BINARY_MAGIC, DB_BINARY_MAGIC_LENGTH) == 0;
+            }
+            return false;
+        }
+        default:
+            return false;
+    }
+}
+
+static void invalid_database(database *db, const char *reason) {
+    log_msg(LOG_LEVEL_ERROR, "%s: invalid binary database: %s", (db->url)->raw, reason);
+    exit(DATABASE_ERROR);
+}
+
+int db_binary_open(database *db) {
+    int fd = fileno((FILE *) db->fp);
+    struct stat st;
+
+    if (fstat(fd, &st) == -1) {
+        log_msg(LOG_LEVEL_ERROR, "fstat failed for %s: %s", (db->url)->raw, strerror(errno));
+        return RETFAIL;
+    }
+    if ((size_t) st.st_size < sizeof(db_binary_header)) {
+        invalid_database(db, "file too short");
+    }
+
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        log_msg(LOG_LEVEL_ERROR, "mmap failed for %s: %s", (db->url)->raw, strerror(errno));
+        return RETFAIL;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+    struct db_binary *bin = checked_malloc(sizeof(struct db_binary)); /* freed in db_binary_close */
+    memcpy(&bin->header, map, sizeof(db_binary_header));
+    bin->map = map;
+    bin->map_size = st.st_size;
+    bin->next_record = 0;
+    bin->records_fp = NULL;
+    bin->strings_fp = NULL;
+    bin->record = NULL;
+    bin->previous_path = NULL;
+
+    db_binary_header *h = &bin->header;
+    if (h->byte_order != DB_BINARY_BYTE_ORDER) {
+        invalid_database(db, "byte order differs from host byte order");
+    }
+    if (h->version != DB_BINARY_VERSION) {
+        log_msg(LOG_LEVEL_ERROR, "%s: unsupported binary database version %u (supported version: %u)", (db->url)->raw, h->version, DB_BINARY_VERSION);
+        exit(DATABASE_ERROR);
+    }
+    if (h->header_size < sizeof(db_binary_header)
+            || h->record_size != get_record_size(get_hashsums_size(h->db_attrs))
+            || h->hashsums_size != get_hashsums_size(h->db_attrs)) {
+        invalid_database(db, "unexpected header or record size");
+    }
+    if (h->records_offset < h->header_size
+            || h->records_offset > bin->map_size
+            || h->num_records > (bin->map_size - h->records_offset) / h->record_size
+            || h->strings_offset < h->records_offset + h->num_records * h->record_size
+            || h->strings_offset > bin->map_size
+            || h->strings_size > bin->map_size - h->strings_offset) {
+        invalid_database(db, "records or string table exceed file size");
+    }
+
+    if (db->mdc) {
+        update_md(db->mdc, map, st.st_size);
+    }
+
+    db->binary = bin;
+
+    char *str;
+    log_msg(LOG_LEVEL_DEBUG, "%s: open binary database (version: %u, records: %llu, record size: %u, string table: %llu bytes, sorted: %s, attributes: %s)",
+            (db->url)->raw, h->version, (unsigned long long) h->num_records, h->record_size,
+            (unsigned long long) h->strings_size, btoa(h->flags&DB_BINARY_FLAG_SORTED),
+            str = diff_database_attributes(0, h->db_attrs));
+    free(str);
+    return RETOK;
+}
+
+static const char *get_string(database *db, uint64_t ref, uint32_t *length) {
+    struct db_binary *bin = db->binary;
+    if (ref == DB_BINARY_NO_STRING) {
+        return NULL;
+    }
+    uint32_t len;
+    const char *strings = bin->map + bin->header.strings_offset;
+    if (ref > bin->header.strings_size || bin->header.strings_size - ref < sizeof(uint32_t)) {
+        LOG_DB_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid string table reference: %llu", (unsigned long long) ref)
+        exit(DATABASE_ERROR);
+    }
+    memcpy(&len, strings + ref, sizeof(uint32_t));
+    if (bin->header.strings_size - ref - sizeof(uint32_t) < (uint64_t) len + 1) {
+        LOG_DB_FORMAT_LINE(LOG_LEVEL_ERROR, "string at reference %llu exceeds string table", (unsigned long long) ref)
+        exit(DATABASE_ERROR);
+    }
+    if (strings[ref + sizeof(uint32_t) + len] != '\0') {
+        LOG_DB_FORMAT_LINE(LOG_LEVEL_ERROR, "string at reference %llu is not terminated", (unsigned long long) ref)
+        exit(DATABASE_ERROR);
+    }
+    *length = len;
+    return strings + ref + sizeof(uint32_t);
+}
+
+static char *copy_string(database *db, uint64_t ref) {
+    uint32_t length;
+    const char *str = get_string(db, ref, &length);
+    if (str == NULL) {
+        return NULL;
+    }
+    char *copy = checked_malloc(length + 1);
+    memcpy(copy, str, length + 1);
+    return copy;
+}
+
+#ifdef WITH_XATTR
+static xattrs_type *read_xattrs(database *db, uint64_t ref) {
+    uint32_t length;
+    const char *data = get_string(db, ref, &length);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    uint32_t num = 0;
+    size_t offset = 0;
+#define READ_XATTR_UINT32(x) \
+    if (length - offset < sizeof(uint32_t)) { goto invalid; } \
+    memcpy(&x, data + offset, sizeof(uint32_t)); \
+    offset += sizeof(uint32_t);
+
+    READ_XATTR_UINT32(num)
+    if (num == 0) {
+        return NULL;
+    }
+    xattrs_type *xattrs = checked_malloc(sizeof(xattrs_type));
+    xattrs->ents = checked_calloc(sizeof(xattr_node), num);
+    xattrs->sz = num;
+    xattrs->num = num;
+    for (uint32_t i = 0 ; i < num ; ++i) {
+        uint32_t key_len, val_len;
+        READ_XATTR_UINT32(key_len)
+        if (length - offset < key_len) { goto invalid; }
+        xattrs->ents[i].key = checked_strndup(data + offset, key_len);
+        offset += key_len;
+        READ_XATTR_UINT32(val_len)
+        if (length - offset < val_len) { goto invalid; }
+        xattrs->ents[i].val = checked_malloc(val_len + 1);
+        memcpy(xattrs->ents[i].val, data + offset, val_len);
+        xattrs->ents[i].val[val_len] = '\0';
+        xattrs->ents[i].vsz = val_len;
+        offset += val_len;
+    }
+    return xattrs;
+#undef READ_XATTR_UINT32
+invalid:
+    LOG_DB_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid extended attributes at string table reference %llu", (unsigned long long) ref)
+    exit(DATABASE_ERROR);
+}
+#endif
+
+static db_line *record2line(database *db, db_binary_record *record, const char *raw_hashsums) {
+    struct db_binary *bin = db->binary;
+
+    db_line *line = checked_malloc(sizeof(db_line));
+
+    line->attr = record->attr;
+    line->perm = record->perm;
+    line->uid = record->uid;
+    line->gid = record->gid;
+    line->atime = record->atime;
+    line->ctime = record->ctime;
+    line->mtime = record->mtime;
+    line->inode = record->inode;
+    line->nlink = record->nlink;
+    line->size = record->size;
+    line->bcount = record->bcount;
+#ifdef HAVE_FSTYPE
+    line->fs_type = record->fs_type;
+#endif
+    line->e2fsattrs = record->e2fsattrs;
+    line->reused_hashsums = 0;
+
+    line->fullpath = copy_string(db, record->filename);
+    line->filename = line->fullpath;
+    line->linkname = copy_string(db, record->linkname);
+    line->cntx = copy_string(db, record->selinux);
+    line->capabilities = copy_string(db, record->capabilities);
+
+#ifdef WITH_POSIX_ACL
+    line->acl = NULL;
+    if (record->flags&DB_BINARY_RECORD_FLAG_ACL) {
+        line->acl = checked_malloc(sizeof(acl_type));
+        line->acl->acl_a = copy_string(db, record->acl_a);
+        line->acl->acl_d = copy_string(db, record->acl_d);
+    }
+#endif
+#ifdef WITH_XATTR
+    line->xattrs = read_xattrs(db, record->xattrs);
+#endif
+
+    size_t offset = 0;
+    for (int i = 0 ; i < num_hashes ; ++i) {
+        line->hashsums[i] = NULL;
+        if (ATTR(hashsums[i].attribute)&bin->header.db_attrs) {
+            if (record->flags&(1U<<i)) {
+                line->hashsums[i] = checked_malloc(hashsums[i].length);
+                memcpy(line->hashsums[i], raw_hashsums + offset, hashsums[i].length);
+            }
+            offset += hashsums[i].length;
+        }
+    }
+    return line;
+}
+
+db_entry_t db_readline_binary(database *db, bool include_limited_entries) {
+    struct db_binary *bin = db->binary;
+    db_entry_t entry = { .line = NULL, .limit = false };
+
+    while (bin->next_record < bin->header.num_records) {
+        const char *data = bin->map + bin->header.records_offset + bin->next_record * bin->header.record_size;
+        db_binary_record record;
+        memcpy(&record, data, sizeof(db_binary_record));
+        db->lineno = ++bin->next_record;
+
+        uint32_t length;
+        const char *path = get_string(db, record.filename, &length);
+        if (path == NULL || *path != '/') {
+            LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip record with invalid path: '%s'", path ? path : "(null)")
+            continue;
+        }
+        LOG_LEVEL db_parse_log_level = LOG_LEVEL_DEBUG;
+        if (check_limit((char *) path, true, NULL)) {
+            if (include_limited_entries) {
+                entry.limit = true;
+                db_parse_log_level = LOG_LEVEL_LIMIT;
+            } else {
+                update_progress_status(PROGRESS_SKIPPED, NULL);
+                continue;
+            }
+        }
+        LOG_DB_FORMAT_LINE(db_parse_log_level, "db_read_binary: read '%s'", path)
+        entry.line = record2line(db, &record, data + sizeof(db_binary_record));
+        return entry;
+    }
+    return entry;
+}
+
+DB_ATTR_TYPE db_binary_get_attrs(database *db) {
+    return db->binary ? (db->binary)->header.db_attrs : 0LLU;
+}
+
+void db_binary_close(database *db) {
+    struct db_binary *bin = db->binary;
+    if (bin && bin->map) {
+        munmap(bin->map, bin->map_size);
+        free(bin);
+        db->binary = NULL;
+    }
+}
+
+/* output database */
+
+static void out_write(FILE *fp, const void *data, size_t len, char *function_str) {
+    if (fwrite(data, 1, len, fp) < len) {
+        handle_io_error_on_write(function_str);
+    }
+}
+
+/* write to database_out and update the database attributes as the text writer does */
+static void db_out_write(database *db, void *data, size_t len) {
+    out_write(db->fp, data, len, "fwrite");
+    if (db->mdc) {
+        update_md(db->mdc, data, len);
+    }
+}
+
+static void db_out_append(database *db, FILE *fp, char *buf, char *name) {
+    if (fflush(fp) != 0 || fseek(fp, 0, SEEK_SET) == -1) {
+        handle_io_error_on_write(name);
+    }
+    size_t n;
+    while ((n = fread(buf, 1, DB_BINARY_COPY_BUFFER_SIZE, fp)) > 0) {
+        db_out_write(db, buf, n);
+    }
+    if (ferror(fp)) {
+        handle_io_error_on_write(name);
+    }
+    fclose(fp);
+}
+
+static uint64_t write_string(struct db_binary *bin, const void *data, size_t len) {
+    if (data == NULL) {
+        return DB_BINARY_NO_STRING;
+    }
+    uint64_t ref = bin->strings_size;
+    uint32_t length = len;
+    out_write(bin->strings_fp, &length, sizeof(uint32_t), "fwrite (string table)");
+    out_write(bin->strings_fp, data, len, "fwrite (string table)");
+    out_write(bin->strings_fp, "", 1, "fwrite (string table)");
+    bin->strings_size += sizeof(uint32_t) + len + 1;
+    return ref;
+}
+
+#ifdef WITH_XATTR
+static uint64_t write_xattrs(struct db_binary *bin, xattrs_type *xattrs) {
+    uint32_t num = xattrs ? xattrs->num : 0;
+    size_t len = sizeof(uint32_t);
+    for (uint32_t i = 0 ; i < num ; ++i) {
+        len += 2*sizeof(uint32_t) + strlen(xattrs->ents[i].key) + xattrs->ents[i].vsz;
+    }
+    char *buf = checked_malloc(len);
+    size_t offset = 0;
+    memcpy(buf + offset, &num, sizeof(uint32_t));
+    offset += sizeof(uint32_t);
+    for (uint32_t i = 0 ; i < num ; ++i) {
+        uint32_t key_len = strlen(xattrs->ents[i].key);
+        uint32_t val_len = xattrs->ents[i].vsz;
+        memcpy(buf + offset, &key_len, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+        memcpy(buf + offset, xattrs->ents[i].key, key_len);
+        offset += key_len;
+        memcpy(buf + offset, &val_len, sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+        memcpy(buf + offset, xattrs->ents[i].val, val_len);
+        offset += val_len;
+    }
+    uint64_t ref = write_string(bin, buf, len);
+    free(buf);
+    return ref;
+}
+#endif
+
+int db_writespec_binary(db_config *dbconf) {
+    database *db = &dbconf->database_out;
+
+    if (setvbuf(db->fp, NULL, _IOFBF, dbconf->database_out_buffer_size) != 0) {
+        log_msg(LOG_LEVEL_WARNING, "setvbuf failed for %s (use default buffer)", (db->url)->raw);
+    }
+
+    struct db_binary *bin = checked_malloc(sizeof(struct db_binary)); /* freed in db_close_binary */
+    memset(&bin->header, 0, sizeof(db_binary_header));
+    bin->map = NULL;
+    bin->map_size = 0;
+    bin->next_record = 0;
+    /* records and strings are written to database_out after the header in db_close_binary */
+    bin->records_fp = tmpfile();
+    if (bin->records_fp == NULL) {
+        log_msg(LOG_LEVEL_ERROR, "tmpfile failed for records of %s: %s", (db->url)->raw, strerror(errno));
+        free(bin);
+        return RETFAIL;
+    }
+    bin->strings_fp = tmpfile();
+    if (bin->strings_fp == NULL) {
+        log_msg(LOG_LEVEL_ERROR, "tmpfile failed for string table of %s: %s", (db->url)->raw, strerror(errno));
+        fclose(bin->records_fp);
+        free(bin);
+        return RETFAIL;
+    }
+    bin->strings_size = 0;
+    bin->num_records = 0;
+    bin->previous_path = NULL;
+    bin->previous_path_size = 0;
+    bin->sorted = true;
+    bin->db_attrs = dbconf->db_out_attrs|ATTR(attr_filename)|ATTR(attr_attr);
+    bin->hashsums_size = get_hashsums_size(bin->db_attrs);
+    bin->record_size = get_record_size(bin->hashsums_size);
+    bin->record = checked_calloc(1, bin->record_size); /* freed in db_close_binary */
+
+    db_binary_header *h = &bin->header;
+    h->aide_version = DB_BINARY_NO_STRING;
+    h->config_version = DB_BINARY_NO_STRING;
+    if (dbconf->database_add_metadata) {
+        h->generation_time = time(NULL);
+        h->aide_version = write_string(bin, dbconf->aide_version, strlen(dbconf->aide_version));
+    }
+    if (dbconf->config_version) {
+        h->config_version = write_string(bin, dbconf->config_version, strlen(dbconf->config_version));
+    }
+
+    db->binary = bin;
+
+    char *str;
+    log_msg(LOG_LEVEL_DEBUG, "%s: write binary database (version: %u, record size: %zu, attributes: %s)",
+            (db->url)->raw, DB_BINARY_VERSION, bin->record_size, str = diff_database_attributes(0, bin->db_attrs));
+    free(str);
+    return RETOK;
+}
+
+int db_writeline_binary(db_line *line, db_config *dbconf) {
+    struct db_binary *bin = dbconf->database_out.binary;
+    DB_ATTR_TYPE attrs = bin->db_attrs;
+
+    db_binary_record record;
+    memset(&record, 0, sizeof(db_binary_record));
+
+    record.attr = line->attr;
+    record.filename = write_string(bin, line->filename, strlen(line->filename));
+    record.linkname = DB_BINARY_NO_STRING;
+    record.selinux = DB_BINARY_NO_STRING;
+    record.capabilities = DB_BINARY_NO_STRING;
+    record.acl_a = DB_BINARY_NO_STRING;
+    record.acl_d = DB_BINARY_NO_STRING;
+    record.xattrs = DB_BINARY_NO_STRING;
+
+    if (attrs&ATTR(attr_perm)) { record.perm = line->perm; }
+    if (attrs&ATTR(attr_uid)) { record.uid = line->uid; }
+    if (attrs&ATTR(attr_gid)) { record.gid = line->gid; }
+    if (attrs&ATTR(attr_atime)) { record.atime = line->atime; }
+    if (attrs&ATTR(attr_ctime)) { record.ctime = line->ctime; }
+    if (attrs&ATTR(attr_mtime)) { record.mtime = line->mtime; }
+    if (attrs&ATTR(attr_inode)) { record.inode = line->inode; }
+    if (attrs&ATTR(attr_linkcount)) { record.nlink = line->nlink; }
+    if (attrs&ATTR(attr_size)) { record.size = line->size; }
+    if (attrs&ATTR(attr_bcount)) { record.bcount = line->bcount; }
+#ifdef HAVE_FSTYPE
+    if (attrs&ATTR(attr_fs_type)) { record.fs_type = line->fs_type; }
+#endif
+#ifdef WITH_E2FSATTRS
+    if (attrs&ATTR(attr_e2fsattrs)) { record.e2fsattrs = line->e2fsattrs; }
+#endif
+    if (attrs&ATTR(attr_linkname) && line->linkname) {
+        record.linkname = write_string(bin, line->linkname, strlen(line->linkname));
+    }
+#ifdef WITH_SELINUX
+    if (attrs&ATTR(attr_selinux) && line->cntx) {
+        record.selinux = write_string(bin, line->cntx, strlen(line->cntx));
+    }
+#endif
+#ifdef WITH_CAPABILITIES
+    if (attrs&ATTR(attr_capabilities) && line->capabilities) {
+        record.capabilities = write_string(bin, line->capabilities, strlen(line->capabilities));
+    }
+#endif
+#ifdef WITH_POSIX_ACL
+    if (attrs&ATTR(attr_acl) && line->acl) {
+        record.flags |= DB_BINARY_RECORD_FLAG_ACL;
+        if (line->acl->acl_a) { record.acl_a = write_string(bin, line->acl->acl_a, strlen(line->acl->acl_a)); }
+        if (line->acl->acl_d) { record.acl_d = write_string(bin, line->acl->acl_d, strlen(line->acl->acl_d)); }
+    }
+#endif
+#ifdef WITH_XATTR
+    if (attrs&ATTR(attr_xattrs) && line->xattrs) {
+        record.xattrs = write_xattrs(bin, line->xattrs);
+    }
+#endif
+
+    char *raw_hashsums = bin->record + sizeof(db_binary_record);
+    memset(raw_hashsums, 0, bin->record_size - sizeof(db_binary_record));
+    size_t offset = 0;
+    for (int i = 0 ; i < num_hashes ; ++i) {
+        if (ATTR(hashsums[i].attribute)&attrs) {
+            if (line->hashsums[i]) {
+                record.flags |= 1U<<i;
+                memcpy(raw_hashsums + offset, line->hashsums[i], hashsums[i].length);
+            }
+            offset += hashsums[i].length;
+        }
+    }
+    memcpy(bin->record, &record, sizeof(db_binary_record));
+
+    out_write(bin->records_fp, bin->record, bin->record_size, "fwrite (records)");
+
+    if (bin->sorted) {
+        if (bin->previous_path && db_path_cmp(bin->previous_path, line->filename) >= 0) {
+            log_msg(LOG_LEVEL_DEBUG, "%s: '%s' is not sorted after '%s' (clear sorted flag)", (dbconf->database_out.url)->raw, line->filename, bin->previous_path);
+            bin->sorted = false;
+        } else {
+            size_t len = strlen(line->filename) + 1;
+            if (len > bin->previous_path_size) {
+                bin->previous_path = checked_realloc(bin->previous_path, len); /* freed in db_close_binary */
+                bin->previous_path_size = len;
+            }
+            memcpy(bin->previous_path, line->filename, len);
+        }
+    }
+
+    bin->num_records++;
+    return RETOK;
+}
+
+int db_close_binary(db_config *dbconf) {
+    database *db = &dbconf->database_out;
+    struct db_binary *bin = db->binary;
+    FILE *fp = db->fp;
+
+    db_binary_header *h = &bin->header;
+    memcpy(h->magic, DB_BINARY_MAGIC, DB_BINARY_MAGIC_LENGTH);
+    h->version = DB_BINARY_VERSION;
+    h->byte_order = DB_BINARY_BYTE_ORDER;
+    h->header_size = sizeof(db_binary_header);
+    h->record_size = bin->record_size;
+    h->flags = bin->sorted ? DB_BINARY_FLAG_SORTED : 0;
+    h->hashsums_size = bin->hashsums_size;
+    h->db_attrs = bin->db_attrs;
+    h->num_records = bin->num_records;
+    h->records_offset = sizeof(db_binary_header);
+    h->strings_offset = h->records_offset + bin->num_records * bin->record_size;
+    h->strings_size = bin->strings_size;
+
+    char *buf = checked_malloc(DB_BINARY_COPY_BUFFER_SIZE);
+    db_out_write(db, h, sizeof(db_binary_header));
+    db_out_append(db, bin->records_fp, buf, "fread (records)");
+    bin->records_fp = NULL;
+    db_out_append(db, bin->strings_fp, buf, "fread (string table)");
+    bin->strings_fp = NULL;
+    free(buf);
+
+    log_msg(LOG_LEVEL_DEBUG, "%s: wrote %llu record(s) to binary database (string table: %llu bytes, sorted: %s)",
+            (db->url)->raw, (unsigned long long) bin->num_records, (unsigned long long) bin->strings_size, btoa(bin->sorted));
+
+    free(bin->previous_path);
+    free(bin->record);
+    free(bin);
+    db->binary = NULL;
+
+    if (fclose(fp)) {
+        log_msg(LOG_LEVEL_ERROR, "unable to close database '%s': %s", (db->url)->raw, strerror(errno));
+        return RETFAIL;
+    }
+    db->fp = NULL;
+
+    fsync_database(dbconf);
+
+    return RETOK;
+}
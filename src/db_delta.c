@@ -0,0 +1,149 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "aide.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attributes.h"
+#include "base64.h"
+#include "db.h"
+#include "db_config.h"
+#include "db_delta.h"
+#include "db_merge.h"
+#include "db_line.h"
+#include "hashsum.h"
+#include "log.h"
+#include "url.h"
+#include "util.h"
+
+int db_delta_init(database *db) {
+    database **dbs = checked_malloc((conf->num_database_in_deltas + 1) * sizeof(database*)); /* freed below */
+    dbs[0] = db;
+    for (int i = 0 ; i < conf->num_database_in_deltas ; ++i) {
+        database *delta = &conf->database_in_deltas[i];
+        if (db_init(delta, true, false) == RETFAIL) {
+            free(dbs);
+            return RETFAIL;
+        }
+        if (delta->binary) {
+            log_msg(LOG_LEVEL_ERROR, "%s: binary databases cannot be used as delta database", (delta->url)->raw);
+            free(dbs);
+            return RETFAIL;
+        }
+        dbs[i+1] = delta;
+        log_msg(LOG_LEVEL_DEBUG, "%s: delta database #%d of %s", (delta->url)->raw, i+1, (db->url)->raw);
+    }
+    db->merge = db_merge_new(dbs, conf->num_database_in_deltas + 1, false); /* freed in db_close() */
+    free(dbs);
+    log_msg(LOG_LEVEL_INFO, "merge %s with %d delta database(s)", (db->url)->raw, conf->num_database_in_deltas);
+    return RETOK;
+}
+
+/* hashsums of the base database */
+
+static char *get_hashsums_string(db_line *line) {
+    char *str = NULL;
+    size_t len = 0;
+    for (int i = 0 ; i < num_hashes ; ++i) {
+        if (line->hashsums[i]) {
+            char *enc = encode_base64(line->hashsums[i], hashsums[i].length);
+            const char *name = attributes[hashsums[i].attribute].db_name;
+            size_t n = (len ? 1 : 0) + strlen(name) + 1 + strlen(enc);
+            str = checked_realloc(str, len + n + 1); /* freed by caller */
+            snprintf(&str[len], n + 1, "%s%s:%s", len ? " " : "", name, enc);
+            len += n;
+            free(enc);
+        }
+    }
+    return str;
+}
+
+char *db_delta_parent_hashsums(void) {
+    database *parent = conf->num_database_in_deltas ? &conf->database_in_deltas[conf->num_database_in_deltas-1] : &conf->database_in;
+    db_finish_attrs(parent);
+    return parent->db_line ? get_hashsums_string(parent->db_line) : NULL;
+}
+
+/*
+ * Compares the hashsums recorded in the delta database with the ones
+ * calculated for the parent database
+ *
+ * Returns the number of matching hashsums or -1 on mismatch
+ */
+static int check_parent(database *delta, database *parent) {
+    db_line *line = parent->db_line;
+    if (line == NULL) {
+        return 0;
+    }
+    int matches = 0;
+    char *recorded = checked_strdup(delta->delta_parent);
+    char *saveptr = NULL;
+    for (char *token = strtok_r(recorded, " ", &saveptr); token ; token = strtok_r(NULL, " ", &saveptr)) {
+        char *value = strchr(token, ':');
+        if (value == NULL) {
+            log_msg(LOG_LEVEL_WARNING, "%s: '@@delta_db': skip invalid hashsum '%s'", (delta->url)->raw, token);
+            continue;
+        }
+        *value++ = '\0';
+        for (int i = 0 ; i < num_hashes ; ++i) {
+            if (line->hashsums[i] && strcmp(attributes[hashsums[i].attribute].db_name, token) == 0) {
+                char *enc = encode_base64(line->hashsums[i], hashsums[i].length);
+                bool match = strcmp(enc, value) == 0;
+                log_msg(match ? LOG_LEVEL_DEBUG : LOG_LEVEL_ERROR, "%s: %s of base database %s: %s (expected: %s)", (delta->url)->raw, token, (parent->url)->raw, enc, value);
+                free(enc);
+                if (!match) {
+                    free(recorded);
+                    return -1;
+                }
+                matches++;
+            }
+        }
+    }
+    free(recorded);
+    return matches;
+}
+
+int db_delta_verify(void) {
+    database *parent = &conf->database_in;
+    for (int i = 0 ; i < conf->num_database_in_deltas ; ++i) {
+        database *delta = &conf->database_in_deltas[i];
+        if (delta->delta_parent == NULL) {
+            log_msg(LOG_LEVEL_ERROR, "%s: base database cannot be verified (delta database has not been read)", (delta->url)->raw);
+            return RETFAIL;
+        }
+        int matches = check_parent(delta, parent);
+        if (matches < 0) {
+            log_msg(LOG_LEVEL_ERROR, "%s: delta database is not based on %s (hashsum mismatch)", (delta->url)->raw, (parent->url)->raw);
+            return RETFAIL;
+        } else if (matches == 0) {
+            log_msg(LOG_LEVEL_ERROR, "%s: base database %s cannot be verified (no common database_attrs hashsum)", (delta->url)->raw, (parent->url)->raw);
+            return RETFAIL;
+        }
+        log_msg(LOG_LEVEL_INFO, "%s: verified base database %s (%d hashsum(s))", (delta->url)->raw, (parent->url)->raw, matches);
+        free(delta->delta_parent);
+        delta->delta_parent = NULL;
+        parent = delta;
+    }
+    return RETOK;
+}
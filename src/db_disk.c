@@ -29,13 +29,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#ifdef HAVE_STATX
+#include <sys/sysmacros.h>
+#endif
 #ifdef HAVE_FSTYPE
 #include <sys/vfs.h>
 #endif
+#include <time.h>
 #include <unistd.h>
 #include "aide.h"
 #include "attributes.h"
+#include "checkpoint.h"
 #include "do_md.h"
 #include "db.h"
 #include "db_config.h"
@@ -44,14 +50,120 @@
 #include "errorcodes.h"
 #include "file.h"
 #include "gen_list.h"
+#include "hashsum.h"
 #include "log.h"
 #include "progress.h"
 #include "queue.h"
 #include "rx_rule.h"
 #include "seltree_struct.h"
+#include "tree.h"
 #include "util.h"
+#include "wsqueue.h"
 
 queue_ts_t *queue_worker_entries = NULL;
+wsqueue_t *wsqueue_worker_entries = NULL;
+
+static unsigned long long trust_ctime_seed = 0ULL;
+
+typedef struct hardlink_key {
+    dev_t dev;
+    ino_t ino;
+    time_t ctime;
+    off_t size;
+} hardlink_key;
+
+typedef struct hardlink_entry {
+    hardlink_key key;
+    bool pending; /* a worker is calculating the hashsums */
+    nlink_t remaining; /* links not yet processed */
+    md_hashsums *hs; /* NULL if not (yet) available or no longer needed */
+} hardlink_entry;
+
+/* hashsums of files with multiple hard links, shared by all workers */
+static tree_node *hardlink_cache = NULL;
+static pthread_mutex_t hardlink_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t hardlink_cache_cond = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Directory whose entries are queued for processing. The entries are opened
+ * relative to the directory file descriptor, so the kernel does not have to
+ * resolve the full path of every entry again. If no file descriptor is left
+ * (see dir_fds_max) the entries are accessed via their full path.
+ */
+typedef struct disk_dir {
+    char *path;
+    int fd; /* -1 if the entries are accessed via their full path */
+#ifdef HAVE_FSTYPE
+    FS_TYPE fs_type;
+#endif
+    int refcount; /* the reading worker plus one per queued entry */
+
+    /* set if checkpoints are written (see checkpoint.h) */
+    checkpoint_batch *batch; /* lines of the entries */
+    struct disk_dir *up; /* directory containing the directory */
+    int subtree_refcount; /* one for the entries plus one per subdirectory not yet completed */
+} disk_dir;
+
+/*
+ * Rule match of an entry based on the file type reported by the directory
+ * (d_type), reused if the file type of the entry is unchanged
+ */
+typedef struct disk_prematch {
+    FT_TYPE type;
+    match_t match;
+} disk_prematch;
+
+typedef struct disk_work_item {
+    disk_dir *parent; /* NULL for the root entry */
+    bool matched; /* prematch is valid */
+    disk_prematch prematch;
+    char name[]; /* name relative to parent (full path for the root entry) */
+} disk_work_item;
+
+typedef struct dir_child {
+    ino_t ino;
+    unsigned char type;
+    char *name;
+} dir_child;
+
+/* entries added to but not yet taken from the queue of worker entries */
+static long pending_entries = 0;
+static long peak_pending_entries = 0;
+static int producers_waiting = 0;
+static pthread_mutex_t pending_entries_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_entries_cond = PTHREAD_COND_INITIALIZER;
+
+#ifdef HAVE_GETDENTS64
+#define DIRENTS_BUFFER_SIZE (1024*1024)
+
+/* per-thread buffer for getdents64(2) */
+static pthread_key_t dirents_buffer_key;
+static pthread_once_t dirents_buffer_key_once = PTHREAD_ONCE_INIT;
+#endif
+
+static long dir_fds_open = 0;
+static long dir_fds_max = 0;
+
+/* stat fields compared by stat_cmp() */
+#define STAT_ATTRS (ATTR(attr_inode)|ATTR(attr_perm)|ATTR(attr_linkcount)|ATTR(attr_size)|ATTR(attr_mtime)|ATTR(attr_ctime) \
+        |ATTR(attr_bcount)|ATTR(attr_bsize)|ATTR(attr_rdev)|ATTR(attr_gid)|ATTR(attr_uid)|ATTR(attr_dev))
+
+#ifdef HAVE_STATX
+/* statx(2) fields requested for every entry, see get_statx_mask() */
+static unsigned int statx_mask = STATX_BASIC_STATS;
+#endif
+
+#ifdef HAVE_FSTYPE
+typedef struct fs_type_entry {
+    dev_t dev;
+    unsigned long long mnt_id; /* 0 if the mount ID is not available */
+    FS_TYPE fs_type;
+} fs_type_entry;
+
+/* file system types per device and mount, shared by all workers */
+static tree_node *fs_type_cache = NULL;
+static pthread_rwlock_t fs_type_cache_lock = PTHREAD_RWLOCK_INITIALIZER;
+#endif
 
 struct worker_args {
     long worker_index;
@@ -72,6 +184,142 @@ static char *name_construct (const char *dirpath, const char *filename) {
     return ret;
 }
 
+static disk_work_item *new_disk_work_item(disk_dir *parent, const char *name) {
+    size_t len = strlen(name);
+    disk_work_item *item = checked_malloc(sizeof(disk_work_item) + len + 1); /* freed in process_disk_entries() */
+    item->parent = parent;
+    item->matched = false;
+    memcpy(item->name, name, len + 1);
+    if (parent) {
+        __atomic_add_fetch(&parent->refcount, 1, __ATOMIC_RELAXED);
+    }
+    return item;
+}
+
+static disk_dir *new_disk_dir(disk_entry *entry, disk_dir *up, const char *whoami) {
+    char *path = entry->filename;
+    disk_dir *dir = checked_malloc(sizeof(disk_dir)); /* freed in release_disk_subtree() */
+    dir->path = checked_strdup(path);
+    dir->fd = -1;
+#ifdef HAVE_FSTYPE
+    dir->fs_type = entry->fs_type;
+#endif
+    dir->refcount = 1;
+    dir->batch = NULL;
+    dir->up = NULL;
+    dir->subtree_refcount = 1;
+    if (checkpoint_active()) {
+        dir->batch = checkpoint_batch_new();
+        if (up) {
+            dir->up = up;
+            __atomic_add_fetch(&up->subtree_refcount, 1, __ATOMIC_RELAXED);
+        }
+    }
+    if (__atomic_add_fetch(&dir_fds_open, 1, __ATOMIC_RELAXED) <= dir_fds_max) {
+        dir->fd = dup(entry->fd);
+        if (dir->fd == -1) {
+            log_msg(LOG_LEVEL_DEBUG, "'%s': failed to duplicate directory file descriptor: %s (use full paths for entries)", path, strerror(errno));
+        }
+    } else {
+        LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> limit of open directory file descriptors (%ld) reached (use full paths for entries)", path, dir_fds_max);
+    }
+    if (dir->fd == -1) {
+        __atomic_sub_fetch(&dir_fds_open, 1, __ATOMIC_RELAXED);
+    }
+    return dir;
+}
+
+/*
+ * Writes the checkpoint of every directory whose subtree has been completed,
+ * starting with dir (a directory whose subtree could not be written marks
+ * its parents as incomplete as well)
+ */
+static void release_disk_subtree(disk_dir *dir) {
+    while (dir && __atomic_sub_fetch(&dir->subtree_refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        disk_dir *up = dir->up;
+        if (dir->batch && !checkpoint_batch_commit(dir->batch, &dir->path[conf->root_prefix_length]) && up) {
+            checkpoint_batch_invalidate(up->batch);
+        }
+        free(dir->path);
+        free(dir);
+        dir = up;
+    }
+}
+
+static void release_disk_dir(disk_dir *dir) {
+    if (dir && __atomic_sub_fetch(&dir->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        if (dir->fd != -1) {
+            if (close(dir->fd) < 0) {
+                log_msg(LOG_LEVEL_WARNING, "close() failed for '%s': %s", dir->path, strerror(errno));
+            }
+            dir->fd = -1;
+            __atomic_sub_fetch(&dir_fds_open, 1, __ATOMIC_RELAXED);
+        }
+        release_disk_subtree(dir);
+    }
+}
+
+/*
+ * Waits while more than max_pending_entries entries are pending, unless
+ * all other workers are waiting as well (one worker has to keep going, as
+ * blocked workers do not process any entries).
+ */
+static void wait_for_pending_entries(const char *whoami) {
+    if (conf->max_pending_entries == 0 || conf->num_workers < 2
+            || __atomic_load_n(&pending_entries, __ATOMIC_SEQ_CST) < conf->max_pending_entries) {
+        return;
+    }
+    pthread_mutex_lock(&pending_entries_mutex);
+    __atomic_add_fetch(&producers_waiting, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pending_entries, __ATOMIC_SEQ_CST) >= conf->max_pending_entries && producers_waiting < conf->num_workers) {
+        log_msg(LOG_LEVEL_THREAD, "%10s: pause reading directory (%ld pending entries)", whoami, pending_entries);
+        while (__atomic_load_n(&pending_entries, __ATOMIC_SEQ_CST) >= conf->max_pending_entries && producers_waiting < conf->num_workers) {
+            pthread_cond_wait(&pending_entries_cond, &pending_entries_mutex);
+        }
+        log_msg(LOG_LEVEL_THREAD, "%10s: resume reading directory (%ld pending entries)", whoami, pending_entries);
+    }
+    __atomic_sub_fetch(&producers_waiting, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pending_entries_mutex);
+}
+
+static void add_disk_entry(disk_work_item *item, int worker_index, const char *whoami) {
+    wait_for_pending_entries(whoami);
+    long pending = __atomic_add_fetch(&pending_entries, 1, __ATOMIC_SEQ_CST);
+    long peak = __atomic_load_n(&peak_pending_entries, __ATOMIC_RELAXED);
+    while (pending > peak && !__atomic_compare_exchange_n(&peak_pending_entries, &peak, pending, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    if (wsqueue_worker_entries) {
+        log_msg(LOG_LEVEL_THREAD, "%10s: add entry %p to deque of worker entries (name: '%s')", whoami,
+                (void *)item, item->name);
+        wsqueue_push(wsqueue_worker_entries, worker_index > 0 ? worker_index - 1 : 0, item, whoami);
+    } else {
+        log_msg(LOG_LEVEL_THREAD, "%10s: add entry %p to queue of worker entries (name: '%s')", whoami,
+                (void *)item, item->name);
+        if (conf->max_pending_entries) {
+            queue_ts_push(queue_worker_entries, item, whoami);
+        } else {
+            queue_ts_enqueue(queue_worker_entries, item, whoami);
+        }
+    }
+}
+
+static void *get_disk_entry(int worker_index, const char *whoami) {
+    void *item;
+    if (wsqueue_worker_entries) {
+        item = wsqueue_pop_wait(wsqueue_worker_entries, worker_index > 0 ? worker_index - 1 : 0, whoami);
+    } else {
+        item = queue_ts_dequeue_wait(queue_worker_entries, whoami);
+    }
+    if (item) {
+        long pending = __atomic_sub_fetch(&pending_entries, 1, __ATOMIC_SEQ_CST);
+        if (pending < conf->max_pending_entries && __atomic_load_n(&producers_waiting, __ATOMIC_SEQ_CST)) {
+            pthread_mutex_lock(&pending_entries_mutex);
+            pthread_cond_broadcast(&pending_entries_cond);
+            pthread_mutex_unlock(&pending_entries_mutex);
+        }
+    }
+    return item;
+}
+
 static bool open_for_reading(disk_entry *entry, bool dir_rec, const char *whoami) {
     int fd = -1;
     struct stat fs;
@@ -96,18 +344,18 @@ static bool open_for_reading(disk_entry *entry, bool dir_rec, const char *whoami
             );
     if (attrs_req_read || dir_rec) {
 #ifdef O_NOATIME
-        if ((fd = open(entry->filename, O_NOFOLLOW | O_RDONLY | O_NOATIME | O_NONBLOCK)) == -1) {
-            LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> open() with O_NOATIME flag failed: %s (retrying without O_NOATIME)", entry->filename, strerror(errno));
+        if ((fd = openat(entry->dirfd, entry->name, O_NOFOLLOW | O_RDONLY | O_NOATIME | O_NONBLOCK)) == -1) {
+            LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> openat() with O_NOATIME flag failed: %s (retrying without O_NOATIME)", entry->filename, strerror(errno));
 #endif
-            fd = open(entry->filename, O_NOFOLLOW | O_RDONLY | O_NONBLOCK);
+            fd = openat(entry->dirfd, entry->name, O_NOFOLLOW | O_RDONLY | O_NONBLOCK);
 #ifdef O_NOATIME
         }
 #endif
         if (fd == -1) {
-            failure_str = "open() failed";
+            failure_str = "openat() failed";
             error_str = checked_strdup(strerror(errno));
         } else {
-            LOG_WHOAMI(LOG_LEVEL_TRACE, "%s> open() returned O_RDONLY fd %d", entry->filename, fd);
+            LOG_WHOAMI(LOG_LEVEL_TRACE, "%s> openat() returned O_RDONLY fd %d", entry->filename, fd);
             if (fstat(fd, &fs) != 0) {
                 failure_str = "fstat() failed";
                 error_str = checked_strdup(strerror(errno));
@@ -120,7 +368,7 @@ static bool open_for_reading(disk_entry *entry, bool dir_rec, const char *whoami
                     fs.st_rdev=0;
                 }
                 int stat_diff;
-                if ((stat_diff = stat_cmp(&entry->fs, &fs, entry->attrs&ATTR(attr_growing))) != RETOK) {
+                if ((stat_diff = stat_cmp(&entry->fs, &fs, entry->attrs&ATTR(attr_growing))&entry->stat_attrs) != RETOK) {
                     failure_str = "stat fields changed";
                     error_str = diff_attributes(0, stat_diff);
                     if (close(fd) < 0) {
@@ -161,54 +409,533 @@ static bool open_for_reading(disk_entry *entry, bool dir_rec, const char *whoami
     return false;
 }
 
-static void process_path(char *path, bool dry_run, int worker_index, const char *whoami) {
-    db_line *line = NULL;
+static int hardlink_key_cmp(const void *p1, const void *p2) {
+    const hardlink_key *k1 = p1;
+    const hardlink_key *k2 = p2;
+    if (k1->dev != k2->dev) { return k1->dev < k2->dev ? -1 : 1; }
+    if (k1->ino != k2->ino) { return k1->ino < k2->ino ? -1 : 1; }
+    if (k1->ctime != k2->ctime) { return k1->ctime < k2->ctime ? -1 : 1; }
+    if (k1->size != k2->size) { return k1->size < k2->size ? -1 : 1; }
+    return 0;
+}
 
-    LOG_WHOAMI(LOG_LEVEL_DEBUG, "process '%s' (fullpath: '%s')", &path[conf->root_prefix_length], path);
+static void free_hardlink_entry(void *data) {
+    hardlink_entry *entry = data;
+    free(entry->hs);
+    free(entry);
+}
 
-    struct stat stat;
-    int fd = -1;
+/* must be called with hardlink_cache_mutex locked */
+static void hardlink_entry_processed(hardlink_entry *entry) {
+    if (entry->remaining > 0 && --entry->remaining == 0) {
+        free(entry->hs);
+        entry->hs = NULL;
+    }
+}
+
+/* must be called with hardlink_cache_mutex locked */
+static hardlink_entry *new_hardlink_entry(hardlink_key *key, nlink_t nlink) {
+    hardlink_entry *entry = checked_malloc(sizeof(hardlink_entry)); /* freed in db_scan_disk */
+    entry->key = *key;
+    entry->pending = false;
+    entry->remaining = nlink;
+    entry->hs = NULL;
+    hardlink_cache = tree_insert(hardlink_cache, &entry->key, entry, hardlink_key_cmp);
+    return entry;
+}
+
+static hardlink_key get_hardlink_key(disk_entry *file) {
+    hardlink_key key = {
+        .dev = file->fs.st_dev,
+        .ino = file->fs.st_ino,
+        .ctime = file->fs.st_ctime,
+        .size = file->fs.st_size,
+    };
+    return key;
+}
+
+/*
+ * Marks a link of a file with multiple hard links as processed, if its
+ * hashsums have not been calculated but taken from the old database.
+ */
+void hardlink_hashsums_reused(disk_entry *file) {
+    if (file->fs.st_nlink < 2) {
+        return;
+    }
+    hardlink_key key = get_hardlink_key(file);
+
+    pthread_mutex_lock(&hardlink_cache_mutex);
+    hardlink_entry *entry = tree_search(hardlink_cache, &key, hardlink_key_cmp);
+    if (entry == NULL) {
+        entry = new_hardlink_entry(&key, file->fs.st_nlink);
+    }
+    hardlink_entry_processed(entry);
+    pthread_mutex_unlock(&hardlink_cache_mutex);
+}
+
+/*
+ * Calculates the hashsums of a file with multiple hard links only once per
+ * (dev, inode, ctime, size). The first worker reaching the inode calculates
+ * the hashsums, workers reaching another link of the same inode in the
+ * meantime wait for the result.
+ */
+md_hashsums calc_hashsums_hardlinked(disk_entry *file, DB_ATTR_TYPE attrs, hash_buffers *buffers, int worker_index, const char *whoami) {
+    if (file->fs.st_nlink < 2) {
+        return calc_hashsums(file, attrs, -1, false, buffers, worker_index, whoami);
+    }
+
+    hardlink_key key = get_hardlink_key(file);
+
+    pthread_mutex_lock(&hardlink_cache_mutex);
+    hardlink_entry *entry = tree_search(hardlink_cache, &key, hardlink_key_cmp);
+    while (entry && entry->pending) {
+        LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> wait for hashsums of hard linked inode %lu", file->filename, (unsigned long) key.ino);
+        pthread_cond_wait(&hardlink_cache_cond, &hardlink_cache_mutex);
+    }
+    if (entry && entry->hs && !(attrs&get_hashes(false)&~entry->hs->attrs)) {
+        md_hashsums hs = *entry->hs;
+        hs.attrs &= attrs;
+        hardlink_entry_processed(entry);
+        conf->num_hardlink_hashsums++;
+        conf->hardlink_bytes_saved += file->fs.st_size;
+        pthread_mutex_unlock(&hardlink_cache_mutex);
+        LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> reuse hashsums of hard linked inode %lu", file->filename, (unsigned long) key.ino);
+        return hs;
+    }
+    if (entry == NULL) {
+        entry = new_hardlink_entry(&key, file->fs.st_nlink);
+    }
+    entry->pending = true;
+    pthread_mutex_unlock(&hardlink_cache_mutex);
+
+    md_hashsums hs = calc_hashsums(file, attrs, -1, false, buffers, worker_index, whoami);
+
+    pthread_mutex_lock(&hardlink_cache_mutex);
+    entry->pending = false;
+    hardlink_entry_processed(entry);
+    if (hs.attrs && entry->remaining > 0) {
+        if (entry->hs == NULL) {
+            entry->hs = checked_malloc(sizeof(md_hashsums)); /* freed in hardlink_entry_processed or free_hardlink_entry */
+        }
+        *entry->hs = hs;
+    }
+    pthread_cond_broadcast(&hardlink_cache_cond);
+    pthread_mutex_unlock(&hardlink_cache_mutex);
+    return hs;
+}
+
+static DB_ATTR_TYPE get_rule_attrs(seltree *node) {
+    DB_ATTR_TYPE attrs = 0LLU;
+    for (list *l = node->sel_rx_lst; l != NULL; l = l->next) {
+        attrs |= ((rx_rule *) l->data)->attr;
+    }
+    for (list *l = node->equ_rx_lst; l != NULL; l = l->next) {
+        attrs |= ((rx_rule *) l->data)->attr;
+    }
+    for (tree_node *n = tree_walk_first(node->children); n != NULL ; n = tree_walk_next(n)) {
+        attrs |= get_rule_attrs(tree_get_data(n));
+    }
+    return attrs;
+}
+
+#ifdef HAVE_STATX
+static unsigned int get_statx_mask(DB_ATTR_TYPE attrs) {
+    /* file type and permissions are needed for rule matching, the inode for moved files */
+    unsigned int mask = STATX_TYPE|STATX_MODE|STATX_INO;
+    if (attrs&ATTR(attr_uid)) { mask |= STATX_UID; }
+    if (attrs&ATTR(attr_gid)) { mask |= STATX_GID; }
+    if (attrs&ATTR(attr_atime)) { mask |= STATX_ATIME; }
+    if (attrs&ATTR(attr_mtime)) { mask |= STATX_MTIME; }
+    if (attrs&ATTR(attr_ctime)) { mask |= STATX_CTIME; }
+    if (attrs&ATTR(attr_linkcount)) { mask |= STATX_NLINK; }
+    if (attrs&ATTR(attr_bcount)) { mask |= STATX_BLOCKS; }
+    if (attrs&(ATTR(attr_size)|ATTR(attr_sizeg)|ATTR(attr_growing))) { mask |= STATX_SIZE; }
+    if (attrs&get_hashes(true)) {
+        /* size for reading, link count and ctime for the hard link cache */
+        mask |= STATX_SIZE|STATX_NLINK|STATX_CTIME;
+        if (conf->trust_ctime) {
+            mask |= STATX_MTIME;
+        }
+    }
+#if defined HAVE_FSTYPE && defined STATX_MNT_ID
+    mask |= STATX_MNT_ID;
+#endif
+    return mask;
+}
+
+static DB_ATTR_TYPE statx2stat(const struct statx *stx, struct stat *st) {
+    memset(st, 0, sizeof(struct stat));
+    /* device numbers and block size are always returned */
+    DB_ATTR_TYPE stat_attrs = ATTR(attr_dev)|ATTR(attr_rdev)|ATTR(attr_bsize);
+    st->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    st->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+    st->st_blksize = stx->stx_blksize;
+    st->st_mode = stx->stx_mode;
+    if (stx->stx_mask&(STATX_TYPE|STATX_MODE)) { stat_attrs |= ATTR(attr_perm); }
+    if (stx->stx_mask&STATX_INO) { st->st_ino = stx->stx_ino; stat_attrs |= ATTR(attr_inode); }
+    if (stx->stx_mask&STATX_NLINK) { st->st_nlink = stx->stx_nlink; stat_attrs |= ATTR(attr_linkcount); }
+    if (stx->stx_mask&STATX_UID) { st->st_uid = stx->stx_uid; stat_attrs |= ATTR(attr_uid); }
+    if (stx->stx_mask&STATX_GID) { st->st_gid = stx->stx_gid; stat_attrs |= ATTR(attr_gid); }
+    if (stx->stx_mask&STATX_SIZE) { st->st_size = stx->stx_size; stat_attrs |= ATTR(attr_size); }
+    if (stx->stx_mask&STATX_BLOCKS) { st->st_blocks = stx->stx_blocks; stat_attrs |= ATTR(attr_bcount); }
+    if (stx->stx_mask&STATX_ATIME) {
+        st->st_atim.tv_sec = stx->stx_atime.tv_sec;
+        st->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+    }
+    if (stx->stx_mask&STATX_MTIME) {
+        st->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+        st->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+        stat_attrs |= ATTR(attr_mtime);
+    }
+    if (stx->stx_mask&STATX_CTIME) {
+        st->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+        st->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+        stat_attrs |= ATTR(attr_ctime);
+    }
+    return stat_attrs;
+}
+#endif
+
+/*
+ * Gets the metadata of the entry without following symlinks. Only the stat
+ * fields returned in stat_attrs are valid.
+ */
+static int stat_entry(int dirfd, const char *name, struct stat *st, DB_ATTR_TYPE *stat_attrs, unsigned long long *mnt_id) {
+    *mnt_id = 0ULL;
+#ifdef HAVE_STATX
+    struct statx stx;
+    if (statx(dirfd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, statx_mask, &stx) == 0) {
+        *stat_attrs = statx2stat(&stx, st);
+#ifdef STATX_MNT_ID
+        if (stx.stx_mask&STATX_MNT_ID) {
+            *mnt_id = stx.stx_mnt_id;
+        }
+#endif
+        return 0;
+    } else if (errno != ENOSYS) {
+        return -1;
+    }
+#endif
+    *stat_attrs = STAT_ATTRS;
+    return fstatat(dirfd, name, st, AT_SYMLINK_NOFOLLOW);
+}
+
+/*
+ * Opens an O_PATH file descriptor for entries that are not opened for reading
+ * but need a file descriptor (e.g. for extended attributes).
+ */
+static bool open_path_fd(disk_entry *entry, const char *whoami) {
 #ifdef O_PATH
-    fd = open(path, O_NOFOLLOW | O_PATH);
+    if (entry->fd != -1) {
+        return true;
+    }
+    int fd = openat(entry->dirfd, entry->name, O_NOFOLLOW | O_PATH);
     if (fd == -1) {
-        log_msg(LOG_LEVEL_WARNING, "failed to access '%s': %s (skipping)", path, strerror(errno));
-        return;
+        log_msg(LOG_LEVEL_WARNING, "failed to access '%s': %s", entry->filename, strerror(errno));
+        return false;
     }
-    LOG_WHOAMI(LOG_LEVEL_TRACE, "%s> open() returned O_PATH fd %d", path, fd);
-    if (fstat(fd, &stat) == -1) {
-        log_msg(LOG_LEVEL_WARNING, "fstat() failed for %s: %s (skipping)", path, strerror(errno));
+    LOG_WHOAMI(LOG_LEVEL_TRACE, "%s> openat() returned O_PATH fd %d", entry->filename, fd);
+    struct stat fs;
+    if (fstat(fd, &fs) == -1) {
+        log_msg(LOG_LEVEL_WARNING, "fstat() failed for '%s': %s", entry->filename, strerror(errno));
     } else {
+        /* entry->fs.st_rdev is not reset yet if the entry's attributes are
+         * not known (e.g. when called from get_fs_type) */
+        DB_ATTR_TYPE cmp_attrs = entry->stat_attrs;
+        if(!(entry->attrs&ATTR(attr_rdev))) {
+            fs.st_rdev=0;
+            cmp_attrs &= ~ATTR(attr_rdev);
+        }
+        if (stat_cmp(&entry->fs, &fs, false)&cmp_attrs) {
+            log_msg(LOG_LEVEL_WARNING, "'%s' has changed while AIDE was running", entry->filename);
+        } else {
+            entry->fd = fd;
+            return true;
+        }
+    }
+    if (close(fd) < 0) {
+        log_msg(LOG_LEVEL_WARNING, "close() failed for '%s' (fd: %d): %s", entry->filename, fd, strerror(errno));
+    }
 #else
-    if(lstat(path, &stat) == -1) {
-        log_msg(LOG_LEVEL_WARNING, "lstat() failed for '%s': %s (skipping)", path, strerror(errno));
-    } else {
+    (void) entry;
+    (void) whoami;
+#endif
+    return false;
+}
+
+#ifdef HAVE_FSTYPE
+static int fs_type_entry_cmp(const void *p1, const void *p2) {
+    const fs_type_entry *e1 = p1;
+    const fs_type_entry *e2 = p2;
+    if (e1->dev != e2->dev) { return e1->dev < e2->dev ? -1 : 1; }
+    if (e1->mnt_id != e2->mnt_id) { return e1->mnt_id < e2->mnt_id ? -1 : 1; }
+    return 0;
+}
+
+/*
+ * Returns the file system type of the entry. The types are cached per device
+ * and mount ID, so that fstatfs(2) is called only once per mount (a new mount
+ * gets a new mount ID).
+ */
+static FS_TYPE get_fs_type(disk_entry *entry, unsigned long long mnt_id, const char *whoami) {
+    fs_type_entry key = { .dev = entry->fs.st_dev, .mnt_id = mnt_id };
+
+    pthread_rwlock_rdlock(&fs_type_cache_lock);
+    fs_type_entry *cached = tree_search(fs_type_cache, &key, fs_type_entry_cmp);
+    pthread_rwlock_unlock(&fs_type_cache_lock);
+    if (cached) {
+        return cached->fs_type;
+    }
+
+    struct statfs statfs;
+    if (!open_path_fd(entry, whoami)) {
+        log_msg(LOG_LEVEL_WARNING, "%s: file system type information missing", entry->filename);
+        return 0UL;
+    }
+    if (fstatfs(entry->fd, &statfs) == -1) {
+        log_msg(LOG_LEVEL_WARNING, "fstatfs() failed for %s: %s (file system type information missing)", entry->filename, strerror(errno));
+        return 0UL;
+    }
+    LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> cache file system type 0x%lx for device %lu (mount ID: %llu)", entry->filename,
+            (unsigned long) statfs.f_type, (unsigned long) key.dev, mnt_id);
+
+    pthread_rwlock_wrlock(&fs_type_cache_lock);
+    if (tree_search(fs_type_cache, &key, fs_type_entry_cmp) == NULL) {
+        fs_type_entry *new_entry = checked_malloc(sizeof(fs_type_entry)); /* freed in db_scan_disk */
+        *new_entry = key;
+        new_entry->fs_type = statfs.f_type;
+        fs_type_cache = tree_insert(fs_type_cache, new_entry, new_entry, fs_type_entry_cmp);
+    }
+    pthread_rwlock_unlock(&fs_type_cache_lock);
+    return statfs.f_type;
+}
 #endif
+
+static bool select_for_verification(const char *path) {
+    if (conf->trust_ctime_verify_percentage <= 0) {
+        return false;
+    }
+    /* FNV-1a hash of the path mixed with the seed of this run */
+    unsigned long long h = 14695981039346656037ULL ^ trust_ctime_seed;
+    for (const unsigned char *c = (const unsigned char *) path; *c != '\0'; ++c) {
+        h ^= *c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (long) (h % 100) < conf->trust_ctime_verify_percentage;
+}
+
+/*
+ * Returns the old entry if its hashsums can be reused for the file (i.e. the
+ * old entry has all requested hashsums and inode, size, mtime and ctime are
+ * unchanged), NULL otherwise
+ */
+static const db_line *get_trusted_line(const db_line *old, const struct stat *fs, DB_ATTR_TYPE hashsums, const char *path, const char *whoami) {
+    const DB_ATTR_TYPE identity = ATTR(attr_inode)|ATTR(attr_size)|ATTR(attr_mtime)|ATTR(attr_ctime);
+    if ((old->attr&identity) != identity) {
+        char *attrs_str = diff_attributes(old->attr&identity, identity);
+        LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> trust_ctime: old entry lacks %s (calculate hashsums)", path, attrs_str);
+        free(attrs_str);
+        return NULL;
+    }
+    if ((old->attr&hashsums) != hashsums) {
+        char *attrs_str = diff_attributes(old->attr&hashsums, hashsums);
+        LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> trust_ctime: old entry lacks %s (calculate hashsums)", path, attrs_str);
+        free(attrs_str);
+        return NULL;
+    }
+    if (old->inode != (long) fs->st_ino || old->size != (long long) fs->st_size
+            || old->mtime != fs->st_mtime || old->ctime != fs->st_ctime) {
+        LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> trust_ctime: stat identity changed (calculate hashsums)", path);
+        return NULL;
+    }
+    if (select_for_verification(path)) {
+        LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> trust_ctime: selected for verification (calculate hashsums)", path);
+        return NULL;
+    }
+    LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> trust_ctime: stat identity unchanged (reuse hashsums of old entry)", path);
+    return old;
+}
+
+/*
+ * Queues a directory entry. Entries of a known file type other than
+ * directories are matched against the rules right away and are neither
+ * stat'ed nor queued if they are not to be added (directories are always
+ * queued, their file system type may differ from the parent's).
+ */
+static void add_dir_child(disk_dir *parent, const char *name, unsigned char d_type, bool dry_run, int worker_index, const char *whoami) {
+    disk_work_item *item = new_disk_work_item(parent, name);
+#ifdef DTTOIF
+    if (!dry_run && d_type != DT_UNKNOWN && d_type != DT_DIR) {
+        char *path = name_construct(parent->path, name);
         file_t file = {
             .name = &path[conf->root_prefix_length],
-            .type = get_f_type_from_perm(stat.st_mode),
+            .type = get_f_type_from_perm(DTTOIF(d_type)),
 #ifdef HAVE_FSTYPE
-            .fs_type = 0UL,
+            .fs_type = parent->fs_type,
 #endif
         };
-#ifdef HAVE_FSTYPE
-        struct statfs statfs;
-        if (fstatfs(fd, &statfs) == -1) {
-            log_msg(LOG_LEVEL_WARNING, "fstatfs() failed for %s: %s (file system type information missing)", path, strerror(errno));
-        } else {
-            file.fs_type = statfs.f_type;
+        match_t match = check_rxtree(file, conf->tree, "disk", false, whoami);
+        if (!(match.result & (RESULT_SELECTIVE_MATCH|RESULT_EQUAL_MATCH))) {
+            LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> skip entry without getting its metadata (file type: %c)", path, get_f_type_char_from_f_type(file.type));
+            free(path);
+            release_disk_dir(parent);
+            free(item);
+            return;
         }
+        free(path);
+        item->matched = true;
+        item->prematch = (disk_prematch) { .type = file.type, .match = match };
+    }
 #endif
-        match_t path_match = check_rxtree(file, conf->tree, "disk", false, whoami);
-        char *attrs_str = NULL;
+    add_disk_entry(item, worker_index, whoami);
+}
+
+static int dir_child_cmp(const void *p1, const void *p2) {
+    const dir_child *c1 = p1;
+    const dir_child *c2 = p2;
+    if (c1->ino != c2->ino) {
+        return c1->ino < c2->ino ? -1 : 1;
+    }
+    return 0;
+}
+
+/*
+ * Collects the entry if the entries are to be sorted by inode number,
+ * otherwise queues it right away.
+ */
+static void read_dir_child(disk_dir *parent, dir_child **children, size_t *num, size_t *size,
+        ino_t ino, unsigned char d_type, const char *name, bool dry_run, int worker_index, const char *whoami) {
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        return;
+    }
+    if (conf->sort_directory_entries) {
+        if (*num == *size) {
+            *size = *size ? 2 * *size : 64;
+            *children = checked_realloc(*children, *size * sizeof(dir_child)); /* freed in read_directory() */
+        }
+        (*children)[(*num)++] = (dir_child) { .ino = ino, .type = d_type, .name = checked_strdup(name) };
+    } else {
+        add_dir_child(parent, name, d_type, dry_run, worker_index, whoami);
+    }
+}
+
+#ifdef HAVE_GETDENTS64
+static void dirents_buffer_key_create(void) {
+    pthread_key_create(&dirents_buffer_key, free);
+}
+#endif
+
+/*
+ * Reads the entries of the directory opened for reading in entry->fd and
+ * queues them with parent as their parent directory
+ */
+static bool read_directory(disk_entry *entry, disk_dir *parent, bool dry_run, int worker_index, const char *whoami) {
+    dir_child *children = NULL;
+    size_t num = 0;
+    size_t size = 0;
+    bool success = true;
+#ifdef HAVE_GETDENTS64
+    pthread_once(&dirents_buffer_key_once, dirents_buffer_key_create);
+    char *buf = pthread_getspecific(dirents_buffer_key);
+    if (buf == NULL) {
+        buf = checked_malloc(DIRENTS_BUFFER_SIZE); /* freed by the pthread_key destructor */
+        pthread_setspecific(dirents_buffer_key, buf);
+    }
+    ssize_t nread;
+    while ((nread = getdents64(entry->fd, buf, DIRENTS_BUFFER_SIZE)) > 0) {
+        for (ssize_t pos = 0 ; pos < nread ; ) {
+            struct dirent64 *d = (struct dirent64 *) &buf[pos];
+            read_dir_child(parent, &children, &num, &size, d->d_ino, d->d_type, d->d_name, dry_run, worker_index, whoami);
+            pos += d->d_reclen;
+        }
+    }
+    if (nread == -1) {
+        log_msg(LOG_LEVEL_WARNING, "getdents64() failed for '%s': %s", entry->filename, strerror(errno));
+        success = false;
+    }
+#else
+    DIR *dir = NULL;
+    int dupfd = dup(entry->fd);
+    if (dupfd == -1) {
+        log_msg(LOG_LEVEL_WARNING, "'%s': failed to duplicate file descriptor: %s", entry->filename, strerror(errno));
+        return false;
+    }
+    if ((dir = fdopendir(dupfd)) == NULL) {
+        log_msg(LOG_LEVEL_WARNING, "failed to open directory '%s' for reading directory contents: %s (skipping recursion)",
+                entry->filename, strerror(errno));
+        close(dupfd);
+        return false;
+    }
+    const struct dirent *entp = NULL;
+    while ((entp = readdir(dir)) != NULL) {
+        read_dir_child(parent, &children, &num, &size, entp->d_ino,
+#ifdef _DIRENT_HAVE_D_TYPE
+                entp->d_type,
+#else
+                0, /* DT_UNKNOWN */
+#endif
+                entp->d_name, dry_run, worker_index, whoami);
+    }
+    if (closedir(dir) < 0) {
+        log_msg(LOG_LEVEL_WARNING, "closedir() failed for '%s': %s", entry->filename, strerror(errno));
+    }
+#endif
+    if (num) {
+        LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> sort %zu directory entries by inode number", entry->filename, num);
+        qsort(children, num, sizeof(dir_child), dir_child_cmp);
+        for (size_t i = 0 ; i < num ; ++i) {
+            /* the work-stealing deques (and the shared queue if the number of pending entries is limited) are processed LIFO */
+            dir_child *child = &children[wsqueue_worker_entries || conf->max_pending_entries ? num - 1 - i : i];
+            add_dir_child(parent, child->name, child->type, dry_run, worker_index, whoami);
+            free(child->name);
+        }
+    }
+    free(children);
+    return success;
+}
+
+static void process_path(char *path, int dirfd, const char *name, disk_dir *parent_dir, const disk_prematch *prematch, bool dry_run, hash_buffers *buffers, int worker_index, const char *whoami) {
+    db_line *line = NULL;
+
+    LOG_WHOAMI(LOG_LEVEL_DEBUG, "process '%s' (fullpath: '%s')", &path[conf->root_prefix_length], path);
+
+    struct stat stat;
+    DB_ATTR_TYPE stat_attrs;
+    unsigned long long mnt_id;
+    if (stat_entry(dirfd, name, &stat, &stat_attrs, &mnt_id) == -1) {
+        log_msg(LOG_LEVEL_WARNING, "failed to get metadata of '%s': %s (skipping)", path, strerror(errno));
+    } else {
         disk_entry entry = {
             .filename = path,
+            .dirfd = dirfd,
+            .name = name,
             .fs = stat,
+            .stat_attrs = stat_attrs,
             .attrs = 0LLU,
+            .fd = -1,
+        };
 #ifdef HAVE_FSTYPE
-            .fs_type = file.fs_type,
+        entry.fs_type = get_fs_type(&entry, mnt_id, whoami);
+#else
+        (void) mnt_id;
+#endif
+        file_t file = {
+            .name = &path[conf->root_prefix_length],
+            .type = get_f_type_from_perm(stat.st_mode),
+#ifdef HAVE_FSTYPE
+            .fs_type = entry.fs_type,
 #endif
-            .fd = fd,
         };
+        match_t path_match;
+        if (prematch && prematch->type == file.type) {
+            path_match = prematch->match;
+        } else {
+            path_match = check_rxtree(file, conf->tree, "disk", false, whoami);
+        }
+        char *attrs_str = NULL;
         if (!dry_run && path_match.result & (RESULT_SELECTIVE_MATCH|RESULT_EQUAL_MATCH)) {
             entry.attrs = path_match.rule->attr;
 
@@ -259,38 +986,23 @@ static void process_path(char *path, bool dry_run, int worker_index, const char
         }
         if (S_ISDIR(stat.st_mode)) {
             const char * whoami_log_thread = whoami ? whoami : "(main)";
-            DIR *dir = NULL;
             switch (path_match.result) {
                 case RESULT_SELECTIVE_MATCH:
                 case RESULT_EQUAL_MATCH:
                 case RESULT_PARTIAL_MATCH:
                 case RESULT_RECURSIVE_NEGATIVE_MATCH:
                 case RESULT_PARTIAL_LIMIT_MATCH:
+                    if (!dry_run && checkpoint_replay(&path[conf->root_prefix_length], whoami)) {
+                        LOG_WHOAMI(LOG_LEVEL_DEBUG, "do NOT read directory contents of '%s' (reason: completed in a previous run)", path);
+                        break;
+                    }
                     LOG_WHOAMI(LOG_LEVEL_DEBUG, "read directory contents of '%s' (reason: %s)", path, get_match_result_desc(path_match.result));
                     if (open_for_reading(&entry, true, whoami)) {
-                        int dupfd = dup(entry.fd);
-                        if (dupfd == -1) {
-                            log_msg(LOG_LEVEL_WARNING, "'%s': failed to duplicate file descriptor: %s", path, strerror(errno));
-                        } else {
-                            if ((dir = fdopendir(dupfd)) == NULL) {
-                                log_msg(LOG_LEVEL_WARNING, "failed to open directory '%s' for reading directory contents: %s (skipping recursion)",
-                                        path, strerror(errno));
-                            } else {
-                                const struct dirent *entp = NULL;
-                                while ((entp = readdir(dir)) != NULL) {
-                                    if (strcmp(entp->d_name, ".") != 0 && strcmp(entp->d_name, "..") != 0) {
-                                        char *entry_full_path = name_construct(path, entp->d_name);
-                                        log_msg(LOG_LEVEL_THREAD,
-                                                "%10s: add entry %p to queue of worker entries (filename: '%s')", whoami_log_thread,
-                                                (void *)entry_full_path, entry_full_path);
-                                        queue_ts_enqueue(queue_worker_entries, entry_full_path, whoami_log_thread);
-                                    }
-                                }
-                                if (closedir(dir) < 0) {
-                                    log_msg(LOG_LEVEL_WARNING, "closedir() failed for '%s': %s", path, strerror(errno));
-                                }
-                            }
+                        disk_dir *parent = new_disk_dir(&entry, parent_dir, whoami);
+                        if (!read_directory(&entry, parent, dry_run, worker_index, whoami_log_thread) && parent->batch) {
+                            checkpoint_batch_invalidate(parent->batch);
                         }
+                        release_disk_dir(parent);
                     }
                     break;
                 case RESULT_NON_RECURSIVE_NEGATIVE_MATCH:
@@ -308,25 +1020,62 @@ static void process_path(char *path, bool dry_run, int worker_index, const char
             print_match(file, path_match);
         } else {
             DB_ATTR_TYPE transition_hashsums = 0LL;
+            const db_line *hashsums_line = NULL;
 
             if (path_match.result & (RESULT_SELECTIVE_MATCH|RESULT_EQUAL_MATCH)) {
                 if (S_ISREG(stat.st_mode)) {
                     if (open_for_reading(&entry, false, whoami)) {
                         if (conf->action & DO_COMPARE && entry.attrs & get_hashes(false)) {
-                            const seltree *node = get_seltree_node(conf->tree, &path[conf->root_prefix_length]);
-                            if (node && node->old_data) {
-                                transition_hashsums = get_transition_hashsums(
-                                        (node->old_data)->filename, (node->old_data)->attr, &path[conf->root_prefix_length], entry.attrs);
+                            /* the hashsums to calculate depend on the old entry */
+                            wait_for_old_entries(&path[conf->root_prefix_length], false, whoami);
+                            seltree *node = get_seltree_node(conf->tree, &path[conf->root_prefix_length]);
+                            if (node) {
+                                pthread_rwlock_rdlock(&node->rwlock);
+                                if (node->old_data) {
+                                    transition_hashsums = get_transition_hashsums(
+                                            (node->old_data)->filename, (node->old_data)->attr, &path[conf->root_prefix_length], entry.attrs);
+                                    if (conf->trust_ctime) {
+                                        hashsums_line = get_trusted_line(node->old_data, &entry.fs, entry.attrs&get_hashes(false), &path[conf->root_prefix_length], whoami);
+                                    }
+                                }
+                                pthread_rwlock_unlock(&node->rwlock);
                             }
                         }
                     }
                 }
+#ifdef O_PATH
+                DB_ATTR_TYPE attrs_req_fd = entry.attrs & (0LLU
+#ifdef WITH_ACL
+                        | ATTR(attr_acl)
+#endif
+#ifdef WITH_XATTR
+                        | ATTR(attr_xattrs)
+#endif
+#ifdef WITH_SELINUX
+                        | ATTR(attr_selinux)
+#endif
+#ifdef WITH_CAPABILITIES
+                        | ATTR(attr_capabilities)
+#endif
+                        );
+                if (attrs_req_fd && !open_path_fd(&entry, whoami)) {
+                    attrs_str = diff_attributes(0, attrs_req_fd);
+                    log_msg(LOG_LEVEL_WARNING, "'%s': disabling attrs requiring a file descriptor: %s", path, attrs_str);
+                    free(attrs_str);
+                    entry.attrs &= ~attrs_req_fd;
+                }
+#endif
 
                 attrs_str = diff_attributes(0, entry.attrs);
                 LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> requested attributes: %s", entry.filename, attrs_str);
                 free(attrs_str);
 
-                line = get_file_attrs(&entry, entry.attrs, transition_hashsums, worker_index, whoami);
+                line = get_file_attrs(&entry, entry.attrs, transition_hashsums, hashsums_line, buffers, worker_index, whoami);
+                if (line->reused_hashsums) {
+                    __atomic_add_fetch(&conf->num_reused_hashsums, 1, __ATOMIC_RELAXED);
+                } else if (line->attr&get_hashes(true)) {
+                    __atomic_add_fetch(&conf->num_computed_hashsums, 1, __ATOMIC_RELAXED);
+                }
 
                 /* attr_filename is always needed/returned but never requested */
                 DB_ATTR_TYPE returned_attr = (~ATTR(attr_filename) & line->attr);
@@ -339,6 +1088,15 @@ static void process_path(char *path, bool dry_run, int worker_index, const char
                     free(attrs_str);
                 }
 
+                if (parent_dir && parent_dir->batch) {
+                    if (line->attr&(ATTR(attr_growing)|ATTR(attr_compressed))) {
+                        /* the comparison needs the file on disk */
+                        checkpoint_batch_invalidate(parent_dir->batch);
+                    } else {
+                        checkpoint_batch_add(parent_dir->batch, line);
+                    }
+                }
+
                 add_file_to_tree(conf->tree, line, DB_NEW | DB_DISK, NULL, &entry, whoami);
             }
         }
@@ -350,23 +1108,37 @@ static void process_path(char *path, bool dry_run, int worker_index, const char
     }
 }
 
-static void process_disk_entries(bool dry_run, int worker_index, const char *whoami) {
+static void process_disk_entries(bool dry_run, hash_buffers *buffers, int worker_index, const char *whoami) {
     const char * whoami_log_thread = whoami ? whoami : "(main)";
     while (1) {
         log_msg(LOG_LEVEL_THREAD, "%10s: process_disk_entries: wait for entries", whoami_log_thread);
-        char *data = queue_ts_dequeue_wait(queue_worker_entries, whoami_log_thread);
-        if (data) {
-            log_msg(LOG_LEVEL_THREAD, "%10s: process_disk_entries: got entry %p from queue of worker entries (path: '%s')", whoami_log_thread, (void*) data, data);
+        disk_work_item *item = get_disk_entry(worker_index, whoami_log_thread);
+        if (item) {
+            disk_dir *parent = item->parent;
+            char *path = parent ? name_construct(parent->path, item->name) : item->name;
+            log_msg(LOG_LEVEL_THREAD, "%10s: process_disk_entries: got entry %p from worker entries (path: '%s')", whoami_log_thread, (void*) item, path);
             if (worker_index > 0) {
-                update_progress_worker_status(worker_index, progress_worker_state_processing, data);
+                update_progress_worker_status(worker_index, progress_worker_state_processing, path);
+            }
+            const disk_prematch *prematch = item->matched ? &item->prematch : NULL;
+            if (parent && parent->fd != -1) {
+                process_path(path, parent->fd, item->name, parent, prematch, dry_run, buffers, worker_index, whoami);
+            } else {
+                process_path(path, AT_FDCWD, path, parent, prematch, dry_run, buffers, worker_index, whoami);
             }
-            process_path(data, dry_run, worker_index, whoami);
             if (worker_index > 0) {
                 update_progress_worker_status(worker_index, progress_worker_state_idle, NULL);
             }
-            free(data);
+            if (parent) {
+                free(path);
+                release_disk_dir(parent);
+            }
+            free(item);
+            if (wsqueue_worker_entries) {
+                wsqueue_done(wsqueue_worker_entries, whoami_log_thread);
+            }
         } else {
-            log_msg(LOG_LEVEL_THREAD, "%10s: process_disk_entries: queue empty", whoami_log_thread);
+            log_msg(LOG_LEVEL_THREAD, "%10s: process_disk_entries: no entries left", whoami_log_thread);
             break;
         }
     }
@@ -379,11 +1151,17 @@ static void * worker(void *arg) {
 
     mask_sig(whoami);
 
-    queue_ts_register(queue_worker_entries, whoami);
+    if (queue_worker_entries) {
+        queue_ts_register(queue_worker_entries, whoami);
+    }
+
+    hash_buffers *buffers = hash_buffers_init(); /* freed below */
 
     log_msg(LOG_LEVEL_THREAD, "%10s: worker: initialized worker thread #%ld", whoami, args.worker_index);
 
-    process_disk_entries(args.dry_run, args.worker_index, whoami);
+    process_disk_entries(args.dry_run, buffers, args.worker_index, whoami);
+
+    hash_buffers_free(buffers);
 
     log_msg(LOG_LEVEL_THREAD, "%10s: worker: exit thread", whoami);
     return (void *) pthread_self();
@@ -392,21 +1170,56 @@ static void * worker(void *arg) {
 void db_scan_disk(bool dry_run) {
     const char *whoami_main = "(main)";
 
-    char* full_path=checked_malloc((conf->root_prefix_length+2)*sizeof(char)); /* freed in process_disk_entries() */
+    trust_ctime_seed = ((unsigned long long) time(NULL) << 32) ^ (unsigned long long) getpid();
+    pending_entries = 0;
+    peak_pending_entries = 0;
+
+    char* full_path=checked_malloc((conf->root_prefix_length+2)*sizeof(char)); /* freed below */
     strncpy(full_path, conf->root_prefix, conf->root_prefix_length+1);
     strcat (full_path, "/");
+    disk_work_item *root = new_disk_work_item(NULL, full_path);
+    free(full_path);
+
+    /* keep half of the file descriptors for the files being processed */
+    struct rlimit nofile;
+    if (getrlimit(RLIMIT_NOFILE, &nofile) == 0 && nofile.rlim_cur != RLIM_INFINITY) {
+        dir_fds_max = nofile.rlim_cur / 2;
+    } else {
+        dir_fds_max = 1024;
+    }
+    log_msg(LOG_LEVEL_DEBUG, "keep at most %ld directory file descriptors open", dir_fds_max);
+    if (conf->max_pending_entries) {
+        log_msg(LOG_LEVEL_DEBUG, "traverse depth-first with at most %ld pending entries", conf->max_pending_entries);
+    }
+
+#ifdef HAVE_STATX
+    statx_mask = get_statx_mask(get_rule_attrs(conf->tree->rule_tree ? conf->tree->rule_tree : conf->tree));
+    log_msg(LOG_LEVEL_DEBUG, "use statx() mask 0x%x", statx_mask);
+#endif
 
     if (dry_run || conf->num_workers == 0) {
         queue_worker_entries = queue_ts_init(); /* freed below */
-        queue_ts_enqueue(queue_worker_entries, full_path, whoami_main);
+        add_disk_entry(root, 0, whoami_main);
         queue_ts_release(queue_worker_entries, whoami_main);
 
-        process_disk_entries(dry_run, 0, NULL);
+        hash_buffers *buffers = dry_run ? NULL : hash_buffers_init(); /* freed below */
+
+        process_disk_entries(dry_run, buffers, 0, NULL);
+
+        hash_buffers_free(buffers);
 
         queue_ts_free(queue_worker_entries);
+        queue_worker_entries = NULL;
     } else {
-        queue_worker_entries = queue_ts_init(); /* freed below */
-        log_msg(LOG_LEVEL_THREAD, "%10s: initialized worker entries queue %p", whoami_main, (void*) queue_worker_entries);
+        if (conf->work_stealing) {
+            wsqueue_worker_entries = wsqueue_init(conf->num_workers); /* freed below */
+            log_msg(LOG_LEVEL_THREAD, "%10s: initialized work-stealing queue %p of worker entries", whoami_main, (void*) wsqueue_worker_entries);
+            /* the root entry has to be pending before the workers are started */
+            add_disk_entry(root, 0, whoami_main);
+        } else {
+            queue_worker_entries = queue_ts_init(); /* freed below */
+            log_msg(LOG_LEVEL_THREAD, "%10s: initialized worker entries queue %p", whoami_main, (void*) queue_worker_entries);
+        }
 
         worker_thread *worker_threads = checked_malloc(conf->num_workers * sizeof(worker_thread)); /* freed below */
 
@@ -419,8 +1232,10 @@ void db_scan_disk(bool dry_run) {
             }
         }
 
-        queue_ts_enqueue(queue_worker_entries, full_path, whoami_main);
-        queue_ts_release(queue_worker_entries, whoami_main);
+        if (queue_worker_entries) {
+            add_disk_entry(root, 0, whoami_main);
+            queue_ts_release(queue_worker_entries, whoami_main);
+        }
 
         log_msg(LOG_LEVEL_THREAD, "%10s: wait for worker threads to be finished", whoami_main);
         for (int i = 0 ; i < conf->num_workers ; ++i) {
@@ -430,6 +1245,34 @@ void db_scan_disk(bool dry_run) {
             log_msg(LOG_LEVEL_THREAD, "%10s: worker thread #%d finished", whoami_main, i);
         }
         free(worker_threads);
-        queue_ts_free(queue_worker_entries);
+        if (wsqueue_worker_entries) {
+            for (int i = 0 ; i < conf->num_workers ; ++i) {
+                log_msg(LOG_LEVEL_DEBUG, "worker #%d processed %lu entries (%lu stolen from other workers)", i+1,
+                        wsqueue_get_num_popped(wsqueue_worker_entries, i), wsqueue_get_num_stolen(wsqueue_worker_entries, i));
+            }
+            wsqueue_free(wsqueue_worker_entries);
+            wsqueue_worker_entries = NULL;
+        } else {
+            queue_ts_free(queue_worker_entries);
+            queue_worker_entries = NULL;
+        }
+    }
+
+    if (hardlink_cache) {
+        log_msg(LOG_LEVEL_INFO, "reused hashsums of hard linked files %ld times (%lld bytes not read)",
+                conf->num_hardlink_hashsums, conf->hardlink_bytes_saved);
+        tree_free(hardlink_cache, free_hardlink_entry);
+        hardlink_cache = NULL;
+    }
+#ifdef HAVE_FSTYPE
+    tree_free(fs_type_cache, free);
+    fs_type_cache = NULL;
+#endif
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        log_msg(LOG_LEVEL_INFO, "file system scan: peak of %ld pending entries, peak RSS: %ld KiB", peak_pending_entries, usage.ru_maxrss);
+        log_msg(LOG_LEVEL_DEBUG, "resource usage after file system scan: page faults: %ld minor, %ld major",
+                usage.ru_minflt, usage.ru_majflt);
     }
 }
@@ -30,6 +30,8 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include "db_config.h"
 #include "gen_list.h"
 #include "hashsum.h"
@@ -48,8 +50,11 @@
 #include "base64.h"
 #include "db_line.h"
 #include "db_file.h"
+#include "db_delta.h"
+#include "db_index.h"
 #include "util.h"
 #include "errorcodes.h"
+#include "queue.h"
 
 #ifdef WITH_ZLIB
 #include <zlib.h>
@@ -121,6 +126,11 @@ static bool db_parse_spec(database* db, char **saveptr){
 static char *fgets_wrapper(char *ptr, size_t size, database *db) {
     char * buf = NULL;
 
+    if (db->flags&DB_FLAG_INDEX && db->read_pos >= db->read_end) {
+        /* end of the last block to read */
+        return NULL;
+    }
+
 #ifdef WITH_CURL
   switch ((db->url)->type) {
   case url_http:
@@ -136,9 +146,19 @@ static char *fgets_wrapper(char *ptr, size_t size, database *db) {
   default:
 #endif
 
+#ifdef WITH_ZSTD
+        if (db->zstd_in) {
+            buf = zstd_reader_gets(db->zstd_in, ptr, size);
+            if (!buf && zstd_reader_error(db->zstd_in)) {
+                log_msg(LOG_LEVEL_ERROR, "zstd decompression failed for %s: %s", (db->url)->raw, zstd_reader_error(db->zstd_in));
+                exit(IO_ERROR);
+            }
+        } else {
+#endif
 #ifdef WITH_ZLIB
         if (db->gzp == NULL) {
-            db->gzp=gzdopen(fileno((FILE *)db->fp),"rb");
+            /* gzclose() closes the duplicated descriptor only */
+            db->gzp=gzdopen(dup(fileno((FILE *)db->fp)),"rb");
             if (db->gzp == NULL) {
                 log_msg(LOG_LEVEL_ERROR, "gzdopen failed for %s", (db->url)->raw);
                 exit(IO_ERROR);
@@ -157,11 +177,18 @@ static char *fgets_wrapper(char *ptr, size_t size, database *db) {
             exit(IO_ERROR);
         }
 #endif
+#ifdef WITH_ZSTD
+        }
+#endif
 #ifdef WITH_CURL
   }
 #endif
-  if (buf && db->mdc) {
-      update_md(db->mdc, buf, strlen(buf));
+  if (buf) {
+      size_t len = strlen(buf);
+      db->read_pos += len;
+      if (db->mdc) {
+          update_md(db->mdc, buf, len);
+      }
   }
   return buf;
 }
@@ -185,12 +212,457 @@ static char *get_next_dbline(database *db) {
     return line;
 }
 
-db_entry_t db_readline_file(database* db, bool include_limited_entries) {
+/* matches the decoded path against the limit (like the paths read from disk) */
+static match_result check_db_limit(char *token) {
+    if (strchr(token, '%') == NULL) {
+        return check_limit(token, true, NULL);
+    }
+    char *path = checked_strdup(token);
+    decode_string(path);
+    match_result result = check_limit(path, true, NULL);
+    free(path);
+    return result;
+}
+
+/*
+ * Parses the database line starting with token (the path)
+ *
+ * Returns true if entry has been set
+ */
+static bool parse_db_entry(database *db, char *token, char **saveptr, bool include_limited_entries, db_entry_t *entry) {
+    LOG_LEVEL db_parse_log_level = LOG_LEVEL_DEBUG;
     char **s = NULL;
+    if (*token != '/') {
+        LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip line with invalid path: '%s'", token)
+        return false;
+    }
+    entry->limit = false;
+    if (check_db_limit(token)) {
+        if (include_limited_entries) {
+            entry->limit = true;
+            db_parse_log_level = LOG_LEVEL_LIMIT;
+        } else {
+            update_progress_status(PROGRESS_SKIPPED, NULL);
+            return false;
+        }
+    }
+    LOG_DB_FORMAT_LINE(db_parse_log_level, "db_read_file: parse '%s'", token)
+    s = checked_malloc(sizeof(char*)*num_attrs);
+    for(ATTRIBUTE j=0; j<num_attrs; j++){
+        s[j]=NULL;
+    }
+    int i = 0;
+    while(token != NULL) {
+        if (token[0] == '#') {
+            LOG_DB_FORMAT_LINE(db_parse_log_level, "%s", "db_read_file: skip inline comment")
+                break;
+        } else if (i >= db->num_fields) {
+            LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip unexpected string '%s')", token);
+        } else if (db->fields[i] != attr_unknown) {
+            s[db->fields[i]] = checked_strdup(token);
+            LOG_DB_FORMAT_LINE(db_parse_log_level, "db_read_file: '%s' set field '%s' (position %d): '%s'", s[0], attributes[db->fields[i]].db_name, i, token)
+        } else {
+            LOG_DB_FORMAT_LINE(db_parse_log_level, "skip unknown/redefined field at position: %d: '%s'", i, token);
+        }
+        token = strtok_r(NULL, " ", saveptr);
+        i++;
+    }
+    if (i<db->num_fields) {
+        LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip cutoff database line '%s' found (field '%s' (position: %d) is missing)", s[0], attributes[db->fields[i]].db_name, i)
+        for(int a=0;a<i;a++){
+            free(s[db->fields[a]]);
+            s[db->fields[a]] = NULL;
+        }
+        free(s);
+        return false;
+    }
+    entry->line = db_char2line(s, db);
+    for(int j=0;j<db->num_fields;j++){
+        if(db->fields[j]!=attr_unknown &&
+                s[db->fields[j]]!=NULL){
+            free(s[db->fields[j]]);
+            s[db->fields[j]]=NULL;
+        }
+    }
+    free(s);
+    return true;
+}
+
+/*
+ * Parses the '@@remove' line of a delta database (see db_delta.h)
+ *
+ * Returns true if entry has been set
+ */
+static bool parse_db_remove(database *db, char **saveptr, bool include_limited_entries, db_entry_t *entry) {
+    LOG_LEVEL db_parse_log_level = LOG_LEVEL_DEBUG;
+    if (!(db->flags&DB_FLAG_DELTA)) {
+        LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "%s", "skip '@@remove' line (no delta database)")
+        return false;
+    }
+    char *token = strtok_r(NULL, " ", saveptr);
+    if (token) {
+        decode_string(token);
+    }
+    if (token == NULL || *token != '/') {
+        LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip '@@remove' line with invalid path: '%s'", token ? token : "")
+        return false;
+    }
+    entry->limit = false;
+    if (check_db_limit(token)) {
+        if (include_limited_entries) {
+            entry->limit = true;
+            db_parse_log_level = LOG_LEVEL_LIMIT;
+        } else {
+            update_progress_status(PROGRESS_SKIPPED, NULL);
+            return false;
+        }
+    }
+    LOG_DB_FORMAT_LINE(db_parse_log_level, "db_read_file: parse removed entry '%s'", token)
+    db_line *line = checked_calloc(1, sizeof(db_line)); /* freed in db_merge_readline() */
+    line->fullpath = checked_strdup(token);
+    line->filename = line->fullpath;
+    entry->line = line;
+    entry->removed = true;
+    return true;
+}
+
+/*
+ * Parses a single database line (e.g. of a checkpoint, see checkpoint.h)
+ * using the fields of db, the line is modified
+ *
+ * Returns NULL if the line is invalid
+ */
+db_line *db_parse_line_file(database *db, char *line) {
+    db_entry_t entry = { 0 };
+    char *saveptr = NULL;
+    char *token = strtok_r(line, " ", &saveptr);
+    if (token == NULL || !parse_db_entry(db, token, &saveptr, true, &entry)) {
+        return NULL;
+    }
+    return entry.line;
+}
+
+/* continues reading at the first block which may match the limit (see db_index.h) */
+static void db_index_seek(database *db) {
+    db_index_range range;
+    if (!db_index_find(db, &range)) {
+        return;
+    }
+    if (range.pos > db->read_pos) {
+        LOG_DB_FORMAT_LINE(LOG_LEVEL_DEBUG, "db_read_file: continue at offset %llu (line: %ld)", range.offset, range.lineno)
+#ifdef WITH_ZLIB
+        if (db->gzp) {
+            gzclose(db->gzp);
+            db->gzp = NULL;
+        }
+        if (lseek(fileno((FILE *) db->fp), range.offset, SEEK_SET) == -1) {
+#else
+        if (fseek(db->fp, range.offset, SEEK_SET) != 0) {
+#endif
+            log_msg(LOG_LEVEL_ERROR, "%s: seek to offset %llu failed: %s", (db->url)->raw, range.offset, strerror(errno));
+            exit(IO_ERROR);
+        }
+        db->read_pos = range.pos;
+        db->lineno = range.lineno - 1;
+    }
+    db->read_end = range.end;
+    db->flags |= DB_FLAG_INDEX;
+    if (db->mdc) {
+        log_msg(LOG_LEVEL_INFO, "%s: database_attrs hashsums are not calculated (database is read partially)", (db->url)->raw);
+        close_md(db->mdc, NULL, (db->url)->raw, NULL);
+        free(db->mdc);
+        db->mdc = NULL;
+    }
+}
+
+static bool db_index_end(database *db) {
+    return db->flags&DB_FLAG_INDEX && db->read_pos >= db->read_end;
+}
+
+/*
+ * Parallel parsing of the database body
+ *
+ * Once '@@begin_db' and '@@db_spec' have been read, a splitter thread reads
+ * the remaining lines (up to and including '@@end_db') in chunks of complete
+ * lines, so decompression and the database_attrs digests still see the byte
+ * stream in order. The chunks are
+ * parsed by database_parse_threads threads and db_readline_file() returns the
+ * parsed entries chunk by chunk in database order.
+ */
+
+#define DB_PARSE_CHUNK_SIZE (1024*1024)
+
+typedef struct db_parse_chunk {
+    char *data; /* '\0' separated lines */
+    size_t len;
+    long lineno; /* line number of the first line */
+
+    db_entry_t *entries;
+    size_t num_entries;
+    size_t next_entry;
+    bool parsed;
+
+    struct db_parse_chunk *next;
+} db_parse_chunk;
+
+struct db_parser {
+    database *db;
+    database db_spec; /* copy taken at start (read-only) */
+    bool include_limited_entries;
+
+    queue_ts_t *queue; /* chunks to be parsed */
+    pthread_t splitter;
+    pthread_t *threads;
+    long num_threads;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    db_parse_chunk *head; /* chunks in database order */
+    db_parse_chunk *tail;
+    int num_chunks;
+    bool eof;
+    bool end_db;
+    bool stop;
+};
+
+static db_parse_chunk *read_db_chunk(database *db, bool *end_db) {
+    size_t size = DB_PARSE_CHUNK_SIZE + BUFSIZE;
+    db_parse_chunk *chunk = checked_malloc(sizeof(db_parse_chunk)); /* freed in db_parser_readline() */
+    *chunk = (db_parse_chunk) { .data = checked_malloc(size), .lineno = db->lineno + 1 }; /* freed in db_parser_worker() */
+    size_t line_start = 0;
+    while (chunk->len < DB_PARSE_CHUNK_SIZE || line_start != chunk->len) {
+        if (size - chunk->len < BUFSIZE) {
+            size *= 2;
+            chunk->data = checked_realloc(chunk->data, size);
+        }
+        if (fgets_wrapper(&chunk->data[chunk->len], size - chunk->len, db) == NULL) {
+            if (chunk->len > line_start) { /* last line without newline */
+                db->lineno++;
+                chunk->len++;
+            }
+            break;
+        }
+        chunk->len += strlen(&chunk->data[chunk->len]);
+        if (chunk->data[chunk->len-1] == '\n') {
+            char *line = &chunk->data[line_start];
+            chunk->data[chunk->len-1] = '\0';
+            db->lineno++;
+            if (strncmp(line, "@@end_db", 8) == 0 && (line[8] == '\0' || line[8] == ' ')) {
+                LOG_DB_FORMAT_LINE(LOG_LEVEL_DEBUG, "%s", "db_read_file: stop reading database (found '@@end_db')")
+                if (line[8] == ' ' && line[9] != '\0') {
+                    LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip unexpected string after '@@end_db': '%s'", &line[9])
+                }
+                chunk->len = line_start;
+                *end_db = true;
+                break;
+            }
+            line_start = chunk->len;
+        }
+    }
+    if (chunk->len == 0) {
+        free(chunk->data);
+        free(chunk);
+        return NULL;
+    }
+    return chunk;
+}
+
+static void *db_parser_splitter(void *arg) {
+    struct db_parser *parser = arg;
+    mask_sig("(db-split)");
+    bool end_db = false;
+    while (!end_db) {
+        pthread_mutex_lock(&parser->mutex);
+        while (parser->num_chunks >= 2 * parser->num_threads + 2 && !parser->stop) {
+            pthread_cond_wait(&parser->cond, &parser->mutex);
+        }
+        bool stop = parser->stop;
+        pthread_mutex_unlock(&parser->mutex);
+        if (stop) {
+            break;
+        }
+
+        db_parse_chunk *chunk = read_db_chunk(parser->db, &end_db);
+        if (chunk == NULL) {
+            break;
+        }
+        pthread_mutex_lock(&parser->mutex);
+        if (parser->tail) {
+            parser->tail->next = chunk;
+        } else {
+            parser->head = chunk;
+        }
+        parser->tail = chunk;
+        parser->num_chunks++;
+        pthread_mutex_unlock(&parser->mutex);
+        queue_ts_enqueue(parser->queue, chunk, "(db-split)");
+    }
+    queue_ts_release(parser->queue, "(db-split)");
+    pthread_mutex_lock(&parser->mutex);
+    parser->eof = true;
+    parser->end_db = end_db;
+    pthread_cond_broadcast(&parser->cond);
+    pthread_mutex_unlock(&parser->mutex);
+    return (void *) pthread_self();
+}
+
+static void *db_parser_worker(void *arg) {
+    struct db_parser *parser = arg;
+    mask_sig("(db-parse)");
+    db_parse_chunk *chunk;
+    while ((chunk = queue_ts_dequeue_wait(parser->queue, "(db-parse)")) != NULL) {
+        /* private copy for the line numbers in log messages */
+        database db_copy = parser->db_spec;
+        database *db = &db_copy;
+        size_t size = 0;
+        db->lineno = chunk->lineno;
+        for (size_t pos = 0 ; pos < chunk->len ; ++db->lineno) {
+            char *line = &chunk->data[pos];
+            pos += strlen(line) + 1;
+            if (line[0] == '#') {
+                LOG_DB_FORMAT_LINE(LOG_LEVEL_DEBUG, "db_read_file: skip comment line: '%s'", line)
+            } else if (line[0] == '\0') {
+                LOG_DB_FORMAT_LINE(LOG_LEVEL_DEBUG, "%s", "db_read_file: skip empty line")
+            } else {
+                char *saveptr = NULL;
+                char *token = strtok_r(line, " ", &saveptr);
+                if (token == NULL) {
+                    continue;
+                } else if (strcmp("@@db_spec", token) == 0 || strcmp("@@begin_db", token) == 0 || strcmp("@@delta_db", token) == 0) {
+                    LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip additional '%s' line", token)
+                } else {
+                    db_entry_t entry = { .line = NULL, .limit = false, .removed = false };
+                    if (strcmp("@@remove", token) == 0
+                            ? parse_db_remove(db, &saveptr, parser->include_limited_entries, &entry)
+                            : parse_db_entry(db, token, &saveptr, parser->include_limited_entries, &entry)) {
+                        if (chunk->num_entries == size) {
+                            size = size ? 2 * size : 1024;
+                            chunk->entries = checked_realloc(chunk->entries, size * sizeof(db_entry_t)); /* freed in db_parser_readline() */
+                        }
+                        chunk->entries[chunk->num_entries++] = entry;
+                    }
+                }
+            }
+        }
+        free(chunk->data);
+        chunk->data = NULL;
+
+        pthread_mutex_lock(&parser->mutex);
+        chunk->parsed = true;
+        pthread_cond_broadcast(&parser->cond);
+        pthread_mutex_unlock(&parser->mutex);
+    }
+    return (void *) pthread_self();
+}
+
+static void db_parser_start(database *db, bool include_limited_entries) {
+    struct db_parser *parser = checked_malloc(sizeof(struct db_parser)); /* freed in db_parser_close() */
+    *parser = (struct db_parser) {
+        .db = db,
+        .db_spec = *db,
+        .include_limited_entries = include_limited_entries,
+        .queue = queue_ts_init(), /* freed in db_parser_close() */
+        .num_threads = conf->database_parse_threads,
+    };
+    pthread_mutex_init(&parser->mutex, NULL);
+    pthread_cond_init(&parser->cond, NULL);
+
+    log_msg(LOG_LEVEL_DEBUG, "%s: parse database with %ld threads", (db->url)->raw, parser->num_threads);
+
+    parser->threads = checked_malloc(parser->num_threads * sizeof(pthread_t)); /* freed in db_parser_close() */
+    for (long i = 0 ; i < parser->num_threads ; ++i) {
+        if (pthread_create(&parser->threads[i], NULL, &db_parser_worker, parser) != 0) {
+            log_msg(LOG_LEVEL_ERROR, "failed to start database parser thread #%ld", i+1);
+            exit(THREAD_ERROR);
+        }
+    }
+    if (pthread_create(&parser->splitter, NULL, &db_parser_splitter, parser) != 0) {
+        log_msg(LOG_LEVEL_ERROR, "%s", "failed to start database splitter thread");
+        exit(THREAD_ERROR);
+    }
+    db->parser = parser;
+}
+
+void db_parser_close(database *db) {
+    struct db_parser *parser = db->parser;
+    if (parser == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&parser->mutex);
+    parser->stop = true;
+    pthread_cond_broadcast(&parser->cond);
+    pthread_mutex_unlock(&parser->mutex);
+
+    pthread_join(parser->splitter, NULL);
+    for (long i = 0 ; i < parser->num_threads ; ++i) {
+        pthread_join(parser->threads[i], NULL);
+    }
+    for (db_parse_chunk *chunk = parser->head, *next ; chunk ; chunk = next) {
+        next = chunk->next;
+        for (size_t i = chunk->next_entry ; i < chunk->num_entries ; ++i) {
+            free_db_line(chunk->entries[i].line);
+            free(chunk->entries[i].line);
+        }
+        free(chunk->entries);
+        free(chunk->data);
+        free(chunk);
+    }
+    queue_ts_free(parser->queue);
+    pthread_cond_destroy(&parser->cond);
+    pthread_mutex_destroy(&parser->mutex);
+    free(parser->threads);
+    free(parser);
+    db->parser = NULL;
+}
+
+static db_entry_t db_parser_readline(database *db) {
+    struct db_parser *parser = db->parser;
+    db_entry_t entry = { .line = NULL, .limit = false, .removed = false };
+    pthread_mutex_lock(&parser->mutex);
+    while (1) {
+        db_parse_chunk *chunk = parser->head;
+        if (chunk == NULL) {
+            if (parser->eof) {
+                break;
+            }
+        } else if (chunk->parsed) {
+            if (chunk->next_entry < chunk->num_entries) {
+                entry = chunk->entries[chunk->next_entry++];
+                pthread_mutex_unlock(&parser->mutex);
+                return entry;
+            }
+            if ((parser->head = chunk->next) == NULL) {
+                parser->tail = NULL;
+            }
+            parser->num_chunks--;
+            pthread_cond_broadcast(&parser->cond);
+            free(chunk->entries);
+            free(chunk);
+            continue;
+        }
+        pthread_cond_wait(&parser->cond, &parser->mutex);
+    }
+    bool end_db = parser->end_db;
+    pthread_mutex_unlock(&parser->mutex);
+
+    db_parser_close(db);
+    if (!end_db && !db_index_end(db)) {
+        LOG_DB_FORMAT_LINE(LOG_LEVEL_ERROR, "%s", "missing '@@end_db' (incomplete database file)")
+        exit(DATABASE_ERROR);
+    }
+    db->flags &= ~(DB_FLAG_PARSE);
+    return entry;
+}
+
+db_entry_t db_readline_file(database* db, bool include_limited_entries) {
     char *saveptr, *token;
     char *line = NULL;
 
-    db_entry_t entry = { .line = NULL, .limit = false };
+    db_entry_t entry = { .line = NULL, .limit = false, .removed = false };
+
+    if (db->parser) {
+        return db_parser_readline(db);
+    }
 
     while ((line = get_next_dbline(db)) != NULL) {
         db->lineno++;
@@ -208,6 +680,9 @@ db_entry_t db_readline_file(database* db, bool include_limited_entries) {
                 if (strcmp("@@db_spec", token) == 0) {
                     if (db->fields) {
                         LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip additional '%s' line", token)
+                    } else if (db->flags&DB_FLAG_DELTA && db->delta_parent == NULL) {
+                        LOG_DB_FORMAT_LINE(LOG_LEVEL_ERROR, "%s", "missing '@@delta_db' line (no delta database)")
+                        exit(DATABASE_ERROR);
                     } else {
                         LOG_DB_FORMAT_LINE(db_parse_log_level, "db_read_file: parse '%s'", token)
                         db_parse_spec(db, &saveptr);
@@ -222,6 +697,17 @@ db_entry_t db_readline_file(database* db, bool include_limited_entries) {
                     if ((token = strtok_r(NULL, "\n", &saveptr)) != NULL) {
                         LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip unexpected string after '@@begin_db': '%s'", token)
                     }
+                } else if (strcmp("@@delta_db", token) == 0) {
+                    if (!(db->flags&DB_FLAG_DELTA)) {
+                        LOG_DB_FORMAT_LINE(LOG_LEVEL_ERROR, "%s", "unexpected '@@delta_db' line (delta databases have to be configured with 'database_in_delta')")
+                        exit(DATABASE_ERROR);
+                    } else if (db->delta_parent || db->fields) {
+                        LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip additional '%s' line", token)
+                    } else {
+                        token = strtok_r(NULL, "\n", &saveptr);
+                        db->delta_parent = checked_strdup(token ? token : ""); /* freed in db_delta_verify() */
+                        LOG_DB_FORMAT_LINE(db_parse_log_level, "db_read_file: base database hashsums: '%s'", db->delta_parent)
+                    }
                 } else if (strcmp("@@end_db", token) == 0) {
                     if (db->flags&DB_FLAG_PARSE) {
                         db->flags &= ~(DB_FLAG_PARSE);
@@ -235,60 +721,11 @@ db_entry_t db_readline_file(database* db, bool include_limited_entries) {
                         exit(DATABASE_ERROR);
                     }
                 } else if (db->flags&DB_FLAG_PARSE) {
-                    if (*token != '/') {
-                        LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip line with invalid path: '%s'", token)
-                        break;
-                    } else {
-                        if (check_limit(token, true, NULL)) {
-                            if (include_limited_entries) {
-                                entry.limit = true;
-                                db_parse_log_level = LOG_LEVEL_LIMIT;
-                            } else {
-                                update_progress_status(PROGRESS_SKIPPED, NULL);
-                                break;
-                            }
-                        }
-                        LOG_DB_FORMAT_LINE(db_parse_log_level, "db_read_file: parse '%s'", token)
-                        s = checked_malloc(sizeof(char*)*num_attrs);
-                        for(ATTRIBUTE j=0; j<num_attrs; j++){
-                            s[j]=NULL;
-                        }
-                        int i = 0;
-                        while(token != NULL) {
-                            if (token[0] == '#') {
-                                LOG_DB_FORMAT_LINE(db_parse_log_level, "%s", "db_read_file: skip inline comment")
-                                    break;
-                            } else if (i >= db->num_fields) {
-                                LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip unexpected string '%s')", token);
-                            } else if (db->fields[i] != attr_unknown) {
-                                s[db->fields[i]] = checked_strdup(token);
-                                LOG_DB_FORMAT_LINE(db_parse_log_level, "db_read_file: '%s' set field '%s' (position %d): '%s'", s[0], attributes[db->fields[i]].db_name, i, token)
-                            } else {
-                                LOG_DB_FORMAT_LINE(db_parse_log_level, "skip unknown/redefined field at position: %d: '%s'", i, token);
-                            }
-                            token = strtok_r(NULL, " ", &saveptr);
-                            i++;
-                        }
-                        if (i<db->num_fields) {
-                            LOG_DB_FORMAT_LINE(LOG_LEVEL_WARNING, "skip cutoff database line '%s' found (field '%s' (position: %d) is missing)", s[0], attributes[db->fields[i]].db_name, i)
-                            for(int a=0;a<i;a++){
-                                free(s[db->fields[a]]);
-                                s[db->fields[a]] = NULL;
-                            }
-                            free(s);
-                            s = NULL;
-                        } else {
-                             entry.line = db_char2line(s, db);
-                             for(int j=0;j<db->num_fields;j++){
-                                 if(db->fields[j]!=attr_unknown &&
-                                         s[db->fields[j]]!=NULL){
-                                     free(s[db->fields[j]]);
-                                     s[db->fields[j]]=NULL;
-                                 }
-                             }
-                             free(s);
-                            return entry;
-                        }
+                    if (strcmp("@@remove", token) == 0
+                            ? parse_db_remove(db, &saveptr, include_limited_entries, &entry)
+                            : parse_db_entry(db, token, &saveptr, include_limited_entries, &entry)) {
+                        free(line);
+                        return entry;
                     }
                 } else {
                     LOG_DB_FORMAT_LINE(db_parse_log_level, "skip line '%s' ('@@begin_db' not (yet) found)", line)
@@ -296,8 +733,22 @@ db_entry_t db_readline_file(database* db, bool include_limited_entries) {
         }
         free(line);
         line = NULL;
+        if (db->flags&DB_FLAG_PARSE && db->fields && !(db->flags&DB_FLAG_INDEX_CHECKED)) {
+            db->flags |= DB_FLAG_INDEX_CHECKED;
+            if (!include_limited_entries) {
+                db_index_seek(db);
+            }
+        }
+        if (conf->database_parse_threads > 0 && db->flags&DB_FLAG_PARSE && db->fields) {
+            db_parser_start(db, include_limited_entries);
+            return db_parser_readline(db);
+        }
     }
-    if (db->flags&DB_FLAG_PARSE) {
+    if (db_index_end(db)) {
+        LOG_DB_FORMAT_LINE(LOG_LEVEL_DEBUG, "%s", "db_read_file: stop reading database (end of the blocks matching the limit)")
+        db->flags &= ~(DB_FLAG_PARSE);
+        return entry;
+    } else if (db->flags&DB_FLAG_PARSE) {
         LOG_DB_FORMAT_LINE(LOG_LEVEL_ERROR, "%s", "missing '@@end_db' (incomplete database file)")
         exit(DATABASE_ERROR);
     } else {
@@ -306,70 +757,183 @@ db_entry_t db_readline_file(database* db, bool include_limited_entries) {
     }
 }
 
-static int str_format(char *, int n, const char*, ...)
+typedef struct db_out_buffer_t {
+    char *data;
+    size_t size;
+    size_t len;
+    bool grow; /* grow instead of writing to database_out when full */
+} db_out_buffer_t;
+
+static db_out_buffer_t db_out_buffer = { NULL, 0, 0, false };
+
+/* block index of database_out (see db_index.h) */
+static struct {
+    db_index_t *index;
+    unsigned long long pos; /* uncompressed bytes written */
+    long lines; /* lines written */
+    unsigned long long block_pos; /* uncompressed position of the current block */
+} db_out_index = { NULL, 0LLU, 0L, 0LLU };
+
+void handle_io_error_on_write(char *function_str) {
+    if (conf->database_out.url->type == url_file && conf->database_out.flags&DB_FLAG_CREATED) {
+        log_msg(LOG_LEVEL_ERROR, "%s failed for %s (remove incompletely written database)", function_str, ((conf->database_out).url)->raw);
+        unlink(conf->database_out.url->value);
+    } else {
+        log_msg(LOG_LEVEL_ERROR, "%s failed for %s", function_str, ((conf->database_out).url)->raw);
+    }
+    exit(IO_ERROR);
+}
+
+static void db_out_write_raw(char * str, size_t len) {
+    if ((conf->database_out).mdc) {
+        update_md((conf->database_out).mdc, str, len);
+    }
+    if (db_out_index.index) {
+        db_out_index.pos += len;
+        for (char *p = str ; (p = memchr(p, '\n', len - (p - str))) != NULL ; ++p) {
+            db_out_index.lines++;
+        }
+    }
+
+#ifdef WITH_ZLIB
+    if((conf->database_out).pgz) {
+        if (pgzip_write((conf->database_out).pgz, str, len) != 0) {
+            handle_io_error_on_write("pgzip_write");
+        }
+        return;
+    }
+#endif
+#ifdef WITH_ZSTD
+    if((conf->database_out).zstd_out) {
+        if (zstd_writer_write((conf->database_out).zstd_out, str, len) != 0) {
+            handle_io_error_on_write("zstd_writer_write");
+        }
+        return;
+    }
+#endif
+    if (fwrite(str, sizeof(char), len, conf->database_out.fp) < len) {
+        handle_io_error_on_write("fwrite");
+    }
+}
+
+static void db_out_flush(void) {
+    if (db_out_buffer.len) {
+        log_msg(LOG_LEVEL_TRACE, "db_out_flush(): write %zu bytes to %s", db_out_buffer.len, ((conf->database_out).url)->raw);
+        db_out_write_raw(db_out_buffer.data, db_out_buffer.len);
+        db_out_buffer.len = 0;
+    }
+}
+
+static void db_out_grow(db_out_buffer_t *buf, size_t len) {
+    if (buf->size - buf->len < len) {
+        while (buf->size - buf->len < len) {
+            buf->size = buf->size ? 2 * buf->size : BUFSIZE;
+        }
+        buf->data = checked_realloc(buf->data, buf->size);
+    }
+}
+
+static void db_out_write(db_out_buffer_t *buf, char * str, size_t len) {
+    if (len > buf->size - buf->len) {
+        if (buf->grow) {
+            db_out_grow(buf, len);
+        } else {
+            db_out_flush();
+            if (len > buf->size) {
+                db_out_write_raw(str, len);
+                return;
+            }
+        }
+    }
+    memcpy(buf->data + buf->len, str, len);
+    buf->len += len;
+}
+
+static void db_out_format(db_out_buffer_t *, const char*, ...)
 #ifdef __GNUC__
-        __attribute__ ((format (printf, 3, 4)))
+        __attribute__ ((format (printf, 2, 3)))
 #endif
 ;
-static int str_format(char *str, int n, const char* format, ...) {
+static void db_out_format(db_out_buffer_t *buf, const char* format, ...) {
     va_list ap;
+    size_t avail = buf->size - buf->len;
+
     va_start(ap, format);
-    int len = vsnprintf(NULL, 0, format, ap);
+    int len = vsnprintf(buf->data + buf->len, avail, format, ap);
     va_end(ap);
-    if (str) {
+    if (len < 0) {
+        handle_io_error_on_write("vsnprintf");
+    }
+    if ((size_t) len < avail) {
+        buf->len += len;
+        return;
+    }
+
+    /* string does not fit into the remaining buffer */
+    if (buf->grow) {
+        db_out_grow(buf, len + 1);
         va_start(ap, format);
-        vsnprintf(&str[n], len+1, format, ap);
+        vsnprintf(buf->data + buf->len, buf->size - buf->len, format, ap);
         va_end(ap);
+        buf->len += len;
+        return;
+    }
+    db_out_flush();
+    if ((size_t) len < buf->size) {
+        va_start(ap, format);
+        vsnprintf(buf->data, buf->size, format, ap);
+        va_end(ap);
+        buf->len = len;
+    } else {
+        char *str = checked_malloc(len + 1);
+        va_start(ap, format);
+        vsnprintf(str, len + 1, format, ap);
+        va_end(ap);
+        db_out_write_raw(str, len);
+        free(str);
     }
-    return len;
 }
 
-static int str_filename(char *str, int n, char *path) {
+static void str_filename(db_out_buffer_t *buf, char *path) {
     char *safe_path = NULL;
-    int len = 0;
     if (contains_unsafe(path)) {
         safe_path = encode_string(path);
     }
-    len = str_format(str, n+len, "%s", safe_path?safe_path:path);
+    db_out_format(buf, "%s", safe_path?safe_path:path);
     free(safe_path);
-    return len;
 }
 
-static int str_linkname(char *str, int n, char *path) {
+static void str_linkname(db_out_buffer_t *buf, char *path) {
     char *safe_path = NULL;
-    int len = 0;
     if (path == NULL) {
-        len = str_format(str, n, " %s", "0");
-        return len;
+        db_out_format(buf, " %s", "0");
+        return;
     }
     if (*path == '\0') {
-        len = str_format(str, n, " %s", "0-");
-        return len;
+        db_out_format(buf, " %s", "0-");
+        return;
     }
     if (contains_unsafe(path)) {
         safe_path = encode_string(path);
     }
-    len += str_format(str, n, " %s%s", *path == '0'?"0":"", safe_path?safe_path:path);
+    db_out_format(buf, " %s%s", *path == '0'?"0":"", safe_path?safe_path:path);
     free(safe_path);
-    return len;
 }
 
-static int byte_base64(char *str, int n, byte *src, int src_len) {
+static void byte_base64(db_out_buffer_t *buf, byte *src, int src_len) {
     char *enc = src ? encode_base64(src, src_len) : NULL;
-    int len = str_format(str, n, " %s", enc ? enc : "0");
+    db_out_format(buf, " %s", enc ? enc : "0");
     free(enc);
-    return len;
 }
 
-#define CASE_BYTE_BASE64(attr, src, src_len) case attr : { n += byte_base64(str, n, src, src_len); break; }
+#define CASE_BYTE_BASE64(attr, src, src_len) case attr : { byte_base64(buf, src, src_len); break; }
 
 #define CASE_HASHSUM(x) CASE_BYTE_BASE64(attr_ ##x, line->hashsums[hash_ ##x], hashsums[hash_ ##x].length)
 
 #ifdef WITH_XATTR
-static int str_xattr(char *str, int n, xattrs_type *xattrs) {
+static void str_xattr(db_out_buffer_t *buf, xattrs_type *xattrs) {
     if (xattrs) {
-        size_t m = 0;
-        m = str_format(str, n, " %lu", xattrs->num);
+        db_out_format(buf, " %lu", xattrs->num);
         xattr_node *xattr = xattrs->ents;
         for (size_t i = xattrs->num; i > 0; --i) {
             char *enc_key = NULL;
@@ -377,92 +941,88 @@ static int str_xattr(char *str, int n, xattrs_type *xattrs) {
                 enc_key = encode_string(xattr->key);
             }
             char *enc_value = encode_base64(xattr->val, xattr->vsz);
-            m += str_format(str, n + m, ",%s,%s", enc_key?enc_key:xattr->key, enc_value?enc_value:"0");
+            db_out_format(buf, ",%s,%s", enc_key?enc_key:xattr->key, enc_value?enc_value:"0");
             free(enc_key);
             free(enc_value);
             ++xattr;
         }
-        return m;
     } else {
-        return str_format(str, n, " %lu", 0LU);
+        db_out_format(buf, " %lu", 0LU);
     }
 }
 #endif
 
 #ifdef WITH_ACL
-static int str_acl(char *str, int n, acl_type *acl) {
+static void str_acl(db_out_buffer_t *buf, acl_type *acl) {
 #ifdef WITH_POSIX_ACL
     if (acl) {
         char *enc_acl_a = acl->acl_a ? encode_base64((byte *)acl->acl_a, strlen(acl->acl_a)) : NULL;
         char *enc_acl_d = acl->acl_d ? encode_base64((byte *)acl->acl_d, strlen(acl->acl_d)) : NULL;
-        int len = str_format(str, n, " %s,%s,%s", "POSIX", enc_acl_a ? enc_acl_a : "0", enc_acl_d ? enc_acl_d : "0");
+        db_out_format(buf, " %s,%s,%s", "POSIX", enc_acl_a ? enc_acl_a : "0", enc_acl_d ? enc_acl_d : "0");
         free(enc_acl_d);
         free(enc_acl_a);
-        return len;
     } else {
-        return str_format(str, n, " %lu", 0LU);
+        db_out_format(buf, " %lu", 0LU);
     }
 #endif
 }
 #endif
 
-static int construct_database_line(db_line *line, char *str) {
-    int n = 0;
-
+static void write_database_line(db_out_buffer_t *buf, db_line *line) {
     for (ATTRIBUTE i = 0; i < num_attrs; ++i) {
         if (attributes[i].db_name && ATTR(i) & conf->db_out_attrs) {
             switch (i) {
             case attr_filename: {
-                n += str_filename(str, n, line->filename);
+                str_filename(buf, line->filename);
                 break;
             }
             case attr_attr: {
-                n += str_format(str, n, " %llu", line->attr);
+                db_out_format(buf, " %llu", line->attr);
                 break;
             }
             case attr_inode: {
-                n += str_format(str, n, " %li", line->inode);
+                db_out_format(buf, " %li", line->inode);
                 break;
             }
             case attr_size: {
-                n += str_format(str, n, " %lli", line->size);
+                db_out_format(buf, " %lli", line->size);
                 break;
             }
             case attr_bcount: {
-                n += str_format(str, n, " %lli", line->bcount);
+                db_out_format(buf, " %lli", line->bcount);
                 break;
             }
             case attr_perm: {
-                n += str_format(str, n, " %lo", (long)line->perm);
+                db_out_format(buf, " %lo", (long)line->perm);
                 break;
             }
             case attr_uid: {
-                n += str_format(str, n, " %li", line->uid);
+                db_out_format(buf, " %li", line->uid);
                 break;
             }
             case attr_gid: {
-                n += str_format(str, n, " %li", line->gid);
+                db_out_format(buf, " %li", line->gid);
                 break;
             }
             case attr_atime: {
-                n += str_format(str, n, " %ld", (long)line->atime);
+                db_out_format(buf, " %ld", (long)line->atime);
                 break;
             }
             case attr_ctime: {
-                n += str_format(str, n, " %ld", (long)line->ctime);
+                db_out_format(buf, " %ld", (long)line->ctime);
                 break;
             }
             case attr_mtime: {
-                n += str_format(str, n, " %ld", (long)line->mtime);
+                db_out_format(buf, " %ld", (long)line->mtime);
                 break;
             }
             case attr_linkname: {
-                n += str_linkname(str, n, line->linkname);
+                str_linkname(buf, line->linkname);
                 break;
                 ;
             }
             case attr_linkcount: {
-                n += str_format(str, n, " %li", line->nlink);
+                db_out_format(buf, " %li", line->nlink);
                 break;
             }
             CASE_HASHSUM(md5)
@@ -484,38 +1044,38 @@ static int construct_database_line(db_line *line, char *str) {
             CASE_HASHSUM(blake3)
             case attr_acl: {
 #ifdef WITH_ACL
-                n += str_acl(str, n, line->acl);
+                str_acl(buf, line->acl);
 #endif
                 break;
             }
             case attr_xattrs: {
 #ifdef WITH_XATTR
-                n += str_xattr(str, n, line->xattrs);
+                str_xattr(buf, line->xattrs);
 #endif
                 break;
             }
             case attr_selinux: {
 #ifdef WITH_SELINUX
-                n += byte_base64(str, n, (byte *)line->cntx, line->cntx ? strlen(line->cntx) : 0);
+                byte_base64(buf, (byte *)line->cntx, line->cntx ? strlen(line->cntx) : 0);
 #endif
                 break;
             }
             case attr_e2fsattrs: {
 #ifdef WITH_E2FSATTRS
-                n += str_format(str, n, " %lu", line->e2fsattrs);
+                db_out_format(buf, " %lu", line->e2fsattrs);
 #endif
                 break;
             }
             case attr_capabilities: {
 #ifdef WITH_CAPABILITIES
-                n += byte_base64(str, n, (byte *)line->capabilities,
+                byte_base64(buf, (byte *)line->capabilities,
                  line->capabilities ? strlen(line->capabilities) : 0);
 #endif
                 break;
             }
             case attr_fs_type : {
 #ifdef HAVE_FSTYPE
-                n += str_format(str, n, " %llu", (unsigned long long) line->fs_type);
+                db_out_format(buf, " %llu", (unsigned long long) line->fs_type);
 #endif
                 break;
             }
@@ -537,105 +1097,151 @@ static int construct_database_line(db_line *line, char *str) {
             }
         }
     }
-    if (str) {
-        snprintf(&str[n], 2, "\n");
-    }
-    n++;
-
-    return n;
+    db_out_write(buf, "\n", 1);
 }
 
-static void handle_io_error_on_write(char *function_str) {
-    if (conf->database_out.url->type == url_file && conf->database_out.flags&DB_FLAG_CREATED) {
-        log_msg(LOG_LEVEL_ERROR, "%s failed for %s (remove incompletely written database)", function_str, ((conf->database_out).url)->raw);
-        unlink(conf->database_out.url->value);
-    } else {
-        log_msg(LOG_LEVEL_ERROR, "%s failed for %s", function_str, ((conf->database_out).url)->raw);
-    }
-    exit(IO_ERROR);
-}
-
-static void db_out_write(char * str, size_t len) {
-    if ((conf->database_out).mdc) {
-        update_md((conf->database_out).mdc, str, len);
-    }
-
+/* starts a new block if the current block of the index is full */
+static void db_out_index_next_block(void) {
+    if (db_out_index.index && db_out_index.pos + db_out_buffer.len - db_out_index.block_pos >= DB_INDEX_BLOCK_SIZE) {
+        db_out_flush();
+        unsigned long long offset = db_out_index.pos;
 #ifdef WITH_ZLIB
-    if(conf->gzip_dbout) {
-        if (gzwrite((conf->database_out).gzp, str, len) < (int) len) {
-            handle_io_error_on_write("gzwrite");
+        if ((conf->database_out).pgz && pgzip_new_member((conf->database_out).pgz, &offset) != 0) {
+            handle_io_error_on_write("pgzip_new_member");
         }
-    } else {
 #endif
-        if (fwrite(str, sizeof(char), len, conf->database_out.fp) < len) {
-            handle_io_error_on_write("fwrite");
-        }
-        if (fflush(conf->database_out.fp) != 0) {
-            handle_io_error_on_write("fflush");
-        }
-#ifdef WITH_ZLIB
+        db_out_index.block_pos = db_out_index.pos;
+        db_index_add_block(db_out_index.index, offset, db_out_index.pos, db_out_index.lines + 1);
     }
-#endif
 }
 
 int db_writeline_file(db_line* line) {
+    if (db_out_index.index) {
+        db_out_index_next_block();
+        db_index_add_path(db_out_index.index, line->filename);
+    }
+    write_database_line(&db_out_buffer, line);
+    return RETOK;
+}
 
-    char *str = NULL;
-    int n = construct_database_line(line, str);
-
-    str = checked_malloc(n+1);
-    construct_database_line(line, str);
-
-    db_out_write(str, n);
+/* writes the '@@remove' line of a delta database (see db_delta.h) */
+int db_writeremoved_file(db_line* line) {
+    db_out_format(&db_out_buffer, "%s", "@@remove ");
+    str_filename(&db_out_buffer, line->filename);
+    db_out_format(&db_out_buffer, "%s", "\n");
+    return RETOK;
+}
 
-    free(str);
+/*
+ * Formats the database lines into a newly allocated buffer (may be called
+ * by multiple threads), the buffer is written by db_write_formatted_file()
+ */
+char *db_format_lines_file(db_line **lines, size_t num_lines, size_t *len) {
+    db_out_buffer_t buf = { .grow = true };
+    for (size_t i = 0 ; i < num_lines ; ++i) {
+        write_database_line(&buf, lines[i]);
+    }
+    *len = buf.len;
+    return buf.data;
+}
 
-    return RETOK;
+/* appends the database line to the buffer data of the given length and size */
+void db_append_line_file(db_line *line, char **data, size_t *len, size_t *size) {
+    db_out_buffer_t buf = { .data = *data, .size = *size, .len = *len, .grow = true };
+    write_database_line(&buf, line);
+    *data = buf.data;
+    *len = buf.len;
+    *size = buf.size;
 }
 
-static int construct_database_header(db_config *dbconf, char *str) {
-    int n = 0;
+void db_write_formatted_file(char *data, size_t len, db_line **lines, size_t num_lines) {
+    if (db_out_index.index) {
+        db_out_index_next_block();
+        for (size_t i = 0 ; i < num_lines ; ++i) {
+            db_index_add_path(db_out_index.index, lines[i]->filename);
+        }
+    }
+    db_out_write(&db_out_buffer, data, len);
+}
 
-    n += str_format(str, n, "%s", "@@begin_db\n");
+static void write_database_header(db_config *dbconf) {
+    db_out_buffer_t *buf = &db_out_buffer;
+    db_out_format(buf, "%s", "@@begin_db\n");
     if (dbconf->database_add_metadata) {
         time_t db_gen_time = time(NULL);
         char *time_str = get_time_string(&db_gen_time);
-        n += str_format(str, n,
+        db_out_format(buf,
              "# This file was generated by Aide, version %s\n"
              "# Time of generation was %s\n",
              conf->aide_version, time_str);
         free(time_str);
     }
     if (dbconf->config_version) {
-        n += str_format(str, n,
+        db_out_format(buf,
                         "# The config version used to generate this file was:\n"
                         "# %s\n",
                         dbconf->config_version);
     }
-    n += str_format(str, n, "%s", "@@db_spec");
+    if (dbconf->database_out_delta) {
+        char *parent_hashsums = db_delta_parent_hashsums();
+        if (parent_hashsums == NULL) {
+            log_msg(LOG_LEVEL_ERROR, "%s: no database_attrs hashsums of the base database available, cannot write delta database", (dbconf->database_out.url)->raw);
+            exit(DATABASE_ERROR);
+        }
+        db_out_format(buf, "@@delta_db %s\n", parent_hashsums);
+        free(parent_hashsums);
+    }
+    db_out_format(buf, "%s", "@@db_spec");
     for (ATTRIBUTE i = 0; i < num_attrs; ++i) {
         if (attributes[i].db_name && attributes[i].attr & conf->db_out_attrs) {
-            n += str_format(str, n, " %s", attributes[i].db_name);
+            db_out_format(buf, " %s", attributes[i].db_name);
         }
     }
-    n += str_format(str, n, "%s", "\n");
-    return n;
+    db_out_format(buf, "%s", "\n");
 }
 
 int db_writespec_file(db_config* dbconf) {
-    char *str = NULL;
-    int n = construct_database_header(dbconf, str);
-
-    str = checked_malloc(n+1);
-    construct_database_header(dbconf, str);
+    if (db_out_buffer.data == NULL) {
+        db_out_buffer.size = dbconf->database_out_buffer_size;
+        db_out_buffer.data = checked_malloc(db_out_buffer.size); /* freed in db_close_file */
+        db_out_buffer.len = 0;
+        log_msg(LOG_LEVEL_DEBUG, "use write buffer of %zu bytes for %s", db_out_buffer.size, (dbconf->database_out.url)->raw);
+    }
 
-    db_out_write(str, n);
+    if (dbconf->database_out_index && db_out_index.index == NULL) {
+        if (dbconf->database_out_delta) {
+            log_msg(LOG_LEVEL_WARNING, "block index is not supported for delta database %s", (dbconf->database_out.url)->raw);
+        } else if ((dbconf->database_out.url)->type != url_file
+#ifdef WITH_ZSTD
+                || dbconf->database_out.zstd_out
+#endif
+           ) {
+            log_msg(LOG_LEVEL_WARNING, "block index is not supported for %s (only for uncompressed or gzipped files)", (dbconf->database_out.url)->raw);
+        } else {
+            db_out_index.index = db_index_new(); /* freed in db_close_file */
+            db_out_index.pos = db_out_index.block_pos = 0LLU;
+            db_out_index.lines = 0L;
+            db_index_add_block(db_out_index.index, 0LLU, 0LLU, 1L);
+        }
+    }
 
-    free(str);
+    write_database_header(dbconf);
 
     return RETOK;
 }
 
+void fsync_database(db_config* dbconf) {
+    if ((dbconf->database_out.url)->type == url_file) {
+        int fd = open((dbconf->database_out.url)->value, O_RDONLY);
+        if (fd == -1 || (fsync(fd) == -1 && errno != EINVAL && errno != EROFS)) {
+            log_msg(LOG_LEVEL_WARNING, "fsync failed for database '%s': %s", (dbconf->database_out.url)->raw, strerror(errno));
+        }
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+}
+
 int db_close_file(db_config* dbconf){
   
   if(dbconf->database_out.fp
@@ -644,26 +1250,46 @@ int db_close_file(db_config* dbconf){
 #endif
      ){
       char *end_db_str = "@@end_db\n";
-      db_out_write(end_db_str, strlen(end_db_str));
+      db_out_write(&db_out_buffer, end_db_str, strlen(end_db_str));
+      db_out_flush();
   }
+  free(db_out_buffer.data);
+  db_out_buffer.data = NULL;
+  db_out_buffer.size = 0;
 
 #ifdef WITH_ZLIB
-  if(dbconf->gzip_dbout){
-    if(gzclose(dbconf->database_out.gzp)){
-      log_msg(LOG_LEVEL_ERROR,"unable to gzclose database '%s': %s", (dbconf->database_out.url)->raw, strerror(errno));
+  if(dbconf->database_out.pgz){
+    if(pgzip_close(dbconf->database_out.pgz)){
+      log_msg(LOG_LEVEL_ERROR,"unable to finish gzip stream of database '%s': %s", (dbconf->database_out.url)->raw, strerror(errno));
+      dbconf->database_out.pgz = NULL;
       return RETFAIL;
     }
-    dbconf->database_out.gzp = NULL;
-  }else {
+    dbconf->database_out.pgz = NULL;
+  }
 #endif
-    if(fclose(dbconf->database_out.fp)){
-      log_msg(LOG_LEVEL_ERROR,"unable to close database '%s': %s",  (dbconf->database_out.url)->raw, strerror(errno));
+#ifdef WITH_ZSTD
+  if(dbconf->database_out.zstd_out){
+    if(zstd_writer_close(dbconf->database_out.zstd_out)){
+      log_msg(LOG_LEVEL_ERROR,"unable to finish zstd stream of database '%s': %s", (dbconf->database_out.url)->raw, strerror(errno));
+      dbconf->database_out.zstd_out = NULL;
       return RETFAIL;
     }
-    dbconf->database_out.fp = NULL;
-#ifdef WITH_ZLIB
+    dbconf->database_out.zstd_out = NULL;
   }
 #endif
+  if(fclose(dbconf->database_out.fp)){
+    log_msg(LOG_LEVEL_ERROR,"unable to close database '%s': %s",  (dbconf->database_out.url)->raw, strerror(errno));
+    return RETFAIL;
+  }
+  dbconf->database_out.fp = NULL;
+
+  fsync_database(dbconf);
+
+  if (db_out_index.index) {
+      db_index_write(db_out_index.index, &dbconf->database_out, db_out_index.pos);
+      db_index_free(db_out_index.index);
+      db_out_index.index = NULL;
+  }
 
   return RETOK;
 }
@@ -0,0 +1,321 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "aide.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "db_binary.h"
+#include "db_config.h"
+#include "db_index.h"
+#include "log.h"
+#include "url.h"
+#include "util.h"
+
+typedef struct db_index_block {
+    unsigned long long offset;
+    unsigned long long pos;
+    long lineno;
+    char *first;
+    char *last;
+} db_index_block;
+
+struct db_index {
+    db_index_block *blocks;
+    size_t num_blocks;
+    size_t size;
+
+    char *last_path;
+    size_t last_path_size;
+    bool sorted;
+};
+
+static char *get_index_path(database *db) {
+    size_t len = strlen((db->url)->value);
+    char *path = checked_malloc(len + 5); /* freed by caller */
+    snprintf(path, len + 5, "%s.idx", (db->url)->value);
+    return path;
+}
+
+static void free_blocks(db_index_block *blocks, size_t num_blocks) {
+    for (size_t i = 0 ; i < num_blocks ; ++i) {
+        free(blocks[i].first);
+        free(blocks[i].last);
+    }
+    free(blocks);
+}
+
+/* output database */
+
+db_index_t *db_index_new(void) {
+    db_index_t *index = checked_malloc(sizeof(db_index_t)); /* freed in db_index_free() */
+    *index = (db_index_t) { .sorted = true };
+    return index;
+}
+
+/* sets the last path of the current block */
+static void finish_block(db_index_t *index) {
+    if (index->num_blocks && index->blocks[index->num_blocks-1].first) {
+        index->blocks[index->num_blocks-1].last = checked_strdup(index->last_path); /* freed in db_index_free() */
+    }
+}
+
+void db_index_add_block(db_index_t *index, unsigned long long offset, unsigned long long pos, long lineno) {
+    finish_block(index);
+    if (index->num_blocks == index->size) {
+        index->size = index->size ? 2 * index->size : 64;
+        index->blocks = checked_realloc(index->blocks, index->size * sizeof(db_index_block)); /* freed in db_index_free() */
+    }
+    index->blocks[index->num_blocks++] = (db_index_block) { .offset = offset, .pos = pos, .lineno = lineno };
+    log_msg(LOG_LEVEL_TRACE, "db_index: start block #%zu (offset: %llu, position: %llu, line: %ld)", index->num_blocks - 1, offset, pos, lineno);
+}
+
+void db_index_add_path(db_index_t *index, const char *path) {
+    if (!index->sorted) {
+        return;
+    }
+    if (index->last_path && db_path_cmp(index->last_path, path) >= 0) {
+        log_msg(LOG_LEVEL_WARNING, "database is not sorted by path ('%s' after '%s'), do not write block index", path, index->last_path);
+        index->sorted = false;
+        return;
+    }
+    db_index_block *block = &index->blocks[index->num_blocks-1];
+    if (block->first == NULL) {
+        block->first = checked_strdup(path); /* freed in db_index_free() */
+    }
+    size_t len = strlen(path) + 1;
+    if (len > index->last_path_size) {
+        index->last_path_size = len;
+        index->last_path = checked_realloc(index->last_path, len); /* freed in db_index_free() */
+    }
+    memcpy(index->last_path, path, len);
+}
+
+static void write_index_path(FILE *fp, const char *path) {
+    char *safe_path = contains_unsafe(path) ? encode_string(path) : NULL;
+    fprintf(fp, " %s", safe_path ? safe_path : path);
+    free(safe_path);
+}
+
+void db_index_write(db_index_t *index, database *db, unsigned long long end) {
+    char *path = get_index_path(db);
+    struct stat st;
+    if (!index->sorted || stat((db->url)->value, &st) == -1) {
+        if (unlink(path) == 0) {
+            log_msg(LOG_LEVEL_INFO, "removed outdated block index '%s'", path);
+        }
+        free(path);
+        return;
+    }
+    finish_block(index);
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        log_msg(LOG_LEVEL_WARNING, "failed to open block index '%s' for writing: %s", path, strerror(errno));
+        free(path);
+        return;
+    }
+    fprintf(fp, "@@aide_index %d %lld %lld %ld %llu %llu\n", DB_INDEX_VERSION, (long long) st.st_size,
+            (long long) st.st_mtim.tv_sec, (long) st.st_mtim.tv_nsec, (unsigned long long) st.st_ino, end);
+    size_t num_blocks = 0;
+    for (size_t i = 0 ; i < index->num_blocks ; ++i) {
+        db_index_block *block = &index->blocks[i];
+        if (block->first) {
+            fprintf(fp, "%llu %llu %ld", block->offset, block->pos, block->lineno);
+            write_index_path(fp, block->first);
+            write_index_path(fp, block->last);
+            fputc('\n', fp);
+            num_blocks++;
+        }
+    }
+    if (ferror(fp) | fclose(fp)) {
+        log_msg(LOG_LEVEL_WARNING, "failed to write block index '%s': %s", path, strerror(errno));
+        unlink(path);
+    } else {
+        log_msg(LOG_LEVEL_INFO, "wrote block index '%s' (%zu blocks)", path, num_blocks);
+    }
+    free(path);
+}
+
+void db_index_free(db_index_t *index) {
+    if (index) {
+        free_blocks(index->blocks, index->num_blocks);
+        free(index->last_path);
+        free(index);
+    }
+}
+
+/* input database */
+
+/* returns the literal prefix every path matching the (anchored) limit starts with */
+char *get_limit_prefix(const char *limit) {
+    if (strchr(limit, '|')) {
+        return NULL;
+    }
+    size_t len = strcspn(limit, "\\^$.[]()?*+{}");
+    if (len && limit[len] && strchr("?*{", limit[len])) {
+        /* last character is optional */
+        len--;
+    }
+    if (len < 2) {
+        return NULL;
+    }
+    char *prefix = checked_strndup(limit, len); /* freed by caller */
+    if (contains_unsafe(prefix)) {
+        free(prefix);
+        return NULL;
+    }
+    return prefix;
+}
+
+static db_index_block *read_index(const char *path, database *db, unsigned long long *end, size_t *num_blocks) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        log_msg(LOG_LEVEL_DEBUG, "%s: no block index found (%s: %s)", (db->url)->raw, path, strerror(errno));
+        return NULL;
+    }
+    db_index_block *blocks = NULL;
+    size_t size = 0;
+    *num_blocks = 0;
+
+    char *line = NULL;
+    size_t line_size = 0;
+    long lineno = 0;
+    const char *error = NULL;
+    while (error == NULL && getline(&line, &line_size, fp) != -1) {
+        lineno++;
+        line[strcspn(line, "\n")] = '\0';
+        if (lineno == 1) {
+            int version;
+            long long db_size, db_mtime;
+            long db_mtime_nsec;
+            unsigned long long db_inode;
+            struct stat st;
+            if (sscanf(line, "@@aide_index %d", &version) != 1) {
+                error = "invalid header";
+            } else if (version != DB_INDEX_VERSION) {
+                error = "unsupported version";
+            } else if (sscanf(line, "@@aide_index %d %lld %lld %ld %llu %llu", &version, &db_size, &db_mtime, &db_mtime_nsec, &db_inode, end) != 6) {
+                error = "invalid header";
+            } else if (fstat(fileno((FILE *) db->fp), &st) == -1 || st.st_size != db_size
+                    || st.st_mtim.tv_sec != db_mtime || st.st_mtim.tv_nsec != db_mtime_nsec
+                    || st.st_ino != db_inode) {
+                /* a database replaced within the same second (e.g. by rename) keeps size and mtime seconds */
+                error = "database has been modified";
+            }
+            continue;
+        }
+        db_index_block block = { 0 };
+        char *saveptr = NULL;
+        char *token = strtok_r(line, " ", &saveptr);
+        for (int i = 0 ; i < 5 && error == NULL ; ++i, token = strtok_r(NULL, " ", &saveptr)) {
+            char *endptr = NULL;
+            if (token == NULL) {
+                error = "missing field";
+                break;
+            }
+            switch (i) {
+                case 0: block.offset = strtoull(token, &endptr, 10); break;
+                case 1: block.pos = strtoull(token, &endptr, 10); break;
+                case 2: block.lineno = strtol(token, &endptr, 10); break;
+                case 3: block.first = checked_strdup(token); decode_string(block.first); break;
+                case 4: block.last = checked_strdup(token); decode_string(block.last); break;
+            }
+            if (endptr && *endptr != '\0') {
+                error = "invalid number";
+            }
+        }
+        if (*num_blocks == size) {
+            size = size ? 2 * size : 64;
+            blocks = checked_realloc(blocks, size * sizeof(db_index_block)); /* freed in db_index_find() */
+        }
+        blocks[(*num_blocks)++] = block;
+    }
+    free(line);
+    fclose(fp);
+    if (error == NULL && *num_blocks == 0) {
+        error = "no blocks";
+    }
+    if (error) {
+        log_msg(LOG_LEVEL_WARNING, "%s: ignore block index '%s' (%s, line: %ld)", (db->url)->raw, path, error, lineno);
+        free_blocks(blocks, *num_blocks);
+        return NULL;
+    }
+    return blocks;
+}
+
+bool db_index_find(database *db, db_index_range *range) {
+    /* the hashsums of the whole databases are needed to verify delta databases */
+    if (conf->limit == NULL || (db->url)->type != url_file || db->fp == NULL || db->merge || db->flags&DB_FLAG_DELTA
+#ifdef WITH_ZSTD
+            || db->zstd_in
+#endif
+       ) {
+        return false;
+    }
+    char *prefix = get_limit_prefix(conf->limit);
+    if (prefix == NULL) {
+        log_msg(LOG_LEVEL_DEBUG, "%s: limit '%s' has no literal prefix, do not use block index", (db->url)->raw, conf->limit);
+        return false;
+    }
+    size_t prefix_len = strlen(prefix);
+
+    char *path = get_index_path(db);
+    unsigned long long end;
+    size_t num_blocks;
+    db_index_block *blocks = read_index(path, db, &end, &num_blocks);
+    if (blocks == NULL) {
+        free(prefix);
+        free(path);
+        return false;
+    }
+
+    /* the paths starting with prefix are stored consecutively */
+    size_t first = 0;
+    while (first < num_blocks && db_path_cmp(blocks[first].last, prefix) < 0) {
+        first++;
+    }
+    size_t last = first;
+    while (last < num_blocks && (db_path_cmp(blocks[last].first, prefix) < 0 || strncmp(blocks[last].first, prefix, prefix_len) == 0)) {
+        last++;
+    }
+    if (first == num_blocks) {
+        *range = (db_index_range) { .offset = blocks[num_blocks-1].offset, .pos = end, .end = end, .lineno = 0 };
+    } else {
+        *range = (db_index_range) {
+            .offset = blocks[first].offset,
+            .pos = blocks[first].pos,
+            .end = last < num_blocks ? blocks[last].pos : end,
+            .lineno = blocks[first].lineno,
+        };
+    }
+    log_msg(LOG_LEVEL_INFO, "%s: read %zu of %zu blocks (prefix of limit: '%s', block index: '%s')", (db->url)->raw, last - first, num_blocks, prefix, path);
+
+    free_blocks(blocks, num_blocks);
+    free(prefix);
+    free(path);
+    return true;
+}
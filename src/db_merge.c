@@ -0,0 +1,137 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "aide.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "db.h"
+#include "db_binary.h"
+#include "db_config.h"
+#include "db_merge.h"
+#include "db_line.h"
+#include "errorcodes.h"
+#include "log.h"
+#include "url.h"
+#include "util.h"
+
+typedef struct merge_input {
+    database *db;
+    db_entry_t head; /* next entry (line is NULL if not yet read) */
+    bool eof;
+
+    char *last_path;
+    size_t last_path_size;
+} merge_input;
+
+struct db_merge {
+    merge_input *inputs;
+    int num_inputs;
+    bool disjoint;
+};
+
+db_merge_t *db_merge_new(database **dbs, int num_dbs, bool disjoint) {
+    db_merge_t *merge = checked_malloc(sizeof(db_merge_t)); /* freed in db_merge_free() */
+    merge->num_inputs = num_dbs;
+    merge->disjoint = disjoint;
+    merge->inputs = checked_calloc(num_dbs, sizeof(merge_input)); /* freed in db_merge_free() */
+    for (int i = 0 ; i < num_dbs ; ++i) {
+        merge->inputs[i].db = dbs[i];
+    }
+    return merge;
+}
+
+static void read_next(merge_input *input, bool include_limited_entries) {
+    input->head = db_readline_single(input->db, include_limited_entries);
+    if (input->head.line == NULL) {
+        input->eof = true;
+        return;
+    }
+    const char *path = (input->head.line)->filename;
+    if (input->last_path && db_path_cmp(input->last_path, path) >= 0) {
+        log_msg(LOG_LEVEL_ERROR, "%s: database is not sorted by path ('%s' after '%s'), cannot merge databases", (input->db->url)->raw, path, input->last_path);
+        exit(DATABASE_ERROR);
+    }
+    size_t len = strlen(path) + 1;
+    if (len > input->last_path_size) {
+        input->last_path_size = len;
+        input->last_path = checked_realloc(input->last_path, len); /* freed in db_merge_free() */
+    }
+    memcpy(input->last_path, path, len);
+}
+
+static void free_entry(db_entry_t *entry) {
+    free_db_line(entry->line);
+    free(entry->line);
+    entry->line = NULL;
+}
+
+db_entry_t db_merge_readline(db_merge_t *merge, bool include_limited_entries) {
+    while (1) {
+        int latest = -1;
+        for (int i = 0 ; i < merge->num_inputs ; ++i) {
+            merge_input *input = &merge->inputs[i];
+            if (input->head.line == NULL && !input->eof) {
+                read_next(input, include_limited_entries);
+            }
+            /* on equal paths the later database wins */
+            if (input->head.line && (latest == -1 || db_path_cmp((input->head.line)->filename, (merge->inputs[latest].head.line)->filename) <= 0)) {
+                latest = i;
+            }
+        }
+        if (latest == -1) {
+            return (db_entry_t) { .line = NULL, .limit = false, .removed = false };
+        }
+        db_entry_t entry = merge->inputs[latest].head;
+        merge->inputs[latest].head.line = NULL;
+        for (int i = 0 ; i < latest ; ++i) {
+            merge_input *input = &merge->inputs[i];
+            if (input->head.line && strcmp((input->head.line)->filename, (entry.line)->filename) == 0) {
+                if (merge->disjoint) {
+                    log_msg(LOG_LEVEL_ERROR, "entry '%s' found in %s and %s (databases are not disjoint)", (entry.line)->filename, (input->db->url)->raw, (merge->inputs[latest].db->url)->raw);
+                    exit(DATABASE_ERROR);
+                }
+                log_msg(LOG_LEVEL_TRACE, "merge: entry '%s' of %s replaced by %s", (entry.line)->filename, (input->db->url)->raw, (merge->inputs[latest].db->url)->raw);
+                free_entry(&input->head);
+            }
+        }
+        if (!entry.removed) {
+            return entry;
+        }
+        log_msg(LOG_LEVEL_DEBUG, "merge: entry '%s' removed by %s", (entry.line)->filename, (merge->inputs[latest].db->url)->raw);
+        free_entry(&entry);
+    }
+}
+
+void db_merge_free(db_merge_t *merge) {
+    if (merge == NULL) {
+        return;
+    }
+    for (int i = 0 ; i < merge->num_inputs ; ++i) {
+        if (merge->inputs[i].head.line) {
+            free_entry(&merge->inputs[i].head);
+        }
+        free(merge->inputs[i].last_path);
+    }
+    free(merge->inputs);
+    free(merge);
+}
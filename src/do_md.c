@@ -21,6 +21,7 @@
  */
 
 #include "config.h"
+#include "aide.h"
 #include "db_disk.h"
 #include "progress.h"
 #include <stdbool.h>
@@ -39,6 +40,9 @@
 #ifdef WITH_ZLIB
 #include <zlib.h>
 #endif
+#ifdef WITH_ZSTD
+#include "zstdio.h"
+#endif
 
 #ifdef WITH_XATTR
 #include <sys/xattr.h>
@@ -61,6 +65,12 @@
 #include <sys/capability.h>
 #endif
 
+#ifdef WITH_LIBURING
+#include <liburing.h>
+#include <pthread.h>
+#include <stdint.h>
+#endif
+
 
 #include "md.h"
 #include "do_md.h"
@@ -71,21 +81,31 @@
 #include "util.h"
 #include "log.h"
 #include "attributes.h"
+#include "errorcodes.h"
 
 /* This define should be somewhere else */
 #define READ_BLOCK_SIZE 16777216
+/* files up to this size are read using the small buffer */
+#define SMALL_READ_BLOCK_SIZE 131072
+#define HUGE_PAGE_SIZE 2097152
 
 typedef union fd {
     int plain;
 #ifdef WITH_ZLIB
     gzFile gzip;
 #endif
+#ifdef WITH_ZSTD
+    zstd_reader_t *zstd;
+#endif
 } _fd;
 
 typedef enum compression {
     COMPRESSION_PLAIN,
 #ifdef WITH_ZLIB
     COMPRESSION_GZIP,
+#endif
+#ifdef WITH_ZSTD
+    COMPRESSION_ZSTD,
 #endif
     COMPRESSION_ERROR
 } compression;
@@ -121,11 +141,11 @@ static hashsums_file hashsum_open(int filedes, char* fullpath, bool uncompress,
     hashsums_file file;
 
     if (uncompress) {
-        char head[2];
+        char head[4];
         char *magic_gzip = "\037\213";
-        ssize_t magic_length = strlen(magic_gzip);
-        ssize_t bytes = read(filedes, head, magic_length);
-        if (bytes == magic_length && strncmp(head, magic_gzip, magic_length) == 0) {
+        char *magic_zstd = "\050\265\057\375";
+        ssize_t bytes = read(filedes, head, sizeof(head));
+        if (bytes >= 2 && memcmp(head, magic_gzip, 2) == 0) {
             LOG_WHOAMI(LOG_LEVEL_COMPARE, "│ '%s' is gzip compressed", fullpath);
             lseek(filedes, 0, SEEK_SET);
 #ifdef WITH_ZLIB
@@ -148,6 +168,23 @@ static hashsums_file hashsum_open(int filedes, char* fullpath, bool uncompress,
             log_msg(LOG_LEVEL_WARNING, "'%s': gzip support not compiled in, recompile AIDE with '--with-zlib' (uncompressed hashsums could not be calculated)", fullpath);
             file.compression = COMPRESSION_ERROR;
             return file;
+#endif
+        } else if (bytes == 4 && memcmp(head, magic_zstd, 4) == 0) {
+            LOG_WHOAMI(LOG_LEVEL_COMPARE, "│ '%s' is zstd compressed", fullpath);
+            lseek(filedes, 0, SEEK_SET);
+#ifdef WITH_ZSTD
+            file.fd.zstd = zstd_reader_open(filedes);
+            if (file.fd.zstd == NULL){
+                log_msg(LOG_LEVEL_WARNING, "hash calculation: zstd_reader_open() failed for %s (uncompressed hashsums could not be calculated)", fullpath);
+                file.compression = COMPRESSION_ERROR;
+                return file;
+            }
+            file.compression = COMPRESSION_ZSTD;
+            return file;
+#else
+            log_msg(LOG_LEVEL_WARNING, "'%s': zstd support not compiled in, recompile AIDE with '--with-zstd' (uncompressed hashsums could not be calculated)", fullpath);
+            file.compression = COMPRESSION_ERROR;
+            return file;
 #endif
         } else {
             log_msg(LOG_LEVEL_NOTICE, "'%s': no supported compression algorithm found (uncompressed hashsums could not be calculated)", fullpath);
@@ -172,6 +209,14 @@ static off_t hashsum_read(hashsums_file file, void *buf, size_t count) {
         case COMPRESSION_GZIP:
              size = gzread(file.fd.gzip, buf, count);
              break;
+#endif
+#ifdef WITH_ZSTD
+        case COMPRESSION_ZSTD:
+             size = zstd_reader_read(file.fd.zstd, buf, count);
+             if (size == -1) {
+                 log_msg(LOG_LEVEL_DEBUG, "hash calculation: zstd decompression failed: %s", zstd_reader_error(file.fd.zstd));
+             }
+             break;
 #endif
         case COMPRESSION_ERROR:
              size = -2;
@@ -181,6 +226,176 @@ static off_t hashsum_read(hashsums_file file, void *buf, size_t count) {
     return size;
 }
 
+#ifdef WITH_LIBURING
+#define URING_QUEUE_DEPTH 4
+#define URING_BLOCK_SIZE (READ_BLOCK_SIZE/URING_QUEUE_DEPTH)
+
+static pthread_key_t uring_key;
+static pthread_once_t uring_key_once = PTHREAD_ONCE_INIT;
+static struct io_uring uring_unavailable;
+
+static void uring_free(void *ring) {
+    if (ring != &uring_unavailable) {
+        io_uring_queue_exit(ring);
+        free(ring);
+    }
+}
+
+static void uring_key_create(void) {
+    pthread_key_create(&uring_key, uring_free);
+}
+
+/* every thread uses its own ring, it is set up on first use and torn down on thread exit */
+static struct io_uring *get_uring(const char *whoami) {
+    pthread_once(&uring_key_once, uring_key_create);
+    struct io_uring *ring = pthread_getspecific(uring_key);
+    if (ring == NULL) {
+        ring = checked_malloc(sizeof(struct io_uring)); /* freed in uring_free */
+        int ret = io_uring_queue_init(URING_QUEUE_DEPTH, ring, 0);
+        if (ret < 0) {
+            log_msg(LOG_LEVEL_NOTICE, "%s%sio_uring_queue_init() failed: %s (fall back to synchronous reads for hash calculation)",
+                    whoami?whoami:"", whoami?": ":"", strerror(-ret));
+            free(ring);
+            ring = &uring_unavailable;
+        } else {
+            LOG_WHOAMI(LOG_LEVEL_THREAD, "initialized io_uring with queue depth %d", URING_QUEUE_DEPTH)
+        }
+        pthread_setspecific(uring_key, ring);
+    }
+    return ring == &uring_unavailable ? NULL : ring;
+}
+
+typedef enum uring_slot_state {
+    URING_SLOT_IDLE,
+    URING_SLOT_IN_FLIGHT,
+    URING_SLOT_COMPLETED,
+} uring_slot_state;
+
+typedef struct uring_slot {
+    char *buf;
+    off_t offset;
+    size_t length;
+    size_t done;
+    int res;
+    uring_slot_state state;
+} uring_slot;
+
+static void uring_submit_read(struct io_uring *ring, int fd, uring_slot *slots, int i) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+    /* the ring has one sqe per slot, so there is always a free sqe */
+    io_uring_prep_read(sqe, fd, slots[i].buf + slots[i].done, slots[i].length - slots[i].done, slots[i].offset + slots[i].done);
+    io_uring_sqe_set_data(sqe, (void *)(uintptr_t) i);
+    slots[i].state = URING_SLOT_IN_FLIGHT;
+}
+
+/*
+ * Reads the file into buf (READ_BLOCK_SIZE bytes) in blocks of URING_BLOCK_SIZE
+ * up to read_limit with up to URING_QUEUE_DEPTH reads in flight and feeds the
+ * blocks to update_md() in file order.
+ *
+ * Returns 0 on success, -1 on read failure (errno is set) or -2 if update_md() failed.
+ */
+static off_t uring_update_md(struct io_uring *ring, disk_entry *entry, struct md_container *mdc, char *buf, off_t read_limit, int worker_index, off_t *r_size) {
+    uring_slot slots[URING_QUEUE_DEPTH];
+    off_t submit_offset = 0;
+    int in_flight = 0;
+    off_t ret = 0;
+
+    for (int i = 0 ; i < URING_QUEUE_DEPTH ; ++i) {
+        slots[i].buf = buf + i * URING_BLOCK_SIZE;
+        slots[i].state = URING_SLOT_IDLE;
+        if (submit_offset < read_limit) {
+            slots[i].offset = submit_offset;
+            slots[i].length = read_limit - submit_offset < URING_BLOCK_SIZE ? read_limit - submit_offset : URING_BLOCK_SIZE;
+            slots[i].done = 0;
+            uring_submit_read(ring, entry->fd, slots, i);
+            submit_offset += slots[i].length;
+            in_flight++;
+        }
+    }
+    io_uring_submit(ring);
+
+    int next = 0;
+    while (slots[next].state != URING_SLOT_IDLE) {
+        while (slots[next].state == URING_SLOT_IN_FLIGHT) {
+            struct io_uring_cqe *cqe;
+            int err = io_uring_wait_cqe(ring, &cqe);
+            if (err == -EINTR) {
+                continue;
+            } else if (err < 0) {
+                errno = -err;
+                ret = -1;
+                goto drain;
+            }
+            int i = (int) (uintptr_t) io_uring_cqe_get_data(cqe);
+            slots[i].res = cqe->res;
+            slots[i].state = URING_SLOT_COMPLETED;
+            io_uring_cqe_seen(ring, cqe);
+            in_flight--;
+        }
+        uring_slot *slot = &slots[next];
+        if (slot->res == -EINTR || slot->res == -EAGAIN) {
+            uring_submit_read(ring, entry->fd, slots, next);
+            io_uring_submit(ring);
+            in_flight++;
+            continue;
+        } else if (slot->res < 0) {
+            errno = -slot->res;
+            ret = -1;
+            break;
+        }
+        slot->done += slot->res;
+        if (slot->res > 0 && slot->done < slot->length) {
+            /* short read, read the rest of the block */
+            uring_submit_read(ring, entry->fd, slots, next);
+            io_uring_submit(ring);
+            in_flight++;
+            continue;
+        }
+        if (slot->done) {
+            if (update_md(mdc, slot->buf, slot->done) != RETOK) {
+                ret = -2;
+                break;
+            }
+            *r_size += slot->done;
+            if (worker_index) {
+                update_progress_worker_progress(worker_index, *r_size*100/read_limit);
+            }
+        }
+        if (slot->done < slot->length) {
+            /* end of file reached before read_limit */
+            break;
+        }
+        slot->state = URING_SLOT_IDLE;
+        if (submit_offset < read_limit) {
+            slot->offset = submit_offset;
+            slot->length = read_limit - submit_offset < URING_BLOCK_SIZE ? read_limit - submit_offset : URING_BLOCK_SIZE;
+            slot->done = 0;
+            uring_submit_read(ring, entry->fd, slots, next);
+            io_uring_submit(ring);
+            submit_offset += slot->length;
+            in_flight++;
+        }
+        next = (next + 1) % URING_QUEUE_DEPTH;
+    }
+drain:
+    /* wait for outstanding reads before the buffer is released */
+    while (in_flight > 0) {
+        struct io_uring_cqe *cqe;
+        int err = io_uring_wait_cqe(ring, &cqe);
+        if (err == -EINTR) {
+            continue;
+        } else if (err < 0) {
+            log_msg(LOG_LEVEL_ERROR, "io_uring_wait_cqe() failed for '%s': %s", entry->filename, strerror(-err));
+            exit(IO_ERROR);
+        }
+        io_uring_cqe_seen(ring, cqe);
+        in_flight--;
+    }
+    return ret;
+}
+#endif
+
 static int hashsum_close(hashsums_file file) {
     switch (file.compression) {
         case COMPRESSION_PLAIN:
@@ -188,6 +403,11 @@ static int hashsum_close(hashsums_file file) {
 #ifdef WITH_ZLIB
         case COMPRESSION_GZIP:
              return gzclose(file.fd.gzip);
+#endif
+#ifdef WITH_ZSTD
+        case COMPRESSION_ZSTD:
+             zstd_reader_close(file.fd.zstd);
+             return 0;
 #endif
         case COMPRESSION_ERROR:
              return -1;
@@ -195,7 +415,39 @@ static int hashsum_close(hashsums_file file) {
     return -1;
 }
 
-md_hashsums calc_hashsums(disk_entry *entry, DB_ATTR_TYPE attr, ssize_t limit_size, bool uncompress, int worker_index, const char *whoami) {
+static char *alloc_large_read_buffer(void) {
+    void *buf = NULL;
+    /* align to huge page size, so the buffer can be backed by transparent huge pages */
+    int err = posix_memalign(&buf, HUGE_PAGE_SIZE, READ_BLOCK_SIZE);
+    if (err) {
+        log_msg(LOG_LEVEL_ERROR, "posix_memalign() failed to allocate %d bytes: %s", READ_BLOCK_SIZE, strerror(err));
+        exit(MEMORY_ALLOCATION_FAILURE);
+    }
+#ifdef MADV_HUGEPAGE
+    if (madvise(buf, READ_BLOCK_SIZE, MADV_HUGEPAGE) == -1) {
+        log_msg(LOG_LEVEL_DEBUG, "madvise(MADV_HUGEPAGE) failed for read buffer %p: %s", buf, strerror(errno));
+    }
+#endif
+    return buf;
+}
+
+hash_buffers *hash_buffers_init(void) {
+    hash_buffers *buffers = checked_malloc(sizeof(hash_buffers)); /* freed in hash_buffers_free */
+    buffers->small = checked_malloc(SMALL_READ_BLOCK_SIZE);
+    /* large buffer is allocated on first use */
+    buffers->large = NULL;
+    return buffers;
+}
+
+void hash_buffers_free(hash_buffers *buffers) {
+    if (buffers) {
+        free(buffers->small);
+        free(buffers->large);
+        free(buffers);
+    }
+}
+
+md_hashsums calc_hashsums(disk_entry *entry, DB_ATTR_TYPE attr, ssize_t limit_size, bool uncompress, hash_buffers *buffers, int worker_index, const char *whoami) {
     md_hashsums md_hash;
     md_hash.attrs = 0LU;
 
@@ -215,20 +467,64 @@ md_hashsums calc_hashsums(disk_entry *entry, DB_ATTR_TYPE attr, ssize_t limit_si
 
     off_t r_size=0;
     off_t size=0;
-    char* buf;
+    char* buf = NULL;
+    size_t buf_size;
 
     struct md_container mdc;
     mdc.todo_attr = attr;
     if (init_md(&mdc, entry->filename, whoami)==RETOK) {
         LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> calculate hashes", entry->filename);
-        buf=checked_malloc(READ_BLOCK_SIZE);
-#if READ_BLOCK_SIZE>SSIZE_MAX
-#error "READ_BLOCK_SIZE" is too large. Max value is SSIZE_MAX, and current is READ_BLOCK_SIZE
+        if (conf->parallel_hashsums_threshold > 0 && entry->fs.st_size >= conf->parallel_hashsums_threshold) {
+            init_md_parallel(&mdc, entry->filename, whoami);
+        }
+#ifdef HAVE_BLAKE3_HASHER_UPDATE_TBB
+        if (mdc.calc_attr&ATTR(attr_blake3) && conf->parallel_blake3_threshold > 0 && entry->fs.st_size >= conf->parallel_blake3_threshold) {
+            LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> use multithreaded BLAKE3", entry->filename);
+            mdc.blake3_parallel = true;
+        }
 #endif
         if (worker_index) {
             update_progress_worker_progress(worker_index, 0);
         }
-        while ((size = hashsum_read(file,buf,READ_BLOCK_SIZE)) > 0) {
+        /* compressed files are read until EOF, so the stat size is not an upper bound */
+        if (!uncompress && entry->fs.st_size < SMALL_READ_BLOCK_SIZE) {
+            buf_size = SMALL_READ_BLOCK_SIZE;
+            buf = buffers ? buffers->small : checked_malloc(buf_size);
+        } else {
+            buf_size = READ_BLOCK_SIZE;
+            if (buffers) {
+                if (buffers->large == NULL) {
+                    buffers->large = alloc_large_read_buffer(); /* freed in hash_buffers_free */
+                }
+                buf = buffers->large;
+            } else {
+                buf = alloc_large_read_buffer();
+            }
+        }
+        LOG_WHOAMI(LOG_LEVEL_TRACE, "%s> use %s read buffer %p (%zu bytes)", entry->filename, buffers ? "pooled" : "temporary", (void*) buf, buf_size);
+#if READ_BLOCK_SIZE>SSIZE_MAX
+#error "READ_BLOCK_SIZE" is too large. Max value is SSIZE_MAX, and current is READ_BLOCK_SIZE
+#endif
+#ifdef WITH_LIBURING
+        struct io_uring *ring = NULL;
+        if (conf->hash_io_engine == HASH_IO_ENGINE_URING && file.compression == COMPRESSION_PLAIN && buf_size == READ_BLOCK_SIZE) {
+            ring = get_uring(whoami);
+        }
+        if (ring) {
+            LOG_WHOAMI(LOG_LEVEL_TRACE, "%s> read file content using io_uring", entry->filename);
+            size = uring_update_md(ring, entry, &mdc, buf, limit_size > 0 ? limit_size : entry->fs.st_size, worker_index, &r_size);
+            if (size == -2) {
+                log_msg(LOG_LEVEL_WARNING, "hash calculation: update_md() failed for '%s' (hashsums could not be calculated)", entry->filename);
+                if (buffers == NULL) {
+                    free(buf);
+                }
+                hashsum_close(file);
+                close_md(&mdc, NULL, entry->filename, whoami);
+                return md_hash;
+            }
+        } else {
+#endif
+        while ((size = hashsum_read(file,buf,buf_size)) > 0) {
 
             off_t update_md_size;
             if (limit_size > 0 && r_size+size > limit_size) {
@@ -242,7 +538,9 @@ md_hashsums calc_hashsums(disk_entry *entry, DB_ATTR_TYPE attr, ssize_t limit_si
 
             if (update_md(&mdc,buf,update_md_size)!=RETOK) {
                 log_msg(LOG_LEVEL_WARNING, "hash calculation: update_md() failed for '%s' (hashsums could not be calculated)", entry->filename);
-                free(buf);
+                if (buffers == NULL) {
+                    free(buf);
+                }
                 hashsum_close(file);
                 close_md(&mdc, NULL, entry->filename, whoami);
                 return md_hash;
@@ -260,10 +558,15 @@ md_hashsums calc_hashsums(disk_entry *entry, DB_ATTR_TYPE attr, ssize_t limit_si
                 }
             }
         }
+#ifdef WITH_LIBURING
+        }
+#endif
+        if (buffers == NULL) {
+            free(buf);
+        }
         if (worker_index) {
             update_progress_worker_progress(worker_index, 0);
         }
-        free(buf);
         hashsum_close(file);
         if (size == -1) {
             log_msg(LOG_LEVEL_WARNING, "hash calculation: failed to read file content of '%s': %s (hashsums could not be calculated)", entry->filename, strerror(errno));
@@ -281,7 +584,7 @@ md_hashsums calc_hashsums(disk_entry *entry, DB_ATTR_TYPE attr, ssize_t limit_si
             new_fs.st_rdev=0;
         }
         int stat_diff;
-        if ((stat_diff = stat_cmp(&new_fs, &entry->fs, attr&ATTR(attr_growing))) != RETOK) {
+        if ((stat_diff = stat_cmp(&new_fs, &entry->fs, attr&ATTR(attr_growing))&entry->stat_attrs) != RETOK) {
             DB_ATTR_TYPE changed_attribures = 0ULL;
             for(ATTRIBUTE i=0;i<num_attrs;i++) {
                 if (((1LLU<<i)&stat_diff)!=0) {
@@ -47,19 +47,41 @@
 #include "db_line.h"
 #include "db_config.h"
 #include "db_disk.h"
+#include "db_file.h"
+#include "db_binary.h"
 #include "do_md.h"
+#include "errorcodes.h"
 #include "log.h"
 #include "progress.h"
+#include "shard.h"
 #include "util.h"
 /*for locale support*/
 #include "locale-aide.h"
 /*for locale support*/
 
-void hsymlnk(db_line* line);
+void hsymlnk(db_line* line, int, const char *);
 void fs2db_line(struct stat* fs,db_line* line);
 
 LOG_LEVEL compare_log_level = LOG_LEVEL_COMPARE;
 
+/*
+ * State of the thread reading database_in concurrently to the file system
+ * scan (see populate_tree())
+ */
+static bool old_entries_concurrent = false;
+static bool old_entries_reading = false;
+static bool old_entries_ordered = true;
+static char *old_entries_last = NULL; /* path of the last old entry added to the tree */
+static int old_entries_waiting = 0;
+static pthread_mutex_t old_entries_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t old_entries_cond = PTHREAD_COND_INITIALIZER;
+
+/* new entries to be checked for being moved in after the old database has been read */
+static seltree **deferred_nodes = NULL;
+static size_t num_deferred_nodes = 0;
+static size_t deferred_nodes_size = 0;
+static pthread_mutex_t deferred_nodes_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static int bytecmp(byte *b1, byte *b2, size_t len) {
   return strncmp((char *)b1, (char *)b2, len);
 }
@@ -239,13 +261,15 @@ static DB_ATTR_TYPE get_changed_attributes(db_line* l1,db_line* l2, DB_ATTR_TYPE
             LOG_WHOAMI(compare_log_level, "│ old:'%s' and new:'%s' have CHANGED hashsum(s): %s", l1->filename, l2->filename, str);
             free(str);
             if (l1->attr&ATTR(attr_growing)) {
-                if (conf->action&DO_COMPARE) {
+                if (conf->action&DO_COMPARE && entry == NULL) {
+                    LOG_WHOAMI(compare_log_level, "┝ old:'%s' has growing attribute set, but skip hashsum calculation (file is not opened)", l1->filename);
+                } else if (conf->action&DO_COMPARE) {
                     if(l1->size < l2->size) {
                         if (l1->size) {
                             LOG_WHOAMI(compare_log_level, "┝ old:'%s' has growing attribute set, check for growing hashsums", l1->filename);
                             LOG_WHOAMI(compare_log_level, "│ compare hashsums of old:'%s' and new:'%s' (limited to old size %lld)", l1->filename, l2->filename, l1->size);
                             DB_ATTR_TYPE transition_hashsums = get_transition_hashsums(l1->filename, l1->attr, l2->filename, l2->attr);
-                            md_hashsums hs = calc_hashsums(entry, l2->attr|transition_hashsums, l1->size, false, 0, whoami);
+                            md_hashsums hs = calc_hashsums(entry, l2->attr|transition_hashsums, l1->size, false, NULL, 0, whoami);
 
                             byte* new_hashsums[num_hashes];
                             copy_hashsums(l2->fullpath, &hs, &new_hashsums, whoami);
@@ -363,7 +387,7 @@ void print_match(file_t file, match_t match) {
 #endif
     rx_rule *rule = match.rule;
     char *filename_safe = stresc(file.name);
-    char *limit_safe = conf->limit?stresc(conf->limit):NULL;
+    char *limit_safe = conf->limit?stresc(conf->limit):conf->shard?stresc(conf->shard):NULL;
     switch (match.result) {
         case RESULT_SELECTIVE_MATCH:
         case RESULT_EQUAL_MATCH:
@@ -408,6 +432,133 @@ void print_match(file_t file, match_t match) {
     free(limit_safe);
 }
 
+/*
+ * Whether the reader of the old database has added the entry of path (or all
+ * entries below path if subtree is true) to the tree
+ *
+ * old_entries_mutex has to be locked
+ */
+static bool old_entries_passed(const char *path, bool subtree) {
+    if (!old_entries_reading) {
+        return true;
+    }
+    if (!old_entries_ordered || old_entries_last == NULL) {
+        return false;
+    }
+    int cmp = db_path_cmp(old_entries_last, path);
+    if (!subtree) {
+        return cmp >= 0;
+    }
+    size_t len = strlen(path);
+    if (len == 1) { /* every entry is below '/' */
+        return false;
+    }
+    return cmp > 0 && !(strncmp(old_entries_last, path, len) == 0 && old_entries_last[len] == '/');
+}
+
+static bool old_entries_read(const char *path, bool subtree) {
+    pthread_mutex_lock(&old_entries_mutex);
+    bool passed = old_entries_passed(path, subtree);
+    pthread_mutex_unlock(&old_entries_mutex);
+    return passed;
+}
+
+void wait_for_old_entries(const char *path, bool subtree, const char *whoami) {
+    if (!old_entries_concurrent) {
+        return;
+    }
+    pthread_mutex_lock(&old_entries_mutex);
+    if (!old_entries_passed(path, subtree)) {
+        log_msg(LOG_LEVEL_THREAD, "%10s: wait for old database entries of '%s'%s", whoami ? whoami : "(main)", path, subtree ? " (and below)" : "");
+        old_entries_waiting++;
+        while (!old_entries_passed(path, subtree)) {
+            pthread_cond_wait(&old_entries_cond, &old_entries_mutex);
+        }
+        old_entries_waiting--;
+    }
+    pthread_mutex_unlock(&old_entries_mutex);
+}
+
+static void defer_moved_in_check(seltree *node, const char *whoami) {
+    pthread_mutex_lock(&deferred_nodes_mutex);
+    if (num_deferred_nodes == deferred_nodes_size) {
+        deferred_nodes_size = deferred_nodes_size ? 2 * deferred_nodes_size : 64;
+        deferred_nodes = checked_realloc(deferred_nodes, deferred_nodes_size * sizeof(seltree *)); /* freed in populate_tree() */
+    }
+    deferred_nodes[num_deferred_nodes++] = node;
+    pthread_mutex_unlock(&deferred_nodes_mutex);
+    LOG_WHOAMI(compare_log_level, "│ defer search for source file of '%s' (old entries of '%s' not read yet)", node->path, (node->parent)->path);
+}
+
+/*
+ * Searches the siblings of a new entry for an old entry with check inode
+ * attribute set and the same inode (i.e. the source of a moved file)
+ *
+ * Returns true if the new entry has been accepted as moved in
+ */
+static bool check_moved_in_by_inode(seltree *node, disk_entry *entry, const char *whoami) {
+  DB_ATTR_TYPE default_move_ignored_attr = ATTR(attr_allownewfile)|ATTR(attr_allowrmfile)|ATTR(attr_checkinode)|ATTR(attr_compressed)|ATTR(attr_growing);
+  pthread_rwlock_rdlock(&node->rwlock);
+  /* a node completed as unchanged by an old entry read concurrently has not been moved in */
+  db_line *new_file = node->checked&NODE_FREE ? NULL : node->new_data;
+  pthread_rwlock_unlock(&node->rwlock);
+
+  pthread_rwlock_rdlock(&(node->parent)->rwlock);
+  if( (node->parent)->checked&NODE_CHECK_INODE && new_file != NULL ) {
+      LOG_WHOAMI(compare_log_level, "┝ parent directory (%s) of '%s' (inode: %li) has entries with check inode attribute set, search for source file with same inode", (node->parent)->path, new_file->filename, new_file->inode);
+      seltree* moved_node = NULL;
+      for(tree_node *x = tree_walk_first((node->parent)->children); x != NULL ; x = tree_walk_next(x)) {
+          moved_node = tree_get_data(x);
+          if (moved_node != node) {
+              pthread_rwlock_rdlock(&moved_node->rwlock);
+              if (moved_node->old_data != NULL && (moved_node->old_data)->attr & ATTR(attr_checkinode)) {
+                  if ((moved_node->old_data)->inode == new_file->inode) {
+                      pthread_rwlock_unlock(&moved_node->rwlock);
+                      break;
+                  } else {
+                      LOG_WHOAMI(LOG_LEVEL_DEBUG, "│ '%s' has check inode attribute set but different inode", (moved_node->old_data)->filename);
+                  }
+              }
+              pthread_rwlock_unlock(&moved_node->rwlock);
+          }
+          moved_node = NULL;
+      }
+     if(moved_node != NULL) {
+         pthread_rwlock_wrlock(&moved_node->rwlock);
+         pthread_rwlock_wrlock(&node->rwlock);
+          db_line *newData = new_file;
+          db_line *oldData = moved_node->old_data;
+        if (!(moved_node->checked&NODE_MOVED_OUT)) {
+          LOG_WHOAMI(compare_log_level, "│ found old:'%s' with check inode attribute set and same inode as file new:'%s'", oldData->filename, newData->filename);
+          LOG_WHOAMI(compare_log_level, "│ compare attributes of source file old:'%s' and target file new:'%s'", oldData->filename, newData->filename);
+          DB_ATTR_TYPE move_ignored_attr = default_move_ignored_attr | get_hashsums_to_ignore(oldData->filename, oldData->attr, newData->filename, newData->attr);
+          if (get_different_attributes(oldData, newData, move_ignored_attr, whoami)) {
+              LOG_WHOAMI(compare_log_level, "│ ignore old:'%s' as source file of target file new:'%s' (due to different attributes)", oldData->filename, newData->filename);
+          } else if (get_changed_attributes(oldData, newData, ATTR(attr_ctime), entry, true, whoami) == RETOK) {
+              node->checked |= NODE_MOVED_IN;
+              moved_node->checked |= NODE_MOVED_OUT;
+              LOG_WHOAMI(compare_log_level, "│ accept old:'%s' as source file of target file new:'%s'", oldData->filename, newData->filename);
+              LOG_WHOAMI(compare_log_level, "┴ finished '%s'", node->path);
+              pthread_rwlock_unlock(&node->rwlock);
+              pthread_rwlock_unlock(&moved_node->rwlock);
+              pthread_rwlock_unlock(&(node->parent)->rwlock);
+              return true;
+          } else {
+              LOG_WHOAMI(compare_log_level, "│ ignore old:'%s' as source file of target file new:'%s' (due to changed attributes)", oldData->filename, newData->filename);
+          }
+        } else {
+              LOG_WHOAMI(compare_log_level, "│ '%s' has been already moved out", oldData->filename);
+        }
+        pthread_rwlock_unlock(&node->rwlock);
+        pthread_rwlock_unlock(&moved_node->rwlock);
+      } else {
+          LOG_WHOAMI(compare_log_level, "│ no source file found for target file '%s'", new_file->filename);
+      }
+  }
+  pthread_rwlock_unlock(&(node->parent)->rwlock);
+  return false;
+}
+
 /*
  * add_file_to_tree
  */
@@ -435,7 +586,9 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
 
   switch (db_flags) {
   case DB_OLD: {
-    update_progress_status(PROGRESS_OLDDB, file->filename);
+    if (!old_entries_concurrent) {
+        update_progress_status(PROGRESS_OLDDB, file->filename);
+    }
     LOG_WHOAMI(add_entry_log_level, "add old database entry '%s' (%c) to node '%s' (%p) as old data", file->filename, get_f_type_char_from_perm(file->perm), node->path, (void*) node);
     node->old_data=file;
     break;
@@ -461,6 +614,8 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
     return;
   }
   }
+  /* the entry completing the node (old or new) does the comparison */
+  bool complete = (node->checked&DB_OLD) && (node->checked&DB_NEW);
   pthread_rwlock_unlock(&node->rwlock);
 
     if (conf->action&(DO_COMPARE|DO_DIFF)) {
@@ -471,7 +626,7 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
       }
 
     pthread_rwlock_wrlock(&node->rwlock);
-        if((node->checked&DB_OLD)&&(node->checked&DB_NEW)){
+        if(complete){
     LOG_WHOAMI(compare_log_level, "┝ compare attributes of '%s'", node->path);
     get_different_attributes(node->old_data,node->new_data, 0, whoami);
     node->changed_attrs=get_changed_attributes(node->old_data,node->new_data, 0, entry, true, whoami);
@@ -505,18 +660,29 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
 
   DB_ATTR_TYPE default_move_ignored_attr = ATTR(attr_allownewfile)|ATTR(attr_allowrmfile)|ATTR(attr_checkinode)|ATTR(attr_compressed)|ATTR(attr_growing);
   if (db_flags&DB_NEW) {
+      /* an old entry read concurrently may complete the node meanwhile (and free the new data if unchanged) */
       pthread_rwlock_rdlock(&node->rwlock);
-      db_line *new_file = node->new_data;
+      DB_ATTR_TYPE new_attrs = node->new_data ? (node->new_data)->attr : 0;
       pthread_rwlock_unlock(&node->rwlock);
-      if (new_file->attr&ATTR(attr_compressed)) {
+      if (new_attrs&ATTR(attr_compressed)) {
           DB_ATTR_TYPE available_hashsums = get_hashes(false);
-          if (new_file->attr&available_hashsums) {
+          if (new_attrs&available_hashsums) {
               if (conf->action&DO_COMPARE) {
-                  LOG_WHOAMI(compare_log_level, "┝ '%s' has compressed attribute set, calculate uncompressed hashsums", new_file->filename);
+                  LOG_WHOAMI(compare_log_level, "┝ '%s' has compressed attribute set, calculate uncompressed hashsums", node->path);
 
                   seltree *moved_node = NULL;
 
-                  md_hashsums hs = calc_hashsums(entry, new_file->attr, -1, true, 0, whoami);
+                  wait_for_old_entries((node->parent)->path, true, whoami);
+
+                  pthread_rwlock_rdlock(&node->rwlock);
+                  db_line *new_file = node->checked&NODE_FREE ? NULL : node->new_data;
+                  pthread_rwlock_unlock(&node->rwlock);
+                  if (new_file == NULL) {
+                      LOG_WHOAMI(compare_log_level, "┴ finished '%s' (unchanged)", node->path);
+                      return;
+                  }
+
+                  md_hashsums hs = calc_hashsums(entry, new_file->attr, -1, true, NULL, 0, whoami);
                   if (hs.attrs) {
                       byte* new_hashsums[num_hashes];
                       copy_hashsums(new_file->fullpath, &hs, &new_hashsums, whoami);
@@ -590,10 +756,10 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
                       LOG_WHOAMI(compare_log_level, "│ calculation of uncompressed hashsums for comprressed file new:'%s' FAILED", new_file->filename);
                   }
               } else {
-                  LOG_WHOAMI(compare_log_level, "┝ new:'%s' has compressed attribute set, but skip hashsum calculation (NOT supported in dataase compare mode)", new_file->filename);
+                  LOG_WHOAMI(compare_log_level, "┝ new:'%s' has compressed attribute set, but skip hashsum calculation (NOT supported in dataase compare mode)", node->path);
               }
           } else {
-              LOG_WHOAMI(compare_log_level, "┝ new:'%s' has compressed attribute set, but skip hashsum calculation (file has no hashsums set)", new_file->filename);
+              LOG_WHOAMI(compare_log_level, "┝ new:'%s' has compressed attribute set, but skip hashsum calculation (file has no hashsums set)", node->path);
           }
       }
   }
@@ -607,63 +773,11 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
           }
           pthread_rwlock_unlock(&(node->parent)->rwlock);
       } else {
-            pthread_rwlock_rdlock(&node->rwlock);
-            db_line *new_file = node->new_data;
-            pthread_rwlock_unlock(&node->rwlock);
-
-            pthread_rwlock_rdlock(&(node->parent)->rwlock);
-          if( (node->parent)->checked&NODE_CHECK_INODE && new_file != NULL ) {
-              LOG_WHOAMI(compare_log_level, "┝ parent directory (%s) of '%s' (inode: %li) has entries with check inode attribute set, search for source file with same inode", (node->parent)->path, new_file->filename, new_file->inode);
-              seltree* moved_node = NULL;
-              for(tree_node *x = tree_walk_first((node->parent)->children); x != NULL ; x = tree_walk_next(x)) {
-                  moved_node = tree_get_data(x);
-                  if (moved_node != node) {
-                      pthread_rwlock_rdlock(&moved_node->rwlock);
-                      if (moved_node->old_data != NULL && (moved_node->old_data)->attr & ATTR(attr_checkinode)) {
-                          if ((moved_node->old_data)->inode == new_file->inode) {
-                              pthread_rwlock_unlock(&moved_node->rwlock);
-                              break;
-                          } else {
-                              LOG_WHOAMI(LOG_LEVEL_DEBUG, "│ '%s' has check inode attribute set but different inode", (moved_node->old_data)->filename);
-                          }
-                      }
-                      pthread_rwlock_unlock(&moved_node->rwlock);
-                  }
-                  moved_node = NULL;
-              }
-             if(moved_node != NULL) {
-                 pthread_rwlock_wrlock(&moved_node->rwlock);
-                 pthread_rwlock_wrlock(&node->rwlock);
-                  db_line *newData = new_file;
-                  db_line *oldData = moved_node->old_data;
-                if (!(moved_node->checked&NODE_MOVED_OUT)) {
-                  LOG_WHOAMI(compare_log_level, "│ found old:'%s' with check inode attribute set and same inode as file new:'%s'", oldData->filename, newData->filename);
-                  LOG_WHOAMI(compare_log_level, "│ compare attributes of source file old:'%s' and target file new:'%s'", oldData->filename, newData->filename);
-                  DB_ATTR_TYPE move_ignored_attr = default_move_ignored_attr | get_hashsums_to_ignore(oldData->filename, oldData->attr, newData->filename, newData->attr);
-                  if (get_different_attributes(oldData, newData, move_ignored_attr, whoami)) {
-                      LOG_WHOAMI(compare_log_level, "│ ignore old:'%s' as source file of target file new:'%s' (due to different attributes)", oldData->filename, newData->filename);
-                  } else if (get_changed_attributes(oldData, newData, ATTR(attr_ctime), entry, true, whoami) == RETOK) {
-                      node->checked |= NODE_MOVED_IN;
-                      moved_node->checked |= NODE_MOVED_OUT;
-                      LOG_WHOAMI(compare_log_level, "│ accept old:'%s' as source file of target file new:'%s'", oldData->filename, newData->filename);
-                      LOG_WHOAMI(compare_log_level, "┴ finished '%s'", node->path);
-                      pthread_rwlock_unlock(&node->rwlock);
-                      pthread_rwlock_unlock(&moved_node->rwlock);
-                      pthread_rwlock_unlock(&(node->parent)->rwlock);
-                      return;
-                  } else {
-                      LOG_WHOAMI(compare_log_level, "│ ignore old:'%s' as source file of target file new:'%s' (due to changed attributes)", oldData->filename, newData->filename);
-                  }
-                } else {
-                      LOG_WHOAMI(compare_log_level, "│ '%s' has been already moved out", oldData->filename);
-                }
-                pthread_rwlock_unlock(&node->rwlock);
-                pthread_rwlock_unlock(&moved_node->rwlock);
-              } else {
-                  LOG_WHOAMI(compare_log_level, "│ no source file found for target file '%s'", new_file->filename);
-              }
+          if (old_entries_concurrent && !old_entries_read((node->parent)->path, true)) {
+              defer_moved_in_check(node, whoami);
+          } else if (check_moved_in_by_inode(node, entry, whoami)) {
+              return;
           }
-          pthread_rwlock_unlock(&(node->parent)->rwlock);
       }
   }
 
@@ -689,11 +803,18 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
 }
 
 match_result check_limit(char* filename, bool log_partial_match, const char *whoami) {
+    match_result shard_result = 0;
+    if (conf->shard_plan != NULL) {
+        shard_result = shard_check(conf->shard_plan, filename);
+        if (shard_result == RESULT_NO_LIMIT_MATCH) {
+            LOG_WHOAMI(LOG_LEVEL_LIMIT, "skip '%s' (reason: not in shard, shard: '%s')", filename, conf->shard);
+            return RESULT_NO_LIMIT_MATCH;
+        }
+    }
     if(conf->limit!=NULL) {
-        int match=pcre2_match(conf->limit_crx, (PCRE2_SPTR) filename, PCRE2_ZERO_TERMINATED, 0, PCRE2_PARTIAL_SOFT, conf->limit_md, NULL);
+        int match=pcre2_match(conf->limit_crx, (PCRE2_SPTR) filename, PCRE2_ZERO_TERMINATED, 0, PCRE2_PARTIAL_SOFT, get_thread_match_data(), NULL);
         if (match >= 0) {
             LOG_WHOAMI(LOG_LEVEL_TRACE, "'%s' does match limit '%s'", filename, conf->limit);
-            return 0;
         } else if (match == PCRE2_ERROR_PARTIAL) {
             if (log_partial_match) {
                 LOG_WHOAMI(LOG_LEVEL_LIMIT, "skip '%s' (reason: partial limit match, limit: '%s')", filename, conf->limit);
@@ -704,7 +825,10 @@ match_result check_limit(char* filename, bool log_partial_match, const char *who
             return RESULT_NO_LIMIT_MATCH;
         }
     }
-    return 0;
+    if (shard_result == RESULT_PARTIAL_LIMIT_MATCH && log_partial_match) {
+        LOG_WHOAMI(LOG_LEVEL_LIMIT, "skip '%s' (reason: parent directory of shard, shard: '%s')", filename, conf->shard);
+    }
+    return shard_result;
 }
 
 match_t check_rxtree(file_t file, seltree* tree, char* source, bool check_parent_dirs, const char *whoami) {
@@ -712,7 +836,7 @@ match_t check_rxtree(file_t file, seltree* tree, char* source, bool check_parent
   match_t match;
   if (limit_result) {
       if (limit_result == RESULT_PARTIAL_LIMIT_MATCH && file.type&FT_DIR) {
-        LOG_WHOAMI(LOG_LEVEL_RULE, "\u252c partial limit match (limit: '%s') for directory '%s', check for no-recurse match", conf->limit, file.name);
+        LOG_WHOAMI(LOG_LEVEL_RULE, "\u252c partial limit match (limit: '%s', shard: '%s') for directory '%s', check for no-recurse match", conf->limit?conf->limit:"(none)", conf->shard?conf->shard:"(none)", file.name);
         match = check_seltree(tree, file, check_parent_dirs, whoami);
         if (match.result == RESULT_NON_RECURSIVE_NEGATIVE_MATCH || match.result == RESULT_NO_RULE_MATCH) {
             match.result = RESULT_PART_LIMIT_AND_NO_RECURSE_MATCH;
@@ -747,7 +871,7 @@ match_t check_rxtree(file_t file, seltree* tree, char* source, bool check_parent
   return match;
 }
 
-db_line* get_file_attrs(disk_entry *file, DB_ATTR_TYPE attrs, DB_ATTR_TYPE extra_hashsums, int worker_index, const char *whoami) {
+db_line* get_file_attrs(disk_entry *file, DB_ATTR_TYPE attrs, DB_ATTR_TYPE extra_hashsums, const db_line *hashsums_line, hash_buffers *buffers, int worker_index, const char *whoami) {
   LOG_WHOAMI(LOG_LEVEL_DEBUG, "get file attributes '%s' (fullpath: '%s')", &file->filename[conf->root_prefix_length], file->filename);
   db_line* line=NULL;
   time_t cur_time;
@@ -801,7 +925,7 @@ db_line* get_file_attrs(disk_entry *file, DB_ATTR_TYPE attrs, DB_ATTR_TYPE extra
     Handle symbolic link
   */
   
-  hsymlnk(line);
+  hsymlnk(line, file->dirfd, file->name);
   
   /*
     Set normal part
@@ -834,8 +958,21 @@ db_line* get_file_attrs(disk_entry *file, DB_ATTR_TYPE attrs, DB_ATTR_TYPE extra
 #endif
 
   DB_ATTR_TYPE all_hashsums = get_hashes(true);
-  if (line->attr&all_hashsums) {
-    md_hashsums hs = calc_hashsums(file, line->attr|extra_hashsums, -1, false, worker_index, whoami);
+  if (line->attr&all_hashsums && hashsums_line) {
+    /* stat identity is unchanged, take the hashsums from the old database */
+    md_hashsums hs = { .attrs = line->attr&get_hashes(false) };
+    for (int i = 0 ; i < num_hashes ; ++i) {
+        if (hs.attrs&ATTR(hashsums[i].attribute) && hashsums_line->hashsums[i]) {
+            memcpy(hs.hashsums[i], hashsums_line->hashsums[i], hashsums[i].length);
+        } else {
+            hs.attrs &= ~ATTR(hashsums[i].attribute);
+        }
+    }
+    hashsums2line(&hs, line, whoami);
+    line->reused_hashsums = hs.attrs;
+    hardlink_hashsums_reused(file);
+  } else if (line->attr&all_hashsums) {
+    md_hashsums hs = calc_hashsums_hardlinked(file, line->attr|extra_hashsums, buffers, worker_index, whoami);
     if (hs.attrs) {
         hashsums2line(&hs,line, whoami);
     } else {
@@ -846,53 +983,397 @@ db_line* get_file_attrs(disk_entry *file, DB_ATTR_TYPE attrs, DB_ATTR_TYPE extra
   return line;
 }
 
-void write_tree(seltree* node) {
+static void free_written_line(seltree* node) {
+    if (node->checked&NODE_FREE) {
+        free_db_line(node->new_data);
+        free(node->new_data);
+        node->new_data=NULL;
+    }
+}
+
+static void write_tree_sequential(seltree* node) {
     pthread_rwlock_rdlock(&node->rwlock);
     if (node->checked&DB_NEW) {
         update_progress_status(PROGRESS_WRITEDB, (node->new_data)->filename);
         db_writeline(node->new_data,conf);
-        if (node->checked&NODE_FREE) {
-            free_db_line(node->new_data);
-            free(node->new_data);
-            node->new_data=NULL;
+        free_written_line(node);
+    }
+    for(tree_node *n = tree_walk_first(node->children); n != NULL ; n = tree_walk_next(n)) {
+        write_tree_sequential(tree_get_data(n));
+    }
+    pthread_rwlock_unlock(&node->rwlock);
+}
+
+/*
+ * Writes the added and changed entries and the paths of the removed entries
+ * only (see db_delta.h), the unchanged entries are kept in the base database
+ */
+static void write_tree_delta(seltree* node) {
+    pthread_rwlock_rdlock(&node->rwlock);
+    if (node->checked&DB_NEW) {
+        /* NODE_FREE is set for unchanged entries and entries outside of the limit */
+        if (!(node->checked&NODE_FREE)) {
+            update_progress_status(PROGRESS_WRITEDB, (node->new_data)->filename);
+            db_writeline(node->new_data,conf);
         }
+        free_written_line(node);
+    } else if (node->checked&DB_OLD) {
+        log_msg(LOG_LEVEL_DEBUG, "write removed entry '%s' to delta database", (node->old_data)->filename);
+        db_writeremoved(node->old_data,conf);
     }
     for(tree_node *n = tree_walk_first(node->children); n != NULL ; n = tree_walk_next(n)) {
-        write_tree(tree_get_data(n));
+        write_tree_delta(tree_get_data(n));
     }
     pthread_rwlock_unlock(&node->rwlock);
 }
 
-void populate_tree(seltree* tree) {
+/*
+ * Parallel formatting of the new database (text format)
+ *
+ * The nodes to be written are collected in tree order and split into chunks
+ * of consecutive nodes (i.e. subtrees). The chunks are formatted by
+ * num_workers threads into separate buffers, which are written in tree order
+ * by the main thread, so the database is the same as if written sequentially.
+ */
+
+#define WRITE_CHUNK_LINES 4096
+
+typedef struct write_chunk {
+    char *data;
+    size_t len;
+    bool formatted;
+} write_chunk;
+
+typedef struct write_state {
+    seltree **nodes;
+    db_line **lines;
+    size_t num_nodes;
+    size_t nodes_size;
+
+    write_chunk *chunks;
+    size_t num_chunks;
+    size_t next_chunk; /* next chunk to be formatted */
+    size_t next_write; /* next chunk to be written */
+    long num_threads;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} write_state;
+
+static void collect_new_lines(seltree* node, write_state *state) {
+    pthread_rwlock_rdlock(&node->rwlock);
+    if (node->checked&DB_NEW) {
+        if (state->num_nodes == state->nodes_size) {
+            state->nodes_size = state->nodes_size ? 2 * state->nodes_size : 1024;
+            state->nodes = checked_realloc(state->nodes, state->nodes_size * sizeof(seltree*)); /* freed in write_tree() */
+            state->lines = checked_realloc(state->lines, state->nodes_size * sizeof(db_line*)); /* freed in write_tree() */
+        }
+        state->nodes[state->num_nodes] = node;
+        state->lines[state->num_nodes] = node->new_data;
+        state->num_nodes++;
+    }
+    for(tree_node *n = tree_walk_first(node->children); n != NULL ; n = tree_walk_next(n)) {
+        collect_new_lines(tree_get_data(n), state);
+    }
+    pthread_rwlock_unlock(&node->rwlock);
+}
+
+static void *write_tree_formatter(void *arg) {
+    write_state *state = arg;
+    const char *whoami = "(write-db)";
+    mask_sig(whoami);
+    pthread_mutex_lock(&state->mutex);
+    while (state->next_chunk < state->num_chunks) {
+        /* do not format too far ahead of the writer */
+        if (state->next_chunk >= state->next_write + 2 * state->num_threads) {
+            pthread_cond_wait(&state->cond, &state->mutex);
+            continue;
+        }
+        size_t c = state->next_chunk++;
+        pthread_mutex_unlock(&state->mutex);
+
+        size_t first = c * WRITE_CHUNK_LINES;
+        size_t num = state->num_nodes - first < WRITE_CHUNK_LINES ? state->num_nodes - first : WRITE_CHUNK_LINES;
+        LOG_WHOAMI(LOG_LEVEL_THREAD, "format chunk #%zu (%zu lines)", c, num)
+        size_t len;
+        char *data = db_format_lines_file(&state->lines[first], num, &len); /* freed in write_tree() */
+
+        pthread_mutex_lock(&state->mutex);
+        state->chunks[c] = (write_chunk) { .data = data, .len = len, .formatted = true };
+        pthread_cond_broadcast(&state->cond);
+    }
+    pthread_mutex_unlock(&state->mutex);
+    return (void *) pthread_self();
+}
+
+void write_tree(seltree* node) {
+    if (conf->database_out_delta) {
+        write_tree_delta(node);
+        return;
+    }
+    if (conf->database_out.binary || conf->database_out.fp == NULL || conf->num_workers < 2) {
+        write_tree_sequential(node);
+        return;
+    }
+
+    write_state state = { .num_threads = conf->num_workers };
+    collect_new_lines(node, &state);
+    state.num_chunks = (state.num_nodes + WRITE_CHUNK_LINES - 1) / WRITE_CHUNK_LINES;
+    if (state.num_chunks < 2) {
+        free(state.nodes);
+        free(state.lines);
+        write_tree_sequential(node);
+        return;
+    }
+    if (state.num_threads > (long) state.num_chunks) {
+        state.num_threads = state.num_chunks;
+    }
+    state.chunks = checked_calloc(state.num_chunks, sizeof(write_chunk)); /* freed below */
+    pthread_mutex_init(&state.mutex, NULL);
+    pthread_cond_init(&state.cond, NULL);
+
+    log_msg(LOG_LEVEL_DEBUG, "format %zu database lines in %zu chunks with %ld threads", state.num_nodes, state.num_chunks, state.num_threads);
+
+    pthread_t *threads = checked_malloc(state.num_threads * sizeof(pthread_t)); /* freed below */
+    for (long i = 0 ; i < state.num_threads ; ++i) {
+        if (pthread_create(&threads[i], NULL, &write_tree_formatter, &state) != 0) {
+            log_msg(LOG_LEVEL_ERROR, "failed to start database formatter thread #%ld", i+1);
+            exit(THREAD_ERROR);
+        }
+    }
+
+    for (size_t c = 0 ; c < state.num_chunks ; ++c) {
+        pthread_mutex_lock(&state.mutex);
+        while (!state.chunks[c].formatted) {
+            pthread_cond_wait(&state.cond, &state.mutex);
+        }
+        pthread_mutex_unlock(&state.mutex);
+
+        size_t first = c * WRITE_CHUNK_LINES;
+        size_t last = first + WRITE_CHUNK_LINES < state.num_nodes ? first + WRITE_CHUNK_LINES : state.num_nodes;
+        update_progress_status(PROGRESS_WRITEDB, state.lines[last-1]->filename);
+        db_write_formatted_file(state.chunks[c].data, state.chunks[c].len, &state.lines[first], last - first);
+        free(state.chunks[c].data);
+        for (size_t i = first ; i < last ; ++i) {
+            free_written_line(state.nodes[i]);
+        }
+
+        pthread_mutex_lock(&state.mutex);
+        state.next_write = c + 1;
+        pthread_cond_broadcast(&state.cond);
+        pthread_mutex_unlock(&state.mutex);
+    }
+
+    for (long i = 0 ; i < state.num_threads ; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_cond_destroy(&state.cond);
+    pthread_mutex_destroy(&state.mutex);
+    free(state.chunks);
+    free(state.nodes);
+    free(state.lines);
+}
+
+/* publishes path (taken over) as the path of the last old entry read */
+static void old_entry_read(char *path) {
+    pthread_mutex_lock(&old_entries_mutex);
+    if (old_entries_ordered && old_entries_last && db_path_cmp(old_entries_last, path) > 0) {
+        log_msg(LOG_LEVEL_INFO, "old database is not sorted by path ('%s' after '%s'), entries depending on old entries wait for the complete old database",
+                path, old_entries_last);
+        old_entries_ordered = false;
+    }
+    free(old_entries_last);
+    old_entries_last = path;
+    if (old_entries_waiting) {
+        pthread_cond_broadcast(&old_entries_cond);
+    }
+    pthread_mutex_unlock(&old_entries_mutex);
+}
+
+static void start_old_entries(void) {
+    old_entries_concurrent = true;
+    old_entries_reading = true;
+    old_entries_ordered = true;
+}
+
+/* does the checks deferred until all old entries have been read */
+static void finish_old_entries(void) {
+    pthread_mutex_lock(&old_entries_mutex);
+    old_entries_reading = false;
+    pthread_cond_broadcast(&old_entries_cond);
+    pthread_mutex_unlock(&old_entries_mutex);
+
+    old_entries_concurrent = false;
+    free(old_entries_last);
+    old_entries_last = NULL;
+
+    log_msg(LOG_LEVEL_DEBUG, "search source files of %zu new entries read before the old entries of their directory", num_deferred_nodes);
+    for (size_t i = 0 ; i < num_deferred_nodes ; ++i) {
+        seltree *node = deferred_nodes[i];
+        pthread_rwlock_rdlock(&node->rwlock);
+        /* the old entry of the node has been read meanwhile (see add_file_to_tree()) */
+        bool completed = node->checked&(DB_OLD|NODE_FREE);
+        pthread_rwlock_unlock(&node->rwlock);
+        if (!completed) {
+            check_moved_in_by_inode(node, NULL, NULL);
+        }
+    }
+    free(deferred_nodes);
+    deferred_nodes = NULL;
+    num_deferred_nodes = deferred_nodes_size = 0;
+}
+
+static void read_old_entries(seltree* tree, const char *whoami) {
     db_entry_t entry;
+    while((entry = db_readline(&(conf->database_in), conf->action&DO_INIT)).line != NULL) {
+        char *path = old_entries_concurrent ? checked_strdup(entry.line->filename) : NULL; /* freed in old_entry_read() */
+        if (entry.limit) {
+            add_file_to_tree(tree,entry.line,DB_OLD|DB_NEW, &(conf->database_in), NULL, whoami);
+        } else {
+            add_file_to_tree(tree,entry.line,DB_OLD, &(conf->database_in), NULL, whoami);
+        }
+        if (path) {
+            old_entry_read(path);
+        }
+    }
+}
+
+/*
+ * Compares database_in and database_new (both sorted by path) in a single
+ * pass. Unchanged entries are freed right away, only entries which are
+ * added, removed or changed (or not in order) are added to the tree.
+ * The search for moved files is deferred until the old entries of the
+ * directory have been read (see add_file_to_tree()).
+ */
+static void compare_databases(seltree* tree) {
+    db_line *old = NULL;
+    db_line *new = NULL;
+    bool old_eof = false;
+    bool new_eof = false;
+    char *last_new = NULL;
+    bool new_ordered = true;
+
+    start_old_entries();
+    while (1) {
+        if (old == NULL && !old_eof) {
+            old_eof = (old = db_readline(&(conf->database_in), false).line) == NULL;
+        }
+        if (new == NULL && !new_eof) {
+            new_eof = (new = db_readline(&(conf->database_new), false).line) == NULL;
+            if (new) {
+                if (new_ordered && last_new && db_path_cmp(last_new, new->filename) > 0) {
+                    log_msg(LOG_LEVEL_INFO, "new database is not sorted by path ('%s' after '%s'), entries out of order are compared via the tree",
+                            new->filename, last_new);
+                    new_ordered = false;
+                }
+                free(last_new);
+                last_new = checked_strdup(new->filename); /* freed below */
+            }
+        }
+        if (old == NULL && new == NULL) {
+            break;
+        }
+        int cmp = old == NULL ? 1 : new == NULL ? -1 : db_path_cmp(old->filename, new->filename);
+        if (cmp == 0 && !(old->attr^new->attr)
+                && !((old->attr|new->attr)&(ATTR(attr_checkinode)|ATTR(attr_compressed)))
+                && get_changed_attributes(old, new, 0, NULL, true, NULL) == RETOK) {
+            log_msg(LOG_LEVEL_DEBUG, "'%s' is unchanged (free old and new data)", old->filename);
+            update_progress_status(PROGRESS_NEWDB, new->filename);
+            conf->num_unchanged_streamed++;
+            old_entry_read(checked_strdup(old->filename));
+            free_db_line(old);
+            free(old);
+            free_db_line(new);
+            free(new);
+            old = new = NULL;
+        } else {
+            if (cmp <= 0) {
+                char *path = checked_strdup(old->filename); /* freed in old_entry_read() */
+                add_file_to_tree(tree, old, DB_OLD, &(conf->database_in), NULL, NULL);
+                old_entry_read(path);
+                old = NULL;
+            }
+            if (cmp >= 0) {
+                add_file_to_tree(tree, new, DB_NEW, &(conf->database_new), NULL, NULL);
+                new = NULL;
+            }
+        }
+    }
+    free(last_new);
+    finish_old_entries();
+}
+
+static void * old_entries_reader(void *arg) {
+    const char *whoami = "(read-old)";
+    mask_sig(whoami);
+
+    read_old_entries((seltree *) arg, whoami);
+
+    pthread_mutex_lock(&old_entries_mutex);
+    old_entries_reading = false;
+    pthread_cond_broadcast(&old_entries_cond);
+    pthread_mutex_unlock(&old_entries_mutex);
+    log_msg(LOG_LEVEL_THREAD, "%10s: finished reading old database", whoami);
+    return (void *) pthread_self();
+}
+
+void populate_tree(seltree* tree) {
+    pthread_t old_entries_thread;
     if((conf->action&DO_COMPARE)||(conf->action&DO_DIFF)){
         update_progress_status(PROGRESS_OLDDB, NULL);
         log_msg(LOG_LEVEL_INFO, "read old entries from database: %s", (conf->database_in.url)->raw);
-            while((entry = db_readline(&(conf->database_in), conf->action&DO_INIT)).line != NULL) {
-                if (entry.limit) {
-                    add_file_to_tree(tree,entry.line,DB_OLD|DB_NEW, &(conf->database_in), NULL, NULL);
-                } else {
-                    add_file_to_tree(tree,entry.line,DB_OLD, &(conf->database_in), NULL, NULL);
-                }
+        if (conf->action&DO_DIFF) {
+            update_progress_status(PROGRESS_NEWDB, NULL);
+            log_msg(LOG_LEVEL_INFO, "read new entries from database: %s", (conf->database_new.url)->raw);
+            compare_databases(tree);
+        } else if (conf->database_in_concurrent) {
+            start_old_entries();
+            if (pthread_create(&old_entries_thread, NULL, &old_entries_reader, (void *) tree) != 0) {
+                log_msg(LOG_LEVEL_ERROR, "failed to start old database reader thread");
+                exit(THREAD_ERROR);
             }
+        } else {
+            read_old_entries(tree, NULL);
+        }
     }
-    if(conf->action&DO_DIFF){
-        update_progress_status(PROGRESS_NEWDB, NULL);
-        log_msg(LOG_LEVEL_INFO, "read new entries from database: %s", (conf->database_new.url)->raw);
-      while((entry = db_readline(&(conf->database_new), false)).line != NULL){
-          add_file_to_tree(tree,entry.line,DB_NEW, &(conf->database_new), NULL, NULL);
-      }
-    }
-
     if((conf->action&DO_INIT)||(conf->action&DO_COMPARE)){
       update_progress_status(PROGRESS_DISK, NULL);
-      log_msg(LOG_LEVEL_INFO, "read new entries from disk (limit: '%s', root prefix: '%s')", conf->limit?conf->limit:"(none)", conf->root_prefix);
+      log_msg(LOG_LEVEL_INFO, "read new entries from disk (limit: '%s', shard: '%s', root prefix: '%s')", conf->limit?conf->limit:"(none)", conf->shard?conf->shard:"(none)", conf->root_prefix);
 
       db_scan_disk(false);
     }
+
+    if (old_entries_concurrent) {
+        log_msg(LOG_LEVEL_THREAD, "%10s: wait for old database reader thread to be finished", "(main)");
+        if (pthread_join(old_entries_thread, NULL) != 0) {
+            log_msg(LOG_LEVEL_WARNING, "failed to join old database reader thread");
+        }
+        finish_old_entries();
+    }
+}
+
+/* reads all entries of database_in into the tree (see daemon.h) */
+void read_old_database(seltree* tree) {
+    log_msg(LOG_LEVEL_INFO, "read old entries from database: %s", (conf->database_in.url)->raw);
+    read_old_entries(tree, NULL);
+}
+
+/* removes the old entries not matching the limit from the tree (see daemon.h) */
+void limit_old_entries(seltree* node) {
+    if (node->checked&DB_OLD && check_limit((node->old_data)->filename, false, NULL) != 0) {
+        log_msg(LOG_LEVEL_LIMIT, "skip old entry '%s' (reason: no limit match, limit: '%s')", (node->old_data)->filename, conf->limit);
+        free_db_line(node->old_data);
+        free(node->old_data);
+        node->old_data = NULL;
+        node->checked &= ~DB_OLD;
+    }
+    for(tree_node *n = tree_walk_first(node->children); n != NULL ; n = tree_walk_next(n)) {
+        limit_old_entries(tree_get_data(n));
+    }
 }
 
-void hsymlnk(db_line* line) {
+void hsymlnk(db_line* line, int dirfd, const char *name) {
   
   line->linkname = NULL;
   if (line->attr&ATTR(attr_linkname)) {
@@ -907,7 +1388,7 @@ void hsymlnk(db_line* line) {
     if(conf->warn_dead_symlinks==1) {
       struct stat fs;
       int sres;
-      sres=stat(line->fullpath,&fs);
+      sres=fstatat(dirfd,name,&fs,0);
       if (sres!=0 && sres!=EACCES) {
 	log_msg(LOG_LEVEL_WARNING,"Dead symlink detected at %s",line->fullpath);
       }
@@ -933,9 +1414,9 @@ void hsymlnk(db_line* line) {
     */
     memset(line->linkname,0,_POSIX_PATH_MAX+1);
     
-    len=readlink(line->fullpath,line->linkname,_POSIX_PATH_MAX+1);
+    len=readlinkat(dirfd,name,line->linkname,_POSIX_PATH_MAX+1);
     if (len < 0) {
-        log_msg(LOG_LEVEL_WARNING, "readlink() failed for '%s': %s", line->fullpath, strerror(errno));
+        log_msg(LOG_LEVEL_WARNING, "readlinkat() failed for '%s': %s", line->fullpath, strerror(errno));
         line->attr&=(~ATTR(attr_linkname));
         free(line->linkname);
         line->linkname = NULL;
@@ -20,6 +20,9 @@
  */
 
 #include "config.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
@@ -80,6 +83,37 @@ nettle_fucntions_t nettle_functions[] = {  /* order must match hashsums array */
 };
 #endif
 
+typedef struct md_helper {
+    pthread_t thread;
+    struct md_parallel *parallel;
+    int index;
+    /* hashsums updated by this helper */
+    DB_ATTR_TYPE attrs;
+    bool gcrypt;
+    unsigned long generation;
+} md_helper;
+
+struct md_parallel {
+    struct md_container *md;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    /* current (read-only) data block shared by the helpers */
+    void *data;
+    ssize_t size;
+    unsigned long generation;
+    int busy;
+    bool stop;
+
+    /* hashsums updated by the calling thread */
+    DB_ATTR_TYPE attrs;
+    bool gcrypt;
+
+    int num_helpers;
+    md_helper *helpers;
+};
+
 /*
   Initialise md_container according its todo_attr field
  */
@@ -102,6 +136,7 @@ int init_md(struct md_container* md, const char *filename, const char *whoami) {
     We don't have calculator for this yet :)
   */
   md->calc_attr=0;
+  md->parallel=NULL;
    for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
        DB_ATTR_TYPE h = ATTR(hashsums[i].attribute);
        if (h&md->todo_attr) {
@@ -109,6 +144,7 @@ int init_md(struct md_container* md, const char *filename, const char *whoami) {
                 case hash_blake3:
 #ifdef WITH_BLAKE3
                     blake3_hasher_init(&md->blake3);
+                    md->blake3_parallel = false;
                     md->calc_attr |= h;
 #endif
                 break;
@@ -135,38 +171,195 @@ int init_md(struct md_container* md, const char *filename, const char *whoami) {
   return RETOK;
 }
 
-/*
-  update :)
-  Just call this when you have more data.
- */
-
-int update_md(struct md_container* md,void* data,ssize_t size) {
-
-#ifdef _PARAMETER_CHECK_
-  if (md==NULL||data==NULL) {
-    return RETFAIL;
-  }
-#endif
-
+static void update_md_attrs(struct md_container* md, DB_ATTR_TYPE attrs, __attribute__((unused)) bool gcrypt, void* data, ssize_t size) {
 #ifdef WITH_NETTLE
    for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
        DB_ATTR_TYPE h = ATTR(hashsums[i].attribute);
-       if (i != hash_blake3 && h&md->calc_attr) {
+       if (i != hash_blake3 && h&attrs) {
            nettle_functions[i].update(&md->ctx[i], size, data);
        }
    }
 #endif
 #ifdef WITH_GCRYPT
+   if (gcrypt) {
 	gcry_md_write(md->mdh, data, size);
+   }
 #endif
 #ifdef WITH_BLAKE3
-   if (ATTR(attr_blake3)&md->todo_attr) {
+   if (ATTR(attr_blake3)&attrs) {
+#ifdef HAVE_BLAKE3_HASHER_UPDATE_TBB
+       if (md->blake3_parallel) {
+           /* hashes the subtrees of the input concurrently */
+           blake3_hasher_update_tbb(&md->blake3, data, size);
+       } else
+#endif
        blake3_hasher_update(&md->blake3, data, size);
     }
 #endif
+}
+
+static void * md_helper_thread(void *arg) {
+    md_helper *helper = (md_helper *)arg;
+    struct md_parallel *parallel = helper->parallel;
+    char whoami[32];
+    snprintf(whoami, 32, "(md-%03d)", helper->index);
+
+    mask_sig(whoami);
+
+    pthread_mutex_lock(&parallel->mutex);
+    while (true) {
+        while (parallel->generation == helper->generation && !parallel->stop) {
+            pthread_cond_wait(&parallel->cond, &parallel->mutex);
+        }
+        if (parallel->stop) {
+            break;
+        }
+        helper->generation = parallel->generation;
+        void *data = parallel->data;
+        ssize_t size = parallel->size;
+        pthread_mutex_unlock(&parallel->mutex);
+
+        update_md_attrs(parallel->md, helper->attrs, helper->gcrypt, data, size);
+
+        pthread_mutex_lock(&parallel->mutex);
+        if (--parallel->busy == 0) {
+            pthread_cond_broadcast(&parallel->cond);
+        }
+    }
+    pthread_mutex_unlock(&parallel->mutex);
+    log_msg(LOG_LEVEL_THREAD, "%10s: md helper: exit thread", whoami);
+    return (void *) pthread_self();
+}
+
+/*
+  Update the hashsums of an initialised md_container concurrently,
+  every hashsum library context is updated by its own thread.
+
+  The helper threads are started per file and stopped in close_md. This is
+  only done for files above parallel_hashsums_threshold, for which hashing
+  takes much longer than starting a thread, so the helpers are not pooled.
+
+  Returns the number of started helper threads (0 if there is nothing to
+  parallelize).
+ */
+
+int init_md_parallel(struct md_container* md, const char *filename, const char *whoami) {
+    DB_ATTR_TYPE units[num_hashes+1];
+    bool gcrypt_units[num_hashes+1];
+    int num_units = 0;
+#ifdef WITH_NETTLE
+    for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+        DB_ATTR_TYPE h = ATTR(hashsums[i].attribute);
+        if (i != hash_blake3 && h&md->calc_attr) {
+            gcrypt_units[num_units] = false;
+            units[num_units++] = h;
+        }
+    }
+#endif
+#ifdef WITH_GCRYPT
+    /* all gcrypt hashsums are updated by a single handle */
+    if (md->calc_attr&~ATTR(attr_blake3)) {
+        gcrypt_units[num_units] = true;
+        units[num_units++] = 0LLU;
+    }
+#endif
+#ifdef WITH_BLAKE3
+    if (ATTR(attr_blake3)&md->calc_attr) {
+        gcrypt_units[num_units] = false;
+        units[num_units++] = ATTR(attr_blake3);
+    }
+#endif
+    if (num_units < 2) {
+        return 0;
+    }
+
+    struct md_parallel *parallel = checked_malloc(sizeof(struct md_parallel)); /* freed in close_md */
+    parallel->md = md;
+    pthread_mutex_init(&parallel->mutex, NULL);
+    pthread_cond_init(&parallel->cond, NULL);
+    parallel->data = NULL;
+    parallel->size = 0;
+    parallel->generation = 0LU;
+    parallel->busy = 0;
+    parallel->stop = false;
+    parallel->attrs = units[0];
+    parallel->gcrypt = gcrypt_units[0];
+    parallel->num_helpers = num_units - 1;
+    parallel->helpers = checked_malloc(parallel->num_helpers * sizeof(md_helper)); /* freed in close_md */
+
+    for (int i = 0 ; i < parallel->num_helpers ; ++i) {
+        md_helper *helper = &parallel->helpers[i];
+        helper->parallel = parallel;
+        helper->index = i + 1;
+        helper->attrs = units[i + 1];
+        helper->gcrypt = gcrypt_units[i + 1];
+        helper->generation = 0LU;
+        if (pthread_create(&helper->thread, NULL, &md_helper_thread, (void *) helper) != 0) {
+            log_msg(LOG_LEVEL_ERROR, "failed to start hashsum helper thread #%d", i + 1);
+            exit(THREAD_ERROR);
+        }
+    }
+    md->parallel = parallel;
+
+    LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> update hashsums of md_container (%p) using %d helper thread(s)", filename, (void*) md, parallel->num_helpers);
+    return parallel->num_helpers;
+}
+
+/*
+  update :)
+  Just call this when you have more data.
+ */
+
+int update_md(struct md_container* md,void* data,ssize_t size) {
+
+#ifdef _PARAMETER_CHECK_
+  if (md==NULL||data==NULL) {
+    return RETFAIL;
+  }
+#endif
+
+  if (md->parallel) {
+      struct md_parallel *parallel = md->parallel;
+      pthread_mutex_lock(&parallel->mutex);
+      parallel->data = data;
+      parallel->size = size;
+      parallel->busy = parallel->num_helpers;
+      parallel->generation++;
+      pthread_cond_broadcast(&parallel->cond);
+      pthread_mutex_unlock(&parallel->mutex);
+
+      update_md_attrs(md, parallel->attrs, parallel->gcrypt, data, size);
+
+      /* the caller may reuse the data block after returning */
+      pthread_mutex_lock(&parallel->mutex);
+      while (parallel->busy > 0) {
+          pthread_cond_wait(&parallel->cond, &parallel->mutex);
+      }
+      pthread_mutex_unlock(&parallel->mutex);
+  } else {
+      update_md_attrs(md, md->calc_attr, true, data, size);
+  }
   return RETOK;
 }
 
+static void close_md_parallel(struct md_container* md) {
+    struct md_parallel *parallel = md->parallel;
+    pthread_mutex_lock(&parallel->mutex);
+    parallel->stop = true;
+    pthread_cond_broadcast(&parallel->cond);
+    pthread_mutex_unlock(&parallel->mutex);
+    for (int i = 0 ; i < parallel->num_helpers ; ++i) {
+        if (pthread_join(parallel->helpers[i].thread, NULL) != 0) {
+            log_msg(LOG_LEVEL_WARNING, "failed to join hashsum helper thread #%d", i + 1);
+        }
+    }
+    pthread_cond_destroy(&parallel->cond);
+    pthread_mutex_destroy(&parallel->mutex);
+    free(parallel->helpers);
+    free(parallel);
+    md->parallel = NULL;
+}
+
 /*
   close.. Does some magic.
   After this calling update_db is not a good idea.
@@ -178,6 +371,10 @@ int close_md(struct md_container* md, md_hashsums * hs, const char *filename, co
         return RETFAIL;
     }
 #endif
+    if (md->parallel) {
+        /* all updates are finished, the helpers are no longer needed */
+        close_md_parallel(md);
+    }
     if (hs) {
         LOG_WHOAMI(LOG_LEVEL_DEBUG, "%s> copy hashsums from md_container (%p)", filename, (void*) md);
         for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
@@ -0,0 +1,364 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+#include <zlib.h>
+
+#include "pgzip.h"
+#include "errorcodes.h"
+#include "log.h"
+#include "util.h"
+
+#define PGZIP_BLOCK_SIZE (128*1024)
+#define PGZIP_DICT_SIZE (32*1024)
+
+typedef enum {
+    PGZIP_JOB_FREE = 0,
+    PGZIP_JOB_PENDING,
+    PGZIP_JOB_DONE,
+} pgzip_job_state;
+
+typedef struct pgzip_job {
+    unsigned char *in;
+    size_t in_len;
+    unsigned char dict[PGZIP_DICT_SIZE];
+    size_t dict_len;
+    unsigned char *out;
+    size_t out_size;
+    size_t out_len;
+    uLong crc;
+    bool last;
+    int error;
+    pgzip_job_state state;
+} pgzip_job;
+
+typedef struct pgzip_thread {
+    pgzip_t *pgz;
+    int index;
+    pthread_t thread;
+} pgzip_thread;
+
+struct pgzip_s {
+    FILE *fp;
+    int level;
+
+    pgzip_job *jobs;
+    int num_jobs;
+
+    /* sequence numbers of the next job to fill, to compress and to write */
+    unsigned long next_submit;
+    unsigned long next_compress;
+    unsigned long next_write;
+
+    pgzip_thread *threads;
+    int num_threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_pending;
+    pthread_cond_t cond_done;
+    bool stop;
+    bool opened;
+
+    /* crc and length of the current gzip member */
+    uLong crc;
+    unsigned long long total_in;
+    unsigned long long total_in_members; /* length of the finished members */
+    unsigned long long total_out;
+};
+
+static void compress_job(pgzip_t *pgz, pgzip_job *job) {
+    z_stream strm;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+
+    job->error = deflateInit2(&strm, pgz->level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    if (job->error != Z_OK) {
+        return;
+    }
+    if (job->dict_len) {
+        deflateSetDictionary(&strm, job->dict, job->dict_len);
+    }
+
+    /* room for the empty stored block appended by Z_SYNC_FLUSH */
+    size_t bound = deflateBound(&strm, job->in_len) + 16;
+    if (bound > job->out_size) {
+        job->out = checked_realloc(job->out, bound); /* freed in pgzip_close */
+        job->out_size = bound;
+    }
+
+    strm.next_in = job->in;
+    strm.avail_in = job->in_len;
+    job->out_len = 0;
+    int flush = job->last ? Z_FINISH : Z_SYNC_FLUSH;
+    do {
+        if (job->out_len == job->out_size) {
+            job->out_size *= 2;
+            job->out = checked_realloc(job->out, job->out_size);
+        }
+        strm.next_out = job->out + job->out_len;
+        strm.avail_out = job->out_size - job->out_len;
+        job->error = deflate(&strm, flush);
+        job->out_len = job->out_size - strm.avail_out;
+    } while (job->error == Z_OK && (strm.avail_out == 0 || (job->last && job->error != Z_STREAM_END)));
+    if (job->error == Z_OK || job->error == Z_STREAM_END || job->error == Z_BUF_ERROR) {
+        job->error = Z_OK;
+    }
+    deflateEnd(&strm);
+
+    job->crc = crc32(crc32(0L, Z_NULL, 0), job->in, job->in_len);
+}
+
+static void *pgzip_compress_thread(void *arg) {
+    pgzip_thread *t = (pgzip_thread *) arg;
+    pgzip_t *pgz = t->pgz;
+    char whoami[32];
+    snprintf(whoami, 32, "(gz-%03d)", t->index);
+
+    mask_sig(whoami);
+
+    pthread_mutex_lock(&pgz->mutex);
+    while (true) {
+        while (pgz->next_compress == pgz->next_submit && !pgz->stop) {
+            pthread_cond_wait(&pgz->cond_pending, &pgz->mutex);
+        }
+        if (pgz->next_compress == pgz->next_submit) {
+            break;
+        }
+        unsigned long seq = pgz->next_compress++;
+        pthread_mutex_unlock(&pgz->mutex);
+
+        pgzip_job *job = &pgz->jobs[seq % pgz->num_jobs];
+        compress_job(pgz, job);
+        log_msg(LOG_LEVEL_TRACE, "%10s: pgzip(%p): compressed block #%lu (%zu -> %zu bytes)", whoami, (void*) pgz, seq, job->in_len, job->out_len);
+
+        pthread_mutex_lock(&pgz->mutex);
+        job->state = PGZIP_JOB_DONE;
+        pthread_cond_broadcast(&pgz->cond_done);
+    }
+    pthread_mutex_unlock(&pgz->mutex);
+    log_msg(LOG_LEVEL_THREAD, "%10s: pgzip: exit thread", whoami);
+    return (void *) pthread_self();
+}
+
+static int write_bytes(pgzip_t *pgz, const void *data, size_t len) {
+    if (fwrite(data, 1, len, pgz->fp) < len) {
+        return -1;
+    }
+    pgz->total_out += len;
+    return 0;
+}
+
+/* write compressed blocks in order, wait for all blocks up to sequence number min_written */
+static int write_jobs(pgzip_t *pgz, unsigned long min_written) {
+    while (pgz->next_write < pgz->next_submit) {
+        pgzip_job *job = &pgz->jobs[pgz->next_write % pgz->num_jobs];
+        if (pgz->num_threads) {
+            pthread_mutex_lock(&pgz->mutex);
+            while (pgz->next_write < min_written && job->state != PGZIP_JOB_DONE) {
+                pthread_cond_wait(&pgz->cond_done, &pgz->mutex);
+            }
+            bool done = job->state == PGZIP_JOB_DONE;
+            pthread_mutex_unlock(&pgz->mutex);
+            if (!done) {
+                return 0;
+            }
+        }
+        if (job->error != Z_OK) {
+            log_msg(LOG_LEVEL_ERROR, "pgzip: deflate failed for block #%lu (zlib error: %d)", pgz->next_write, job->error);
+            return -1;
+        }
+        if (write_bytes(pgz, job->out, job->out_len) != 0) {
+            return -1;
+        }
+        pgz->crc = crc32_combine(pgz->crc, job->crc, job->in_len);
+        pgz->total_in += job->in_len;
+        job->in_len = 0;
+        job->state = PGZIP_JOB_FREE;
+        pgz->next_write++;
+    }
+    return 0;
+}
+
+static int submit_job(pgzip_t *pgz, bool last) {
+    pgzip_job *job = &pgz->jobs[pgz->next_submit % pgz->num_jobs];
+    size_t in_len = job->in_len;
+    job->last = last;
+
+    if (pgz->num_threads) {
+        pthread_mutex_lock(&pgz->mutex);
+        job->state = PGZIP_JOB_PENDING;
+        pgz->next_submit++;
+        pthread_cond_signal(&pgz->cond_pending);
+        pthread_mutex_unlock(&pgz->mutex);
+    } else {
+        compress_job(pgz, job);
+        job->state = PGZIP_JOB_DONE;
+        pgz->next_submit++;
+    }
+
+    /* the slot of the next block has to be written before it can be refilled */
+    unsigned long min_written = pgz->next_submit >= (unsigned long) pgz->num_jobs ? pgz->next_submit - pgz->num_jobs + 1 : 0LU;
+    if (write_jobs(pgz, min_written) != 0) {
+        return -1;
+    }
+
+    pgzip_job *next = &pgz->jobs[pgz->next_submit % pgz->num_jobs];
+    if (!last) {
+        /* prime the next block with the tail of this block (the input buffer
+         * is not modified before the slot is refilled) */
+        size_t dict_len = in_len < PGZIP_DICT_SIZE ? in_len : PGZIP_DICT_SIZE;
+        memcpy(next->dict, job->in + in_len - dict_len, dict_len);
+        next->dict_len = dict_len;
+    } else {
+        next->dict_len = 0;
+    }
+    return 0;
+}
+
+static int write_header(pgzip_t *pgz) {
+    /* gzip header: no file name, no modification time, OS: unix */
+    const unsigned char header[10] = { 0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, pgz->level == 9 ? 2 : pgz->level == 1 ? 4 : 0, 3 };
+    return write_bytes(pgz, header, sizeof(header));
+}
+
+/* compresses the pending data as last block of the member and writes the trailer */
+static int finish_member(pgzip_t *pgz) {
+    if (submit_job(pgz, true) != 0 || write_jobs(pgz, pgz->next_submit) != 0) {
+        return -1;
+    }
+    unsigned char trailer[8];
+    for (int i = 0 ; i < 4 ; ++i) {
+        trailer[i] = (pgz->crc >> (8 * i)) & 0xff;
+        trailer[4 + i] = (pgz->total_in >> (8 * i)) & 0xff;
+    }
+    return write_bytes(pgz, trailer, sizeof(trailer));
+}
+
+pgzip_t *pgzip_open(FILE *fp, int level, int num_threads) {
+    pgzip_t *pgz = checked_malloc(sizeof(pgzip_t)); /* freed in pgzip_close */
+    pgz->fp = fp;
+    pgz->level = level;
+    pgz->num_threads = num_threads > 0 ? num_threads : 0;
+    pgz->num_jobs = 2 * (pgz->num_threads + 1);
+    pgz->jobs = checked_calloc(pgz->num_jobs, sizeof(pgzip_job)); /* freed in pgzip_close */
+    for (int i = 0 ; i < pgz->num_jobs ; ++i) {
+        pgz->jobs[i].in = checked_malloc(PGZIP_BLOCK_SIZE); /* freed in pgzip_close */
+        pgz->jobs[i].state = PGZIP_JOB_FREE;
+    }
+    pgz->next_submit = 0LU;
+    pgz->next_compress = 0LU;
+    pgz->next_write = 0LU;
+    pgz->stop = false;
+    pgz->crc = crc32(0L, Z_NULL, 0);
+    pgz->total_in = 0LLU;
+    pgz->total_in_members = 0LLU;
+    pgz->total_out = 0LLU;
+    pthread_mutex_init(&pgz->mutex, NULL);
+    pthread_cond_init(&pgz->cond_pending, NULL);
+    pthread_cond_init(&pgz->cond_done, NULL);
+    pgz->threads = NULL;
+    pgz->opened = false;
+
+    if (write_header(pgz) != 0) {
+        pgzip_close(pgz);
+        return NULL;
+    }
+    pgz->opened = true;
+
+    if (pgz->num_threads) {
+        pgz->threads = checked_malloc(pgz->num_threads * sizeof(pgzip_thread)); /* freed in pgzip_close */
+    }
+    for (int i = 0 ; i < pgz->num_threads ; ++i) {
+        pgz->threads[i].pgz = pgz;
+        pgz->threads[i].index = i + 1;
+        if (pthread_create(&pgz->threads[i].thread, NULL, &pgzip_compress_thread, (void *) &pgz->threads[i]) != 0) {
+            log_msg(LOG_LEVEL_ERROR, "failed to start gzip compression thread #%d", i + 1);
+            exit(THREAD_ERROR);
+        }
+    }
+    log_msg(LOG_LEVEL_DEBUG, "pgzip(%p): compress with level %d using %d thread(s) (block size: %d bytes)", (void*) pgz, level, pgz->num_threads, PGZIP_BLOCK_SIZE);
+    return pgz;
+}
+
+int pgzip_write(pgzip_t *pgz, const char *data, size_t len) {
+    while (len) {
+        pgzip_job *job = &pgz->jobs[pgz->next_submit % pgz->num_jobs];
+        size_t n = PGZIP_BLOCK_SIZE - job->in_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(job->in + job->in_len, data, n);
+        job->in_len += n;
+        data += n;
+        len -= n;
+        if (job->in_len == PGZIP_BLOCK_SIZE && submit_job(pgz, false) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int pgzip_new_member(pgzip_t *pgz, unsigned long long *offset) {
+    if (finish_member(pgz) != 0) {
+        return -1;
+    }
+    pgz->total_in_members += pgz->total_in;
+    pgz->crc = crc32(0L, Z_NULL, 0);
+    pgz->total_in = 0LLU;
+    *offset = pgz->total_out;
+    log_msg(LOG_LEVEL_TRACE, "pgzip(%p): start new gzip member at offset %llu", (void*) pgz, *offset);
+    return write_header(pgz);
+}
+
+int pgzip_close(pgzip_t *pgz) {
+    int ret = 0;
+    if (pgz->opened && finish_member(pgz) != 0) {
+        ret = -1;
+    }
+
+    if (pgz->threads) {
+        pthread_mutex_lock(&pgz->mutex);
+        pgz->stop = true;
+        pthread_cond_broadcast(&pgz->cond_pending);
+        pthread_mutex_unlock(&pgz->mutex);
+        for (int i = 0 ; i < pgz->num_threads ; ++i) {
+            pthread_join(pgz->threads[i].thread, NULL);
+        }
+    }
+    log_msg(LOG_LEVEL_DEBUG, "pgzip(%p): compressed %llu bytes to %llu bytes", (void*) pgz, pgz->total_in_members + pgz->total_in, pgz->total_out);
+
+    for (int i = 0 ; i < pgz->num_jobs ; ++i) {
+        free(pgz->jobs[i].in);
+        free(pgz->jobs[i].out);
+    }
+    free(pgz->jobs);
+    free(pgz->threads);
+    pthread_cond_destroy(&pgz->cond_done);
+    pthread_cond_destroy(&pgz->cond_pending);
+    pthread_mutex_destroy(&pgz->mutex);
+    free(pgz);
+    return ret;
+}
@@ -207,7 +207,13 @@ static void update_state(progress_state new_state) {
                 log_msg(log_level, "read %lu %s%s [%lu entries/s] from %s in %ldm %.4lfs", num_entries, entries_string, skipped_str?skipped_str:"", performance, (conf->database_new.url)->raw, elapsed_minutes, elapsed_seconds);
                 break;
             case PROGRESS_DISK:
-                log_msg(log_level, "read %lu %s [%lu entries/s] from file system in %ldm %.4lfs", num_entries, entries_string, performance, elapsed_minutes, elapsed_seconds);
+                if (conf->num_workers > 0) {
+                    log_msg(log_level, "read %lu %s [%lu entries/s, %ld %s, %s] from file system in %ldm %.4lfs", num_entries, entries_string, performance,
+                            conf->num_workers, conf->num_workers == 1 ? "worker" : "workers", conf->work_stealing ? "work stealing" : "shared queue",
+                            elapsed_minutes, elapsed_seconds);
+                } else {
+                    log_msg(log_level, "read %lu %s [%lu entries/s] from file system in %ldm %.4lfs", num_entries, entries_string, performance, elapsed_minutes, elapsed_seconds);
+                }
                 break;
             case PROGRESS_CONFIG:
                 log_msg(log_level, "parsed %lu config %s [%lu files/s] in %ldm %.4lfs", num_entries, num_entries == 1 ? "file" : "files", performance, elapsed_minutes, elapsed_seconds);
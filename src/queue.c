@@ -77,6 +77,31 @@ static bool queue_enqueue(queue_ts_t * const queue, void * const data) {
     return new_head_tail;
 }
 
+static bool queue_push(queue_ts_t * const queue, void * const data) {
+    qnode_t *new;
+    new = checked_malloc(sizeof(qnode_t)); /* freed in queue_dequeue */
+    new->data = data;
+
+    bool new_head_tail = false;
+
+    if (queue->head == NULL) {
+        queue->head = new;
+        queue->tail = new;
+        new->next = NULL;
+        new->prev = NULL;
+        new_head_tail = true;
+        log_msg(queue_log_level, "queue(%p): add node %p with payload %p as new head and new tail", (void*) queue, (void*) new, (void*) new->data);
+    } else {
+        /* new node is new head, i.e. it is dequeued next */
+        (queue->head)->next = new;
+        new->prev = queue->head;
+        new->next = NULL;
+        queue->head = new;
+        log_msg(queue_log_level, "queue(%p): add node %p with payload %p as new head", (void*) queue, (void*) new, (void*) new->data);
+    }
+    return new_head_tail;
+}
+
 queue_ts_t *queue_ts_init(void) {
     queue_ts_t *queue = checked_malloc (sizeof(queue_ts_t));
 
@@ -121,6 +146,18 @@ bool queue_ts_enqueue(queue_ts_t * const queue, void * const data, const char *w
     return new_head_tail;
 }
 
+bool queue_ts_push(queue_ts_t * const queue, void * const data, const char *whoami) {
+    pthread_mutex_lock(&queue->mutex);
+    bool new_head_tail = queue_push(queue,data);
+    pthread_mutex_unlock(&queue->mutex);
+
+    if (new_head_tail) {
+        pthread_cond_broadcast(&queue->cond);
+        log_msg(LOG_LEVEL_THREAD, "%10s: queue(%p): broadcast waiting threads for new head node in queue", whoami, (void*) queue);
+    }
+    return new_head_tail;
+}
+
 void *queue_ts_dequeue_wait(queue_ts_t * const queue, const char *whoami) {
     qnode_t *head;
     void *data = NULL;
@@ -374,6 +374,9 @@ void print_report_config_options(report_t *report, void (*print_config_option)(r
     if (conf->limit != NULL) {
         print_config_option(report, LIMIT_CMDLINE_OPTION, conf->limit);
     }
+    if (conf->shard != NULL) {
+        print_config_option(report, SHARD_CMDLINE_OPTION, conf->shard);
+    }
     if (conf->action&(DO_INIT|DO_COMPARE) && conf->root_prefix_length > 0) {
         print_config_option(report, ROOT_PREFIX_OPTION, conf->root_prefix);
     }
@@ -826,6 +829,11 @@ void print_databases_attrs(report_t *report, void (*print_database_attributes)(r
     if (conf->database_in.db_line) {
         print_database_attributes(report, conf->database_in.db_line);
     }
+    for (int i = 0 ; i < conf->num_database_in_deltas ; ++i) {
+        if (conf->database_in_deltas[i].db_line) {
+            print_database_attributes(report, conf->database_in_deltas[i].db_line);
+        }
+    }
     if (conf->database_out.db_line) {
         print_database_attributes(report, conf->database_out.db_line);
     }
@@ -953,6 +961,11 @@ static void print_report(report_t * report, seltree * node, report_format_module
 int gen_report(seltree* node) {
     list* report_list = NULL;
 
+    /* unchanged entries of --compare are not kept in the tree */
+    for (report_list=conf->report_urls; report_list; report_list=report_list->next) {
+        ((report_t*) report_list->data)->ntotal += conf->num_unchanged_streamed;
+    }
+
     terse_report(node);
 
 #ifdef WITH_AUDIT
@@ -252,6 +252,9 @@ static void _print_report_dbline_attributes(report_t *report, db_line* oline, db
         report_printf(report, JSON_FMT_OBJECT_BEGIN, 4, ' ', escaped_filename);
         json_attributes_first = true;
         print_dbline_attrs(report, oline, nline, report_attrs, _print_attribute);
+        if (conf->trust_ctime && nline && nline->reused_hashsums&report_attrs) {
+            report_printf(report, ",\n%*c\"%s\": true", 6, ' ', "reused_hashsums");
+        }
         report_printf(report,"\n");
         report_printf(report, JSON_FMT_OBJECT_END_PLAIN, 4, ' ');
         free(escaped_filename);
@@ -295,6 +298,18 @@ static void print_report_summary_json(report_t *report) {
         report_printf(report, JSON_FMT_LONG_LAST, 4, ' ', "total", report->ntotal);
     }
     report_printf(report, JSON_FMT_OBJECT_END, 2, ' ');
+    if (conf->action&DO_COMPARE && conf->trust_ctime) {
+        report_printf(report, JSON_FMT_OBJECT_BEGIN, 2, ' ', "hashsums");
+        report_printf(report, JSON_FMT_LONG, 4, ' ', "reused", conf->num_reused_hashsums);
+        report_printf(report, JSON_FMT_LONG_LAST, 4, ' ', "computed", conf->num_computed_hashsums);
+        report_printf(report, JSON_FMT_OBJECT_END, 2, ' ');
+    }
+    if (conf->num_hardlink_hashsums) {
+        report_printf(report, JSON_FMT_OBJECT_BEGIN, 2, ' ', "hard_links");
+        report_printf(report, JSON_FMT_LONG, 4, ' ', "reused_hashsums", conf->num_hardlink_hashsums);
+        report_printf(report, JSON_FMT_LONG_LAST, 4, ' ', "bytes_not_read", (long) conf->hardlink_bytes_saved);
+        report_printf(report, JSON_FMT_OBJECT_END, 2, ' ');
+    }
 }
 
 static void print_report_new_database_written_json(report_t *report) {
@@ -172,6 +172,9 @@ static void _print_report_dbline_attributes(report_t *report, db_line* oline, db
         report_printf(report, NDJSON_FMT_OBJECT_BEGIN, 0, ' ', escaped_filename);
         ndjson_attributes_first = true;
         print_dbline_attrs(report, oline, nline, report_attrs, _print_attribute);
+        if (conf->trust_ctime && nline && nline->reused_hashsums&report_attrs) {
+            report_printf(report, ", \"%s\": true", "reused_hashsums");
+        }
         report_printf(report, NDJSON_FMT_OBJECT_END_PLAIN, 0, ' ');
         report_printf(report, NDJSON_FMT_LINE_END);
         free(escaped_filename);
@@ -222,6 +225,18 @@ static void print_report_summary_ndjson(report_t *report) {
         report_printf(report, NDJSON_FMT_LONG_LAST, 0, ' ', "total", report->ntotal);
     }
     report_printf(report, NDJSON_FMT_LINE_END);
+    if (conf->action&DO_COMPARE && conf->trust_ctime) {
+        report_printf(report, NDJSON_FMT_LINE_START, "hashsums");
+        report_printf(report, NDJSON_FMT_LONG, 0, ' ', "reused", conf->num_reused_hashsums);
+        report_printf(report, NDJSON_FMT_LONG_LAST, 0, ' ', "computed", conf->num_computed_hashsums);
+        report_printf(report, NDJSON_FMT_LINE_END);
+    }
+    if (conf->num_hardlink_hashsums) {
+        report_printf(report, NDJSON_FMT_LINE_START, "hard_links");
+        report_printf(report, NDJSON_FMT_LONG, 0, ' ', "reused_hashsums", conf->num_hardlink_hashsums);
+        report_printf(report, NDJSON_FMT_LONG_LAST, 0, ' ', "bytes_not_read", (long) conf->hardlink_bytes_saved);
+        report_printf(report, NDJSON_FMT_LINE_END);
+    }
 }
 
 static void print_report_new_database_written_ndjson(report_t *report) {
@@ -145,6 +145,14 @@ static void print_report_summary_plain(report_t *report) {
     } else {
         report_printf(report, _("\nNumber of entries:\t%li"), report->ntotal);
     }
+    if (conf->action&DO_COMPARE && conf->trust_ctime) {
+        report_printf(report, _("\n\nHashsums (trust_ctime):\n  Reused from old database:\t%li\n  Computed:\t\t\t%li"),
+                conf->num_reused_hashsums, conf->num_computed_hashsums);
+    }
+    if (conf->num_hardlink_hashsums) {
+        report_printf(report, _("\n\nHard linked files:\n  Reused hashsums:\t\t%li\n  Bytes not read:\t\t%lld"),
+                conf->num_hardlink_hashsums, conf->hardlink_bytes_saved);
+    }
 }
 
 static void print_line_plain(report_t* report, char* filename, int node_checked, seltree* node) {
@@ -177,6 +185,9 @@ static void print_report_dbline_attributes_plain(report_t *report, db_line* olin
         free(filename_safe);
 
         print_dbline_attrs(report, oline, nline, report_attrs, _print_attribute);
+        if (conf->trust_ctime && nline && nline->reused_hashsums&report_attrs) {
+            report_printf(report, _(" (hashsums reused from old database)\n"));
+        }
     }
 }
 
@@ -19,11 +19,145 @@
  */
 
 #include "config.h"
+#include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "file.h"
 #include "rx_rule.h"
+#include "log.h"
 #include "util.h"
+#include "errorcodes.h"
+
+static pthread_key_t match_data_key;
+static pthread_once_t match_data_key_once = PTHREAD_ONCE_INIT;
+
+static void match_data_free(void *md) {
+    pcre2_match_data_free(md);
+}
+
+static void match_data_key_create(void) {
+    pthread_key_create(&match_data_key, match_data_free);
+}
+
+/* every thread uses its own match data, no captures are needed so it fits all patterns */
+pcre2_match_data *get_thread_match_data(void) {
+    pthread_once(&match_data_key_once, match_data_key_create);
+    pcre2_match_data *md = pthread_getspecific(match_data_key);
+    if (md == NULL) {
+        md = pcre2_match_data_create(1, NULL); /* freed in match_data_free */
+        if (md == NULL) {
+            log_msg(LOG_LEVEL_ERROR, "pcre2_match_data_create: failed to allocate memory");
+            exit(MEMORY_ALLOCATION_FAILURE);
+        }
+        pthread_setspecific(match_data_key, md);
+    }
+    return md;
+}
+
+/*
+ * init_rx_literal()
+ * set the literal of rules without regular expression syntax (e.g. '/etc/passwd$'),
+ * these rules are matched without calling pcre2_match()
+ */
+void init_rx_literal(rx_rule *rule) {
+    const char *rx = rule->rx;
+    char *literal = checked_malloc(strlen(rx) + 1);
+    size_t n = 0;
+    bool eol = false;
+
+    for (size_t i = 0; rx[i]; ++i) {
+        if (rx[i] == '\\') {
+            if (rx[i+1] == '\0' || isalnum((unsigned char) rx[i+1])) {
+                /* escape sequence (e.g. '\d') */
+                goto not_literal;
+            }
+            literal[n++] = rx[++i];
+        } else if (strchr("^$.[]|()?*+{}", rx[i])) {
+            if (rx[i] == '$' && rx[i+1] == '\0') {
+                eol = true;
+                break;
+            }
+            goto not_literal;
+        } else {
+            literal[n++] = rx[i];
+        }
+    }
+    literal[n] = '\0';
+    rule->literal = literal; /* not to be freed */
+    rule->literal_length = n;
+    rule->literal_eol = eol;
+    return;
+not_literal:
+    free(literal);
+    rule->literal = NULL;
+    rule->literal_length = 0;
+    rule->literal_eol = false;
+}
+
+/* see RFC 3629, pcre2_match() rejects invalid UTF-8 subjects */
+static bool is_valid_utf8(const unsigned char *s, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        unsigned char c = s[i];
+        size_t n;
+        unsigned int min, cp;
+        if (c < 0x80) { i++; continue; }
+        else if ((c & 0xe0) == 0xc0) { n = 1; min = 0x80; cp = c & 0x1f; }
+        else if ((c & 0xf0) == 0xe0) { n = 2; min = 0x800; cp = c & 0x0f; }
+        else if ((c & 0xf8) == 0xf0) { n = 3; min = 0x10000; cp = c & 0x07; }
+        else { return false; }
+        if (i + n >= length) {
+            return false;
+        }
+        for (size_t j = 1; j <= n; ++j) {
+            if ((s[i+j] & 0xc0) != 0x80) {
+                return false;
+            }
+            cp = (cp << 6) | (s[i+j] & 0x3f);
+        }
+        if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+            return false;
+        }
+        i += n + 1;
+    }
+    return true;
+}
+
+/*
+ * match_rx_rule()
+ * match the (anchored) rule against name like
+ * pcre2_match(..., PCRE2_PARTIAL_SOFT, ...) does
+ *
+ * returns >=0 on match, PCRE2_ERROR_PARTIAL on partial match
+ * and a negative pcre2 error code otherwise
+ */
+int match_rx_rule(rx_rule *rule, const char *name) {
+    if (rule->literal == NULL) {
+        return pcre2_match(rule->crx, (PCRE2_SPTR) name, PCRE2_ZERO_TERMINATED, 0, PCRE2_PARTIAL_SOFT, get_thread_match_data(), NULL);
+    }
+    size_t length = strlen(name);
+    if (!is_valid_utf8((const unsigned char *) name, length)) {
+        return PCRE2_ERROR_UTF8_ERR1;
+    }
+    size_t n = rule->literal_length;
+    if (length >= n) {
+        if (memcmp(name, rule->literal, n) != 0) {
+            return PCRE2_ERROR_NOMATCH;
+        }
+        /* '$' also matches before a newline at the end */
+        if (!rule->literal_eol || length == n || (length == n + 1 && name[n] == '\n')) {
+            return 0;
+        }
+        return PCRE2_ERROR_NOMATCH;
+    }
+    if (length && memcmp(name, rule->literal, length) == 0) {
+        return PCRE2_ERROR_PARTIAL;
+    }
+    return PCRE2_ERROR_NOMATCH;
+}
 
 static int generate_restriction_string(rx_restriction_t r, char *str) {
     int n = 0;
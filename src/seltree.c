@@ -37,12 +37,25 @@
 #include "errorcodes.h"
 #include "db.h"
 
+/* nodes of the rule tree are immutable and therefore not locked */
+static void rdlock_node(seltree *node) {
+    if (!node->frozen) {
+        pthread_rwlock_rdlock(&node->rwlock);
+    }
+}
+
+static void unlock_node(seltree *node) {
+    if (!node->frozen) {
+        pthread_rwlock_unlock(&node->rwlock);
+    }
+}
+
 void log_tree(LOG_LEVEL log_level, seltree* node, int depth) {
 
     list* r;
     rx_rule* rxc;
 
-    pthread_rwlock_rdlock(&node->rwlock);
+    rdlock_node(node);
 
     log_msg(log_level, "%-*s %s:", depth, depth?"\u251d":"\u250c", node->path);
 
@@ -70,7 +83,7 @@ void log_tree(LOG_LEVEL log_level, seltree* node, int depth) {
         log_tree(log_level, tree_get_data(n), depth+2);
     }
 
-    pthread_rwlock_unlock(&node->rwlock);
+    unlock_node(node);
 
     if (depth == 0) {
         log_msg(log_level, "%s", "\u2514");
@@ -141,14 +154,17 @@ static seltree *create_seltree_node(char *path, seltree *parent) {
     node->old_data = NULL;
     node->changed_attrs = 0;
 
+    node->rule_tree = NULL;
+    node->frozen = false;
+
     return node;
 }
 
 static seltree* _get_seltree_node(seltree* node, char *path, bool create) {
     LOG_LEVEL log_level = LOG_LEVEL_TRACE;
-    pthread_rwlock_rdlock(&node->rwlock);
+    rdlock_node(node);
     log_msg(log_level, "_get_seltree_node(): %s> node: '%s' (%p), create: %s", path, node->path, (void*) node, btoa(create));
-    pthread_rwlock_unlock(&node->rwlock);
+    unlock_node(node);
     seltree *parent = NULL;
     char *tmp = checked_strdup(path);
 
@@ -158,10 +174,10 @@ static seltree* _get_seltree_node(seltree* node, char *path, bool create) {
             parent = node;
             next_dir = strchr(&next_dir[1], '/');
             if (next_dir) { tmp[next_dir-path] = '\0'; }
-            pthread_rwlock_rdlock(&parent->rwlock);
+            rdlock_node(parent);
             log_msg(log_level, "_get_seltree_node(): %s> search for child node '%s' (parent: '%s' (%p))", path, strrchr(tmp,'/'), parent->path, (void*) parent);
             node = tree_search(parent->children, strrchr(tmp,'/'), (tree_cmp_f) strcmp);
-            pthread_rwlock_unlock(&parent->rwlock);
+            unlock_node(parent);
             if (create && node == NULL) {
                 pthread_rwlock_wrlock(&parent->rwlock);
                 node = tree_search(parent->children, strrchr(tmp,'/'), (tree_cmp_f) strcmp);
@@ -179,9 +195,9 @@ static seltree* _get_seltree_node(seltree* node, char *path, bool create) {
     if (node == NULL) {
         log_msg(log_level, "_get_seltree_node(): %s> return NULL (node == NULL)", path);
     } else {
-        pthread_rwlock_rdlock(&node->rwlock);
+        rdlock_node(node);
         log_msg(log_level, "_get_seltree_node(): %s> return node: '%s' (%p)", path, node->path, (void*) node);
-        pthread_rwlock_unlock(&node->rwlock);
+        unlock_node(node);
     }
     return node;
 }
@@ -201,13 +217,13 @@ seltree *init_tree(void) {
 }
 
 bool is_tree_empty(seltree *node) {
-    pthread_rwlock_rdlock(&node->rwlock);
+    rdlock_node(node);
     bool is_empty = (node->children == NULL
           && node->equ_rx_lst == NULL
           && node->sel_rx_lst == NULL
           && node->neg_rx_lst == NULL
         );
-    pthread_rwlock_unlock(&node->rwlock);
+    unlock_node(node);
     return is_empty;
 }
 
@@ -238,10 +254,9 @@ rx_rule * add_rx_to_tree(char * rx, rx_restriction_t restriction, AIDE_RULE_TYPE
         free(r);
         return NULL;
     } else {
-        r->md = pcre2_match_data_create_from_pattern(r->crx, NULL);
-        if (r->md == NULL) {
-            log_msg(LOG_LEVEL_ERROR, "pcre2_match_data_create_from_pattern: failed to allocate memory");
-            exit(MEMORY_ALLOCATION_FAILURE);
+        init_rx_literal(r);
+        if (r->literal) {
+            log_msg(LOG_LEVEL_DEBUG, "regex '%s' is a literal path (match without pcre2)", r->rx);
         }
         int pcre2_jit = pcre2_jit_compile(r->crx, PCRE2_JIT_PARTIAL_SOFT);
         if (pcre2_jit < 0) {
@@ -262,6 +277,11 @@ rx_rule * add_rx_to_tree(char * rx, rx_restriction_t restriction, AIDE_RULE_TYPE
             }
         }
 
+        if (tree->rule_tree) {
+            log_msg(LOG_LEVEL_DEBUG, "discard compiled rule tree (%p) of '%s' (new rule '%s' added)", (void*) tree->rule_tree, tree->path, rx);
+            tree->rule_tree = NULL;
+        }
+
         curnode = get_or_create_seltree_node(tree, rxtok);
 
         pthread_rwlock_wrlock(&curnode->rwlock);
@@ -312,7 +332,7 @@ static int check_list_for_match(list* rxrlist, file_t file, rx_rule* *rule, int
   for(r=rxrlist;r;r=r->next){
       rx_rule *rx = (rx_rule*)r->data;
 
-      pcre_retval = pcre2_match(rx->crx, (PCRE2_SPTR) file.name, PCRE2_ZERO_TERMINATED, 0, PCRE2_PARTIAL_SOFT, rx->md, NULL);
+      pcre_retval = match_rx_rule(rx, file.name);
       if (pcre_retval >= 0) { /* matching regex */
           if (!rx->restriction.f_type || file.type&rx->restriction.f_type) { /* no file type restriction OR matching file type */
 #ifdef HAVE_FSTYPE
@@ -380,7 +400,7 @@ static match_t check_node_for_match(seltree *pnode, file_t file, const char* who
     char *last_slash = strrchr(file.name,'/');
     int parent_length = (last_slash != file.name?last_slash-file.name:0);
 
-    pthread_rwlock_rdlock(&pnode->rwlock);
+    rdlock_node(pnode);
     LOG_WHOAMI(LOG_LEVEL_TRACE, "\u2502 check_node_for_match: pnode: '%s' (%p), filename: '%s', file_type: %c", pnode->path, (void*) pnode, file.name, get_f_type_char_from_f_type(file.type));
     if (strncmp(pnode->path, file.name, parent_length) == 0) {
 
@@ -390,9 +410,9 @@ static match_t check_node_for_match(seltree *pnode, file_t file, const char* who
             } else {
                 seltree * child_node = tree_search(pnode->children, last_slash, (tree_cmp_f) strcmp);
                 if (child_node) {
-                    pthread_rwlock_rdlock(&child_node->rwlock);
+                    rdlock_node(child_node);
                     match.result = _get_default_match_result(child_node, depth, whoami);
-                    pthread_rwlock_unlock(&child_node->rwlock);
+                    unlock_node(child_node);
                 } else {
                     LOG_WHOAMI(LOG_LEVEL_DEBUG, "\u2502 %*cno node for directory '%s' exists (keep default match result at RESULT_NO_RULE_MATCH)", depth, ' ', file.name);
                 }
@@ -411,17 +431,17 @@ static match_t check_node_for_match(seltree *pnode, file_t file, const char* who
     } else {
         LOG_WHOAMI(LOG_LEVEL_DEBUG, "\u2502 %*cnode: '%s' skip equal list (reason: not on top level)", depth, ' ', pnode->path);
     }
-    pthread_rwlock_unlock(&pnode->rwlock);
+    unlock_node(pnode);
 
     /* seltree* stack for negative rules */
     int i = 0;
     seltree * p = pnode;
     while (p) {
-        pthread_rwlock_t *rwlock = &p->rwlock;
-        pthread_rwlock_rdlock(rwlock);
+        seltree *node = p;
+        rdlock_node(node);
         p = p->parent;
         i++;
-        pthread_rwlock_unlock(rwlock);
+        unlock_node(node);
     }
     seltree* *nodes = checked_malloc(sizeof(seltree*)*i);
 
@@ -429,7 +449,7 @@ static match_t check_node_for_match(seltree *pnode, file_t file, const char* who
     seltree *next_parent = NULL;;
     /* check selective rules down -> top */
     do {
-        pthread_rwlock_rdlock(&pnode->rwlock);
+        rdlock_node(pnode);
         if (pnode->sel_rx_lst || pnode->neg_rx_lst) {
             nodes[i++] = pnode;
 
@@ -451,14 +471,14 @@ static match_t check_node_for_match(seltree *pnode, file_t file, const char* who
             LOG_WHOAMI(LOG_LEVEL_DEBUG, "\u2502 %*cnode: '%s': skip selective and negative list (reason: lists are empty)", depth, ' ', pnode->path);
         }
         next_parent = pnode->parent;
-        pthread_rwlock_unlock(&pnode->rwlock);
+        unlock_node(pnode);
     } while ((pnode = next_parent));
 
     /* check negative rules top -> down */
     while (--i >=0) {
         pnode = nodes[i];
         depth--;
-        pthread_rwlock_rdlock(&pnode->rwlock);
+        rdlock_node(pnode);
         if (match.result == RESULT_EQUAL_MATCH || match.result == RESULT_SELECTIVE_MATCH || match.result == RESULT_PARTIAL_MATCH) {
             if (pnode->neg_rx_lst) {
                 LOG_WHOAMI(LOG_LEVEL_RULE, "\u2502 %*cnode: '%s': check negative list (reason: previous positive/partial match)", depth, ' ', pnode->path);
@@ -474,15 +494,57 @@ static match_t check_node_for_match(seltree *pnode, file_t file, const char* who
         } else {
             LOG_WHOAMI(LOG_LEVEL_DEBUG, "\u2502 %*cnode: '%s': skip negative list (reason: no previous positive/partial match)", depth, ' ', pnode->path);
         }
-        pthread_rwlock_unlock(&pnode->rwlock);
+        unlock_node(pnode);
     }
     free(nodes);
     LOG_WHOAMI(LOG_LEVEL_TRACE, "\u2502 check_node_for_match: match result %s (%d) for '%s'", get_match_result_string(match.result), match.result, file.name);
     return match;
 }
 
+static seltree *copy_rule_node(seltree *node, seltree *parent) {
+    seltree *copy = checked_malloc(sizeof(seltree)); /* not to be freed */
+    pthread_rwlock_init(&copy->rwlock, NULL);
+
+    rdlock_node(node);
+    copy->path = node->path;
+    copy->parent = parent;
+    copy->sel_rx_lst = node->sel_rx_lst;
+    copy->neg_rx_lst = node->neg_rx_lst;
+    copy->equ_rx_lst = node->equ_rx_lst;
+    copy->children = NULL;
+    copy->checked = node->checked&NODE_HAS_SUB_RULES;
+    copy->new_data = NULL;
+    copy->old_data = NULL;
+    copy->changed_attrs = 0;
+    copy->rule_tree = NULL;
+    copy->frozen = true;
+
+    for(tree_node *n = tree_walk_first(node->children); n != NULL ; n = tree_walk_next(n)) {
+        seltree *child = copy_rule_node(tree_get_data(n), copy);
+        copy->children = tree_insert(copy->children, strrchr(child->path,'/'), (void*)child, (tree_cmp_f) strcmp);
+    }
+    unlock_node(node);
+    return copy;
+}
+
+/*
+ * compile_seltree()
+ * create an immutable copy of the rule nodes of the tree, check_seltree()
+ * uses it without locking and ignores the nodes added while scanning
+ *
+ * has to be called after all rules are added
+ */
+void compile_seltree(seltree *tree) {
+    tree->rule_tree = copy_rule_node(tree, NULL);
+    log_msg(LOG_LEVEL_DEBUG, "compiled rule tree (%p) of '%s' (%p)", (void*) tree->rule_tree, tree->path, (void*) tree);
+}
+
 match_t check_seltree(seltree *tree, file_t file, bool check_parent_dirs, const char * whoami) {
     seltree* pnode=NULL;
+
+    if (tree->rule_tree) {
+        tree = tree->rule_tree;
+    }
     match_t match = { RESULT_NO_RULE_MATCH, NULL, 0 };
     bool parent_negative_match = false;
 
@@ -508,22 +570,22 @@ match_t check_seltree(seltree *tree, file_t file, bool check_parent_dirs, const
         if (node && relative_child_path_start) {
             node = get_seltree_node(pnode, relative_child_path);
             if (node) {
-                pthread_rwlock_rdlock(&node->rwlock);
+                rdlock_node(node);
                 LOG_WHOAMI(LOG_LEVEL_TRACE, "\u2502 got %s (%p) for '%s'", node->path, (void*) node, relative_child_path);
-                pthread_rwlock_unlock(&node->rwlock);
+                unlock_node(node);
                 pnode = node;
             }
         }
 
         if (check_parent_dirs) {
-            pthread_rwlock_rdlock(&pnode->rwlock);
+            rdlock_node(pnode);
             LOG_WHOAMI(LOG_LEVEL_RULE, "\u2502 check parent directory '%s' for non-recurse match (node: '%s' (%p))", parent, pnode->path, (void*) pnode);
             match = check_node_for_match(pnode, (file_t) { .name = parent, .type = FT_DIR,
 #ifdef HAVE_FSTYPE
                     .fs_type = 0UL
 #endif
             }, whoami);
-            pthread_rwlock_unlock(&pnode->rwlock);
+            unlock_node(pnode);
             if (match.result == RESULT_NON_RECURSIVE_NEGATIVE_MATCH) {
                 match.result = RESULT_NEGATIVE_PARENT_MATCH;
                 match.length = parent_length;
@@ -541,9 +603,9 @@ match_t check_seltree(seltree *tree, file_t file, bool check_parent_dirs, const
         relative_child_path = &parent[relative_child_path_start];
         next_dir += 1;
     }
-    pthread_rwlock_rdlock(&pnode->rwlock);
+    rdlock_node(pnode);
     LOG_WHOAMI(LOG_LEVEL_TRACE, "\u2502 got parent node '%s' (%p) for parent name '%s'", pnode->path, (void*) pnode, parent);
-    pthread_rwlock_unlock(&pnode->rwlock);
+    unlock_node(pnode);
     free(parent);
     if (!parent_negative_match) {
         LOG_WHOAMI(LOG_LEVEL_RULE, "\u2502 check '%s' (filetype: %c)", file.name, get_f_type_char_from_f_type(file.type));
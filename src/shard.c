@@ -0,0 +1,331 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "aide.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "db.h"
+#include "db_binary.h"
+#include "db_config.h"
+#include "db_line.h"
+#include "log.h"
+#include "rx_rule.h"
+#include "shard.h"
+#include "url.h"
+#include "util.h"
+
+typedef struct shard_subtree {
+    char *path;
+    size_t len;
+} shard_subtree;
+
+struct shard_plan {
+    int index;
+    int num_shards;
+    /* subtrees of the shard (index > 0) or of all other shards (index 0),
+     * sorted by db_path_cmp() */
+    shard_subtree *subtrees;
+    size_t num_subtrees;
+};
+
+/* returns true if path is root or below root */
+static bool in_subtree(const char *path, const char *root, size_t root_len) {
+    return strncmp(path, root, root_len) == 0
+        && (path[root_len] == '\0' || path[root_len] == '/' || (root_len && root[root_len-1] == '/'));
+}
+
+static int compare_subtrees(const void *a, const void *b) {
+    return db_path_cmp(((const shard_subtree *) a)->path, ((const shard_subtree *) b)->path);
+}
+
+shard_plan_t *shard_plan_load(const char *filename, int index) {
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        log_msg(LOG_LEVEL_ERROR, "failed to open shard plan '%s': %s", filename, strerror(errno));
+        return NULL;
+    }
+    shard_plan_t *plan = checked_malloc(sizeof(shard_plan_t)); /* freed in shard_plan_free() */
+    *plan = (shard_plan_t) { .index = index, .num_shards = 0, .subtrees = NULL, .num_subtrees = 0 };
+    size_t size = 0;
+
+    char *line = NULL;
+    size_t line_size = 0;
+    long lineno = 0;
+    const char *error = NULL;
+    while (error == NULL && getline(&line, &line_size, fp) != -1) {
+        lineno++;
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') {
+            continue;
+        }
+        if (plan->num_shards == 0) {
+            int version;
+            if (sscanf(line, "@@aide_shard_plan %d %d", &version, &plan->num_shards) != 2) {
+                error = "invalid header";
+            } else if (version != SHARD_PLAN_VERSION) {
+                error = "unsupported version";
+            } else if (plan->num_shards < 1) {
+                error = "invalid number of shards";
+            }
+            continue;
+        }
+        int shard;
+        long count;
+        int offset = 0;
+        if (sscanf(line, "%d %ld %n", &shard, &count, &offset) != 2 || line[offset] != '/') {
+            error = "invalid line";
+        } else if (shard < 0 || shard >= plan->num_shards) {
+            error = "invalid shard";
+        } else if (index == 0 ? shard != 0 : shard == index) {
+            if (plan->num_subtrees == size) {
+                size = size ? 2 * size : 64;
+                plan->subtrees = checked_realloc(plan->subtrees, size * sizeof(shard_subtree)); /* freed in shard_plan_free() */
+            }
+            char *path = checked_strdup(line + offset); /* freed in shard_plan_free() */
+            decode_string(path);
+            plan->subtrees[plan->num_subtrees++] = (shard_subtree) { .path = path, .len = strlen(path) };
+        }
+    }
+    free(line);
+    fclose(fp);
+    if (error == NULL && plan->num_shards == 0) {
+        error = "missing header";
+    }
+    if (error) {
+        log_msg(LOG_LEVEL_ERROR, "%s: invalid shard plan (%s, line: %ld)", filename, error, lineno);
+        shard_plan_free(plan);
+        return NULL;
+    }
+    if (index >= plan->num_shards) {
+        log_msg(LOG_LEVEL_ERROR, "%s: shard %d not found in shard plan (number of shards: %d)", filename, index, plan->num_shards);
+        shard_plan_free(plan);
+        return NULL;
+    }
+    qsort(plan->subtrees, plan->num_subtrees, sizeof(shard_subtree), compare_subtrees);
+    if (index) {
+        log_msg(LOG_LEVEL_INFO, "shard %d of %d: %zu subtree(s) (shard plan: '%s')", index, plan->num_shards, plan->num_subtrees, filename);
+    } else {
+        log_msg(LOG_LEVEL_INFO, "shard 0 of %d: all paths except %zu subtree(s) of other shards (shard plan: '%s')", plan->num_shards, plan->num_subtrees, filename);
+    }
+    return plan;
+}
+
+match_result shard_check(shard_plan_t *plan, const char *path) {
+    /* the subtrees are disjoint, so a path can only be in the last subtree
+     * sorted before it and the subtrees below a path directly follow it */
+    size_t low = 0;
+    size_t high = plan->num_subtrees;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (db_path_cmp(plan->subtrees[mid].path, path) <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low > 0 && in_subtree(path, plan->subtrees[low-1].path, plan->subtrees[low-1].len)) {
+        return plan->index ? 0 : RESULT_NO_LIMIT_MATCH;
+    }
+    if (plan->index == 0) {
+        return 0;
+    }
+    if (low < plan->num_subtrees && in_subtree(plan->subtrees[low].path, path, strlen(path))) {
+        /* parent directory of a subtree of the shard */
+        return RESULT_PARTIAL_LIMIT_MATCH;
+    }
+    return RESULT_NO_LIMIT_MATCH;
+}
+
+void shard_plan_free(shard_plan_t *plan) {
+    if (plan) {
+        for (size_t i = 0 ; i < plan->num_subtrees ; ++i) {
+            free(plan->subtrees[i].path);
+        }
+        free(plan->subtrees);
+        free(plan);
+    }
+}
+
+/* plan */
+
+typedef struct plan_node {
+    char *path;
+    long count; /* entries of the subtree (including the directory itself) */
+    long self; /* entries of the subtree not below a child directory */
+    size_t first_child;
+    size_t next_sibling;
+    int shard;
+} plan_node;
+
+static plan_node *plan_nodes = NULL;
+
+static int compare_count(const void *a, const void *b) {
+    const plan_node *n1 = &plan_nodes[*(const size_t *) a];
+    const plan_node *n2 = &plan_nodes[*(const size_t *) b];
+    if (n1->count != n2->count) {
+        return n1->count > n2->count ? -1 : 1;
+    }
+    return db_path_cmp(n1->path, n2->path);
+}
+
+static int compare_path(const void *a, const void *b) {
+    return db_path_cmp(plan_nodes[*(const size_t *) a].path, plan_nodes[*(const size_t *) b].path);
+}
+
+int shard_plan_write(database *db, int num_shards, FILE *out) {
+    /* node 0 is the (virtual) parent of all entries */
+    size_t num_nodes = 1;
+    size_t nodes_size = 1024;
+    plan_node *nodes = checked_malloc(nodes_size * sizeof(plan_node)); /* freed below */
+    nodes[0] = (plan_node) { .path = checked_strdup(""), .count = 0, .self = 0, .first_child = 0, .next_sibling = 0, .shard = 0 };
+
+    size_t *stack = checked_malloc(nodes_size * sizeof(size_t)); /* freed below */
+    size_t depth = 1;
+    stack[0] = 0;
+
+    /* the entries of a subtree are stored consecutively */
+    long num_entries = 0L;
+    db_entry_t entry;
+    while ((entry = db_readline(db, false)).line != NULL) {
+        const char *path = (entry.line)->filename;
+        while (depth > 1 && !in_subtree(path, nodes[stack[depth-1]].path, strlen(nodes[stack[depth-1]].path))) {
+            depth--;
+            nodes[stack[depth-1]].count += nodes[stack[depth]].count;
+        }
+        size_t parent = stack[depth-1];
+        if (S_ISDIR((entry.line)->perm)) {
+            if (num_nodes == nodes_size) {
+                nodes_size *= 2;
+                nodes = checked_realloc(nodes, nodes_size * sizeof(plan_node)); /* freed below */
+                stack = checked_realloc(stack, nodes_size * sizeof(size_t)); /* freed below */
+            }
+            nodes[num_nodes] = (plan_node) { .path = checked_strdup(path), .count = 1, .self = 1, .first_child = 0, .next_sibling = nodes[parent].first_child, .shard = 0 };
+            nodes[parent].first_child = num_nodes;
+            stack[depth++] = num_nodes++;
+        } else {
+            nodes[parent].count++;
+            nodes[parent].self++;
+        }
+        num_entries++;
+        free_db_line(entry.line);
+        free(entry.line);
+    }
+    while (depth > 1) {
+        depth--;
+        nodes[stack[depth-1]].count += nodes[stack[depth]].count;
+    }
+    free(stack);
+    log_msg(LOG_LEVEL_INFO, "plan %d shard(s) for %ld database entries (%zu directories)", num_shards, num_entries, num_nodes - 1);
+
+    /* split the largest subtree into its child directories until all
+     * subtrees are small enough, the entries of the split directories
+     * (which are not in a child directory) are left to shard 0 */
+    size_t max_subtrees = 64 * (size_t) num_shards;
+    size_t *subtrees = checked_malloc(max_subtrees * sizeof(size_t)); /* freed below */
+    size_t num_subtrees = 1;
+    subtrees[0] = 0;
+    long rest = 0L;
+    long threshold = num_entries / (4L * num_shards);
+    while (num_shards > 1) {
+        size_t largest = num_subtrees;
+        for (size_t i = 0 ; i < num_subtrees ; ++i) {
+            plan_node *node = &nodes[subtrees[i]];
+            if (node->first_child && node->count > threshold && (largest == num_subtrees || node->count > nodes[subtrees[largest]].count)) {
+                largest = i;
+            }
+        }
+        if (largest == num_subtrees) {
+            break;
+        }
+        size_t split = subtrees[largest];
+        size_t num_children = 0;
+        for (size_t child = nodes[split].first_child ; child ; child = nodes[child].next_sibling) {
+            num_children++;
+        }
+        if (num_subtrees - 1 + num_children > max_subtrees) {
+            log_msg(LOG_LEVEL_DEBUG, "shard plan: stop splitting at '%s' (%zu subtrees)", nodes[split].path, num_subtrees);
+            break;
+        }
+        log_msg(LOG_LEVEL_DEBUG, "shard plan: split '%s' (%ld entries) into %zu subtree(s)", nodes[split].path, nodes[split].count, num_children);
+        rest += nodes[split].self;
+        subtrees[largest] = subtrees[--num_subtrees];
+        for (size_t child = nodes[split].first_child ; child ; child = nodes[child].next_sibling) {
+            subtrees[num_subtrees++] = child;
+        }
+    }
+    if (num_subtrees == 1 && subtrees[0] == 0) {
+        /* nothing to split */
+        rest += nodes[0].count;
+        num_subtrees = 0;
+    }
+
+    /* longest processing time first */
+    plan_nodes = nodes;
+    qsort(subtrees, num_subtrees, sizeof(size_t), compare_count);
+    long *loads = checked_calloc(num_shards, sizeof(long)); /* freed below */
+    size_t *shard_subtrees = checked_calloc(num_shards, sizeof(size_t)); /* freed below */
+    loads[0] = rest;
+    for (size_t i = 0 ; i < num_subtrees ; ++i) {
+        int shard = 0;
+        for (int j = 1 ; j < num_shards ; ++j) {
+            if (loads[j] < loads[shard]) {
+                shard = j;
+            }
+        }
+        nodes[subtrees[i]].shard = shard;
+        loads[shard] += nodes[subtrees[i]].count;
+        shard_subtrees[shard]++;
+    }
+    qsort(subtrees, num_subtrees, sizeof(size_t), compare_path);
+    plan_nodes = NULL;
+
+    fprintf(out, "# AIDE shard plan for %s (%ld entries)\n", (db->url)->raw, num_entries);
+    for (int j = 0 ; j < num_shards ; ++j) {
+        log_msg(LOG_LEVEL_INFO, "shard %d: %ld entries (%zu subtree(s))", j, loads[j], shard_subtrees[j]);
+        fprintf(out, "# shard %d: %ld entries (%zu subtree(s))\n", j, loads[j], shard_subtrees[j]);
+    }
+    fprintf(out, "@@aide_shard_plan %d %d\n", SHARD_PLAN_VERSION, num_shards);
+    for (size_t i = 0 ; i < num_subtrees ; ++i) {
+        plan_node *node = &nodes[subtrees[i]];
+        char *safe_path = contains_unsafe(node->path) ? encode_string(node->path) : NULL;
+        fprintf(out, "%d %ld %s\n", node->shard, node->count, safe_path ? safe_path : node->path);
+        free(safe_path);
+    }
+
+    free(shard_subtrees);
+    free(loads);
+    free(subtrees);
+    for (size_t i = 0 ; i < num_nodes ; ++i) {
+        free(nodes[i].path);
+    }
+    free(nodes);
+
+    if (fflush(out) != 0 || ferror(out)) {
+        log_msg(LOG_LEVEL_ERROR, "failed to write shard plan: %s", strerror(errno));
+        return RETFAIL;
+    }
+    return RETOK;
+}
@@ -142,3 +142,14 @@ tree_node *tree_walk_next(tree_node *m) {
 void *tree_get_data(tree_node *n) {
     return n->data;
 }
+
+void tree_free(tree_node *root, void (*free_data)(void*)) {
+    if (root) {
+        tree_free(root->left, free_data);
+        tree_free(root->right, free_data);
+        if (free_data) {
+            free_data(root->data);
+        }
+        free(root);
+    }
+}
@@ -0,0 +1,244 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <pthread.h>
+
+#include "wsqueue.h"
+#include "log.h"
+#include "util.h"
+
+#define WSQUEUE_INITIAL_CAPACITY 256
+
+typedef struct wsdeque_s {
+    pthread_mutex_t mutex;
+
+    /* ring buffer, top is items[head], bottom is items[(head+count-1)%capacity] */
+    void **items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+
+    unsigned long num_popped;
+    unsigned long num_stolen;
+} wsdeque_t;
+
+struct wsqueue_s {
+    wsdeque_t **deques;
+    int num_deques;
+
+    /* number of work items pushed but not yet done */
+    long pending;
+    /* number of work items currently stored in any of the deques */
+    long queued;
+
+    pthread_mutex_t idle_mutex;
+    pthread_cond_t idle_cond;
+    int idle_workers;
+};
+
+LOG_LEVEL wsqueue_log_level = LOG_LEVEL_TRACE;
+
+static wsdeque_t *wsdeque_init(void) {
+    wsdeque_t *deque = checked_malloc(sizeof(wsdeque_t)); /* freed in wsqueue_free */
+    pthread_mutex_init(&deque->mutex, NULL);
+    deque->capacity = WSQUEUE_INITIAL_CAPACITY;
+    deque->items = checked_malloc(deque->capacity * sizeof(void*)); /* freed in wsqueue_free */
+    deque->head = 0;
+    deque->count = 0;
+    deque->num_popped = 0LU;
+    deque->num_stolen = 0LU;
+    return deque;
+}
+
+static void wsdeque_grow(wsdeque_t *deque) {
+    size_t new_capacity = 2 * deque->capacity;
+    void **items = checked_malloc(new_capacity * sizeof(void*));
+    for (size_t i = 0 ; i < deque->count ; ++i) {
+        items[i] = deque->items[(deque->head + i) % deque->capacity];
+    }
+    free(deque->items);
+    deque->items = items;
+    deque->capacity = new_capacity;
+    deque->head = 0;
+}
+
+/* caller has to hold deque->mutex */
+static void *wsdeque_pop_bottom(wsdeque_t *deque) {
+    if (deque->count == 0) {
+        return NULL;
+    }
+    deque->count--;
+    return deque->items[(deque->head + deque->count) % deque->capacity];
+}
+
+/* caller has to hold deque->mutex */
+static void *wsdeque_pop_top(wsdeque_t *deque) {
+    if (deque->count == 0) {
+        return NULL;
+    }
+    void *data = deque->items[deque->head];
+    deque->head = (deque->head + 1) % deque->capacity;
+    deque->count--;
+    return data;
+}
+
+wsqueue_t *wsqueue_init(int num_deques) {
+    wsqueue_t *queue = checked_malloc(sizeof(wsqueue_t));
+
+    queue->num_deques = num_deques > 0 ? num_deques : 1;
+    queue->deques = checked_malloc(queue->num_deques * sizeof(wsdeque_t*)); /* freed in wsqueue_free */
+    for (int i = 0 ; i < queue->num_deques ; ++i) {
+        queue->deques[i] = wsdeque_init();
+    }
+
+    queue->pending = 0L;
+    queue->queued = 0L;
+
+    pthread_mutex_init(&queue->idle_mutex, NULL);
+    pthread_cond_init(&queue->idle_cond, NULL);
+    queue->idle_workers = 0;
+
+    log_msg(wsqueue_log_level, "wsqueue(%p): create new work-stealing queue with %d deque(s)", (void*) queue, queue->num_deques);
+    return queue;
+}
+
+void wsqueue_free(wsqueue_t *queue) {
+    if (queue) {
+        for (int i = 0 ; i < queue->num_deques ; ++i) {
+            pthread_mutex_destroy(&queue->deques[i]->mutex);
+            free(queue->deques[i]->items);
+            free(queue->deques[i]);
+        }
+        free(queue->deques);
+        pthread_cond_destroy(&queue->idle_cond);
+        pthread_mutex_destroy(&queue->idle_mutex);
+        free(queue);
+    }
+}
+
+void wsqueue_push(wsqueue_t * const queue, int index, void * const data, const char *whoami) {
+    wsdeque_t *deque = queue->deques[index % queue->num_deques];
+
+    __atomic_add_fetch(&queue->pending, 1, __ATOMIC_SEQ_CST);
+
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count == deque->capacity) {
+        wsdeque_grow(deque);
+    }
+    deque->items[(deque->head + deque->count) % deque->capacity] = data;
+    deque->count++;
+    pthread_mutex_unlock(&deque->mutex);
+
+    log_msg(wsqueue_log_level, "wsqueue(%p): push payload %p to deque #%d", (void*) queue, (void*) data, index % queue->num_deques);
+
+    __atomic_add_fetch(&queue->queued, 1, __ATOMIC_SEQ_CST);
+
+    /* only take the idle mutex if there is a worker to wake up */
+    if (__atomic_load_n(&queue->idle_workers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&queue->idle_mutex);
+        pthread_cond_signal(&queue->idle_cond);
+        pthread_mutex_unlock(&queue->idle_mutex);
+        log_msg(LOG_LEVEL_THREAD, "%10s: wsqueue(%p): signal idle worker about new work item", whoami, (void*) queue);
+    }
+}
+
+static void *wsqueue_steal(wsqueue_t * const queue, int index) {
+    for (int i = 1 ; i < queue->num_deques ; ++i) {
+        int victim = (index + i) % queue->num_deques;
+        wsdeque_t *deque = queue->deques[victim];
+        if (__atomic_load_n(&deque->count, __ATOMIC_RELAXED) == 0) {
+            continue;
+        }
+        pthread_mutex_lock(&deque->mutex);
+        void *data = wsdeque_pop_top(deque);
+        pthread_mutex_unlock(&deque->mutex);
+        if (data) {
+            log_msg(wsqueue_log_level, "wsqueue(%p): deque #%d stole payload %p from deque #%d", (void*) queue, index, data, victim);
+            return data;
+        }
+    }
+    return NULL;
+}
+
+void *wsqueue_pop_wait(wsqueue_t * const queue, int index, const char *whoami) {
+    index %= queue->num_deques;
+    wsdeque_t *own = queue->deques[index];
+    while (true) {
+        pthread_mutex_lock(&own->mutex);
+        void *data = wsdeque_pop_bottom(own);
+        if (data) {
+            own->num_popped++;
+        }
+        pthread_mutex_unlock(&own->mutex);
+
+        if (data == NULL && (data = wsqueue_steal(queue, index)) != NULL) {
+            pthread_mutex_lock(&own->mutex);
+            own->num_popped++;
+            own->num_stolen++;
+            pthread_mutex_unlock(&own->mutex);
+        }
+
+        if (data) {
+            __atomic_sub_fetch(&queue->queued, 1, __ATOMIC_SEQ_CST);
+            log_msg(wsqueue_log_level, "wsqueue(%p): deque #%d returns payload %p", (void*) queue, index, data);
+            return data;
+        }
+
+        bool finished;
+        pthread_mutex_lock(&queue->idle_mutex);
+        __atomic_add_fetch(&queue->idle_workers, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&queue->queued, __ATOMIC_SEQ_CST) == 0
+                && __atomic_load_n(&queue->pending, __ATOMIC_SEQ_CST) > 0) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: wsqueue(%p): waiting for new work item", whoami, (void*) queue);
+            pthread_cond_wait(&queue->idle_cond, &queue->idle_mutex);
+            log_msg(LOG_LEVEL_THREAD, "%10s: wsqueue(%p): got signal (queued: %ld, pending: %ld)", whoami, (void*) queue,
+                    __atomic_load_n(&queue->queued, __ATOMIC_SEQ_CST), __atomic_load_n(&queue->pending, __ATOMIC_SEQ_CST));
+        }
+        __atomic_sub_fetch(&queue->idle_workers, 1, __ATOMIC_SEQ_CST);
+        finished = __atomic_load_n(&queue->pending, __ATOMIC_SEQ_CST) == 0;
+        pthread_mutex_unlock(&queue->idle_mutex);
+
+        if (finished) {
+            log_msg(wsqueue_log_level, "wsqueue(%p): deque #%d returns NULL (no pending work items)", (void*) queue, index);
+            return NULL;
+        }
+    }
+}
+
+void wsqueue_done(wsqueue_t * const queue, const char *whoami) {
+    if (__atomic_sub_fetch(&queue->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+        pthread_mutex_lock(&queue->idle_mutex);
+        pthread_cond_broadcast(&queue->idle_cond);
+        pthread_mutex_unlock(&queue->idle_mutex);
+        log_msg(LOG_LEVEL_THREAD, "%10s: wsqueue(%p): no pending work items left, broadcast idle workers", whoami, (void*) queue);
+    }
+}
+
+unsigned long wsqueue_get_num_popped(wsqueue_t * const queue, int index) {
+    return queue->deques[index % queue->num_deques]->num_popped;
+}
+
+unsigned long wsqueue_get_num_stolen(wsqueue_t * const queue, int index) {
+    return queue->deques[index % queue->num_deques]->num_stolen;
+}
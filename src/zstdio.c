@@ -0,0 +1,279 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zstd.h>
+
+#include "zstdio.h"
+#include "log.h"
+#include "util.h"
+
+struct zstd_reader_s {
+    int fd;
+    ZSTD_DCtx *dctx;
+
+    char *in;
+    ZSTD_inBuffer input;
+
+    /* decompressed data not yet returned by zstd_reader_gets */
+    char *out;
+    size_t out_size;
+    size_t out_pos;
+    size_t out_len;
+
+    /* return value of the last ZSTD_decompressStream call (0: frame complete) */
+    size_t frame_remaining;
+    /* last ZSTD_decompressStream call filled the output buffer (more data may be pending) */
+    bool output_full;
+    const char *error;
+};
+
+struct zstd_writer_s {
+    FILE *fp;
+    ZSTD_CCtx *cctx;
+    ZSTD_outBuffer output;
+
+    unsigned long long total_in;
+    unsigned long long total_out;
+};
+
+zstd_reader_t *zstd_reader_open(int fd) {
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (dctx == NULL) {
+        return NULL;
+    }
+    zstd_reader_t *r = checked_malloc(sizeof(zstd_reader_t)); /* freed in zstd_reader_close */
+    r->fd = fd;
+    r->dctx = dctx;
+    r->in = checked_malloc(ZSTD_DStreamInSize()); /* freed in zstd_reader_close */
+    r->input = (ZSTD_inBuffer) { r->in, 0, 0 };
+    r->out_size = ZSTD_DStreamOutSize();
+    r->out = checked_malloc(r->out_size); /* freed in zstd_reader_close */
+    r->out_pos = 0;
+    r->out_len = 0;
+    r->frame_remaining = 0;
+    r->output_full = false;
+    r->error = NULL;
+    return r;
+}
+
+/* returns number of decompressed bytes, 0 on end of stream and -1 on error */
+static ssize_t decompress(zstd_reader_t *r, void *buf, size_t count) {
+    ZSTD_outBuffer output = { buf, count, 0 };
+
+    while (output.pos == 0) {
+        if (r->input.pos == r->input.size && !r->output_full) {
+            ssize_t n;
+            do {
+                n = read(r->fd, r->in, ZSTD_DStreamInSize());
+            } while (n == -1 && errno == EINTR);
+            if (n == -1) {
+                r->error = strerror(errno);
+                return -1;
+            }
+            if (n == 0) {
+                if (r->frame_remaining != 0) {
+                    r->error = "unexpected end of stream";
+                    errno = EBADMSG;
+                    return -1;
+                }
+                return 0;
+            }
+            r->input.size = n;
+            r->input.pos = 0;
+        }
+        size_t ret = ZSTD_decompressStream(r->dctx, &output, &r->input);
+        if (ZSTD_isError(ret)) {
+            r->error = ZSTD_getErrorName(ret);
+            errno = EBADMSG;
+            return -1;
+        }
+        r->frame_remaining = ret;
+        r->output_full = output.pos == output.size;
+    }
+    return output.pos;
+}
+
+ssize_t zstd_reader_read(zstd_reader_t *r, void *buf, size_t count) {
+    if (r->out_pos < r->out_len) {
+        size_t n = r->out_len - r->out_pos;
+        if (n > count) {
+            n = count;
+        }
+        memcpy(buf, r->out + r->out_pos, n);
+        r->out_pos += n;
+        return n;
+    }
+    return decompress(r, buf, count);
+}
+
+char *zstd_reader_gets(zstd_reader_t *r, char *buf, size_t size) {
+    size_t len = 0;
+
+    if (size == 0) {
+        return NULL;
+    }
+    while (len < size - 1) {
+        if (r->out_pos == r->out_len) {
+            ssize_t n = decompress(r, r->out, r->out_size);
+            if (n <= 0) {
+                r->out_pos = r->out_len = 0;
+                if (n < 0 || len == 0) {
+                    return NULL;
+                }
+                break;
+            }
+            r->out_pos = 0;
+            r->out_len = n;
+        }
+        size_t n = r->out_len - r->out_pos;
+        if (n > size - 1 - len) {
+            n = size - 1 - len;
+        }
+        char *newline = memchr(r->out + r->out_pos, '\n', n);
+        if (newline) {
+            n = newline - (r->out + r->out_pos) + 1;
+        }
+        memcpy(buf + len, r->out + r->out_pos, n);
+        r->out_pos += n;
+        len += n;
+        if (newline) {
+            break;
+        }
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+const char *zstd_reader_error(zstd_reader_t *r) {
+    return r->error;
+}
+
+void zstd_reader_close(zstd_reader_t *r) {
+    if (r) {
+        ZSTD_freeDCtx(r->dctx);
+        free(r->in);
+        free(r->out);
+        free(r);
+    }
+}
+
+static int write_output(zstd_writer_t *w) {
+    if (w->output.pos && fwrite(w->output.dst, 1, w->output.pos, w->fp) != w->output.pos) {
+        return -1;
+    }
+    w->total_out += w->output.pos;
+    w->output.pos = 0;
+    return 0;
+}
+
+zstd_writer_t *zstd_writer_open(FILE *fp, int level, int num_threads) {
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    if (cctx == NULL) {
+        return NULL;
+    }
+    size_t ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    if (!ZSTD_isError(ret)) {
+        ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+    }
+    if (ZSTD_isError(ret)) {
+        log_msg(LOG_LEVEL_ERROR, "zstd: failed to set compression parameters: %s", ZSTD_getErrorName(ret));
+        ZSTD_freeCCtx(cctx);
+        return NULL;
+    }
+    if (num_threads > 0) {
+        ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, num_threads);
+        if (ZSTD_isError(ret)) {
+            log_msg(LOG_LEVEL_WARNING, "zstd: multithreaded compression not supported by libzstd, fall back to single thread (%s)", ZSTD_getErrorName(ret));
+            num_threads = 0;
+        }
+    }
+
+    zstd_writer_t *w = checked_malloc(sizeof(zstd_writer_t)); /* freed in zstd_writer_close */
+    w->fp = fp;
+    w->cctx = cctx;
+    w->output.size = ZSTD_CStreamOutSize();
+    w->output.dst = checked_malloc(w->output.size); /* freed in zstd_writer_close */
+    w->output.pos = 0;
+    w->total_in = 0;
+    w->total_out = 0;
+    log_msg(LOG_LEVEL_DEBUG, "zstd(%p): compress with level %d using %d worker thread(s)", (void*) w, level, num_threads);
+    return w;
+}
+
+int zstd_writer_write(zstd_writer_t *w, const char *data, size_t len) {
+    ZSTD_inBuffer input = { data, len, 0 };
+
+    /* in multithreaded mode not all input is necessarily consumed at once */
+    while (input.pos < input.size) {
+        size_t ret = ZSTD_compressStream2(w->cctx, &w->output, &input, ZSTD_e_continue);
+        if (ZSTD_isError(ret)) {
+            log_msg(LOG_LEVEL_ERROR, "zstd: compression failed: %s", ZSTD_getErrorName(ret));
+            errno = EIO;
+            return -1;
+        }
+        if (w->output.pos == w->output.size && write_output(w) != 0) {
+            return -1;
+        }
+    }
+    w->total_in += len;
+    return 0;
+}
+
+int zstd_writer_close(zstd_writer_t *w) {
+    int retval = 0;
+    ZSTD_inBuffer input = { NULL, 0, 0 };
+    size_t remaining;
+
+    do {
+        remaining = ZSTD_compressStream2(w->cctx, &w->output, &input, ZSTD_e_end);
+        if (ZSTD_isError(remaining)) {
+            log_msg(LOG_LEVEL_ERROR, "zstd: compression failed: %s", ZSTD_getErrorName(remaining));
+            errno = EIO;
+            retval = -1;
+            break;
+        }
+        /* ZSTD_e_end blocks until output is flushed, no output means no progress */
+        if (remaining != 0 && w->output.pos == 0) {
+            log_msg(LOG_LEVEL_ERROR, "zstd: compression failed: no progress while finishing the frame (%zu bytes remaining)", remaining);
+            errno = EIO;
+            retval = -1;
+            break;
+        }
+        if (write_output(w) != 0) {
+            retval = -1;
+            break;
+        }
+    } while (remaining != 0);
+
+    log_msg(LOG_LEVEL_DEBUG, "zstd(%p): compressed %llu bytes to %llu bytes", (void*) w, w->total_in, w->total_out);
+    ZSTD_freeCCtx(w->cctx);
+    free(w->output.dst);
+    free(w);
+    return retval;
+}
@@ -18,11 +18,98 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <ftw.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 
+#include "attributes.h"
+#include "base64.h"
 #include "check_aide.h"
+#include "db_config.h"
 #include "hashsum.h"
 #include "log.h"
+#include "md.h"
+#include "util.h"
+
+db_config* conf;
+
+char *test_dir = NULL;
+static db_config *conf_saved = NULL;
+
+void setup_conf(void) {
+    conf_saved = conf;
+    conf = checked_calloc(1, sizeof(db_config));
+    conf->database_out_buffer_size = 64*1024;
+}
+
+void teardown_conf(void) {
+    free(conf);
+    conf = conf_saved;
+}
+
+void setup_test_dir(void) {
+    char template[] = "/tmp/check_aide.XXXXXX";
+    char *dir = mkdtemp(template);
+    ck_assert(dir != NULL);
+    test_dir = checked_strdup(dir);
+    setup_conf();
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void) st; (void) flag; (void) ftw;
+    return remove(path);
+}
+
+void teardown_test_dir(void) {
+    teardown_conf();
+    nftw(test_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    free(test_dir);
+    test_dir = NULL;
+}
+
+/* returns the path of name in the test directory (absolute paths are kept) */
+char *get_test_path(const char *name) {
+    if (name[0] == '/') {
+        return checked_strdup(name);
+    }
+    char *path = checked_malloc(strlen(test_dir) + strlen(name) + 2);
+    sprintf(path, "%s/%s", test_dir, name);
+    return path;
+}
+
+url_t *new_file_url(const char *name) {
+    url_t *url = checked_malloc(sizeof(url_t));
+    url->type = url_file;
+    url->value = get_test_path(name);
+    url->raw = checked_malloc(strlen(url->value) + 6);
+    sprintf(url->raw, "file:%s", url->value);
+    return url;
+}
+
+/* returns the '@@delta_db' hashsums of a database file */
+char *get_parent_hashsums(const char *name) {
+    char *path = get_test_path(name);
+    struct md_container mdc = { .todo_attr = ATTR(attr_sha256) };
+    init_md(&mdc, path, NULL);
+    FILE *fp = fopen(path, "r");
+    ck_assert(fp != NULL);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        update_md(&mdc, buf, n);
+    }
+    fclose(fp);
+    md_hashsums hs;
+    close_md(&mdc, &hs, path, NULL);
+    free(path);
+    char *enc = encode_base64(hs.hashsums[hash_sha256], hashsums[hash_sha256].length);
+    char *str = checked_malloc(strlen(enc) + 8);
+    sprintf(str, "sha256:%s", enc);
+    free(enc);
+    return str;
+}
 
 int main (void) {
     int number_failed;
@@ -35,6 +122,13 @@ int main (void) {
     srunner_add_suite(sr, make_progress_suite());
     srunner_add_suite(sr, make_seltree_suite());
     srunner_add_suite(sr, make_hashsum_suite());
+    srunner_add_suite(sr, make_db_suite());
+    srunner_add_suite(sr, make_db_disk_suite());
+    srunner_add_suite(sr, make_db_index_suite());
+    srunner_add_suite(sr, make_db_merge_suite());
+    srunner_add_suite(sr, make_shard_suite());
+    srunner_add_suite(sr, make_checkpoint_suite());
+    srunner_add_suite(sr, make_daemon_suite());
 
     set_log_level(LOG_LEVEL_DEBUG);
     set_colored_log(false);
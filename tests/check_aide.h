@@ -20,8 +20,35 @@
 
 #include <check.h>
 
+#include "url.h"
+
 Suite *make_attributes_suite(void);
 Suite *make_base64_suite(void);
+Suite *make_db_suite(void);
+Suite *make_db_disk_suite(void);
+Suite *make_db_index_suite(void);
+Suite *make_db_merge_suite(void);
+Suite *make_shard_suite(void);
+Suite *make_checkpoint_suite(void);
+Suite *make_daemon_suite(void);
 Suite *make_progress_suite(void);
 Suite *make_seltree_suite(void);
 Suite *make_hashsum_suite(void);
+
+/*
+ * Fixtures shared by the suites
+ *
+ * setup_conf() replaces the global configuration by a new one,
+ * setup_test_dir() additionally creates a temporary directory which is
+ * removed with its contents by teardown_test_dir()
+ */
+extern char *test_dir;
+
+void setup_conf(void);
+void teardown_conf(void);
+void setup_test_dir(void);
+void teardown_test_dir(void);
+
+char *get_test_path(const char *);
+url_t *new_file_url(const char *);
+char *get_parent_hashsums(const char *);
@@ -0,0 +1,229 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2025 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <check.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "attributes.h"
+#include "check_aide.h"
+#include "checkpoint.h"
+#include "db_config.h"
+#include "db_file.h"
+#include "db_line.h"
+#include "gen_list.h"
+#include "log.h"
+#include "seltree.h"
+#include "seltree_struct.h"
+#include "util.h"
+
+extern db_config* conf;
+
+#define LINE_ATTRS (ATTR(attr_filename)|ATTR(attr_perm)|ATTR(attr_size))
+
+typedef struct {
+    const char *path;
+    long long size; /* -1 for directories */
+} checkpoint_entry_t;
+
+static char *checkpoint_path = NULL;
+
+static db_line *new_line(checkpoint_entry_t entry) {
+    db_line *line = checked_calloc(1, sizeof(db_line));
+    line->fullpath = checked_strdup(entry.path);
+    line->filename = line->fullpath;
+    line->perm = entry.size < 0 ? S_IFDIR|0755 : S_IFREG|0644;
+    line->size = entry.size < 0 ? 4096 : entry.size;
+    line->attr = LINE_ATTRS;
+    return line;
+}
+
+static void commit_dir(const char *path, checkpoint_entry_t *entries, size_t num_entries) {
+    checkpoint_batch *batch = checkpoint_batch_new();
+    for (size_t i = 0 ; i < num_entries ; ++i) {
+        db_line *line = new_line(entries[i]);
+        checkpoint_batch_add(batch, line);
+        free_db_line(line);
+        free(line);
+    }
+    ck_assert_msg(checkpoint_batch_commit(batch, path), "failed to commit directory '%s'", path);
+}
+
+/* the subdirectory is completed before its parent directory */
+static checkpoint_entry_t sub_entries[] = { { "/a/sub/g", 2 } };
+static checkpoint_entry_t a_entries[] = { { "/a/f", 1 }, { "/a/sub", -1 } };
+static checkpoint_entry_t b_entries[] = { { "/b/x", 1 } };
+static checkpoint_entry_t b_entries_again[] = { { "/b/x", 5 }, { "/b/y", 6 } };
+
+static void write_checkpoint(void) {
+    ck_assert(checkpoint_open(false));
+    commit_dir("/a/sub", sub_entries, sizeof(sub_entries)/sizeof(checkpoint_entry_t));
+    commit_dir("/a", a_entries, sizeof(a_entries)/sizeof(checkpoint_entry_t));
+    commit_dir("/b", b_entries, sizeof(b_entries)/sizeof(checkpoint_entry_t));
+    commit_dir("/b", b_entries_again, sizeof(b_entries_again)/sizeof(checkpoint_entry_t));
+    checkpoint_close(false);
+}
+
+static off_t get_checkpoint_size(void) {
+    struct stat st;
+    ck_assert(stat(checkpoint_path, &st) == 0);
+    return st.st_size;
+}
+
+static void check_replayed(checkpoint_entry_t *expected, size_t num_expected) {
+    for (size_t i = 0 ; i < num_expected ; ++i) {
+        seltree *node = get_seltree_node(conf->tree, (char *) expected[i].path);
+        ck_assert_msg(node != NULL && node->new_data != NULL, "'%s' has not been replayed", expected[i].path);
+        long long size = expected[i].size < 0 ? 4096 : expected[i].size;
+        ck_assert_msg((node->new_data)->size == size, "'%s': replayed size %lld (expected: %lld)",
+                expected[i].path, (node->new_data)->size, size);
+    }
+}
+
+static void setup(void) {
+    setup_test_dir();
+    checkpoint_path = get_test_path("aide.db.checkpoint");
+
+    conf->action = DO_INIT;
+    conf->db_out_attrs = LINE_ATTRS|ATTR(attr_attr);
+    conf->tree = init_tree();
+    conf->database_out.url = new_file_url("aide.db");
+}
+
+static void teardown(void) {
+    checkpoint_close(true);
+    teardown_test_dir();
+    free(checkpoint_path);
+}
+
+START_TEST (test_replay) {
+    write_checkpoint();
+    ck_assert(checkpoint_open(true));
+
+    /* the completed subdirectory is replayed with its parent */
+    ck_assert(checkpoint_replay("/a", "test"));
+    checkpoint_entry_t a_expected[] = { { "/a/f", 1 }, { "/a/sub", -1 }, { "/a/sub/g", 2 } };
+    check_replayed(a_expected, sizeof(a_expected)/sizeof(checkpoint_entry_t));
+
+    /* the last '@@done' of a directory wins */
+    ck_assert(checkpoint_replay("/b", "test"));
+    check_replayed(b_entries_again, sizeof(b_entries_again)/sizeof(checkpoint_entry_t));
+
+    ck_assert_msg(checkpoint_replay("/c", "test") == false, "'/c' has been replayed");
+    ck_assert_msg(checkpoint_replay("/a/su", "test") == false, "'/a/su' has been replayed");
+}
+END_TEST
+
+START_TEST (test_incomplete_directory) {
+    write_checkpoint();
+    off_t size = get_checkpoint_size();
+
+    /* entries of '/c' without '@@done' line, the last line is incomplete */
+    char *data = NULL;
+    size_t len = 0, data_size = 0;
+    checkpoint_entry_t c_entries[] = { { "/c/z", 3 }, { "/c/w", 4 } };
+    for (size_t i = 0 ; i < sizeof(c_entries)/sizeof(checkpoint_entry_t) ; ++i) {
+        db_line *line = new_line(c_entries[i]);
+        db_append_line_file(line, &data, &len, &data_size);
+        free_db_line(line);
+        free(line);
+    }
+    FILE *fp = fopen(checkpoint_path, "a");
+    ck_assert(fp != NULL);
+    ck_assert(fwrite(data, 1, len - 3, fp) == len - 3);
+    fclose(fp);
+    free(data);
+
+    ck_assert(checkpoint_open(true));
+    ck_assert_msg(get_checkpoint_size() == size, "checkpoint has not been truncated (size: %lld, expected: %lld)",
+            (long long) get_checkpoint_size(), (long long) size);
+    ck_assert_msg(checkpoint_replay("/c", "test") == false, "incomplete directory '/c' has been replayed");
+    ck_assert(checkpoint_replay("/a", "test"));
+
+    /* directories completed after resume are appended */
+    commit_dir("/c", c_entries, sizeof(c_entries)/sizeof(checkpoint_entry_t));
+    checkpoint_close(false);
+    ck_assert(checkpoint_open(true));
+    ck_assert(checkpoint_replay("/c", "test"));
+    check_replayed(c_entries, sizeof(c_entries)/sizeof(checkpoint_entry_t));
+}
+END_TEST
+
+typedef struct {
+    const char *desc;
+    int action;
+    char *limit;
+    DB_ATTR_TYPE db_out_attrs;
+    char *config_version;
+    char *config_digest;
+    bool resumed;
+} header_test_t;
+
+#define CONFIG_DIGEST "sha256:AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA="
+#define OTHER_DIGEST "sha256:BAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA="
+
+static header_test_t header_tests[] = {
+    { "same configuration",       DO_INIT,             NULL,  LINE_ATTRS|ATTR(attr_attr), "1",  CONFIG_DIGEST, true  },
+    { "different command",        DO_INIT|DO_COMPARE,  NULL,  LINE_ATTRS|ATTR(attr_attr), "1",  CONFIG_DIGEST, false },
+    { "different limit",          DO_INIT,             "/a",  LINE_ATTRS|ATTR(attr_attr), "1",  CONFIG_DIGEST, false },
+    { "different fields",         DO_INIT,             NULL,  ATTR(attr_filename)|ATTR(attr_perm)|ATTR(attr_attr), "1", CONFIG_DIGEST, false },
+    { "different config version", DO_INIT,             NULL,  LINE_ATTRS|ATTR(attr_attr), "2",  CONFIG_DIGEST, false },
+    { "no config version",        DO_INIT,             NULL,  LINE_ATTRS|ATTR(attr_attr), NULL, CONFIG_DIGEST, false },
+    { "different configuration",  DO_INIT,             NULL,  LINE_ATTRS|ATTR(attr_attr), "1",  OTHER_DIGEST,  false },
+};
+
+START_TEST (test_header_mismatch) {
+    header_test_t t = header_tests[_i];
+    conf->config_version = "1";
+    conf->config_digest = CONFIG_DIGEST;
+    write_checkpoint();
+    off_t size = get_checkpoint_size();
+
+    conf->action = t.action;
+    conf->limit = t.limit;
+    conf->db_out_attrs = t.db_out_attrs;
+    conf->config_version = t.config_version;
+    conf->config_digest = t.config_digest;
+    ck_assert(checkpoint_open(true));
+    ck_assert_msg(checkpoint_replay("/b", "test") == t.resumed, "%s: '/b' %s been replayed", t.desc, t.resumed ? "has not" : "has");
+    if (!t.resumed) {
+        ck_assert_msg(get_checkpoint_size() < size, "%s: ignored checkpoint has not been truncated", t.desc);
+    }
+}
+END_TEST
+
+Suite *make_checkpoint_suite(void) {
+
+    Suite *s = suite_create ("checkpoint");
+
+    TCase *tc_resume = tcase_create ("resume");
+
+    tcase_add_checked_fixture(tc_resume, setup, teardown);
+    tcase_add_test (tc_resume, test_replay);
+    tcase_add_test (tc_resume, test_incomplete_directory);
+    tcase_add_loop_test (tc_resume, test_header_mismatch, 0, sizeof(header_tests)/sizeof(header_test_t));
+
+    suite_add_tcase (s, tc_resume);
+
+    return s;
+}
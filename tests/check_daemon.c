@@ -0,0 +1,176 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2025 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <check.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check_aide.h"
+#include "commandconf.h"
+#include "daemon.h"
+#include "db_config.h"
+#include "errorcodes.h"
+#include "list.h"
+#include "log.h"
+#include "report.h"
+#include "url.h"
+#include "util.h"
+
+extern db_config* conf;
+
+typedef struct {
+    const char *request;
+    bool applied;
+    const char *limit;
+    REPORT_FORMAT report_format;
+    const char *error; /* prefix of the '@@aide_error' message */
+} request_test_t;
+
+static request_test_t request_tests[] = {
+    { "limit=/etc\nreport_format=json\n\n", true,  "/etc", REPORT_FORMAT_JSON,    NULL },
+    { "limit=/etc",                         true,  "/etc", REPORT_FORMAT_UNKNOWN, NULL },
+    { "\n",                                 true,  NULL,   REPORT_FORMAT_UNKNOWN, NULL },
+    { "",                                   true,  NULL,   REPORT_FORMAT_UNKNOWN, NULL },
+    /* the request ends with the empty line */
+    { "limit=/etc\n\nfoo=bar\n",            true,  "/etc", REPORT_FORMAT_UNKNOWN, NULL },
+    { "foo=bar\n\n",                        false, NULL,   REPORT_FORMAT_UNKNOWN, "line 1: unknown key 'foo'" },
+    { "=/etc\n\n",                          false, NULL,   REPORT_FORMAT_UNKNOWN, "line 1: unknown key ''" },
+    { "limit=/etc\nlimit\n\n",              false, NULL,   REPORT_FORMAT_UNKNOWN, "line 2: missing '=': 'limit'" },
+    { "limit=/etc\nlimit=/usr\n\n",         false, NULL,   REPORT_FORMAT_UNKNOWN, "line 2: limit already set" },
+    { "limit=(\n\n",                        false, NULL,   REPORT_FORMAT_UNKNOWN, "error in regular expression of limit '('" },
+    { "report_format=xml\n\n",              false, NULL,   REPORT_FORMAT_UNKNOWN, "line 1: invalid report format: 'xml'" },
+    { "report_url=stdin\n\n",               false, NULL,   REPORT_FORMAT_UNKNOWN, "line 1: invalid report URL: 'stdin'" },
+};
+
+static FILE *output = NULL;
+static int stdout_saved = -1;
+
+static void setup(void) {
+    setup_conf();
+    conf->report_level = REPORT_LEVEL_CHANGED_ATTRIBUTES;
+    conf->report_format = REPORT_FORMAT_PLAIN;
+    ck_assert(do_repurldef(checked_strdup("stdout"), 0, "(default)", NULL));
+
+    /* the errors are sent to the client on stdout */
+    output = tmpfile();
+    ck_assert(output != NULL);
+    fflush(stdout);
+    stdout_saved = dup(STDOUT_FILENO);
+    ck_assert(stdout_saved != -1 && dup2(fileno(output), STDOUT_FILENO) != -1);
+}
+
+static void restore_stdout(void) {
+    if (stdout_saved != -1) {
+        fflush(stdout);
+        dup2(stdout_saved, STDOUT_FILENO);
+        close(stdout_saved);
+        stdout_saved = -1;
+    }
+}
+
+static void teardown(void) {
+    restore_stdout();
+    fclose(output);
+    teardown_conf();
+}
+
+/* returns the output sent to the client */
+static char *get_output(void) {
+    restore_stdout();
+    rewind(output);
+    char *data = checked_calloc(1, 4096);
+    size_t len = fread(data, 1, 4095, output);
+    data[len] = '\0';
+    return data;
+}
+
+START_TEST (test_apply_request) {
+    request_test_t t = request_tests[_i];
+    char *request = checked_strdup(t.request);
+    bool applied = daemon_apply_request(request);
+    free(request);
+    char *sent = get_output();
+
+    ck_assert_msg(applied == t.applied, "request '%s': applied: %d (expected: %d)", t.request, applied, t.applied);
+    if (t.applied) {
+        ck_assert_msg(sent[0] == '\0', "request '%s': unexpected output '%s'", t.request, sent);
+        ck_assert_msg(t.limit ? conf->limit && strcmp(conf->limit, t.limit) == 0 : conf->limit == NULL,
+                "request '%s': limit '%s' (expected: '%s')", t.request, conf->limit, t.limit);
+        ck_assert_msg(t.limit == NULL || conf->limit_crx != NULL, "request '%s': limit not compiled", t.request);
+        REPORT_FORMAT format = t.report_format ? t.report_format : REPORT_FORMAT_PLAIN;
+        ck_assert_msg(conf->report_format == format, "request '%s': report format %d (expected: %d)", t.request, conf->report_format, format);
+    } else {
+        char exit_line[32];
+        snprintf(exit_line, sizeof(exit_line), "\n@@aide_exit %d\n", INVALID_ARGUMENT_ERROR);
+        size_t sent_len = strlen(sent);
+        size_t exit_len = strlen(exit_line);
+        ck_assert_msg(strncmp(sent, "@@aide_error ", 13) == 0 && strncmp(sent + 13, t.error, strlen(t.error)) == 0,
+                "request '%s': sent '%s' (expected: '@@aide_error %s...')", t.request, sent, t.error);
+        ck_assert_msg(sent_len > exit_len && strcmp(sent + sent_len - exit_len, exit_line) == 0
+                && strchr(sent, '\n') == sent + sent_len - exit_len,
+                "request '%s': sent '%s' (expected a single error line followed by '@@aide_exit %d')", t.request, sent, INVALID_ARGUMENT_ERROR);
+    }
+    free(sent);
+}
+END_TEST
+
+START_TEST (test_report_urls) {
+    char request[] = "report_url=file:/tmp/report1\nreport_format=json\nreport_url=file:/tmp/report2\n\n";
+    ck_assert(daemon_apply_request(request));
+    char *sent = get_output();
+    ck_assert_msg(sent[0] == '\0', "unexpected output '%s'", sent);
+    free(sent);
+
+    /* the report URLs of the request replace the configured ones */
+    const char *expected[] = { "/tmp/report1", "/tmp/report2" };
+    bool found[2] = { false, false };
+    int num = 0;
+    for (list *l = conf->report_urls; l; l = l->next) {
+        report_t *r = l->data;
+        ck_assert_msg((r->url)->type == url_file, "unexpected report URL '%s'", (r->url)->raw);
+        for (int i = 0 ; i < 2 ; ++i) {
+            if (strcmp((r->url)->value, expected[i]) == 0) {
+                found[i] = true;
+            }
+        }
+        ck_assert_msg(r->format == REPORT_FORMAT_JSON, "report URL '%s': format %d (expected: %d)", (r->url)->raw, r->format, REPORT_FORMAT_JSON);
+        num++;
+    }
+    ck_assert_msg(num == 2 && found[0] && found[1], "%d report URLs (expected: %s, %s)", num, expected[0], expected[1]);
+}
+END_TEST
+
+Suite *make_daemon_suite(void) {
+
+    Suite *s = suite_create ("daemon");
+
+    TCase *tc_request = tcase_create ("request");
+
+    tcase_add_checked_fixture(tc_request, setup, teardown);
+    tcase_add_loop_test (tc_request, test_apply_request, 0, sizeof(request_tests)/sizeof(request_test_t));
+    tcase_add_test (tc_request, test_report_urls);
+
+    suite_add_tcase (s, tc_request);
+
+    return s;
+}
@@ -0,0 +1,319 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2025 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <check.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "attributes.h"
+#include "check_aide.h"
+#include "db.h"
+#include "db_config.h"
+#include "gen_list.h"
+#include "hashsum.h"
+#include "log.h"
+#include "progress.h"
+#include "seltree.h"
+#include "seltree_struct.h"
+#include "util.h"
+
+extern db_config* conf;
+
+#define LINE_ATTRS (ATTR(attr_filename)|ATTR(attr_perm)|ATTR(attr_inode)|ATTR(attr_size) \
+        |ATTR(attr_mtime)|ATTR(attr_sha256))
+
+#define CHANGED_ENTRY 10
+#define REMOVED_ENTRY 20
+#define ADDED_ENTRY "/added"
+
+static db_config *new_conf(int action) {
+    db_config *c = checked_calloc(1, sizeof(db_config));
+    c->action = action;
+    c->db_out_attrs = LINE_ATTRS|ATTR(attr_attr);
+    c->database_out_buffer_size = 64*1024;
+    c->tree = init_tree();
+    return c;
+}
+
+static db_line *new_line(const char *name, long i, long long size) {
+    db_line *line = checked_calloc(1, sizeof(db_line));
+    line->fullpath = checked_strdup(name);
+    line->filename = line->fullpath;
+    line->perm = S_IFREG|0644;
+    line->inode = i + 1;
+    line->size = size;
+    line->mtime = 1700000000 + i;
+    line->hashsums[hash_sha256] = checked_malloc(32);
+    for (int j = 0 ; j < 32 ; ++j) {
+        line->hashsums[hash_sha256][j] = (i * 31 + j) & 0xff;
+    }
+    line->attr = LINE_ATTRS;
+    return line;
+}
+
+/* adds num entries, the modified set has one entry changed, one removed and one added */
+static void add_lines(seltree *tree, long num, bool modified) {
+    char name[32];
+    for (long i = 0 ; i < num ; ++i) {
+        if (modified && i == REMOVED_ENTRY) {
+            continue;
+        }
+        snprintf(name, sizeof(name), "/d%03ld/f%05ld", i / 100, i);
+        add_file_to_tree(tree, new_line(name, i, modified && i == CHANGED_ENTRY ? 2 * i + 1 : 2 * i), DB_NEW|DB_DISK, NULL, NULL, NULL);
+    }
+    if (modified) {
+        add_file_to_tree(tree, new_line(ADDED_ENTRY, num, 0), DB_NEW|DB_DISK, NULL, NULL, NULL);
+    }
+}
+
+static void write_database(const char *path, long num, bool modified, long num_workers) {
+    db_config *conf_saved = conf;
+    conf = new_conf(DO_INIT);
+    conf->num_workers = num_workers;
+    add_lines(conf->tree, num, modified);
+    conf->database_out.url = new_file_url(path);
+    ck_assert(db_init(&conf->database_out, false, false) == RETOK);
+    ck_assert(db_writespec(conf) == RETOK);
+    write_tree(conf->tree);
+    progress_stop();
+    db_close();
+    free(conf);
+    conf = conf_saved;
+}
+
+/* reverses the order of the entries of a text database */
+static void reverse_database(const char *path) {
+    FILE *fp = fopen(path, "r");
+    ck_assert(fp != NULL);
+    char **lines = NULL;
+    size_t num = 0;
+    char *line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, fp) != -1) {
+        lines = checked_realloc(lines, (num + 1) * sizeof(char *));
+        lines[num++] = checked_strdup(line);
+    }
+    free(line);
+    fclose(fp);
+
+    size_t first = 0, last = num;
+    while (first < num && strncmp(lines[first], "@@db_spec", 9)) { first++; }
+    while (last > 0 && strncmp(lines[last - 1], "@@end_db", 8)) { last--; }
+    ck_assert(first < num && last > first + 1);
+
+    fp = fopen(path, "w");
+    ck_assert(fp != NULL);
+    for (size_t i = 0 ; i <= first ; ++i) {
+        fputs(lines[i], fp);
+    }
+    for (size_t i = last - 1 ; i > first + 1 ; --i) {
+        fputs(lines[i - 1], fp);
+    }
+    for (size_t i = last - 1 ; i < num ; ++i) {
+        fputs(lines[i], fp);
+    }
+    fclose(fp);
+    for (size_t i = 0 ; i < num ; ++i) {
+        free(lines[i]);
+    }
+    free(lines);
+}
+
+#define NUM_COMPARE_ENTRIES 1000
+
+START_TEST (test_compare_databases) {
+    bool sorted = _i == 0;
+    log_msg(LOG_LEVEL_INFO, "test_compare_databases: new database %s", sorted ? "sorted" : "not sorted");
+
+    char *old_path = get_test_path("old.db");
+    char *new_path = get_test_path("new.db");
+    write_database(old_path, NUM_COMPARE_ENTRIES, false, 0);
+    write_database(new_path, NUM_COMPARE_ENTRIES, true, 0);
+    if (!sorted) {
+        reverse_database(new_path);
+    }
+
+    db_config *conf_saved = conf;
+    conf = new_conf(DO_DIFF);
+    conf->database_in.url = new_file_url(old_path);
+    conf->database_new.url = new_file_url(new_path);
+    ck_assert(db_init(&conf->database_in, true, false) == RETOK);
+    ck_assert(db_init(&conf->database_new, true, false) == RETOK);
+    populate_tree(conf->tree);
+    progress_stop();
+    db_close();
+
+    char name[32];
+    for (long i = 0 ; i < NUM_COMPARE_ENTRIES ; ++i) {
+        snprintf(name, sizeof(name), "/d%03ld/f%05ld", i / 100, i);
+        seltree *node = get_seltree_node(conf->tree, name);
+        if (i == CHANGED_ENTRY) {
+            ck_assert_msg(node && (node->checked&(DB_OLD|DB_NEW)) == (DB_OLD|DB_NEW) && node->changed_attrs == ATTR(attr_size),
+                    "'%s' is not reported as changed", name);
+        } else if (i == REMOVED_ENTRY) {
+            ck_assert_msg(node && (node->checked&(DB_OLD|DB_NEW)) == DB_OLD, "'%s' is not reported as removed", name);
+        } else {
+            ck_assert_msg(node == NULL || (node->old_data == NULL && node->new_data == NULL && node->changed_attrs == 0),
+                    "unchanged '%s' is reported", name);
+        }
+    }
+    seltree *node = get_seltree_node(conf->tree, ADDED_ENTRY);
+    ck_assert_msg(node && (node->checked&(DB_OLD|DB_NEW)) == DB_NEW, "'%s' is not reported as added", ADDED_ENTRY);
+    if (sorted) {
+        ck_assert_msg(conf->num_unchanged_streamed == NUM_COMPARE_ENTRIES - 2,
+                "%ld unchanged entries streamed (expected: %d)", conf->num_unchanged_streamed, NUM_COMPARE_ENTRIES - 2);
+    }
+
+    free(conf);
+    conf = conf_saved;
+    free(old_path);
+    free(new_path);
+}
+END_TEST
+
+/* the database is larger than a single parser chunk */
+#define NUM_PARSE_ENTRIES 20000
+
+static long parse_threads[] = { 1, 2, 4, 8 };
+
+static db_line **read_database(const char *path, long database_parse_threads, long *num) {
+    db_config *conf_saved = conf;
+    conf = new_conf(DO_COMPARE);
+    conf->database_parse_threads = database_parse_threads;
+    conf->database_in.url = new_file_url(path);
+    ck_assert(db_init(&conf->database_in, true, false) == RETOK);
+
+    db_line **lines = NULL;
+    *num = 0;
+    db_entry_t entry;
+    while ((entry = db_readline(&conf->database_in, false)).line != NULL) {
+        lines = checked_realloc(lines, (*num + 1) * sizeof(db_line *));
+        lines[(*num)++] = entry.line;
+    }
+    db_close();
+    free(conf);
+    conf = conf_saved;
+    return lines;
+}
+
+START_TEST (test_parse_database) {
+    long threads = parse_threads[_i];
+    log_msg(LOG_LEVEL_INFO, "test_parse_database: database_parse_threads: %ld", threads);
+
+    char *path = get_test_path("aide.db");
+    write_database(path, NUM_PARSE_ENTRIES, false, 0);
+
+    long num_serial, num_parallel;
+    db_line **serial = read_database(path, 0, &num_serial);
+    db_line **parallel = read_database(path, threads, &num_parallel);
+
+    ck_assert_msg(num_serial == NUM_PARSE_ENTRIES, "serial parser read %ld entries (expected: %d)", num_serial, NUM_PARSE_ENTRIES);
+    ck_assert_msg(num_parallel == num_serial, "parallel parser read %ld entries (expected: %ld)", num_parallel, num_serial);
+    for (long i = 0 ; i < num_serial ; ++i) {
+        db_line *s = serial[i], *p = parallel[i];
+        ck_assert_msg(strcmp(s->filename, p->filename) == 0, "entry #%ld: '%s' != '%s'", i, p->filename, s->filename);
+        ck_assert_msg(s->attr == p->attr && s->perm == p->perm && s->inode == p->inode
+                && s->size == p->size && s->mtime == p->mtime, "entry #%ld ('%s') differs", i, s->filename);
+        ck_assert_msg(p->hashsums[hash_sha256] && memcmp(s->hashsums[hash_sha256], p->hashsums[hash_sha256], 32) == 0,
+                "entry #%ld ('%s'): sha256 differs", i, s->filename);
+        free_db_line(s);
+        free(s);
+        free_db_line(p);
+        free(p);
+    }
+    free(serial);
+    free(parallel);
+
+    free(path);
+}
+END_TEST
+
+/* the database has more entries than a single write_tree() chunk */
+#define NUM_WRITE_ENTRIES 20000
+
+static long write_workers[] = { 2, 4, 8 };
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "r");
+    ck_assert(fp != NULL);
+    char *data = NULL;
+    size_t size = 0;
+    *len = 0;
+    size_t n;
+    do {
+        size += 64*1024;
+        data = checked_realloc(data, size);
+        n = fread(&data[*len], 1, size - *len, fp);
+        *len += n;
+    } while (*len == size);
+    fclose(fp);
+    return data;
+}
+
+START_TEST (test_write_tree) {
+    long num_workers = write_workers[_i];
+    log_msg(LOG_LEVEL_INFO, "test_write_tree: num_workers: %ld", num_workers);
+
+    char *serial_path = get_test_path("serial.db");
+    char *parallel_path = get_test_path("parallel.db");
+    write_database(serial_path, NUM_WRITE_ENTRIES, false, 0);
+    write_database(parallel_path, NUM_WRITE_ENTRIES, false, num_workers);
+
+    size_t serial_len, parallel_len;
+    char *serial = read_file(serial_path, &serial_len);
+    char *parallel = read_file(parallel_path, &parallel_len);
+    ck_assert_msg(serial_len == parallel_len, "parallel database has %zu bytes (expected: %zu)", parallel_len, serial_len);
+    ck_assert_msg(memcmp(serial, parallel, serial_len) == 0, "parallel database differs from the serial database");
+    free(serial);
+    free(parallel);
+
+    free(serial_path);
+    free(parallel_path);
+}
+END_TEST
+
+Suite *make_db_suite(void) {
+
+    Suite *s = suite_create ("db");
+
+    TCase *tc_compare = tcase_create ("compare_databases");
+
+    tcase_add_checked_fixture(tc_compare, setup_test_dir, teardown_test_dir);
+    tcase_add_loop_test (tc_compare, test_compare_databases, 0, 2);
+
+    TCase *tc_parse = tcase_create ("parse_database");
+
+    tcase_add_checked_fixture(tc_parse, setup_test_dir, teardown_test_dir);
+    tcase_add_loop_test (tc_parse, test_parse_database, 0, sizeof(parse_threads)/sizeof(long));
+
+    TCase *tc_write = tcase_create ("write_tree");
+
+    tcase_add_checked_fixture(tc_write, setup_test_dir, teardown_test_dir);
+    tcase_add_loop_test (tc_write, test_write_tree, 0, sizeof(write_workers)/sizeof(long));
+
+    suite_add_tcase (s, tc_compare);
+    suite_add_tcase (s, tc_parse);
+    suite_add_tcase (s, tc_write);
+
+    return s;
+}
@@ -0,0 +1,763 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2025 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <check.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "attributes.h"
+#include "check_aide.h"
+#include "checkpoint.h"
+#include "db.h"
+#include "db_config.h"
+#include "db_disk.h"
+#include "gen_list.h"
+#include "hashsum.h"
+#include "log.h"
+#include "progress.h"
+#include "seltree.h"
+#include "seltree_struct.h"
+#include "util.h"
+
+extern db_config* conf;
+
+#define NUM_WIDE_DIRS 64
+#define DEEP_LEVELS 40
+
+/* sha256 of "hello" */
+#define FILE1_SHA256 "2cf24dba5fb0a30e26e83b2ac5b9e29e1b161e5c1fa7425e73043362938b9824"
+
+typedef struct {
+    const char *desc;
+    long num_workers;
+    bool work_stealing;
+    bool sort_directory_entries;
+    long max_pending_entries;
+    rlim_t nofile; /* 0: keep the current limit */
+} db_disk_test_t;
+
+static db_disk_test_t db_disk_tests[] = {
+    { "serial",                          0, false, false, 0,  0 },
+    { "serial, sorted",                  0, false, true,  0,  0 },
+    { "4 workers, shared queue",         4, false, false, 0,  0 },
+    { "4 workers, work-stealing",        4, true,  false, 0,  0 },
+    { "2 workers, backpressure",         2, false, false, 2,  0 },
+    { "2 workers, work-stealing, backpressure", 2, true, true, 2, 0 },
+    /* dir_fds_max is half of RLIMIT_NOFILE, the pending subdirectories of
+     * /wide exceed it and the walker has to fall back to full paths */
+    { "serial, few file descriptors",    0, false, false, 0, 48 },
+    { "4 workers, few file descriptors", 4, true,  false, 0, 48 },
+};
+
+static char **expected_paths = NULL;
+static long num_expected_paths = 0;
+
+static void write_file(const char *path, const char *content) {
+    FILE *fp = fopen(path, "w");
+    ck_assert_msg(fp != NULL, "fopen(%s) failed", path);
+    fputs(content, fp);
+    fclose(fp);
+}
+
+static void add_expected(const char *path) {
+    expected_paths = checked_realloc(expected_paths, (num_expected_paths + 1) * sizeof(char *));
+    expected_paths[num_expected_paths++] = checked_strdup(path);
+}
+
+static void create_path(const char *rel, mode_t type) {
+    char *path = checked_malloc(strlen(test_dir) + strlen(rel) + 1);
+    sprintf(path, "%s%s", test_dir, rel);
+    if (S_ISDIR(type)) {
+        ck_assert_msg(mkdir(path, 0755) == 0, "mkdir(%s) failed", path);
+    } else {
+        write_file(path, rel);
+    }
+    free(path);
+}
+
+static void setup(void) {
+    setup_test_dir();
+    char path[PATH_MAX];
+
+    create_path("/a", S_IFDIR);
+    snprintf(path, PATH_MAX, "%s/a/file1", test_dir);
+    write_file(path, "hello");
+    create_path("/a/b", S_IFDIR);
+    create_path("/a/b/file2", S_IFREG);
+    snprintf(path, PATH_MAX, "%s/a/link", test_dir);
+    ck_assert(symlink("file1", path) == 0);
+    create_path("/c", S_IFDIR);
+    create_path("/c/keep", S_IFREG);
+    create_path("/c/skip.log", S_IFREG);
+
+    const char *expected[] = { "/", "/a", "/a/file1", "/a/b", "/a/b/file2", "/a/link", "/c", "/c/keep", "/wide", };
+    for (size_t i = 0 ; i < sizeof(expected)/sizeof(char*) ; ++i) {
+        add_expected(expected[i]);
+    }
+
+    create_path("/wide", S_IFDIR);
+    for (int i = 0 ; i < NUM_WIDE_DIRS ; ++i) {
+        snprintf(path, PATH_MAX, "/wide/d%02d", i);
+        create_path(path, S_IFDIR);
+        add_expected(path);
+        snprintf(path, PATH_MAX, "/wide/d%02d/file", i);
+        create_path(path, S_IFREG);
+        add_expected(path);
+    }
+
+    char deep[PATH_MAX] = "";
+    for (int i = 0 ; i < DEEP_LEVELS ; ++i) {
+        size_t len = strlen(deep);
+        snprintf(&deep[len], PATH_MAX - len, "/d%02d", i);
+        create_path(deep, S_IFDIR);
+        add_expected(deep);
+    }
+    strcat(deep, "/bottom");
+    create_path(deep, S_IFREG);
+    add_expected(deep);
+}
+
+static void teardown(void) {
+    teardown_test_dir();
+    for (long i = 0 ; i < num_expected_paths ; ++i) {
+        free(expected_paths[i]);
+    }
+    free(expected_paths);
+    expected_paths = NULL;
+    num_expected_paths = 0;
+}
+
+#define RULE_ATTRS (ATTR(attr_filename)|ATTR(attr_perm)|ATTR(attr_ftype)|ATTR(attr_uid)|ATTR(attr_gid) \
+        |ATTR(attr_size)|ATTR(attr_mtime)|ATTR(attr_inode)|ATTR(attr_linkcount) \
+        |ATTR(attr_linkname)|ATTR(attr_sha256))
+/* the link count of a file changes if another hardlink is removed, files
+ * without hashsums do not wait for the old entries (see db_scan_disk()) */
+#define INODE_RULE_ATTRS ((RULE_ATTRS&~(ATTR(attr_linkcount)|ATTR(attr_sha256)))|ATTR(attr_checkinode))
+
+static seltree *add_rules(void) {
+    seltree *tree = init_tree();
+    char *node_path = NULL;
+    rx_rule *r = add_rx_to_tree(checked_strdup("/c/.*\\.log$"), (rx_restriction_t) { .f_type = FT_REG },
+            AIDE_RECURSIVE_NEGATIVE_RULE, tree, 1, "check_db_disk", "n/a", &node_path);
+    /* the first matching rule of a node wins */
+    r = add_rx_to_tree(checked_strdup("/h"), (rx_restriction_t) { .f_type = FT_NULL },
+            AIDE_SELECTIVE_RULE, tree, 2, "check_db_disk", "n/a", &node_path);
+    r->attr = INODE_RULE_ATTRS;
+    r = add_rx_to_tree(checked_strdup("/"), (rx_restriction_t) { .f_type = FT_NULL },
+            AIDE_SELECTIVE_RULE, tree, 3, "check_db_disk", "n/a", &node_path);
+    r->attr = RULE_ATTRS;
+    compile_seltree(tree);
+    return tree;
+}
+
+static void check_entry(seltree *tree, const char *desc, const char *rel) {
+    seltree *node = get_seltree_node(tree, (char *) rel);
+    ck_assert_msg(node != NULL && node->new_data != NULL, "%s: '%s' was not scanned", desc, rel);
+    db_line *line = node->new_data;
+
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, "%s%s", test_dir, strcmp(rel, "/") == 0 ? "" : rel);
+    struct stat st;
+    ck_assert(lstat(path, &st) == 0);
+
+    ck_assert_msg(line->perm == st.st_mode, "%s: '%s' perm %o != %o", desc, rel, line->perm, st.st_mode);
+    ck_assert_msg(line->uid == (long) st.st_uid, "%s: '%s' uid", desc, rel);
+    ck_assert_msg(line->gid == (long) st.st_gid, "%s: '%s' gid", desc, rel);
+    ck_assert_msg(line->inode == (long) st.st_ino, "%s: '%s' inode %ld != %lu", desc, rel, line->inode, st.st_ino);
+    ck_assert_msg(line->nlink == (long) st.st_nlink, "%s: '%s' nlink %ld != %lu", desc, rel, line->nlink, st.st_nlink);
+    ck_assert_msg(line->mtime == st.st_mtime, "%s: '%s' mtime", desc, rel);
+    if (!S_ISDIR(st.st_mode)) {
+        ck_assert_msg(line->size == st.st_size, "%s: '%s' size %lld != %ld", desc, rel, line->size, st.st_size);
+    }
+    if (S_ISLNK(st.st_mode)) {
+        ck_assert_msg(line->linkname != NULL && strcmp(line->linkname, "file1") == 0, "%s: '%s' linkname", desc, rel);
+    }
+    if (strcmp(rel, "/a/file1") == 0) {
+        ck_assert_msg(line->hashsums[hash_sha256] != NULL, "%s: '%s' has no sha256", desc, rel);
+        char *sha256 = byte_to_base16(line->hashsums[hash_sha256], 32);
+        ck_assert_msg(strcmp(sha256, FILE1_SHA256) == 0, "%s: '%s' sha256 %s", desc, rel, sha256);
+        free(sha256);
+    }
+}
+
+static long count_entries(seltree *node) {
+    long n = node->new_data ? 1 : 0;
+    for (tree_node *x = tree_walk_first(node->children); x != NULL ; x = tree_walk_next(x)) {
+        n += count_entries(tree_get_data(x));
+    }
+    return n;
+}
+
+static db_config *new_conf(int action) {
+    db_config *c = checked_calloc(1, sizeof(db_config));
+    c->action = action;
+    c->root_prefix = test_dir;
+    c->root_prefix_length = strlen(test_dir);
+    c->db_out_attrs = RULE_ATTRS|ATTR(attr_attr);
+    c->database_out_buffer_size = 64*1024;
+    c->tree = add_rules();
+    return c;
+}
+
+START_TEST (test_scan_disk) {
+    db_disk_test_t t = db_disk_tests[_i];
+    log_msg(LOG_LEVEL_INFO, "test_scan_disk: %s", t.desc);
+
+    struct rlimit nofile_saved;
+    ck_assert(getrlimit(RLIMIT_NOFILE, &nofile_saved) == 0);
+    if (t.nofile) {
+        struct rlimit nofile = { .rlim_cur = t.nofile, .rlim_max = nofile_saved.rlim_max };
+        ck_assert(setrlimit(RLIMIT_NOFILE, &nofile) == 0);
+    }
+
+    db_config *conf_saved = conf;
+    conf = new_conf(DO_INIT);
+    conf->num_workers = t.num_workers;
+    conf->work_stealing = t.work_stealing;
+    conf->sort_directory_entries = t.sort_directory_entries;
+    conf->max_pending_entries = t.max_pending_entries;
+
+    db_scan_disk(false);
+    progress_stop();
+
+    if (t.nofile) {
+        setrlimit(RLIMIT_NOFILE, &nofile_saved);
+    }
+
+    for (long i = 0 ; i < num_expected_paths ; ++i) {
+        check_entry(conf->tree, t.desc, expected_paths[i]);
+    }
+    ck_assert_msg(get_seltree_node(conf->tree, "/c/skip.log") == NULL
+            || get_seltree_node(conf->tree, "/c/skip.log")->new_data == NULL,
+            "%s: excluded '/c/skip.log' was scanned", t.desc);
+    long num_scanned = count_entries(conf->tree);
+    ck_assert_msg(num_scanned == num_expected_paths, "%s: scanned %ld entries (expected: %ld)", t.desc, num_scanned, num_expected_paths);
+
+    free(conf);
+    conf = conf_saved;
+}
+END_TEST
+
+typedef struct {
+    long num_workers;
+    bool database_in_concurrent;
+} compare_disk_test_t;
+
+static compare_disk_test_t compare_disk_tests[] = {
+    { 0, false },
+    { 0, true  },
+    { 4, false },
+    { 4, true  },
+};
+
+static seltree *check_node(seltree *tree, const char *path, int checked) {
+    seltree *node = get_seltree_node(tree, (char *) path);
+    ck_assert_msg(node != NULL, "no node for '%s'", path);
+    ck_assert_msg((node->checked&(DB_OLD|DB_NEW)) == checked, "'%s': checked 0x%x (expected 0x%x)",
+            path, node->checked&(DB_OLD|DB_NEW), checked);
+    return node;
+}
+
+START_TEST (test_compare_disk) {
+    compare_disk_test_t t = compare_disk_tests[_i];
+    log_msg(LOG_LEVEL_INFO, "test_compare_disk: num_workers: %ld, database_in_concurrent: %s", t.num_workers, btoa(t.database_in_concurrent));
+
+    char db_path[] = "/tmp/check_db_disk.db.XXXXXX";
+    int fd = mkstemp(db_path);
+    ck_assert(fd != -1);
+    close(fd);
+
+    db_config *conf_saved = conf;
+
+    conf = new_conf(DO_INIT);
+    conf->database_out.url = new_file_url(db_path);
+    ck_assert(db_init(&conf->database_out, false, false) == RETOK);
+    ck_assert(db_writespec(conf) == RETOK);
+    populate_tree(conf->tree);
+    write_tree(conf->tree);
+    progress_stop();
+    db_close();
+    free(conf);
+
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, "%s/a/b/file2", test_dir);
+    FILE *fp = fopen(path, "a");
+    ck_assert(fp != NULL);
+    fputs("changed", fp);
+    fclose(fp);
+    snprintf(path, PATH_MAX, "%s/a/link", test_dir);
+    ck_assert(unlink(path) == 0);
+    create_path("/c/new", S_IFREG);
+
+    conf = new_conf(DO_COMPARE);
+    conf->num_workers = t.num_workers;
+    conf->database_in_concurrent = t.database_in_concurrent;
+    conf->database_in.url = new_file_url(db_path);
+    ck_assert(db_init(&conf->database_in, true, false) == RETOK);
+    populate_tree(conf->tree);
+    progress_stop();
+    db_close();
+
+    seltree *node = check_node(conf->tree, "/a/b/file2", DB_OLD|DB_NEW);
+    ck_assert_msg(node->changed_attrs&ATTR(attr_size) && node->changed_attrs&ATTR(attr_sha256),
+            "'/a/b/file2': changed attributes %llu", node->changed_attrs);
+    check_node(conf->tree, "/a/link", DB_OLD);
+    check_node(conf->tree, "/c/new", DB_NEW);
+    for (long i = 0 ; i < num_expected_paths ; ++i) {
+        if (strcmp(expected_paths[i], "/a/b/file2") && strcmp(expected_paths[i], "/a/link")
+                && strcmp(expected_paths[i], "/a/b") && strcmp(expected_paths[i], "/a") && strcmp(expected_paths[i], "/c")) {
+            node = check_node(conf->tree, expected_paths[i], DB_OLD|DB_NEW);
+            ck_assert_msg(node->changed_attrs == 0 && node->old_data == NULL,
+                    "'%s' is reported as changed: %llu", expected_paths[i], node->changed_attrs);
+        }
+    }
+
+    free(conf);
+    conf = conf_saved;
+    unlink(db_path);
+}
+END_TEST
+
+/* writes the database to the FIFO after the file system scan has passed its entries */
+typedef struct {
+    const char *fifo_path;
+    const char *db_path;
+} fifo_writer_args;
+
+static void *fifo_writer(void *arg) {
+    fifo_writer_args *args = arg;
+    int fd = open(args->fifo_path, O_WRONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    sleep(1);
+    FILE *fp = fopen(args->db_path, "r");
+    if (fp) {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), fp)) > 0 && write(fd, buf, n) == (ssize_t) n);
+        fclose(fp);
+    }
+    close(fd);
+    return NULL;
+}
+
+static void append_node_states(seltree *node, char **states, size_t *len) {
+    int checked = node->checked&(DB_OLD|DB_NEW|NODE_MOVED_IN|NODE_MOVED_OUT|NODE_ALLOW_NEW|NODE_ALLOW_RM);
+    if (checked) {
+        size_t n = snprintf(NULL, 0, "%s 0x%x %llu\n", node->path, checked, node->changed_attrs);
+        *states = checked_realloc(*states, *len + n + 1);
+        *len += sprintf(*states + *len, "%s 0x%x %llu\n", node->path, checked, node->changed_attrs);
+    }
+    for (tree_node *x = tree_walk_first(node->children); x != NULL ; x = tree_walk_next(x)) {
+        append_node_states(tree_get_data(x), states, len);
+    }
+}
+
+/* returns the database without the comment lines (time of generation) */
+static char *read_database(const char *path) {
+    FILE *fp = fopen(path, "r");
+    ck_assert(fp != NULL);
+    char *data = checked_strdup("");
+    size_t len = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t n;
+    while ((n = getline(&line, &line_size, fp)) != -1) {
+        if (line[0] != '#') {
+            data = checked_realloc(data, len + n + 1);
+            memcpy(data + len, line, n + 1);
+            len += n;
+        }
+    }
+    free(line);
+    fclose(fp);
+    return data;
+}
+
+START_TEST (test_update_concurrent) {
+    /* a small tree, so the file system scan passes '/h' before the old entries are read */
+    char root_prefix[PATH_MAX];
+    snprintf(root_prefix, PATH_MAX, "%s/u", test_dir);
+    create_path("/u", S_IFDIR);
+    create_path("/u/h", S_IFDIR);
+    create_path("/u/h/file", S_IFREG);
+    char path[PATH_MAX];
+    char link_path[PATH_MAX];
+    snprintf(path, PATH_MAX, "%s/h/file", root_prefix);
+    snprintf(link_path, PATH_MAX, "%s/h/hardlink", root_prefix);
+    ck_assert(link(path, link_path) == 0);
+
+    char db_path[] = "/tmp/check_db_disk.db.XXXXXX";
+    int fd = mkstemp(db_path);
+    ck_assert(fd != -1);
+    close(fd);
+
+    db_config *conf_saved = conf;
+
+    conf = new_conf(DO_INIT);
+    conf->root_prefix = root_prefix;
+    conf->root_prefix_length = strlen(root_prefix);
+    conf->database_out.url = new_file_url(db_path);
+    ck_assert(db_init(&conf->database_out, false, false) == RETOK);
+    ck_assert(db_writespec(conf) == RETOK);
+    populate_tree(conf->tree);
+    seltree *node = get_seltree_node(conf->tree, "/h/file");
+    ck_assert_msg(node && node->new_data && (node->new_data)->attr&ATTR(attr_checkinode), "'/h/file' has no check inode attribute");
+    write_tree(conf->tree);
+    progress_stop();
+    db_close();
+    free(conf);
+
+    /* the removal of the hardlink must not be hidden by the unchanged file with the same inode */
+    ck_assert(unlink(link_path) == 0);
+
+    char *states[2] = { NULL, NULL };
+    char *databases[2];
+    for (int i = 0 ; i < 2 ; ++i) {
+        bool concurrent = i;
+        char out_path[PATH_MAX];
+        snprintf(out_path, PATH_MAX, "%s.new", db_path);
+        char fifo_path[PATH_MAX];
+        snprintf(fifo_path, PATH_MAX, "%s.fifo", db_path);
+
+        conf = new_conf(DO_INIT|DO_COMPARE);
+        conf->root_prefix = root_prefix;
+        conf->root_prefix_length = strlen(root_prefix);
+        conf->num_workers = 4;
+        conf->database_in_concurrent = concurrent;
+        pthread_t writer;
+        fifo_writer_args args = { .fifo_path = fifo_path, .db_path = db_path };
+        if (concurrent) {
+            /* the new entries are read before the old entries of their directory */
+            ck_assert(mkfifo(fifo_path, 0600) == 0);
+            ck_assert(pthread_create(&writer, NULL, &fifo_writer, &args) == 0);
+            conf->database_in.url = new_file_url(fifo_path);
+        } else {
+            conf->database_in.url = new_file_url(db_path);
+        }
+        ck_assert(db_init(&conf->database_in, true, false) == RETOK);
+        conf->database_out.url = new_file_url(out_path);
+        ck_assert(db_init(&conf->database_out, false, false) == RETOK);
+        ck_assert(db_writespec(conf) == RETOK);
+        populate_tree(conf->tree);
+        write_tree(conf->tree);
+        progress_stop();
+        db_close();
+        if (concurrent) {
+            pthread_join(writer, NULL);
+            unlink(fifo_path);
+        }
+
+        node = check_node(conf->tree, "/h/hardlink", DB_OLD);
+        ck_assert_msg(!(node->checked&NODE_MOVED_OUT), "concurrent: %s: removed '/h/hardlink' is reported as moved", btoa(concurrent));
+        node = check_node(conf->tree, "/h/file", DB_OLD|DB_NEW);
+        ck_assert_msg(!(node->checked&NODE_MOVED_IN), "concurrent: %s: unchanged '/h/file' is reported as moved", btoa(concurrent));
+
+        size_t len = 0;
+        append_node_states(conf->tree, &states[i], &len);
+        databases[i] = read_database(out_path);
+        unlink(out_path);
+        free(conf);
+    }
+    ck_assert_msg(strcmp(states[0], states[1]) == 0, "--update differs with concurrent reading of database_in:\n%s\nvs.\n%s", states[0], states[1]);
+    ck_assert_msg(strcmp(databases[0], databases[1]) == 0, "database written by --update differs with concurrent reading of database_in");
+    for (int i = 0 ; i < 2 ; ++i) {
+        free(states[i]);
+        free(databases[i]);
+    }
+
+    conf = conf_saved;
+    unlink(db_path);
+}
+END_TEST
+
+/* runs --update of database_in to database_out (the delta only if delta is set) */
+static void update_database(const char *in_path, const char *out_path, bool delta) {
+    conf = new_conf(DO_INIT|DO_COMPARE);
+    conf->db_attrs = ATTR(attr_sha256);
+    conf->database_out_delta = delta;
+    /* '/wide' and the deep directories are outside of the limit */
+    conf->limit = "/(a|c)";
+    int pcre2_errorcode;
+    PCRE2_SIZE pcre2_erroffset;
+    conf->limit_crx = pcre2_compile((PCRE2_SPTR) conf->limit, PCRE2_ZERO_TERMINATED, PCRE2_UTF|PCRE2_ANCHORED, &pcre2_errorcode, &pcre2_erroffset, NULL);
+    ck_assert(conf->limit_crx != NULL);
+    conf->database_in.url = new_file_url(in_path);
+    ck_assert(db_init(&conf->database_in, true, false) == RETOK);
+    conf->database_out.url = new_file_url(out_path);
+    ck_assert(db_init(&conf->database_out, false, false) == RETOK);
+    if (!delta) {
+        ck_assert(db_writespec(conf) == RETOK);
+    }
+    populate_tree(conf->tree);
+    /* the header of a delta database is written once the base database has been read */
+    if (delta) {
+        ck_assert(db_writespec(conf) == RETOK);
+    }
+    write_tree(conf->tree);
+    progress_stop();
+    db_close();
+    pcre2_code_free(conf->limit_crx);
+    free(conf);
+}
+
+START_TEST (test_update_delta) {
+    char db_path[] = "/tmp/check_db_disk.db.XXXXXX";
+    int fd = mkstemp(db_path);
+    ck_assert(fd != -1);
+    close(fd);
+    char delta_path[PATH_MAX], full_path[PATH_MAX], compact_path[PATH_MAX];
+    snprintf(delta_path, PATH_MAX, "%s.delta", db_path);
+    snprintf(full_path, PATH_MAX, "%s.full", db_path);
+    snprintf(compact_path, PATH_MAX, "%s.compact", db_path);
+
+    db_config *conf_saved = conf;
+
+    conf = new_conf(DO_INIT);
+    conf->database_out.url = new_file_url(db_path);
+    ck_assert(db_init(&conf->database_out, false, false) == RETOK);
+    ck_assert(db_writespec(conf) == RETOK);
+    populate_tree(conf->tree);
+    write_tree(conf->tree);
+    progress_stop();
+    db_close();
+    free(conf);
+
+    /* changed, removed and added entries, '/wide/d00/file' is changed outside of the limit */
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, "%s/a/b/file2", test_dir);
+    FILE *fp = fopen(path, "a");
+    ck_assert(fp != NULL);
+    fputs("changed", fp);
+    fclose(fp);
+    snprintf(path, PATH_MAX, "%s/wide/d00/file", test_dir);
+    write_file(path, "changed outside of the limit");
+    snprintf(path, PATH_MAX, "%s/a/link", test_dir);
+    ck_assert(unlink(path) == 0);
+    create_path("/c/new", S_IFREG);
+
+    update_database(db_path, delta_path, true);
+    update_database(db_path, full_path, false);
+
+    char *parent_hashsums = get_parent_hashsums(db_path);
+    char *delta = read_database(delta_path);
+    bool found_delta_db = false, found_changed = false, found_added = false, found_removed = false;
+    char *saveptr = NULL;
+    for (char *line = strtok_r(delta, "\n", &saveptr) ; line ; line = strtok_r(NULL, "\n", &saveptr)) {
+        if (strncmp(line, "@@delta_db ", 11) == 0) {
+            ck_assert_msg(strcmp(line + 11, parent_hashsums) == 0, "'%s' (expected: '@@delta_db %s')", line, parent_hashsums);
+            found_delta_db = true;
+        } else if (strncmp(line, "@@remove ", 9) == 0) {
+            ck_assert_msg(strcmp(line + 9, "/a/link") == 0, "unexpected '%s'", line);
+            found_removed = true;
+        } else if (line[0] == '/') {
+            char *name = line;
+            name[strcspn(name, " ")] = '\0';
+            /* the directories may have been changed within the same second */
+            ck_assert_msg(strcmp(name, "/a") == 0 || strcmp(name, "/c") == 0
+                    || strcmp(name, "/a/b/file2") == 0 || strcmp(name, "/c/new") == 0,
+                    "unchanged or out of limit entry '%s' written to delta database", name);
+            found_changed |= strcmp(name, "/a/b/file2") == 0;
+            found_added |= strcmp(name, "/c/new") == 0;
+        }
+    }
+    ck_assert_msg(found_delta_db, "'@@delta_db' line is missing");
+    ck_assert_msg(found_changed, "changed '/a/b/file2' is missing");
+    ck_assert_msg(found_added, "added '/c/new' is missing");
+    ck_assert_msg(found_removed, "'@@remove /a/link' is missing");
+    free(delta);
+    free(parent_hashsums);
+
+    /* the base database merged with the delta is the complete --update output */
+    conf = new_conf(DO_CONVERT|DO_COMPACT);
+    conf->db_attrs = ATTR(attr_sha256);
+    conf->database_in.url = new_file_url(db_path);
+    conf->num_database_in_deltas = 1;
+    conf->database_in_deltas = checked_calloc(1, sizeof(database));
+    conf->database_in_deltas[0] = (database) { .url = new_file_url(delta_path), .flags = DB_FLAG_DELTA };
+    conf->database_out.url = new_file_url(compact_path);
+    ck_assert(db_init(&conf->database_in, true, false) == RETOK);
+    ck_assert(db_init(&conf->database_out, false, false) == RETOK);
+    ck_assert(db_convert(NULL, 0) > 0);
+    db_close();
+    free(conf->database_in_deltas);
+    free(conf);
+
+    char *full = read_database(full_path);
+    char *compact = read_database(compact_path);
+    ck_assert_msg(strcmp(full, compact) == 0, "merged delta database differs from --update output:\n%s\nvs.\n%s", compact, full);
+    free(full);
+    free(compact);
+
+    conf = conf_saved;
+    unlink(db_path);
+    unlink(delta_path);
+    unlink(full_path);
+    unlink(compact_path);
+}
+END_TEST
+
+typedef struct {
+    long num_workers;
+    ATTRIBUTE attr; /* attribute of '/a/b/file2' preventing its directory from being completed */
+} checkpoint_test_t;
+
+static checkpoint_test_t checkpoint_tests[] = {
+    { 0, attr_growing },
+    { 4, attr_growing },
+    { 4, attr_compressed },
+};
+
+/* the directories containing '/a/b/file2' are never marked as completed */
+static const char *incomplete_dirs[] = { "", "/a", "/a/b" };
+
+static void scan_checkpoint(checkpoint_test_t t, const char *db_path, bool resume) {
+    conf = new_conf(DO_INIT);
+    conf->num_workers = t.num_workers;
+    conf->checkpoint_interval = 1;
+    conf->database_out.url = new_file_url(db_path);
+    conf->tree = init_tree();
+    char *node_path = NULL;
+    rx_rule *r = add_rx_to_tree(checked_strdup("/c/.*\\.log$"), (rx_restriction_t) { .f_type = FT_REG },
+            AIDE_RECURSIVE_NEGATIVE_RULE, conf->tree, 1, "check_db_disk", "n/a", &node_path);
+    r = add_rx_to_tree(checked_strdup("/a/b/file2"), (rx_restriction_t) { .f_type = FT_NULL },
+            AIDE_SELECTIVE_RULE, conf->tree, 2, "check_db_disk", "n/a", &node_path);
+    r->attr = RULE_ATTRS|ATTR(t.attr);
+    r = add_rx_to_tree(checked_strdup("/"), (rx_restriction_t) { .f_type = FT_NULL },
+            AIDE_SELECTIVE_RULE, conf->tree, 3, "check_db_disk", "n/a", &node_path);
+    r->attr = RULE_ATTRS;
+    compile_seltree(conf->tree);
+
+    ck_assert(checkpoint_open(resume));
+    db_scan_disk(false);
+    progress_stop();
+    checkpoint_close(false);
+}
+
+START_TEST (test_checkpoint) {
+    checkpoint_test_t t = checkpoint_tests[_i];
+    log_msg(LOG_LEVEL_INFO, "test_checkpoint: num_workers: %ld, attribute: %s", t.num_workers, attributes[t.attr].config_name);
+
+    char db_path[] = "/tmp/check_db_disk.db.XXXXXX";
+    int fd = mkstemp(db_path);
+    ck_assert(fd != -1);
+    close(fd);
+    char checkpoint_path[PATH_MAX];
+    snprintf(checkpoint_path, PATH_MAX, "%s.checkpoint", db_path);
+
+    db_config *conf_saved = conf;
+
+    scan_checkpoint(t, db_path, false);
+    free(conf);
+
+    /* every directory is marked as completed after all of its subdirectories */
+    char *data = read_database(checkpoint_path);
+    char **done = NULL;
+    long num_done = 0;
+    char *saveptr = NULL;
+    for (char *line = strtok_r(data, "\n", &saveptr) ; line ; line = strtok_r(NULL, "\n", &saveptr)) {
+        if (strncmp(line, "@@done ", 7) == 0) {
+            char *path = line + 7;
+            for (size_t i = 0 ; i < sizeof(incomplete_dirs)/sizeof(char *) ; ++i) {
+                ck_assert_msg(strcmp(path, incomplete_dirs[i]), "incomplete directory '%s' has been marked as completed", path);
+            }
+            size_t len = strlen(path);
+            for (long i = 0 ; i < num_expected_paths ; ++i) {
+                size_t n = strlen(expected_paths[i]);
+                if (n > len && strncmp(expected_paths[i], path, len) == 0 && expected_paths[i][len] == '/' && strchr(&expected_paths[i][len + 1], '/') == NULL) {
+                    char sub[PATH_MAX];
+                    snprintf(sub, PATH_MAX, "%s%s", test_dir, expected_paths[i]);
+                    struct stat st;
+                    ck_assert(lstat(sub, &st) == 0);
+                    if (S_ISDIR(st.st_mode)) {
+                        bool found = false;
+                        for (long j = 0 ; j < num_done ; ++j) {
+                            found |= strcmp(done[j], expected_paths[i]) == 0;
+                        }
+                        ck_assert_msg(found, "'%s' marked as completed before its subdirectory '%s'", path, expected_paths[i]);
+                    }
+                }
+            }
+            done = checked_realloc(done, (num_done + 1) * sizeof(char *));
+            done[num_done++] = path;
+        }
+    }
+    /* '/c', '/wide', its 64 subdirectories and the 40 deep directories */
+    ck_assert_msg(num_done == 2 + NUM_WIDE_DIRS + DEEP_LEVELS, "%ld directories marked as completed (expected: %d)", num_done, 2 + NUM_WIDE_DIRS + DEEP_LEVELS);
+    free(done);
+    free(data);
+
+    /* the completed directories are not read again */
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, "%s/c/keep", test_dir);
+    write_file(path, "changed after the checkpoint");
+    snprintf(path, PATH_MAX, "%s/a/b/file2", test_dir);
+    write_file(path, "changed after the checkpoint");
+
+    scan_checkpoint(t, db_path, true);
+    for (long i = 0 ; i < num_expected_paths ; ++i) {
+        seltree *node = get_seltree_node(conf->tree, expected_paths[i]);
+        ck_assert_msg(node != NULL && node->new_data != NULL, "'%s' was neither scanned nor replayed", expected_paths[i]);
+    }
+    long num_scanned = count_entries(conf->tree);
+    ck_assert_msg(num_scanned == num_expected_paths, "scanned %ld entries (expected: %ld)", num_scanned, num_expected_paths);
+    db_line *keep = get_seltree_node(conf->tree, "/c/keep")->new_data;
+    ck_assert_msg(keep->size == (long long) strlen("/c/keep"), "'/c/keep' has not been replayed (size: %lld)", keep->size);
+    db_line *file2 = get_seltree_node(conf->tree, "/a/b/file2")->new_data;
+    ck_assert_msg(file2->size == (long long) strlen("changed after the checkpoint"), "'/a/b/file2' has not been read again (size: %lld)", file2->size);
+    free(conf);
+
+    conf = conf_saved;
+    unlink(checkpoint_path);
+    unlink(db_path);
+}
+END_TEST
+
+Suite *make_db_disk_suite(void) {
+
+    Suite *s = suite_create ("db_disk");
+
+    TCase *tc_scan_disk = tcase_create ("scan_disk");
+
+    tcase_add_checked_fixture(tc_scan_disk, setup, teardown);
+    tcase_add_loop_test (tc_scan_disk, test_scan_disk, 0, sizeof(db_disk_tests)/sizeof(db_disk_test_t));
+
+    TCase *tc_compare_disk = tcase_create ("compare_disk");
+
+    tcase_add_checked_fixture(tc_compare_disk, setup, teardown);
+    tcase_add_loop_test (tc_compare_disk, test_compare_disk, 0, sizeof(compare_disk_tests)/sizeof(compare_disk_test_t));
+    tcase_add_test (tc_compare_disk, test_update_concurrent);
+    tcase_add_test (tc_compare_disk, test_update_delta);
+    tcase_add_loop_test (tc_compare_disk, test_checkpoint, 0, sizeof(checkpoint_tests)/sizeof(checkpoint_test_t));
+
+    suite_add_tcase (s, tc_scan_disk);
+    suite_add_tcase (s, tc_compare_disk);
+
+    return s;
+}
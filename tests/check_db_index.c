@@ -0,0 +1,255 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2025 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <check.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "check_aide.h"
+#include "db_config.h"
+#include "db_index.h"
+#include "log.h"
+#include "util.h"
+
+extern db_config* conf;
+
+typedef struct {
+    const char *limit;
+    const char *expected_prefix;
+} limit_prefix_test_t;
+
+static limit_prefix_test_t limit_prefix_tests[] = {
+    { "/etc/ssh",          "/etc/ssh"   },
+    { "/etc/ssh/",         "/etc/ssh/"  },
+    { "/etc/ssh/.*",       "/etc/ssh/"  },
+    { "/etc/ssh$",         "/etc/ssh"   },
+    { "/var/lib/x\\.d",    "/var/lib/x" },
+    { "/etc/ss?h",         "/etc/s"     },
+    { "/etc/ss*",          "/etc/s"     },
+    { "/etc{1,2}",         "/et"        },
+    { "/etc|/usr",         NULL         },
+    { "/",                 NULL         },
+    { "/.*",               NULL         },
+    { ".*",                NULL         },
+    { "/e?",               NULL         },
+    { "/etc/a b",          NULL         },
+};
+
+START_TEST (test_limit_prefix) {
+    limit_prefix_test_t t = limit_prefix_tests[_i];
+    char *prefix = get_limit_prefix(t.limit);
+    if (t.expected_prefix) {
+        ck_assert_msg(prefix != NULL && strcmp(prefix, t.expected_prefix) == 0,
+                "limit '%s': prefix '%s' (expected: '%s')", t.limit, prefix, t.expected_prefix);
+    } else {
+        ck_assert_msg(prefix == NULL, "limit '%s': prefix '%s' (expected: none)", t.limit, prefix);
+    }
+    free(prefix);
+}
+END_TEST
+
+#define INDEX_END 400LLU
+#define INDEX_HEADER "@@aide_index 2 %lld %lld %ld %llu %llu\n"
+
+static const char *index_blocks =
+    "0 0 1 /a /c/x\n"
+    "100 100 11 /d /etc/a\n"
+    "200 200 21 /etc/b /etc/z\n"
+    "300 300 31 /f /z\n";
+
+typedef struct {
+    const char *limit;
+    bool found;
+    db_index_range expected;
+} index_range_test_t;
+
+static index_range_test_t index_range_tests[] = {
+    /* blocks 1 and 2 may contain paths starting with '/etc/' */
+    { "/etc/",       true,  { .offset = 100, .pos = 100, .end = 300,       .lineno = 11 } },
+    { "/etc/b/.*",   true,  { .offset = 200, .pos = 200, .end = 300,       .lineno = 21 } },
+    { "/a",          true,  { .offset = 0,   .pos = 0,   .end = 100,       .lineno = 1  } },
+    { "/f/x",        true,  { .offset = 300, .pos = 300, .end = INDEX_END, .lineno = 31 } },
+    /* behind the last block, nothing is read */
+    { "/zz",         true,  { .offset = 300, .pos = INDEX_END, .end = INDEX_END, .lineno = 0 } },
+    { "/etc|/usr",   false, { 0 } },
+    { ".*",          false, { 0 } },
+};
+
+static char *db_path = NULL;
+static char *index_path = NULL;
+static database db;
+
+typedef struct {
+    long long size;
+    long long mtime;
+    long mtime_nsec;
+    long long inode;
+} index_header_delta_t;
+
+static void write_index(const char *header_format, index_header_delta_t delta) {
+    struct stat st;
+    ck_assert(stat(db_path, &st) == 0);
+    FILE *fp = fopen(index_path, "w");
+    ck_assert(fp != NULL);
+    fprintf(fp, header_format, (long long) st.st_size + delta.size, (long long) st.st_mtim.tv_sec + delta.mtime,
+            (long) st.st_mtim.tv_nsec + delta.mtime_nsec, (unsigned long long) st.st_ino + delta.inode, INDEX_END);
+    fputs(index_blocks, fp);
+    fclose(fp);
+}
+
+static void setup(void) {
+    setup_test_dir();
+    db_path = get_test_path("aide.db");
+    index_path = get_test_path("aide.db.idx");
+    FILE *fp = fopen(db_path, "w");
+    ck_assert(fp != NULL);
+    fputs("@@begin_db\n", fp);
+    fclose(fp);
+
+    db = (database) { .url = new_file_url(db_path), .fp = fopen(db_path, "r") };
+    ck_assert(db.fp != NULL);
+}
+
+static void teardown(void) {
+    fclose(db.fp);
+    teardown_test_dir();
+    free(index_path);
+    free(db_path);
+}
+
+START_TEST (test_index_range) {
+    index_range_test_t t = index_range_tests[_i];
+    write_index(INDEX_HEADER, (index_header_delta_t) { 0 });
+
+    conf->limit = (char *) t.limit;
+    db_index_range range = { 0 };
+    bool found = db_index_find(&db, &range);
+    ck_assert_msg(found == t.found, "limit '%s': db_index_find returned %d (expected: %d)", t.limit, found, t.found);
+    if (found) {
+        ck_assert_msg(range.offset == t.expected.offset && range.pos == t.expected.pos
+                && range.end == t.expected.end && range.lineno == t.expected.lineno,
+                "limit '%s': range (offset: %llu, pos: %llu, end: %llu, lineno: %ld), expected (%llu, %llu, %llu, %ld)", t.limit,
+                range.offset, range.pos, range.end, range.lineno,
+                t.expected.offset, t.expected.pos, t.expected.end, t.expected.lineno);
+    }
+}
+END_TEST
+
+typedef struct {
+    const char *desc;
+    const char *header_format;
+    index_header_delta_t delta;
+} stale_index_test_t;
+
+static stale_index_test_t stale_index_tests[] = {
+    { "database size differs",       INDEX_HEADER, { .size = 1 } },
+    { "database mtime differs",      INDEX_HEADER, { .mtime = -10 } },
+    { "database mtime nsec differs", INDEX_HEADER, { .mtime_nsec = 1 } },
+    { "database inode differs",      INDEX_HEADER, { .inode = 1 } },
+    { "unsupported version",         "@@aide_index 1 %lld %lld %llu\n", { 0 } },
+    { "missing header fields",       "@@aide_index 2 %lld %lld\n", { 0 } },
+    { "invalid header",              "@@aide_idx 2 %lld %lld %ld %llu %llu\n", { 0 } },
+};
+
+START_TEST (test_stale_index) {
+    stale_index_test_t t = stale_index_tests[_i];
+    write_index(t.header_format, t.delta);
+
+    conf->limit = "/etc/";
+    db_index_range range = { 0 };
+    ck_assert_msg(db_index_find(&db, &range) == false, "%s: block index is used", t.desc);
+}
+END_TEST
+
+START_TEST (test_modified_database) {
+    write_index(INDEX_HEADER, (index_header_delta_t) { 0 });
+
+    /* same size, but modified later */
+    struct stat st;
+    ck_assert(stat(db_path, &st) == 0);
+    struct timeval times[2] = { { .tv_sec = st.st_atime }, { .tv_sec = st.st_mtime + 60 } };
+    ck_assert(utimes(db_path, times) == 0);
+
+    conf->limit = "/etc/";
+    db_index_range range = { 0 };
+    ck_assert_msg(db_index_find(&db, &range) == false, "block index of modified database is used");
+}
+END_TEST
+
+START_TEST (test_replaced_database) {
+    db_index_t *index = db_index_new();
+    db_index_add_block(index, 0, 0, 1);
+    db_index_add_path(index, "/etc/passwd");
+    db_index_write(index, &db, 11);
+    db_index_free(index);
+
+    conf->limit = "/etc/";
+    db_index_range range = { 0 };
+    ck_assert_msg(db_index_find(&db, &range), "written block index is not used");
+
+    /* same size and mtime, but a different file (e.g. replaced by rename) */
+    struct stat st;
+    ck_assert(stat(db_path, &st) == 0);
+    char *tmp_path = get_test_path("aide.db.tmp");
+    FILE *fp = fopen(tmp_path, "w");
+    ck_assert(fp != NULL);
+    fputs("@@begin_db\n", fp);
+    fclose(fp);
+    struct timespec times[2] = { st.st_atim, st.st_mtim };
+    ck_assert(utimensat(AT_FDCWD, tmp_path, times, 0) == 0);
+    ck_assert(rename(tmp_path, db_path) == 0);
+    free(tmp_path);
+    fclose(db.fp);
+    db.fp = fopen(db_path, "r");
+    ck_assert(db.fp != NULL);
+
+    ck_assert_msg(db_index_find(&db, &range) == false, "block index of replaced database is used");
+}
+END_TEST
+
+Suite *make_db_index_suite(void) {
+
+    Suite *s = suite_create ("db_index");
+
+    TCase *tc_limit_prefix = tcase_create ("limit_prefix");
+    TCase *tc_index_range = tcase_create ("index_range");
+    TCase *tc_stale_index = tcase_create ("stale_index");
+
+    tcase_add_loop_test (tc_limit_prefix, test_limit_prefix, 0, sizeof(limit_prefix_tests)/sizeof(limit_prefix_test_t));
+
+    tcase_add_checked_fixture(tc_index_range, setup, teardown);
+    tcase_add_loop_test (tc_index_range, test_index_range, 0, sizeof(index_range_tests)/sizeof(index_range_test_t));
+
+    tcase_add_checked_fixture(tc_stale_index, setup, teardown);
+    tcase_add_loop_test (tc_stale_index, test_stale_index, 0, sizeof(stale_index_tests)/sizeof(stale_index_test_t));
+    tcase_add_test (tc_stale_index, test_modified_database);
+    tcase_add_test (tc_stale_index, test_replaced_database);
+
+    suite_add_tcase (s, tc_limit_prefix);
+    suite_add_tcase (s, tc_index_range);
+    suite_add_tcase (s, tc_stale_index);
+
+    return s;
+}
@@ -0,0 +1,292 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2025 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <check.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "attributes.h"
+#include "base64.h"
+#include "check_aide.h"
+#include "db.h"
+#include "db_binary.h"
+#include "db_config.h"
+#include "db_merge.h"
+#include "errorcodes.h"
+#include "hashsum.h"
+#include "log.h"
+#include "util.h"
+
+extern db_config* conf;
+
+#define LINE_ATTRS (ATTR(attr_filename)|ATTR(attr_perm)|ATTR(attr_size))
+
+typedef struct {
+    const char *path;
+    long long size;
+} merge_entry_t;
+
+/* writes a text database, entries with negative size are written as '@@remove' lines */
+static void write_db(const char *name, const char *parent, merge_entry_t *entries, size_t num_entries) {
+    char *path = get_test_path(name);
+    FILE *fp = fopen(path, "w");
+    ck_assert(fp != NULL);
+    fputs("@@begin_db\n", fp);
+    if (parent) {
+        char *parent_hashsums = strcmp(parent, "invalid") ? get_parent_hashsums(parent)
+            : checked_strdup("sha256:AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA=");
+        fprintf(fp, "@@delta_db %s\n", parent_hashsums);
+        free(parent_hashsums);
+    }
+    fputs("@@db_spec name attr perm size\n", fp);
+    for (size_t i = 0 ; i < num_entries ; ++i) {
+        if (entries[i].size < 0) {
+            fprintf(fp, "@@remove %s\n", entries[i].path);
+        } else {
+            fprintf(fp, "%s %llu %o %lld\n", entries[i].path, LINE_ATTRS, S_IFREG|0644, entries[i].size);
+        }
+    }
+    fputs("@@end_db\n", fp);
+    fclose(fp);
+    free(path);
+}
+
+/* base database and 2 delta databases, the later database wins */
+static merge_entry_t base_entries[] = { { "/a", 1 }, { "/b", 1 }, { "/c", 1 }, { "/d", 1 } };
+static merge_entry_t delta1_entries[] = { { "/b", 2 }, { "/c", -1 }, { "/e", 2 } };
+static merge_entry_t delta2_entries[] = { { "/a", 3 }, { "/e", -1 }, { "/f", 3 } };
+static merge_entry_t merged_entries[] = { { "/a", 3 }, { "/b", 2 }, { "/d", 1 }, { "/f", 3 } };
+
+static void setup_delta_chain(const char *delta1_parent) {
+    write_db("base.db", NULL, base_entries, sizeof(base_entries)/sizeof(merge_entry_t));
+    write_db("delta1.db", delta1_parent, delta1_entries, sizeof(delta1_entries)/sizeof(merge_entry_t));
+    write_db("delta2.db", "delta1.db", delta2_entries, sizeof(delta2_entries)/sizeof(merge_entry_t));
+
+    conf->db_attrs = ATTR(attr_sha256);
+    conf->database_in.url = new_file_url("base.db");
+    conf->num_database_in_deltas = 2;
+    conf->database_in_deltas = checked_calloc(2, sizeof(database));
+    conf->database_in_deltas[0] = (database) { .url = new_file_url("delta1.db"), .flags = DB_FLAG_DELTA };
+    conf->database_in_deltas[1] = (database) { .url = new_file_url("delta2.db"), .flags = DB_FLAG_DELTA };
+}
+
+static void check_entries(database *db, merge_entry_t *expected, size_t num_expected) {
+    db_entry_t entry;
+    size_t num = 0;
+    while ((entry = db_readline(db, false)).line != NULL) {
+        ck_assert_msg(num < num_expected, "unexpected entry '%s'", (entry.line)->filename);
+        ck_assert_msg(strcmp((entry.line)->filename, expected[num].path) == 0 && (entry.line)->size == expected[num].size,
+                "entry #%zu: '%s' (size: %lld), expected: '%s' (size: %lld)", num,
+                (entry.line)->filename, (entry.line)->size, expected[num].path, expected[num].size);
+        free_db_line(entry.line);
+        free(entry.line);
+        num++;
+    }
+    ck_assert_msg(num == num_expected, "read %zu entries (expected: %zu)", num, num_expected);
+}
+
+START_TEST (test_delta_merge) {
+    setup_delta_chain("base.db");
+    ck_assert(db_init(&conf->database_in, true, false) == RETOK);
+    check_entries(&conf->database_in, merged_entries, sizeof(merged_entries)/sizeof(merge_entry_t));
+    db_close();
+}
+END_TEST
+
+START_TEST (test_kway_merge) {
+    /* '/' sorts before any other character (see db_path_cmp()) */
+    const char *paths[] = { "/", "/a", "/a/b", "/a/b/c", "/a-b", "/a.b", "/a0", "/b", "/b/a", "/ba", "/c", "/c/d", "/c/e", "/d" };
+    size_t num_paths = sizeof(paths)/sizeof(char*);
+    for (size_t i = 1 ; i < num_paths ; ++i) {
+        ck_assert_msg(db_path_cmp(paths[i-1], paths[i]) < 0, "'%s' >= '%s'", paths[i-1], paths[i]);
+    }
+
+    /* distribute the paths over 3 disjoint databases */
+    const int num_dbs = 3;
+    merge_entry_t *entries[3];
+    size_t num_entries[3] = { 0 };
+    merge_entry_t *expected = checked_malloc(num_paths * sizeof(merge_entry_t));
+    for (int d = 0 ; d < num_dbs ; ++d) {
+        entries[d] = checked_malloc(num_paths * sizeof(merge_entry_t));
+    }
+    for (size_t i = 0 ; i < num_paths ; ++i) {
+        int d = (i * 7 / 3) % num_dbs;
+        entries[d][num_entries[d]++] = (merge_entry_t) { paths[i], d };
+        expected[i] = (merge_entry_t) { paths[i], d };
+    }
+
+    conf->num_database_in_shards = num_dbs;
+    conf->database_in_shards = checked_calloc(num_dbs, sizeof(database));
+    database *dbs[3];
+    char name[16];
+    for (int d = 0 ; d < num_dbs ; ++d) {
+        snprintf(name, sizeof(name), "shard%d.db", d);
+        write_db(name, NULL, entries[d], num_entries[d]);
+        conf->database_in_shards[d].url = new_file_url(name);
+        ck_assert(db_init(&conf->database_in_shards[d], true, false) == RETOK);
+        dbs[d] = &conf->database_in_shards[d];
+        free(entries[d]);
+    }
+
+    db_merge_t *merge = db_merge_new(dbs, num_dbs, true);
+    db_entry_t entry;
+    size_t num = 0;
+    while ((entry = db_merge_readline(merge, false)).line != NULL) {
+        ck_assert_msg(num < num_paths && strcmp((entry.line)->filename, expected[num].path) == 0
+                && (entry.line)->size == expected[num].size,
+                "entry #%zu: '%s' (from shard%lld.db), expected: '%s' (from shard%lld.db)", num,
+                (entry.line)->filename, (entry.line)->size, num < num_paths ? expected[num].path : "(none)", num < num_paths ? expected[num].size : -1);
+        free_db_line(entry.line);
+        free(entry.line);
+        num++;
+    }
+    ck_assert_msg(num == num_paths, "merged %zu entries (expected: %zu)", num, num_paths);
+    db_merge_free(merge);
+    free(expected);
+    db_close();
+}
+END_TEST
+
+START_TEST (test_compact) {
+    setup_delta_chain("base.db");
+    conf->action = DO_CONVERT|DO_COMPACT;
+    conf->database_out.url = new_file_url("compact.db");
+    ck_assert(db_init(&conf->database_in, true, false) == RETOK);
+    ck_assert(db_init(&conf->database_out, false, false) == RETOK);
+    long num_entries = db_convert(NULL, 0);
+    ck_assert_msg(num_entries == sizeof(merged_entries)/sizeof(merge_entry_t), "compacted %ld entries", num_entries);
+    db_close();
+
+    /* the compacted database is a base database */
+    char *path = get_test_path("compact.db");
+    FILE *fp = fopen(path, "r");
+    ck_assert(fp != NULL);
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        ck_assert_msg(strncmp(line, "@@delta_db", 10) && strncmp(line, "@@remove", 8), "compacted database contains '%s'", line);
+    }
+    fclose(fp);
+    free(path);
+
+    database db = { .url = new_file_url("compact.db") };
+    conf->num_database_in_deltas = 0;
+    conf->db_attrs = 0;
+    ck_assert(db_init(&db, true, false) == RETOK);
+    check_entries(&db, merged_entries, sizeof(merged_entries)/sizeof(merge_entry_t));
+}
+END_TEST
+
+START_TEST (test_compact_delta_fields) {
+    setup_delta_chain("base.db");
+
+    /* the last delta database has an additional field */
+    byte sha512[64];
+    for (size_t i = 0 ; i < sizeof(sha512) ; ++i) {
+        sha512[i] = i;
+    }
+    char *sha512_b64 = encode_base64(sha512, sizeof(sha512));
+    char *path = get_test_path("delta2.db");
+    FILE *fp = fopen(path, "w");
+    ck_assert(fp != NULL);
+    char *parent_hashsums = get_parent_hashsums("delta1.db");
+    fprintf(fp, "@@begin_db\n@@delta_db %s\n@@db_spec name attr perm size sha512\n", parent_hashsums);
+    fprintf(fp, "/a %llu %o 3 %s\n", LINE_ATTRS|ATTR(attr_sha512), S_IFREG|0644, sha512_b64);
+    fputs("@@remove /e\n", fp);
+    fprintf(fp, "/f %llu %o 3 0\n", LINE_ATTRS, S_IFREG|0644);
+    fputs("@@end_db\n", fp);
+    fclose(fp);
+    free(parent_hashsums);
+    free(sha512_b64);
+    free(path);
+
+    conf->action = DO_CONVERT|DO_COMPACT;
+    conf->database_out.url = new_file_url("compact.db");
+    ck_assert(db_init(&conf->database_in, true, false) == RETOK);
+    ck_assert(db_init(&conf->database_out, false, false) == RETOK);
+    long num_entries = db_convert(NULL, 0);
+    ck_assert_msg(num_entries == sizeof(merged_entries)/sizeof(merge_entry_t), "compacted %ld entries", num_entries);
+    db_close();
+
+    database db = { .url = new_file_url("compact.db") };
+    conf->num_database_in_deltas = 0;
+    conf->db_attrs = 0;
+    ck_assert(db_init(&db, true, false) == RETOK);
+    db_entry_t entry = db_readline(&db, false);
+    ck_assert_msg(entry.line != NULL && db_get_attrs(&db)&ATTR(attr_sha512), "sha512 field of delta database is missing");
+    ck_assert_msg(strcmp((entry.line)->filename, "/a") == 0 && (entry.line)->attr&ATTR(attr_sha512)
+            && (entry.line)->hashsums[hash_sha512] && memcmp((entry.line)->hashsums[hash_sha512], sha512, sizeof(sha512)) == 0,
+            "sha512 of '%s' has not been written", (entry.line)->filename);
+    free_db_line(entry.line);
+    free(entry.line);
+}
+END_TEST
+
+START_TEST (test_compact_unverified) {
+    setup_delta_chain("invalid");
+    conf->action = DO_CONVERT|DO_COMPACT;
+    conf->database_out.url = new_file_url("compact.db");
+
+    fflush(NULL);
+    pid_t pid = fork();
+    ck_assert(pid != -1);
+    if (pid == 0) {
+        if (db_init(&conf->database_in, true, false) == RETOK && db_init(&conf->database_out, false, false) == RETOK) {
+            db_convert(NULL, 0);
+            db_close();
+        }
+        _exit(0);
+    }
+    int status;
+    ck_assert(waitpid(pid, &status, 0) == pid);
+    ck_assert_msg(WIFEXITED(status) && WEXITSTATUS(status) == DATABASE_ERROR, "exit status %d (expected: %d)", WEXITSTATUS(status), DATABASE_ERROR);
+
+    char *path = get_test_path("compact.db");
+    ck_assert_msg(access(path, F_OK) == -1, "incompletely written database '%s' has not been removed", path);
+    free(path);
+}
+END_TEST
+
+Suite *make_db_merge_suite(void) {
+
+    Suite *s = suite_create ("db_merge");
+
+    TCase *tc_merge = tcase_create ("merge");
+    TCase *tc_compact = tcase_create ("compact");
+
+    tcase_add_checked_fixture(tc_merge, setup_test_dir, teardown_test_dir);
+    tcase_add_test (tc_merge, test_delta_merge);
+    tcase_add_test (tc_merge, test_kway_merge);
+
+    tcase_add_checked_fixture(tc_compact, setup_test_dir, teardown_test_dir);
+    tcase_add_test (tc_compact, test_compact);
+    tcase_add_test (tc_compact, test_compact_delta_fields);
+    tcase_add_test (tc_compact, test_compact_unverified);
+
+    suite_add_tcase (s, tc_merge);
+    suite_add_tcase (s, tc_compact);
+
+    return s;
+}
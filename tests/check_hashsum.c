@@ -98,24 +98,39 @@ static hashsum_test_t hashsum_tests[] = {
 
 static int num_hashsum_tests = sizeof hashsum_tests / sizeof(hashsum_test_t);
 
+/* parallel_hashsums_threshold values, 0 disables the helper threads */
+static long long parallel_thresholds[] = { 0, 1, 32 };
+
+static int num_parallel_thresholds = sizeof parallel_thresholds / sizeof(long long);
+
 START_TEST(test_hashsum) {
     char *dummy_filename = "<test:check_hashsum>";
     md_hashsums md;
 
+    hashsum_test_t *t = &hashsum_tests[_i % num_hashsum_tests];
+    long long threshold = parallel_thresholds[_i / num_hashsum_tests];
+
     struct md_container mdc;
     mdc.todo_attr = get_hashes(false);
     init_md(&mdc, dummy_filename, NULL);
-    update_md(&mdc, message, hashsum_tests[_i].size);
+    if (threshold > 0 && (long long) t->size >= threshold) {
+        init_md_parallel(&mdc, dummy_filename, NULL);
+    }
+    /* update in two blocks to check that the helpers process every block */
+    size_t half = t->size / 2;
+    update_md(&mdc, message, half);
+    update_md(&mdc, &message[half], t->size - half);
     close_md(&mdc, &md, dummy_filename, NULL);
 
     for (int i = 0; i < num_hashes; ++i) {
         if (algorithms[i] >= 0) {
             char *hashsum = byte_to_base16(md.hashsums[i], hashsums[i].length);
-            ck_assert_msg(stricmp(hashsum, hashsum_tests[_i].expected[i]) == 0,
+            ck_assert_msg(stricmp(hashsum, t->expected[i]) == 0,
                           "\n"
                           "%10s hashsum retruned: %s\n"
-                          "                   expected: %s",
-                          attributes[hashsums[i].attribute].config_name, hashsum, hashsum_tests[_i].expected[i]);
+                          "                   expected: %s\n"
+                          "                  threshold: %lld",
+                          attributes[hashsums[i].attribute].config_name, hashsum, t->expected[i], threshold);
             free(hashsum);
         }
     }
@@ -128,7 +143,7 @@ Suite *make_hashsum_suite(void) {
 
     TCase *tc_hashsum = tcase_create("hashsum");
 
-    tcase_add_loop_test(tc_hashsum, test_hashsum, 0, num_hashsum_tests);
+    tcase_add_loop_test(tc_hashsum, test_hashsum, 0, num_hashsum_tests * num_parallel_thresholds);
 
     suite_add_tcase(s, tc_hashsum);
 
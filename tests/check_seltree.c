@@ -49,15 +49,26 @@ static seltree *add_rules(check_seltree_rule_t rules[], size_t num_of_rules) {
     return tree;
 }
 
-static void test_rules(seltree *tree, check_seltree_test_t tests[], size_t num_of_tests) {
+static void _test_rules(seltree *tree, check_seltree_test_t tests[], size_t num_of_tests, const char *tree_type) {
     for (size_t i = 0 ; i < num_of_tests ; i++) {
-        log_msg(LOG_LEVEL_RULE, "\u252c check '%s' (filetype: %c)", tests[i].file.name, get_f_type_char_from_f_type(tests[i].file.type));
+        log_msg(LOG_LEVEL_RULE, "\u252c check '%s' (filetype: %c, tree: %s)", tests[i].file.name, get_f_type_char_from_f_type(tests[i].file.type), tree_type);
         match_t match = check_seltree(tree, tests[i].file, true, NULL);
         log_msg(LOG_LEVEL_RULE, "\u2534 result: %s", get_match_result_string(match.result));
 
-        ck_assert_msg(tests[i].expected_match == match.result , "check_seltree %s (f_type: %c): returned %s (%d) (expected: %s (%d))",
-                tests[i].file.name, get_f_type_char_from_f_type(tests[i].file.type), get_match_result_string(match.result), match.result, get_match_result_string(tests[i].expected_match), tests[i].expected_match);
+        ck_assert_msg(tests[i].expected_match == match.result , "check_seltree %s (f_type: %c, tree: %s): returned %s (%d) (expected: %s (%d))",
+                tests[i].file.name, get_f_type_char_from_f_type(tests[i].file.type), tree_type, get_match_result_string(match.result), match.result, get_match_result_string(tests[i].expected_match), tests[i].expected_match);
+    }
+}
+
+static void test_rules(seltree *tree, check_seltree_test_t tests[], size_t num_of_tests) {
+    _test_rules(tree, tests, num_of_tests, "plain");
+
+    compile_seltree(tree);
+    /* nodes added while scanning must not change the result */
+    for (size_t i = 0 ; i < num_of_tests ; i++) {
+        get_or_create_seltree_node(tree, tests[i].file.name);
     }
+    _test_rules(tree, tests, num_of_tests, "compiled");
 }
 START_TEST (test_unrestricted_equal_rule) {
     log_msg(LOG_LEVEL_INFO, "test_unrestricted_equal_rule");
@@ -535,6 +546,38 @@ START_TEST (test_f_type_restricted_forbid_root) {
 }
 END_TEST
 
+START_TEST (test_literal_rules) {
+    char *regexes[] = { "/dev", "/dev$", "/etc/pass\\.wd", "/etc/pass\\.wd$", "/\\+x", "/\xc3\xa4$", "/" };
+    char *names[] = { "/", "/d", "/dev", "/dev\n", "/dev\n\n", "/devX", "/dev/sda", "/etc", "/etc/pass", "/etc/pass.", "/etc/pass.wd",
+        "/etc/pass.wdX", "/etc/passXwd", "/+x", "/+", "/\xc3", "/\xc3\xa4", "/\xc3\xa4\n", "/\xc3\xa4/x", "/de\xff", "/dev\xc0\x80" };
+
+    for (size_t i = 0 ; i < sizeof(regexes)/sizeof(char*) ; i++) {
+        int pcre2_errorcode;
+        PCRE2_SIZE pcre2_erroffset;
+        rx_rule rule = { .rx = regexes[i] };
+        rule.crx = pcre2_compile((PCRE2_SPTR) rule.rx, PCRE2_ZERO_TERMINATED, PCRE2_UTF|PCRE2_ANCHORED, &pcre2_errorcode, &pcre2_erroffset, NULL);
+        ck_assert_msg(rule.crx != NULL, "failed to compile '%s'", rule.rx);
+        init_rx_literal(&rule);
+        ck_assert_msg(rule.literal != NULL, "'%s' not detected as literal", rule.rx);
+        pcre2_match_data *md = pcre2_match_data_create_from_pattern(rule.crx, NULL);
+        for (size_t j = 0 ; j < sizeof(names)/sizeof(char*) ; j++) {
+            int expected = pcre2_match(rule.crx, (PCRE2_SPTR) names[j], PCRE2_ZERO_TERMINATED, 0, PCRE2_PARTIAL_SOFT, md, NULL);
+            int result = match_rx_rule(&rule, names[j]);
+            ck_assert_msg((expected >= 0) == (result >= 0) && (expected == PCRE2_ERROR_PARTIAL) == (result == PCRE2_ERROR_PARTIAL),
+                    "literal match of '%s' against '%s' returned %d (expected (pcre2_match): %d)", rule.rx, names[j], result, expected);
+        }
+        pcre2_match_data_free(md);
+    }
+
+    char *non_literals[] = { "/dev.", "/d[e]v", "/dev/.*", "/\\d", "/(dev)", "/dev|/etc", "/de?v", "/dev$x", "/dev{1}" };
+    for (size_t i = 0 ; i < sizeof(non_literals)/sizeof(char*) ; i++) {
+        rx_rule rule = { .rx = non_literals[i] };
+        init_rx_literal(&rule);
+        ck_assert_msg(rule.literal == NULL, "'%s' detected as literal", rule.rx);
+    }
+}
+END_TEST
+
 Suite *make_seltree_suite(void) {
 
     Suite *s = suite_create ("seltree");
@@ -567,6 +610,8 @@ Suite *make_seltree_suite(void) {
     tcase_add_test(tc_check_seltree, test_f_type_restricted_deep_selective_rule);
     tcase_add_test(tc_check_seltree, test_f_type_restricted_forbid_root);
 
+    tcase_add_test(tc_check_seltree, test_literal_rules);
+
     suite_add_tcase (s, tc_check_seltree);
 
     return s;
@@ -0,0 +1,417 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2025 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <check.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "attributes.h"
+#include "check_aide.h"
+#include "db.h"
+#include "db_config.h"
+#include "errorcodes.h"
+#include "log.h"
+#include "rx_rule.h"
+#include "shard.h"
+#include "util.h"
+
+extern db_config* conf;
+
+#define LINE_ATTRS (ATTR(attr_filename)|ATTR(attr_perm))
+
+static void write_file(const char *name, const char *content) {
+    char *path = get_test_path(name);
+    FILE *fp = fopen(path, "w");
+    ck_assert(fp != NULL);
+    fputs(content, fp);
+    fclose(fp);
+    free(path);
+}
+
+/* writes a text database, paths ending with '/' are written as directories */
+static void write_db(const char *name, const char **paths, size_t num_paths) {
+    char *path = get_test_path(name);
+    FILE *fp = fopen(path, "w");
+    ck_assert(fp != NULL);
+    fputs("@@begin_db\n@@db_spec name attr perm\n", fp);
+    for (size_t i = 0 ; i < num_paths ; ++i) {
+        size_t len = strlen(paths[i]);
+        bool dir = len > 1 && paths[i][len-1] == '/';
+        fprintf(fp, "%.*s %llu %o\n", (int) (dir ? len - 1 : len), paths[i], LINE_ATTRS, dir || len == 1 ? S_IFDIR|0755 : S_IFREG|0644);
+    }
+    fputs("@@end_db\n", fp);
+    fclose(fp);
+    free(path);
+}
+
+/* plan */
+
+#define NUM_PLAN_SHARDS 3
+
+static char **plan_paths = NULL;
+static size_t num_plan_paths = 0;
+
+static void add_plan_path(const char *format, const char *dir, int i) {
+    plan_paths = checked_realloc(plan_paths, (num_plan_paths + 1) * sizeof(char *));
+    plan_paths[num_plan_paths] = checked_malloc(64);
+    snprintf(plan_paths[num_plan_paths++], 64, format, dir, i);
+}
+
+static void free_plan_paths(void) {
+    for (size_t i = 0 ; i < num_plan_paths ; ++i) {
+        free(plan_paths[i]);
+    }
+    free(plan_paths);
+    plan_paths = NULL;
+    num_plan_paths = 0;
+}
+
+/* writes 'plan.db' and returns the path of the shard plan written for it */
+static char *write_plan(void) {
+    /* the directories are written with a trailing '/' (see write_db()) */
+    const struct { const char *dir; int num_files; } dirs[] = {
+        { "/a", 30 }, { "/b", 20 }, { "/c", 0 }, { "/c/x", 15 }, { "/c/y", 15 },
+    };
+    add_plan_path("%s", "/", 0);
+    for (size_t d = 0 ; d < sizeof(dirs)/sizeof(dirs[0]) ; ++d) {
+        add_plan_path("%s/", dirs[d].dir, 0);
+        for (int i = 0 ; i < dirs[d].num_files ; ++i) {
+            add_plan_path("%s/f%02d", dirs[d].dir, i);
+        }
+    }
+    add_plan_path("%s", "/d", 0);
+    write_db("plan.db", (const char **) plan_paths, num_plan_paths);
+
+    conf->database_in.url = new_file_url("plan.db");
+    ck_assert(db_init(&conf->database_in, true, false) == RETOK);
+    char *plan_file = get_test_path("plan");
+    FILE *fp = fopen(plan_file, "w");
+    ck_assert(fp != NULL);
+    ck_assert(shard_plan_write(&conf->database_in, NUM_PLAN_SHARDS, fp) == RETOK);
+    fclose(fp);
+    db_close();
+    return plan_file;
+}
+
+START_TEST (test_plan) {
+    char *plan_file = write_plan();
+
+    /* every path is part of exactly one shard */
+    shard_plan_t *plans[NUM_PLAN_SHARDS];
+    for (int s = 0 ; s < NUM_PLAN_SHARDS ; ++s) {
+        plans[s] = shard_plan_load(plan_file, s);
+        ck_assert_msg(plans[s] != NULL, "failed to load shard %d of written shard plan", s);
+    }
+    size_t num_shard_paths[NUM_PLAN_SHARDS] = { 0 };
+    for (size_t i = 0 ; i < num_plan_paths ; ++i) {
+        size_t len = strlen(plan_paths[i]);
+        if (len > 1 && plan_paths[i][len-1] == '/') {
+            plan_paths[i][len-1] = '\0';
+        }
+        int shard = -1;
+        for (int s = 0 ; s < NUM_PLAN_SHARDS ; ++s) {
+            if (shard_check(plans[s], plan_paths[i]) == 0) {
+                ck_assert_msg(shard == -1, "'%s' is part of shard %d and %d", plan_paths[i], shard, s);
+                shard = s;
+            }
+        }
+        ck_assert_msg(shard != -1, "'%s' is not part of any shard", plan_paths[i]);
+        num_shard_paths[shard]++;
+    }
+    for (int s = 0 ; s < NUM_PLAN_SHARDS ; ++s) {
+        ck_assert_msg(num_shard_paths[s] > 0, "shard %d is empty", s);
+        shard_plan_free(plans[s]);
+    }
+    ck_assert_msg(shard_plan_load(plan_file, NUM_PLAN_SHARDS) == NULL, "shard %d of %d shards loaded", NUM_PLAN_SHARDS, NUM_PLAN_SHARDS);
+
+    free_plan_paths();
+    free(plan_file);
+}
+END_TEST
+
+/* shard_check */
+
+static const char *check_plan =
+    "# subtrees of shard 1 and 2\n"
+    "@@aide_shard_plan 1 3\n"
+    "1 10 /a\n"
+    "2 5 /ab\n"
+    "1 5 /c/d\n"
+    "2 5 /c/d-e\n";
+
+typedef struct {
+    int shard;
+    const char *path;
+    match_result expected;
+} shard_check_test_t;
+
+static shard_check_test_t shard_check_tests[] = {
+    { 1, "/a",        0 },
+    { 1, "/a/x",      0 },
+    { 1, "/a/x/y",    0 },
+    { 1, "/ab",       RESULT_NO_LIMIT_MATCH },
+    { 1, "/ab/x",     RESULT_NO_LIMIT_MATCH },
+    { 1, "/a-b",      RESULT_NO_LIMIT_MATCH },
+    { 1, "/b",        RESULT_NO_LIMIT_MATCH },
+    { 1, "/",         RESULT_PARTIAL_LIMIT_MATCH },
+    { 1, "/c",        RESULT_PARTIAL_LIMIT_MATCH },
+    { 1, "/c/d",      0 },
+    { 1, "/c/d/e",    0 },
+    { 1, "/c/de",     RESULT_NO_LIMIT_MATCH },
+    { 1, "/c/d-e",    RESULT_NO_LIMIT_MATCH },
+    { 2, "/ab",       0 },
+    { 2, "/ab/x",     0 },
+    { 2, "/a",        RESULT_NO_LIMIT_MATCH },
+    { 2, "/a/b",      RESULT_NO_LIMIT_MATCH },
+    { 2, "/c",        RESULT_PARTIAL_LIMIT_MATCH },
+    { 2, "/c/d",      RESULT_NO_LIMIT_MATCH },
+    { 2, "/c/d-e/f",  0 },
+    /* shard 0 owns everything not below a subtree of another shard */
+    { 0, "/",         0 },
+    { 0, "/a",        RESULT_NO_LIMIT_MATCH },
+    { 0, "/a/x",      RESULT_NO_LIMIT_MATCH },
+    { 0, "/ab/x",     RESULT_NO_LIMIT_MATCH },
+    { 0, "/a-b",      0 },
+    { 0, "/b",        0 },
+    { 0, "/c",        0 },
+    { 0, "/c/de",     0 },
+    { 0, "/c/d/e",    RESULT_NO_LIMIT_MATCH },
+    { 0, "/z",        0 },
+};
+
+START_TEST (test_shard_check) {
+    shard_check_test_t t = shard_check_tests[_i];
+    write_file("plan", check_plan);
+    char *plan_file = get_test_path("plan");
+    shard_plan_t *plan = shard_plan_load(plan_file, t.shard);
+    ck_assert(plan != NULL);
+    match_result result = shard_check(plan, t.path);
+    ck_assert_msg(result == t.expected, "shard %d: '%s': %s (expected: %s)", t.shard, t.path,
+            get_match_result_string(result), get_match_result_string(t.expected));
+    shard_plan_free(plan);
+    free(plan_file);
+}
+END_TEST
+
+typedef struct {
+    const char *desc;
+    const char *plan;
+    int shard;
+} invalid_plan_test_t;
+
+static invalid_plan_test_t invalid_plan_tests[] = {
+    { "missing header",      "1 10 /a\n", 1 },
+    { "empty plan",          "# no subtrees\n", 0 },
+    { "unsupported version", "@@aide_shard_plan 2 3\n1 10 /a\n", 1 },
+    { "no shards",           "@@aide_shard_plan 1 0\n", 0 },
+    { "invalid shard",       "@@aide_shard_plan 1 3\n3 10 /a\n", 1 },
+    { "relative path",       "@@aide_shard_plan 1 3\n1 10 a\n", 1 },
+    { "missing count",       "@@aide_shard_plan 1 3\n1 /a\n", 1 },
+    { "shard not in plan",   "@@aide_shard_plan 1 3\n1 10 /a\n", 3 },
+};
+
+START_TEST (test_invalid_plan) {
+    invalid_plan_test_t t = invalid_plan_tests[_i];
+    write_file("plan", t.plan);
+    char *plan_file = get_test_path("plan");
+    shard_plan_t *plan = shard_plan_load(plan_file, t.shard);
+    ck_assert_msg(plan == NULL, "%s: shard plan loaded", t.desc);
+    free(plan_file);
+}
+END_TEST
+
+/* merge */
+
+static void init_shards(const char **shard_paths[], size_t num_paths[], int num_shards) {
+    conf->num_database_in_shards = num_shards;
+    conf->database_in_shards = checked_calloc(num_shards, sizeof(database));
+    char name[16];
+    for (int s = 0 ; s < num_shards ; ++s) {
+        snprintf(name, sizeof(name), "shard%d.db", s);
+        write_db(name, shard_paths[s], num_paths[s]);
+        conf->database_in_shards[s].url = new_file_url(name);
+    }
+    conf->action = DO_CONVERT|DO_MERGE;
+    conf->database_out.url = new_file_url("merged.db");
+}
+
+static long merge_shards(void) {
+    database **shards = checked_malloc(conf->num_database_in_shards * sizeof(database *));
+    for (int s = 0 ; s < conf->num_database_in_shards ; ++s) {
+        ck_assert(db_init(&conf->database_in_shards[s], true, false) == RETOK);
+        shards[s] = &conf->database_in_shards[s];
+    }
+    ck_assert(db_init(&conf->database_out, false, false) == RETOK);
+    long num_entries = db_convert(shards, conf->num_database_in_shards);
+    db_close();
+    free(shards);
+    return num_entries;
+}
+
+START_TEST (test_merge) {
+    const char *shard0[] = { "/", "/a-b", "/c/" };
+    const char *shard1[] = { "/a/", "/a/x", "/c/d/" };
+    const char *shard2[] = { "/ab/", "/c/d-e" };
+    const char **shard_paths[] = { shard0, shard1, shard2 };
+    size_t num_paths[] = { 3, 3, 2 };
+    init_shards(shard_paths, num_paths, 3);
+    ck_assert(merge_shards() == 8);
+
+    const char *expected[] = { "/", "/a", "/a/x", "/a-b", "/ab", "/c", "/c/d", "/c/d-e" };
+    database db = { .url = new_file_url("merged.db") };
+    conf->num_database_in_shards = 0;
+    ck_assert(db_init(&db, true, false) == RETOK);
+    db_entry_t entry;
+    size_t num = 0;
+    while ((entry = db_readline(&db, false)).line != NULL) {
+        ck_assert_msg(num < 8 && strcmp((entry.line)->filename, expected[num]) == 0,
+                "entry #%zu: '%s' (expected: '%s')", num, (entry.line)->filename, num < 8 ? expected[num] : "(none)");
+        free_db_line(entry.line);
+        free(entry.line);
+        num++;
+    }
+    ck_assert_msg(num == 8, "merged database contains %zu entries (expected: 8)", num);
+}
+END_TEST
+
+START_TEST (test_merge_overlapping) {
+    const char *shard0[] = { "/", "/a/", "/b" };
+    const char *shard1[] = { "/a/", "/a/x" };
+    const char **shard_paths[] = { shard0, shard1 };
+    size_t num_paths[] = { 3, 2 };
+    init_shards(shard_paths, num_paths, 2);
+
+    fflush(NULL);
+    pid_t pid = fork();
+    ck_assert(pid != -1);
+    if (pid == 0) {
+        merge_shards();
+        _exit(0);
+    }
+    int status;
+    ck_assert(waitpid(pid, &status, 0) == pid);
+    ck_assert_msg(WIFEXITED(status) && WEXITSTATUS(status) == DATABASE_ERROR,
+            "overlapping shards merged (exit status: %d, expected: %d)", WEXITSTATUS(status), DATABASE_ERROR);
+}
+END_TEST
+
+/* returns the database lines following the '@@db_spec' line */
+static char *read_entries(const char *name) {
+    char *path = get_test_path(name);
+    FILE *fp = fopen(path, "r");
+    ck_assert(fp != NULL);
+    free(path);
+    char *data = checked_strdup("");
+    size_t len = 0;
+    bool header = true;
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t n;
+    while ((n = getline(&line, &line_size, fp)) != -1) {
+        if (header) {
+            header = strncmp(line, "@@db_spec", 9) != 0;
+        } else {
+            data = checked_realloc(data, len + n + 1);
+            memcpy(data + len, line, n + 1);
+            len += n;
+        }
+    }
+    free(line);
+    fclose(fp);
+    return data;
+}
+
+START_TEST (test_merge_plan) {
+    char *plan_file = write_plan();
+
+    /* split 'plan.db' into the shards of the plan */
+    const char **shard_paths[NUM_PLAN_SHARDS];
+    size_t num_paths[NUM_PLAN_SHARDS] = { 0 };
+    for (int s = 0 ; s < NUM_PLAN_SHARDS ; ++s) {
+        shard_plan_t *plan = shard_plan_load(plan_file, s);
+        ck_assert(plan != NULL);
+        shard_paths[s] = checked_malloc(num_plan_paths * sizeof(char *));
+        for (size_t i = 0 ; i < num_plan_paths ; ++i) {
+            char path[64];
+            size_t len = strlen(plan_paths[i]);
+            snprintf(path, sizeof(path), "%.*s", (int) (len > 1 && plan_paths[i][len-1] == '/' ? len - 1 : len), plan_paths[i]);
+            if (shard_check(plan, path) == 0) {
+                shard_paths[s][num_paths[s]++] = plan_paths[i];
+            }
+        }
+        shard_plan_free(plan);
+    }
+    init_shards(shard_paths, num_paths, NUM_PLAN_SHARDS);
+    ck_assert(merge_shards() == (long) num_plan_paths);
+
+    conf->num_database_in_shards = 0;
+    conf->action = DO_CONVERT;
+    conf->database_in = (database) { .url = new_file_url("plan.db") };
+    conf->database_out = (database) { .url = new_file_url("direct.db") };
+    ck_assert(db_init(&conf->database_in, true, false) == RETOK);
+    ck_assert(db_init(&conf->database_out, false, false) == RETOK);
+    ck_assert(db_convert(NULL, 0) == (long) num_plan_paths);
+    db_close();
+
+    char *merged = read_entries("merged.db");
+    char *direct = read_entries("direct.db");
+    ck_assert_msg(strcmp(merged, direct) == 0, "merged shards differ from the converted database:\n%s\nvs.\n%s", merged, direct);
+    free(merged);
+    free(direct);
+
+    for (int s = 0 ; s < NUM_PLAN_SHARDS ; ++s) {
+        free(shard_paths[s]);
+    }
+    free_plan_paths();
+    free(plan_file);
+}
+END_TEST
+
+Suite *make_shard_suite(void) {
+
+    Suite *s = suite_create ("shard");
+
+    TCase *tc_plan = tcase_create ("plan");
+    TCase *tc_check = tcase_create ("check");
+    TCase *tc_merge = tcase_create ("merge");
+
+    tcase_add_checked_fixture(tc_plan, setup_test_dir, teardown_test_dir);
+    tcase_add_test (tc_plan, test_plan);
+    tcase_add_loop_test (tc_plan, test_invalid_plan, 0, sizeof(invalid_plan_tests)/sizeof(invalid_plan_test_t));
+
+    tcase_add_checked_fixture(tc_check, setup_test_dir, teardown_test_dir);
+    tcase_add_loop_test (tc_check, test_shard_check, 0, sizeof(shard_check_tests)/sizeof(shard_check_test_t));
+
+    tcase_add_checked_fixture(tc_merge, setup_test_dir, teardown_test_dir);
+    tcase_add_test (tc_merge, test_merge);
+    tcase_add_test (tc_merge, test_merge_overlapping);
+    tcase_add_test (tc_merge, test_merge_plan);
+
+    suite_add_tcase (s, tc_plan);
+    suite_add_tcase (s, tc_check);
+    suite_add_tcase (s, tc_merge);
+
+    return s;
+}